@@ -30,6 +30,7 @@
 
 #include <apr_pools.h>
 #include <apr_hash.h>
+#include <apr_global_mutex.h>
 
 #include "svn_types.h"
 #include "svn_error.h"
@@ -270,6 +271,48 @@ svn_cache__make_memcache_from_config(svn_memcache_t **memcache_p,
                                      apr_pool_t *result_pool,
                                      apr_pool_t *scratch_pool);
 
+/**
+ * Creates a new cache in @a *cache_p that keeps its entries as files in
+ * @a directory, such that they survive process restarts.  Entries will be
+ * stored LZ4-compressed.  Once the total size of all files in @a directory
+ * exceeds @a max_size bytes, the least recently used entries get removed.
+ *
+ * If @a front is not @c NULL, it will be used as a first-level cache:
+ * lookups will try @a front first and entries read from disk will be
+ * added to it.  All writes go to both, @a front and the disk.
+ *
+ * The elements in the cache will be indexed by keys of length @a klen,
+ * which may be APR_HASH_KEY_STRING if they are strings.  Values will be
+ * serialized for the disk using @a serialize_func and deserialized using
+ * @a deserialize_func, which must match those used by @a front.  Because
+ * the same @a directory may be shared by many caches and repositories,
+ * @a prefix must be specified to differentiate this cache from others.
+ * @a *cache_p will be allocated in @a result_pool.  Use @a scratch_pool
+ * for temporary allocations.
+ *
+ * If @a deserialize_func is NULL, then the data is returned as an
+ * svn_stringbuf_t; if @a serialize_func is NULL, then the data is
+ * assumed to be an svn_stringbuf_t.
+ *
+ * Any number of threads and processes may share the same @a directory.
+ * Missing sub-directories will be created on demand.
+ *
+ * These caches do not support svn_cache__iter.
+ *
+ * @since New in 1.15.
+ */
+svn_error_t *
+svn_cache__create_persistent(svn_cache__t **cache_p,
+                             svn_cache__t *front,
+                             const char *directory,
+                             apr_uint64_t max_size,
+                             svn_cache__serialize_func_t serialize_func,
+                             svn_cache__deserialize_func_t deserialize_func,
+                             apr_ssize_t klen,
+                             const char *prefix,
+                             apr_pool_t *result_pool,
+                             apr_pool_t *scratch_pool);
+
 /**
  * Creates a new membuffer cache object in @a *cache. It will contain
  * up to @a total_size bytes of data, using @a directory_size bytes
@@ -310,6 +353,67 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
                                   svn_boolean_t allow_blocking_writes,
                                   apr_pool_t *result_pool);
 
+/**
+ * Like svn_cache__membuffer_cache_create() but place all cache data
+ * in an anonymous shared memory segment and serialize access with
+ * cross-process mutexes.  The result is always thread-safe.
+ *
+ * Processes forked after this call will share the cache contents with
+ * the creating process and each other.  They must call
+ * svn_cache__membuffer_child_init() first.  Shared memory and mutexes will
+ * be released when @a result_pool gets cleaned up in the creating
+ * process.  Forked processes will not release them.
+ *
+ * Return #SVN_ERR_UNSUPPORTED_FEATURE if shared caches are not supported
+ * on this platform.
+ *
+ * @since New in 1.15.
+ */
+svn_error_t *
+svn_cache__membuffer_cache_create_shared(svn_membuffer_t **cache,
+                                         apr_size_t total_size,
+                                         apr_size_t directory_size,
+                                         apr_size_t segment_count,
+                                         svn_boolean_t allow_blocking_writes,
+                                         apr_pool_t *result_pool);
+
+/**
+ * Prepare the shared membuffer @a cache for use in a process that has
+ * been forked after its creation.  Each such process must call this once
+ * before accessing the cache.  @a pool must live as long as the process
+ * uses @a cache.
+ *
+ * This is a no-op for process-local caches and if @a cache is @c NULL.
+ *
+ * @since New in 1.15.
+ */
+svn_error_t *
+svn_cache__membuffer_child_init(svn_membuffer_t *cache,
+                                apr_pool_t *pool);
+
+/**
+ * Callback type for svn_cache__membuffer_visit_mutexes().
+ *
+ * @since New in 1.15.
+ */
+typedef apr_status_t (*svn_cache__mutex_visitor_t)(void *baton,
+                                                   apr_global_mutex_t *mutex);
+
+/**
+ * Call @a visitor with @a baton for each of the cross-process mutexes of
+ * the shared membuffer @a cache.  Servers that create the cache before
+ * switching to a different user ID may use this to adjust the access
+ * rights of the mutexes.
+ *
+ * This is a no-op for process-local caches and if @a cache is @c NULL.
+ *
+ * @since New in 1.15.
+ */
+svn_error_t *
+svn_cache__membuffer_visit_mutexes(svn_membuffer_t *cache,
+                                   svn_cache__mutex_visitor_t visitor,
+                                   void *baton);
+
 /**
  * @defgroup Standard priority classes for #svn_cache__create_membuffer_cache.
  * @{
@@ -554,6 +658,22 @@ svn_cache__format_info(const svn_cache__info_t *info,
 struct svn_membuffer_t *
 svn_cache__get_global_membuffer_cache(void);
 
+/**
+ * Request that the process-global membuffer cache be created in shared
+ * memory if @a shared is set.  This only has an effect if called before
+ * the first call to svn_cache__get_global_membuffer_cache().
+ *
+ * Pre-forking servers should call this followed by
+ * svn_cache__get_global_membuffer_cache() before forking any workers
+ * and pass that cache to svn_cache__membuffer_child_init() in each
+ * worker.  They will then all use the same cache.  If a shared cache can't be
+ * created, a process-local cache will be used instead.
+ *
+ * @since New in 1.15.
+ */
+void
+svn_cache__set_global_membuffer_shared(svn_boolean_t shared);
+
 /**
  * Return total access and size stats over all membuffer caches as they
  * share the underlying data buffer.  The result will be allocated in POOL.
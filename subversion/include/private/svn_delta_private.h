@@ -101,6 +101,27 @@ svn_delta__delta_from_editor(const svn_delta_editor_t **deditor,
                              struct svn_delta__extra_baton *exb,
                              apr_pool_t *pool);
 
+/** Like svn_txdelta_to_svndiff3() but compress up to @a max_threads
+ * consecutive windows concurrently.  The output will be identical to
+ * that of svn_txdelta_to_svndiff3().
+ *
+ * The windows get copied and compressed in a process-wide thread pool
+ * while @a handler returns immediately unless that would exceed the
+ * @a max_threads limit of windows in flight.  Output is written in
+ * window order by the thread calling @a handler.
+ *
+ * Without thread support, for svndiff version 0 and for @a max_threads
+ * smaller than 2, this is equivalent to svn_txdelta_to_svndiff3().
+ */
+svn_error_t *
+svn_txdelta__to_svndiff_parallel(svn_txdelta_window_handler_t *handler,
+                                 void **handler_baton,
+                                 svn_stream_t *output,
+                                 int svndiff_version,
+                                 int compression_level,
+                                 int max_threads,
+                                 apr_pool_t *pool);
+
 /** Read the txdelta window header from @a stream and return the total
     length of the unparsed window data in @a *window_len. */
 svn_error_t *
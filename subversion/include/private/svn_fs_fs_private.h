@@ -313,6 +313,14 @@ typedef struct svn_fs_fs__ioctl_get_stats_input_t
 {
   svn_fs_progress_notify_func_t progress_func;
   void *progress_baton;
+
+  /* Number of pack files / shards to read concurrently.  0 or 1 for a
+   * single-threaded scan. */
+  int jobs;
+
+  /* If not NULL, keep the results per pack file in this folder and reuse
+   * them in later runs. */
+  const char *state_dir;
 } svn_fs_fs__ioctl_get_stats_input_t;
 
 typedef struct svn_fs_fs__ioctl_get_stats_output_t
@@ -364,6 +372,52 @@ typedef struct svn_fs_fs__ioctl_build_rep_cache_input_t
 /* See svn_fs_fs__build_rep_cache(). */
 SVN_FS_DECLARE_IOCTL_CODE(SVN_FS_FS__IOCTL_BUILD_REP_CACHE, SVN_FS_TYPE_FSFS, 1004);
 
+/* Block-read read-ahead statistics of a given svn_fs_t.
+ */
+typedef struct svn_fs_fs__read_ahead_stats_t
+{
+  /* Number of block-read requests, i.e. items that had to be read because
+   * they were not found in the cache. */
+  apr_uint64_t requests;
+
+  /* Number of blocks that have been read ahead. */
+  apr_uint64_t blocks_prefetched;
+
+  /* Number of read-ahead blocks that the access pattern reached later,
+   * i.e. that were read ahead in time. */
+  apr_uint64_t hits;
+
+  /* Number of read-ahead blocks that the access pattern did not reach
+   * because it changed before. */
+  apr_uint64_t misses;
+} svn_fs_fs__read_ahead_stats_t;
+
+typedef struct svn_fs_fs__ioctl_get_read_ahead_stats_output_t
+{
+  svn_fs_fs__read_ahead_stats_t stats;
+} svn_fs_fs__ioctl_get_read_ahead_stats_output_t;
+
+/* See svn_fs_fs__get_read_ahead_stats(). */
+SVN_FS_DECLARE_IOCTL_CODE(SVN_FS_FS__IOCTL_GET_READ_AHEAD_STATS, SVN_FS_TYPE_FSFS, 1005);
+
+typedef struct svn_fs_fs__ioctl_build_mergeinfo_index_input_t
+{
+  svn_fs_progress_notify_func_t progress_func;
+  void *progress_baton;
+} svn_fs_fs__ioctl_build_mergeinfo_index_input_t;
+
+/* See svn_fs_fs__build_mergeinfo_index(). */
+SVN_FS_DECLARE_IOCTL_CODE(SVN_FS_FS__IOCTL_BUILD_MERGEINFO_INDEX, SVN_FS_TYPE_FSFS, 1006);
+
+typedef struct svn_fs_fs__ioctl_build_history_index_input_t
+{
+  svn_fs_progress_notify_func_t progress_func;
+  void *progress_baton;
+} svn_fs_fs__ioctl_build_history_index_input_t;
+
+/* See svn_fs_fs__build_history_index(). */
+SVN_FS_DECLARE_IOCTL_CODE(SVN_FS_FS__IOCTL_BUILD_HISTORY_INDEX, SVN_FS_TYPE_FSFS, 1007);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -212,6 +212,34 @@ svn_fs__get_deleted_node(svn_fs_root_t **node_root,
                          apr_pool_t *scratch_pool);
 
 
+/** Attempt to locate the stored contents of the file @a path under
+ * @a root such that they can be copied verbatim, e.g. using sendfile().
+ *
+ * If the back-end supports this and the contents are stored either as
+ * plain fulltext or as an svndiff stream against the empty source, set
+ * @a *success to TRUE.  Then, @a *file will be an open file containing
+ * the data, which start at @a *offset and are @a *length bytes long.
+ * If those bytes are an svndiff stream (including its header), its format
+ * version will be returned in @a *svndiff_version.  If they are the
+ * fulltext, @a *svndiff_version will be -1.  Otherwise, set @a *success
+ * to FALSE and leave the other outputs untouched.
+ *
+ * Callers must not change the file pointer of @a *file but use
+ * positional I/O only.  @a *file will be allocated in @a result_pool
+ * and remain open until that pool gets cleaned up.  Use @a scratch_pool
+ * for temporary allocations.
+ */
+svn_error_t *
+svn_fs__try_get_file_range(svn_boolean_t *success,
+                           apr_file_t **file,
+                           apr_off_t *offset,
+                           svn_filesize_t *length,
+                           int *svndiff_version,
+                           svn_fs_root_t *root,
+                           const char *path,
+                           apr_pool_t *result_pool,
+                           apr_pool_t *scratch_pool);
+
 /** @} */
 
 
@@ -146,6 +146,34 @@ svn_ra_svn__set_shim_callbacks(svn_ra_svn_conn_t *conn,
 apr_pool_t *
 svn_ra_svn__get_pool(svn_ra_svn_conn_t *conn);
 
+/**
+ * Attempt to send the contents of a file as text delta for the window
+ * @a handler and @a handler_baton returned by the apply_textdelta()
+ * function of an editor created by svn_ra_svn_get_editor().  The data are
+ * @a length bytes in @a file, starting at @a offset, and get written to the
+ * network connection directly, i.e. using sendfile() where available.
+ *
+ * If @a svndiff_version is -1, the data is the fulltext.  Otherwise, it is
+ * a self-contained svndiff stream of that format version, including its
+ * header.  The latter will only be forwarded if the client supports it.
+ *
+ * Set @a *sent to TRUE if the data has been sent and the text delta has
+ * been completed.  Set it to FALSE if @a handler does not belong to such
+ * an editor, if it has already been called or if the client cannot accept
+ * the data; the caller must then send the delta through @a handler.
+ *
+ * Use @a scratch_pool for temporary allocations.
+ */
+svn_error_t *
+svn_ra_svn__try_send_file_range(svn_boolean_t *sent,
+                                svn_txdelta_window_handler_t handler,
+                                void *handler_baton,
+                                apr_file_t *file,
+                                apr_off_t offset,
+                                svn_filesize_t length,
+                                int svndiff_version,
+                                apr_pool_t *scratch_pool);
+
 /**
  * @defgroup ra_svn_deprecated ra_svn low-level functions
  * @{
@@ -596,6 +624,21 @@ svn_ra_svn__write_cmd_textdelta_chunk(svn_ra_svn_conn_t *conn,
                                       const svn_string_t *token,
                                       const svn_string_t *chunk);
 
+/** Like svn_ra_svn__write_cmd_textdelta_chunk() but take the @a len bytes
+ * of chunk data from @a file, starting at @a offset.  If the connection
+ * is a plain socket, the data will be sent using sendfile().  Otherwise,
+ * it gets copied through a buffer.  In the latter case, the file pointer
+ * of @a file will be modified.
+ * Use @a pool for allocations.
+ */
+svn_error_t *
+svn_ra_svn__write_cmd_textdelta_chunk_file(svn_ra_svn_conn_t *conn,
+                                           apr_pool_t *pool,
+                                           const svn_string_t *token,
+                                           apr_file_t *file,
+                                           apr_off_t offset,
+                                           svn_filesize_t len);
+
 /** Send a "textdelta-end" command over connection @a conn.  Ends the
  * series of text deltas to be applied to the file identified by @a token.
  * Use @a pool for allocations.
@@ -390,6 +390,40 @@ svn_repos__get_dump_editor(const svn_delta_editor_t **editor,
                            const char *update_anchor_relpath,
                            apr_pool_t *pool);
 
+/**
+ * Callback type used by the reporter to send file contents that are
+ * available as a range of @a length bytes in @a file, starting at
+ * @a offset, directly to the window @a handler with its @a handler_baton.
+ * @a svndiff_version is -1 if the data is the fulltext and the svndiff
+ * format version otherwise.
+ *
+ * Implementations shall set @a *sent to TRUE, if they sent the whole
+ * text delta including its end marker, and to FALSE if they did not send
+ * anything.  Use @a scratch_pool for temporary allocations.
+ *
+ * svn_ra_svn__try_send_file_range() matches this signature.
+ */
+typedef svn_error_t *
+(*svn_repos__send_file_range_func_t)(svn_boolean_t *sent,
+                                     svn_txdelta_window_handler_t handler,
+                                     void *handler_baton,
+                                     apr_file_t *file,
+                                     apr_off_t offset,
+                                     svn_filesize_t length,
+                                     int svndiff_version,
+                                     apr_pool_t *scratch_pool);
+
+/**
+ * Make the reporter given by @a report_baton, as returned by
+ * svn_repos_begin_report3(), use @a send_file_range_func for file
+ * contents that exceed its zero-copy limit and are stored in a suitable
+ * format.  This has no effect if the zero-copy limit is 0.
+ */
+void
+svn_repos__report_set_send_file_range_func(
+  void *report_baton,
+  svn_repos__send_file_range_func_t send_file_range_func);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
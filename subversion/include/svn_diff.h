@@ -455,6 +455,25 @@ typedef enum svn_diff_file_ignore_space_t
   svn_diff_file_ignore_space_all
 } svn_diff_file_ignore_space_t;
 
+/** The algorithm used to find the common lines of two sources.
+ *
+ * @since New in 1.15.
+ */
+typedef enum svn_diff_file_algorithm_t
+{
+  /** The Wu/Manber/Myers O(NP) algorithm, finding a minimal diff. */
+  svn_diff_file_algorithm_myers,
+
+  /** Patience diff: match up the lines that are unique in either source
+   * first.  Often gives more readable diffs for reordered code. */
+  svn_diff_file_algorithm_patience,
+
+  /** Histogram diff: like patience diff, but also uses lines that occur
+   * more than once, preferring the least frequent ones.  Close to linear
+   * time on large or heavily reordered sources. */
+  svn_diff_file_algorithm_histogram
+} svn_diff_file_algorithm_t;
+
 /** Options to control the behaviour of the file diff routines.
  *
  * @since New in 1.4.
@@ -487,6 +506,12 @@ typedef struct svn_diff_file_options_t
    *
    * @since New in 1.9 */
   int context_size;
+
+  /** The algorithm used to compare the sources.  Only affects two- and
+   * three-way diffs.  The default is @c svn_diff_file_algorithm_myers.
+   *
+   * @since New in 1.15. */
+  svn_diff_file_algorithm_t algorithm;
 } svn_diff_file_options_t;
 
 /** Allocate a @c svn_diff_file_options_t structure in @a pool, initializing
@@ -510,6 +535,9 @@ svn_diff_file_options_create(apr_pool_t *pool);
  * - --ignore-eol-style
  * - --show-c-function, -p @since New in 1.5.
  * - --context, -U ARG @since New in 1.9.
+ * - --diff-algorithm ARG, where ARG is one of 'myers', 'patience' and
+ *   'histogram' @since New in 1.15.
+ * - --patience, --histogram (short for the above) @since New in 1.15.
  * - --unified, -u (for compatibility, does nothing).
  */
 svn_error_t *
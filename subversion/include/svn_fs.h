@@ -166,6 +166,18 @@ typedef struct svn_fs_t svn_fs_t;
  */
 #define SVN_FS_CONFIG_FSFS_LOG_ADDRESSING       "fsfs-log-addressing"
 
+/** String with a decimal representation of the maximum number of shards
+ * that svn_fs_pack() may pack concurrently.  Values smaller than 2 (the
+ * default) make the shards get packed one after another.
+ *
+ * Every concurrently packed shard may use the full amount of memory that
+ * the packing code is allowed to use.  This option requires APR thread
+ * support and is ignored otherwise.
+ *
+ * @since New in 1.15.
+ */
+#define SVN_FS_CONFIG_FSFS_PACK_JOBS            "fsfs-pack-jobs"
+
 /* Note to maintainers: if you add further SVN_FS_CONFIG_FSFS_CACHE_* knobs,
    update fs_fs.c:verify_as_revision_before_current_plus_plus(). */
 
@@ -37,6 +37,7 @@
 #include "svn_types.h"
 #include "svn_string.h"
 #include "svn_delta.h"
+#include "svn_diff.h"
 #include "svn_auth.h"
 #include "svn_mergeinfo.h"
 
@@ -1915,6 +1916,65 @@ svn_ra_get_file_revs(svn_ra_session_t *session,
                      void *handler_baton,
                      apr_pool_t *pool);
 
+/**
+ * Callback type to be used with svn_ra_blame().  It will be invoked for
+ * every chunk of consecutive lines that were last changed in the same
+ * revision, in ascending line order.
+ *
+ * The chunk starts at the 0-based line number @a start_line and extends
+ * up to the start of the next chunk or, for the last chunk, up to the end
+ * of the file.  The lines were last changed in @a revision, whose revision
+ * properties are given in @a rev_props.  If the lines were last changed
+ * before the start of the requested revision range, @a revision will be
+ * #SVN_INVALID_REVNUM and @a rev_props will be @c NULL.
+ *
+ * @a baton is the user-provided receiver baton.  @a scratch_pool may be
+ * used for temporary allocations.
+ *
+ * @since New in 1.15.
+ */
+typedef svn_error_t *(*svn_ra_blame_receiver_t)(void *baton,
+                                                apr_int64_t start_line,
+                                                svn_revnum_t revision,
+                                                apr_hash_t *rev_props,
+                                                apr_pool_t *scratch_pool);
+
+/**
+ * Let the server calculate the line attribution ("blame") of the file
+ * @a path in revision @a end and report it to @a receiver with
+ * @a receiver_baton.  @a path is relative to the @a session's URL.
+ * @a receiver will be called at least once.
+ *
+ * The result is the same as diffing all revisions returned by
+ * svn_ra_get_file_revs2() for @a start - 1 to @a end with
+ * @a include_merged_revisions set to @c FALSE, using @a diff_options.
+ * Lines last changed in a revision older than @a start are reported
+ * with an invalid revision number.  @a start must not be greater than
+ * @a end.  Of @a diff_options, only the @c ignore_space and
+ * @c ignore_eol_style members are used.  It may be @c NULL to use the
+ * default options.
+ *
+ * Only the attribution is transmitted, not the contents of the file.
+ * Use svn_ra_get_file() to fetch those for revision @a end.
+ *
+ * If the server doesn't support the 'blame' command, return
+ * #SVN_ERR_UNSUPPORTED_FEATURE in preference to any other error that
+ * might otherwise be returned.
+ *
+ * Use @a scratch_pool for temporary memory allocation.
+ *
+ * @since New in 1.15.
+ */
+svn_error_t *
+svn_ra_blame(svn_ra_session_t *session,
+             const char *path,
+             svn_revnum_t start,
+             svn_revnum_t end,
+             const svn_diff_file_options_t *diff_options,
+             svn_ra_blame_receiver_t receiver,
+             void *receiver_baton,
+             apr_pool_t *scratch_pool);
+
 /**
  * Lock each path in @a path_revs, which is a hash whose keys are the
  * paths to be locked, and whose values are the corresponding base
@@ -2265,6 +2325,13 @@ svn_ra_has_capability(svn_ra_session_t *session,
  */
 #define SVN_RA_CAPABILITY_LIST "list"
 
+/**
+ * The capability of a server to calculate blame information itself.
+ *
+ * @since New in 1.15.
+ */
+#define SVN_RA_CAPABILITY_BLAME "blame"
+
 
 /*       *** PLEASE READ THIS IF YOU ADD A NEW CAPABILITY ***
  *
@@ -35,6 +35,7 @@
 #include "svn_types.h"
 #include "svn_string.h"
 #include "svn_delta.h"
+#include "svn_diff.h"
 #include "svn_fs.h"
 #include "svn_io.h"
 #include "svn_mergeinfo.h"
@@ -2464,6 +2465,69 @@ svn_repos_get_file_revs(svn_repos_t *repos,
                         void *handler_baton,
                         apr_pool_t *pool);
 
+/**
+ * Callback type to be used with svn_repos_blame().  It will be invoked
+ * for every chunk of consecutive lines that were last changed in the
+ * same revision, in ascending line order.
+ *
+ * The chunk starts at the 0-based line number @a start_line and extends
+ * up to the start of the next chunk or, for the last chunk, up to the end
+ * of the file.  The lines were last changed in @a revision, whose revision
+ * properties are given in @a rev_props.  If the lines were last changed
+ * before the start of the requested revision range, @a revision will be
+ * #SVN_INVALID_REVNUM and @a rev_props will be @c NULL.
+ *
+ * @a baton is the user-provided receiver baton.  @a scratch_pool may be
+ * used for temporary allocations.
+ *
+ * @since New in 1.15.
+ */
+typedef svn_error_t *(*svn_repos_blame_receiver_t)(void *baton,
+                                                   apr_int64_t start_line,
+                                                   svn_revnum_t revision,
+                                                   apr_hash_t *rev_props,
+                                                   apr_pool_t *scratch_pool);
+
+/**
+ * Calculate the line attribution ("blame") of the file @a path in
+ * revision @a end of @a repos and report it to @a receiver with
+ * @a receiver_baton.  @a receiver will be called at least once.
+ *
+ * The history of @a path is traversed as svn_repos_get_file_revs2() with
+ * @a include_merged_revisions set to @c FALSE would, and each change of
+ * the file contents is diffed against the previous one using
+ * @a diff_options, which may be @c NULL to use the default options.
+ * Lines last changed in a revision older than @a start are reported with
+ * an invalid revision number.  @a start must not be greater than @a end.
+ *
+ * Only the final attribution is reported, so this is much cheaper for
+ * remote clients than reconstructing every revision of the file from
+ * the deltas returned by svn_repos_get_file_revs2().  The line contents
+ * are not reported; callers need to fetch the file in revision @a end.
+ *
+ * If optional @a authz_read_func is non-NULL, then use it (with
+ * @a authz_read_baton) to check whether each path in the history of
+ * @a path is readable, as svn_repos_get_file_revs2() does, and to filter
+ * the revision properties as svn_repos_fs_revision_proplist() does.  If
+ * @a authz_read_func is @c NULL, results get cached in the process-wide
+ * membuffer cache, if available.
+ *
+ * Use @a scratch_pool for temporary allocations.
+ *
+ * @since New in 1.15.
+ */
+svn_error_t *
+svn_repos_blame(svn_repos_t *repos,
+                const char *path,
+                svn_revnum_t start,
+                svn_revnum_t end,
+                const svn_diff_file_options_t *diff_options,
+                svn_repos_authz_func_t authz_read_func,
+                void *authz_read_baton,
+                svn_repos_blame_receiver_t receiver,
+                void *receiver_baton,
+                apr_pool_t *scratch_pool);
+
 
 /* ---------------------------------------------------------------*/
 
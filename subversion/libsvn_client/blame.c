@@ -52,19 +52,33 @@ struct rev
   const char *path;      /* the absolute repository path */
 };
 
-/* One chunk of blame */
+/* One chunk of blame.
+ *
+ * While the diffs get applied, the chunks of a chain form a treap ordered
+ * by START, so that finding, inserting, deleting and shifting chunks takes
+ * O(log n) time even for files with many chunks.  Shifts are applied
+ * lazily: START is only valid once all SHIFT values of the chunk's
+ * ancestors have been pushed down.  Once all diffs have been applied, the
+ * chunks get linked through NEXT in START order. */
 struct blame
 {
   const struct rev *rev;    /* the responsible revision */
   apr_off_t start;          /* the starting diff-token (line) */
   struct blame *next;       /* the next chunk */
+
+  struct blame *left;       /* chunks starting before this one */
+  struct blame *right;      /* chunks starting after this one */
+  apr_off_t shift;          /* pending shift of LEFT and RIGHT */
+  apr_uint32_t priority;    /* treap heap key */
 };
 
 /* A chain of blame chunks */
 struct blame_chain
 {
   struct blame *blame;      /* linked list of blame chunks */
+  struct blame *root;       /* treap of blame chunks */
   struct blame *avail;      /* linked list of free blame chunks */
+  apr_uint32_t seed;        /* state of the priority generator */
   struct apr_pool_t *pool;  /* Allocate members from this pool. */
 };
 
@@ -141,6 +155,16 @@ blame_create(struct blame_chain *chain,
   blame->rev = rev;
   blame->start = start;
   blame->next = NULL;
+  blame->left = NULL;
+  blame->right = NULL;
+  blame->shift = 0;
+
+  /* xorshift32 is good enough to keep the treap balanced. */
+  chain->seed ^= chain->seed << 13;
+  chain->seed ^= chain->seed >> 17;
+  chain->seed ^= chain->seed << 5;
+  blame->priority = chain->seed;
+
   return blame;
 }
 
@@ -153,33 +177,154 @@ blame_destroy(struct blame_chain *chain,
   chain->avail = blame;
 }
 
-/* Return the blame chunk that contains token OFF, starting the search at
-   BLAME. */
-static struct blame *
-blame_find(struct blame *blame, apr_off_t off)
+/* Destroy BLAME and all chunks in its sub-tree. */
+static void
+blame_destroy_tree(struct blame_chain *chain,
+                   struct blame *blame)
 {
-  struct blame *prev = NULL;
-  while (blame)
+  if (blame)
     {
-      if (blame->start > off) break;
-      prev = blame;
-      blame = blame->next;
+      blame_destroy_tree(chain, blame->left);
+      blame_destroy_tree(chain, blame->right);
+      blame_destroy(chain, blame);
     }
-  return prev;
 }
 
-/* Shift the start-point of BLAME and all subsequence blame-chunks
-   by ADJUST tokens */
+/* Shift the start-point of BLAME and all chunks in its sub-tree
+   by ADJUST tokens.  BLAME may be NULL. */
 static void
 blame_adjust(struct blame *blame, apr_off_t adjust)
 {
-  while (blame)
+  if (blame)
     {
       blame->start += adjust;
-      blame = blame->next;
+      blame->shift += adjust;
     }
 }
 
+/* Apply the pending shift of BLAME to its direct children. */
+static void
+blame_push_shift(struct blame *blame)
+{
+  if (blame->shift)
+    {
+      blame_adjust(blame->left, blame->shift);
+      blame_adjust(blame->right, blame->shift);
+      blame->shift = 0;
+    }
+}
+
+/* Split the treap BLAME into *LEFT, containing all chunks that start at
+   or before token OFF, and *RIGHT, containing all the others. */
+static void
+blame_split(struct blame **left,
+            struct blame **right,
+            struct blame *blame,
+            apr_off_t off)
+{
+  if (!blame)
+    {
+      *left = NULL;
+      *right = NULL;
+    }
+  else
+    {
+      blame_push_shift(blame);
+      if (blame->start <= off)
+        {
+          blame_split(&blame->right, right, blame->right, off);
+          *left = blame;
+        }
+      else
+        {
+          blame_split(left, &blame->left, blame->left, off);
+          *right = blame;
+        }
+    }
+}
+
+/* Return the treap containing all chunks of LEFT and RIGHT.  All chunks in
+   LEFT must start before those in RIGHT. */
+static struct blame *
+blame_merge(struct blame *left,
+            struct blame *right)
+{
+  if (!left)
+    return right;
+  if (!right)
+    return left;
+
+  if (left->priority > right->priority)
+    {
+      blame_push_shift(left);
+      left->right = blame_merge(left->right, right);
+      return left;
+    }
+  else
+    {
+      blame_push_shift(right);
+      right->left = blame_merge(left, right->left);
+      return right;
+    }
+}
+
+/* Return the last chunk in the treap BLAME, which must not be empty. */
+static struct blame *
+blame_last(struct blame *blame)
+{
+  blame_push_shift(blame);
+  while (blame->right)
+    {
+      blame = blame->right;
+      blame_push_shift(blame);
+    }
+
+  return blame;
+}
+
+/* Remove the last chunk from the treap *BLAME, which must not be empty,
+   and return it. */
+static struct blame *
+blame_remove_last(struct blame **blame)
+{
+  struct blame *last;
+
+  blame_push_shift(*blame);
+  while ((*blame)->right)
+    {
+      blame = &(*blame)->right;
+      blame_push_shift(*blame);
+    }
+
+  last = *blame;
+  *blame = last->left;
+  last->left = NULL;
+
+  return last;
+}
+
+/* Link the chunks of the treap BLAME through their NEXT pointers, in
+   order, and append the chunk list TAIL.  Return the first chunk. */
+static struct blame *
+blame_link(struct blame *blame,
+           struct blame *tail)
+{
+  if (!blame)
+    return tail;
+
+  blame_push_shift(blame);
+  blame->next = blame_link(blame->right, tail);
+  return blame_link(blame->left, blame);
+}
+
+/* Turn the treap of CHAIN into the linked list of chunks. */
+static void
+blame_finalize(struct blame_chain *chain)
+{
+  chain->blame = blame_link(chain->root, NULL);
+  chain->root = NULL;
+}
+
 /* Delete the blame associated with the region from token START to
    START + LENGTH */
 static svn_error_t *
@@ -187,37 +332,29 @@ blame_delete_range(struct blame_chain *chain,
                    apr_off_t start,
                    apr_off_t length)
 {
-  struct blame *first = blame_find(chain->blame, start);
-  struct blame *last = blame_find(chain->blame, start + length);
-  struct blame *tail = last->next;
+  struct blame *head, *middle, *tail;
+
+  /* HEAD ends with the chunk that contains START and MIDDLE contains all
+     chunks that start within the deleted region. */
+  blame_split(&head, &tail, chain->root, start + length);
+  blame_split(&head, &middle, head, start);
 
-  if (first != last)
+  if (middle)
     {
-      struct blame *walk = first->next;
-      while (walk != last)
-        {
-          struct blame *next = walk->next;
-          blame_destroy(chain, walk);
-          walk = next;
-        }
-      first->next = last;
+      /* Only the last of them survives, taking over the deleted region. */
+      struct blame *last = blame_remove_last(&middle);
+      blame_destroy_tree(chain, middle);
       last->start = start;
-      if (first->start == start)
-        {
-          *first = *last;
-          blame_destroy(chain, last);
-          last = first;
-        }
-    }
 
-  if (tail && tail->start == last->start + length)
-    {
-      *last = *tail;
-      blame_destroy(chain, tail);
-      tail = last->next;
+      /* It replaces the chunk that starts right at START. */
+      if (blame_last(head)->start == start)
+        blame_destroy(chain, blame_remove_last(&head));
+
+      head = blame_merge(head, last);
     }
 
   blame_adjust(tail, -length);
+  chain->root = blame_merge(head, tail);
 
   return SVN_NO_ERROR;
 }
@@ -230,27 +367,25 @@ blame_insert_range(struct blame_chain *chain,
                    apr_off_t start,
                    apr_off_t length)
 {
-  struct blame *head = chain->blame;
-  struct blame *point = blame_find(head, start);
-  struct blame *insert;
+  struct blame *head, *tail, *point, *insert;
+
+  blame_split(&head, &tail, chain->root, start);
+  point = blame_last(head);
+  insert = blame_create(chain, point->rev, start + length);
 
   if (point->start == start)
     {
-      insert = blame_create(chain, point->rev, point->start + length);
       point->rev = rev;
-      insert->next = point->next;
-      point->next = insert;
     }
   else
     {
       struct blame *middle;
       middle = blame_create(chain, rev, start);
-      insert = blame_create(chain, point->rev, start + length);
-      middle->next = insert;
-      insert->next = point->next;
-      point->next = middle;
+      head = blame_merge(head, middle);
     }
-  blame_adjust(insert->next, length);
+
+  blame_adjust(tail, length);
+  chain->root = blame_merge(blame_merge(head, insert), tail);
 
   return SVN_NO_ERROR;
 }
@@ -297,8 +432,8 @@ add_file_blame(const char *last_file,
 {
   if (!last_file)
     {
-      SVN_ERR_ASSERT(chain->blame == NULL);
-      chain->blame = blame_create(chain, rev, 0);
+      SVN_ERR_ASSERT(chain->root == NULL);
+      chain->root = blame_create(chain, rev, 0);
     }
   else
     {
@@ -591,6 +726,93 @@ file_rev_handler(void *baton, const char *path, svn_revnum_t revnum,
   return SVN_NO_ERROR;
 }
 
+/* The baton used by server_blame_receiver(). */
+struct server_blame_baton {
+  struct blame_chain *chain;
+  /* Map svn_revnum_t to the struct rev * for that revision. */
+  apr_hash_t *revs;
+  /* The rev for lines that were changed before the start revision. */
+  struct rev *no_rev;
+  apr_pool_t *pool;     /* Allocate the rev structures in this pool. */
+};
+
+/* Append the chunk reported by the server to BATON->chain.
+ *
+ * Implements svn_ra_blame_receiver_t.
+ */
+static svn_error_t *
+server_blame_receiver(void *baton,
+                      apr_int64_t start_line,
+                      svn_revnum_t revision,
+                      apr_hash_t *rev_props,
+                      apr_pool_t *scratch_pool)
+{
+  struct server_blame_baton *sbb = baton;
+  struct blame_chain *chain = sbb->chain;
+  struct rev *rev;
+
+  if (!SVN_IS_VALID_REVNUM(revision))
+    {
+      rev = sbb->no_rev;
+    }
+  else
+    {
+      rev = apr_hash_get(sbb->revs, &revision, sizeof(revision));
+      if (!rev)
+        {
+          rev = apr_pcalloc(sbb->pool, sizeof(*rev));
+          rev->revision = revision;
+          rev->rev_props = svn_prop_hash_dup(rev_props, sbb->pool);
+          apr_hash_set(sbb->revs, &rev->revision, sizeof(rev->revision), rev);
+        }
+    }
+
+  /* The server reports the chunks in ascending line order. */
+  chain->root = blame_merge(chain->root,
+                            blame_create(chain, rev, (apr_off_t)start_line));
+
+  return SVN_NO_ERROR;
+}
+
+/* Let the server behind RA_SESSION calculate the blame for FRB->start_rev
+ * to FRB->end_rev and record it in FRB->chain.  Fetch the contents of
+ * FRB->end_rev into a temporary file and make that FRB->last_filename.
+ *
+ * Return SVN_ERR_UNSUPPORTED_FEATURE if the server does not support this.
+ * Use POOL for temporary allocations.
+ */
+static svn_error_t *
+blame_on_server(struct file_rev_baton *frb,
+                svn_ra_session_t *ra_session,
+                apr_pool_t *pool)
+{
+  struct server_blame_baton sbb;
+  svn_stream_t *stream;
+  const char *filename;
+
+  sbb.chain = frb->chain;
+  sbb.revs = apr_hash_make(pool);
+  sbb.no_rev = apr_pcalloc(frb->mainpool, sizeof(*sbb.no_rev));
+  sbb.no_rev->revision = SVN_INVALID_REVNUM;
+  sbb.pool = frb->mainpool;
+
+  SVN_ERR(svn_ra_blame(ra_session, "", frb->start_rev, frb->end_rev,
+                       frb->diff_options, server_blame_receiver, &sbb,
+                       pool));
+
+  /* Only the attribution got transmitted.  Fetch the text to annotate. */
+  SVN_ERR(svn_stream_open_unique(&stream, &filename, NULL,
+                                 svn_io_file_del_on_pool_cleanup,
+                                 frb->mainpool, pool));
+  SVN_ERR(svn_ra_get_file(ra_session, "", frb->end_rev, stream, NULL, NULL,
+                          pool));
+  SVN_ERR(svn_stream_close(stream));
+
+  frb->last_filename = filename;
+
+  return SVN_NO_ERROR;
+}
+
 /* Ensure that CHAIN_ORIG and CHAIN_MERGED have the same number of chunks,
    and that for every chunk C, CHAIN_ORIG[C] and CHAIN_MERGED[C] have the
    same starting value.  Both CHAIN_ORIG and CHAIN_MERGED should not be
@@ -783,13 +1005,17 @@ svn_client_blame6(svn_revnum_t *start_revnum_p,
   frb.last_original_filename = NULL;
   frb.chain = apr_palloc(pool, sizeof(*frb.chain));
   frb.chain->blame = NULL;
+  frb.chain->root = NULL;
   frb.chain->avail = NULL;
+  frb.chain->seed = 0x2545f491;
   frb.chain->pool = pool;
   if (include_merged_revisions)
     {
       frb.merged_chain = apr_palloc(pool, sizeof(*frb.merged_chain));
       frb.merged_chain->blame = NULL;
+      frb.merged_chain->root = NULL;
       frb.merged_chain->avail = NULL;
+      frb.merged_chain->seed = 0x2545f491;
       frb.merged_chain->pool = pool;
     }
   frb.backwards = (frb.start_rev > frb.end_rev);
@@ -811,16 +1037,32 @@ svn_client_blame6(svn_revnum_t *start_revnum_p,
       frb.prevfilepool = svn_pool_create(pool);
     }
 
+  /* If the server can calculate the blame itself, we only need to fetch
+     the attribution and the final text instead of all revisions of the
+     file.  Merged revisions, backward blames and diff algorithms other
+     than the default still need the latter. */
+  if (!include_merged_revisions && !frb.backwards
+      && diff_options->algorithm == svn_diff_file_algorithm_myers)
+    {
+      svn_error_t *err = blame_on_server(&frb, ra_session, pool);
+
+      if (err && err->apr_err == SVN_ERR_UNSUPPORTED_FEATURE)
+        svn_error_clear(err);
+      else
+        SVN_ERR(err);
+    }
+
   /* Collect all blame information.
      We need to ensure that we get one revision before the start_rev,
      if available so that we can know what was actually changed in the start
      revision. */
-  SVN_ERR(svn_ra_get_file_revs2(ra_session, "",
-                                frb.backwards ? start_revnum
-                                              : MAX(0, start_revnum-1),
-                                end_revnum,
-                                include_merged_revisions,
-                                file_rev_handler, &frb, pool));
+  if (!frb.last_filename)
+    SVN_ERR(svn_ra_get_file_revs2(ra_session, "",
+                                  frb.backwards ? start_revnum
+                                                : MAX(0, start_revnum-1),
+                                  end_revnum,
+                                  include_merged_revisions,
+                                  file_rev_handler, &frb, pool));
 
   if (end->kind == svn_opt_revision_working)
     {
@@ -905,12 +1147,16 @@ svn_client_blame6(svn_revnum_t *start_revnum_p,
          semantically a copy, and we want to use the revision on the branch as
          the most recently changed revision.  ### Is this really what we want
          to do here?  Do the semantics of copy change? */
-      if (!frb.chain->blame)
-        frb.chain->blame = blame_create(frb.chain, frb.last_rev, 0);
+      if (!frb.chain->root)
+        frb.chain->root = blame_create(frb.chain, frb.last_rev, 0);
 
+      blame_finalize(frb.chain);
+      blame_finalize(frb.merged_chain);
       normalize_blames(frb.chain, frb.merged_chain, pool);
       walk_merged = frb.merged_chain->blame;
     }
+  else
+    blame_finalize(frb.chain);
 
   /* Process each blame item. */
   for (walk = frb.chain->blame; walk; walk = walk->next)
@@ -24,17 +24,26 @@
 
 #include <assert.h>
 #include <string.h>
+
+#if APR_HAS_THREADS
+#include <apr_thread_pool.h>
+#include <apr_thread_cond.h>
+#endif
+
 #include "svn_delta.h"
 #include "svn_io.h"
 #include "delta.h"
 #include "svn_pools.h"
+#include "svn_sorts.h"
 #include "svn_private_config.h"
 
+#include "private/svn_atomic.h"
 #include "private/svn_error_private.h"
 #include "private/svn_delta_private.h"
 #include "private/svn_subr_private.h"
 #include "private/svn_string_private.h"
 #include "private/svn_dep_compat.h"
+#include "private/svn_mutex.h"
 
 static const char SVNDIFF_V0[] = { 'S', 'V', 'N', 0 };
 static const char SVNDIFF_V1[] = { 'S', 'V', 'N', 1 };
@@ -323,6 +332,332 @@ svn_txdelta_to_svndiff3(svn_txdelta_window_handler_t *handler,
   *handler_baton = eb;
 }
 
+
+/* ----- Pipelined text delta to svndiff ----- */
+
+#if APR_HAS_THREADS
+
+/* Upper limit to the number of threads in ENCODER_THREAD_POOL. */
+#define MAX_ENCODER_THREADS 64
+
+/* Number of microseconds that an unused encoder thread remains alive. */
+#define ENCODER_THREAD_IDLE_LIMIT 1000000
+
+/* Process-wide pool of compression threads, shared by all pipelined
+   encoders.  Creating threads for every representation during e.g.
+   'svnadmin load' would be prohibitively expensive. */
+static apr_thread_pool_t *encoder_thread_pool = NULL;
+
+/* Keep track on whether we already created the ENCODER_THREAD_POOL. */
+static svn_atomic_t encoder_thread_pool_initialized = FALSE;
+
+/* Destructor for ENCODER_THREAD_POOL.  Must be run as pre-cleanup hook
+   because the thread objects live in sub-pools. */
+static apr_status_t
+encoder_thread_pool_pre_cleanup(void *data)
+{
+  apr_thread_pool_t *tp = encoder_thread_pool;
+  if (!encoder_thread_pool)
+    return APR_SUCCESS;
+
+  encoder_thread_pool = NULL;
+  encoder_thread_pool_initialized = FALSE;
+
+  return apr_thread_pool_destroy(tp);
+}
+
+/* Implements svn_atomic__err_init_func_t.  Create ENCODER_THREAD_POOL. */
+static svn_error_t *
+create_encoder_thread_pool(void *baton,
+                           apr_pool_t *scratch_pool)
+{
+  /* The thread-pool must be allocated from a thread-safe root pool. */
+  apr_pool_t *pool = svn_pool_create(NULL);
+  apr_status_t status;
+
+  status = apr_thread_pool_create(&encoder_thread_pool, 0,
+                                  MAX_ENCODER_THREADS, pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create svndiff thread pool"));
+
+  apr_pool_pre_cleanup_register(pool, NULL, encoder_thread_pool_pre_cleanup);
+  apr_thread_pool_idle_wait_set(encoder_thread_pool,
+                                ENCODER_THREAD_IDLE_LIMIT);
+  apr_thread_pool_threshold_set(encoder_thread_pool, 0);
+
+  return SVN_NO_ERROR;
+}
+
+struct parallel_encoder_baton;
+
+/* A single window to be encoded by some thread. */
+typedef struct encode_job_t
+{
+  /* Private copy of the window to encode.  Allocated in POOL. */
+  svn_txdelta_window_t *window;
+
+  /* Results as produced by encode_window(). */
+  svn_stringbuf_t *instructions;
+  svn_stringbuf_t *header;
+  const svn_string_t *newdata;
+  svn_error_t *err;
+
+  /* Set under the encoder's MUTEX once the results are available. */
+  svn_boolean_t done;
+
+  /* Thread-safe root pool owning this job and all its data. */
+  apr_pool_t *pool;
+
+  /* Encoder that this job belongs to. */
+  struct parallel_encoder_baton *eb;
+} encode_job_t;
+
+/* Baton for parallel_window_handler. */
+struct parallel_encoder_baton
+{
+  svn_stream_t *output;
+  svn_boolean_t header_done;
+  int version;
+  int compression_level;
+
+  /* Ring buffer of MAX_JOBS entries.  COUNT jobs, starting at index FIRST,
+     are in flight in window order. */
+  encode_job_t **jobs;
+  int max_jobs;
+  int first;
+  int count;
+
+  /* Synchronize with the encoder threads. */
+  svn_mutex__t *mutex;
+  apr_thread_cond_t *cond;
+
+  /* Pool that this baton has been allocated in. */
+  apr_pool_t *pool;
+};
+
+/* Thread-pool task encoding the encode_job_t given by DATA. */
+static void * APR_THREAD_FUNC
+encode_task(apr_thread_t *tid,
+            void *data)
+{
+  encode_job_t *job = data;
+  struct parallel_encoder_baton *eb = job->eb;
+  svn_error_t *err;
+
+  job->err = encode_window(&job->instructions, &job->header, &job->newdata,
+                           job->window, eb->version, eb->compression_level,
+                           job->pool);
+
+  /* JOB may be released as soon as we unlock the mutex.  Errors here
+     leave the main thread waiting forever, there is nothing to report
+     them to. */
+  err = svn_mutex__lock(eb->mutex);
+  if (!err)
+    {
+      job->done = TRUE;
+      apr_thread_cond_broadcast(eb->cond);
+      err = svn_mutex__unlock(eb->mutex, SVN_NO_ERROR);
+    }
+  svn_error_clear(err);
+
+  return NULL;
+}
+
+/* Wait for the oldest job in EB to complete and remove it from EB.
+   Return it in *JOB_P.  The caller must destroy the job's pool. */
+static svn_error_t *
+wait_for_oldest_job(encode_job_t **job_p,
+                    struct parallel_encoder_baton *eb)
+{
+  encode_job_t *job = eb->jobs[eb->first];
+  svn_error_t *err = SVN_NO_ERROR;
+
+  SVN_ERR(svn_mutex__lock(eb->mutex));
+  while (!job->done && !err)
+    {
+      apr_status_t status = apr_thread_cond_wait(eb->cond,
+                                                 svn_mutex__get(eb->mutex));
+      if (status)
+        err = svn_error_wrap_apr(status,
+                                 _("Can't wait on condition variable"));
+    }
+  SVN_ERR(svn_mutex__unlock(eb->mutex, err));
+
+  eb->first = (eb->first + 1) % eb->max_jobs;
+  eb->count--;
+  *job_p = job;
+
+  return SVN_NO_ERROR;
+}
+
+/* Wait for the oldest job in EB to complete and write its result to
+   the output stream. */
+static svn_error_t *
+write_oldest_job(struct parallel_encoder_baton *eb)
+{
+  encode_job_t *job;
+  svn_error_t *err;
+  apr_size_t len;
+
+  SVN_ERR(wait_for_oldest_job(&job, eb));
+
+  err = job->err;
+  if (!err)
+    {
+      len = job->header->len;
+      err = svn_stream_write(eb->output, job->header->data, &len);
+    }
+  if (!err && job->instructions->len > 0)
+    {
+      len = job->instructions->len;
+      err = svn_stream_write(eb->output, job->instructions->data, &len);
+    }
+  if (!err && job->newdata->len > 0)
+    {
+      len = job->newdata->len;
+      err = svn_stream_write(eb->output, job->newdata->data, &len);
+    }
+
+  svn_pool_destroy(job->pool);
+  return svn_error_trace(err);
+}
+
+/* Pool cleanup function for parallel_encoder_baton.  Wait for all jobs
+   still in flight and release their memory.  This only has work to do
+   if the encoder did not see the final NULL window. */
+static apr_status_t
+parallel_encoder_cleanup(void *data)
+{
+  struct parallel_encoder_baton *eb = data;
+
+  while (eb->count > 0)
+    {
+      encode_job_t *job;
+      svn_error_t *err = wait_for_oldest_job(&job, eb);
+      if (err)
+        {
+          /* We can't release a job that might still be in use. */
+          svn_error_clear(err);
+          return APR_SUCCESS;
+        }
+
+      svn_error_clear(job->err);
+      svn_pool_destroy(job->pool);
+    }
+
+  return APR_SUCCESS;
+}
+
+/* Implements svn_txdelta_window_handler_t for parallel_encoder_baton. */
+static svn_error_t *
+parallel_window_handler(svn_txdelta_window_t *window, void *baton)
+{
+  struct parallel_encoder_baton *eb = baton;
+  encode_job_t *job;
+  apr_pool_t *pool;
+  apr_status_t status;
+
+  /* Make sure we write the header.  */
+  if (!eb->header_done)
+    {
+      apr_size_t len = SVNDIFF_HEADER_SIZE;
+      SVN_ERR(svn_stream_write(eb->output, get_svndiff_header(eb->version),
+                               &len));
+      eb->header_done = TRUE;
+    }
+
+  if (window == NULL)
+    {
+      /* Write all pending windows, then we are done. */
+      while (eb->count > 0)
+        SVN_ERR(write_oldest_job(eb));
+
+      return svn_error_trace(svn_stream_close(eb->output));
+    }
+
+  /* Limit the number of windows in flight. */
+  if (eb->count == eb->max_jobs)
+    SVN_ERR(write_oldest_job(eb));
+
+  /* The caller may reuse WINDOW as soon as we return, so copy it. */
+  pool = svn_pool_create(NULL);
+  job = apr_pcalloc(pool, sizeof(*job));
+  job->window = svn_txdelta_window_dup(window, pool);
+  job->pool = pool;
+  job->eb = eb;
+
+  eb->jobs[(eb->first + eb->count) % eb->max_jobs] = job;
+  eb->count++;
+
+  status = apr_thread_pool_push(encoder_thread_pool, encode_task, job, 0, eb);
+  if (status)
+    {
+      /* Encode the window in this thread, then. */
+      job->err = encode_window(&job->instructions, &job->header,
+                               &job->newdata, job->window, eb->version,
+                               eb->compression_level, job->pool);
+      job->done = TRUE;
+    }
+
+  return SVN_NO_ERROR;
+}
+
+#endif
+
+svn_error_t *
+svn_txdelta__to_svndiff_parallel(svn_txdelta_window_handler_t *handler,
+                                 void **handler_baton,
+                                 svn_stream_t *output,
+                                 int svndiff_version,
+                                 int compression_level,
+                                 int max_threads,
+                                 apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  struct parallel_encoder_baton *eb;
+  apr_status_t status;
+
+  /* Uncompressed windows are cheap to encode, a pipeline won't help. */
+  if (max_threads < 2 || svndiff_version == 0)
+#endif
+    {
+      svn_txdelta_to_svndiff3(handler, handler_baton, output, svndiff_version,
+                              compression_level, pool);
+      return SVN_NO_ERROR;
+    }
+
+#if APR_HAS_THREADS
+  SVN_ERR(svn_atomic__init_once(&encoder_thread_pool_initialized,
+                                create_encoder_thread_pool, NULL, pool));
+
+  eb = apr_pcalloc(pool, sizeof(*eb));
+  eb->output = output;
+  eb->header_done = FALSE;
+  eb->version = svndiff_version;
+  eb->compression_level = compression_level;
+  eb->max_jobs = MIN(max_threads, MAX_ENCODER_THREADS);
+  eb->jobs = apr_pcalloc(pool, eb->max_jobs * sizeof(*eb->jobs));
+  eb->first = 0;
+  eb->count = 0;
+  eb->pool = pool;
+
+  SVN_ERR(svn_mutex__init(&eb->mutex, TRUE, pool));
+  status = apr_thread_cond_create(&eb->cond, pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* Registered after the mutex and condition variable such that it gets
+     run before their cleanups. */
+  apr_pool_cleanup_register(pool, eb, parallel_encoder_cleanup,
+                            apr_pool_cleanup_null);
+
+  *handler = parallel_window_handler;
+  *handler_baton = eb;
+
+  return SVN_NO_ERROR;
+#endif
+}
+
 void
 svn_txdelta_to_svndiff2(svn_txdelta_window_handler_t *handler,
                         void **handler_baton,
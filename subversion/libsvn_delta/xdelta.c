@@ -77,27 +77,28 @@ adler32_replace(apr_uint32_t adler32, const char c_out, const char c_in)
 }
 
 /* Calculate an pseudo-adler32 checksum for MATCH_BLOCKSIZE bytes starting
-   at DATA.  Return the checksum value.  */
+   at DATA.  Return the checksum value.
+
+   The classic formulation accumulates S2 from the running S1, which
+   creates a dependency chain through all bytes.  Here, we use the
+   equivalent closed form S2 = sum((MATCH_BLOCKSIZE - i) * DATA[i]).
+   Both sums are then plain reductions without loop-carried dependencies
+   other than the accumulators, which compilers turn into SIMD code
+   (SSE2, AVX2, NEON, ...) for whatever the target platform offers. */
 
 static APR_INLINE apr_uint32_t
 init_adler32(const char *data)
 {
   const unsigned char *input = (const unsigned char *)data;
-  const unsigned char *last = input + MATCH_BLOCKSIZE;
 
   apr_uint32_t s1 = 0;
   apr_uint32_t s2 = 0;
+  apr_uint32_t i;
 
-  for (; input < last; input += 8)
+  for (i = 0; i < MATCH_BLOCKSIZE; ++i)
     {
-      s1 += input[0]; s2 += s1;
-      s1 += input[1]; s2 += s1;
-      s1 += input[2]; s2 += s1;
-      s1 += input[3]; s2 += s1;
-      s1 += input[4]; s2 += s1;
-      s1 += input[5]; s2 += s1;
-      s1 += input[6]; s2 += s1;
-      s1 += input[7]; s2 += s1;
+      s1 += input[i];
+      s2 += (MATCH_BLOCKSIZE - i) * input[i];
     }
 
   return s2 * 0x10000 + s1;
@@ -278,7 +279,7 @@ find_match(const struct blocks *blocks,
            apr_size_t pending_insert_start)
 {
   apr_size_t apos, bpos = *bposp;
-  apr_size_t delta, max_delta;
+  apr_size_t delta, max_delta, max_back;
 
   apos = find_block(blocks, rolling, b + bpos);
 
@@ -294,14 +295,16 @@ find_match(const struct blocks *blocks,
                                     b + bpos + MATCH_BLOCKSIZE,
                                     max_delta);
 
-  /* See if we can extend backwards (max MATCH_BLOCKSIZE-1 steps because A's
-     content has been sampled only every MATCH_BLOCKSIZE positions).  */
-  while (apos > 0 && bpos > pending_insert_start && a[apos-1] == b[bpos-1])
-    {
-      --apos;
-      --bpos;
-      ++delta;
-    }
+  /* See if we can extend backwards (usually less than MATCH_BLOCKSIZE
+     steps because A's content has been sampled only every MATCH_BLOCKSIZE
+     positions).  Compare word-wise like we do for forward extension. */
+  max_back = apos < bpos - pending_insert_start
+           ? apos
+           : bpos - pending_insert_start;
+  max_back = svn_cstring__reverse_match_length(a + apos, b + bpos, max_back);
+  apos -= max_back;
+  bpos -= max_back;
+  delta += max_back;
 
   *aposp = apos;
   *bposp = bpos;
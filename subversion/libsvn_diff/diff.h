@@ -33,7 +33,6 @@
 
 #define SVN_DIFF__UNIFIED_CONTEXT_SIZE 3
 
-typedef struct svn_diff__node_t svn_diff__node_t;
 typedef struct svn_diff__tree_t svn_diff__tree_t;
 typedef struct svn_diff__position_t svn_diff__position_t;
 typedef struct svn_diff__lcs_t svn_diff__lcs_t;
@@ -101,6 +100,8 @@ typedef enum svn_diff__normalize_state_t
  * equal and be excluded from the comparison process. Similarly, SUFFIX_LINES
  * at the end of both sequences will be skipped.
  *
+ * ALGORITHM selects how the remaining lines are compared.
+ *
  * The resulting lcs structure will be the return value of this function.
  * Allocations will be made from POOL.
  */
@@ -112,17 +113,19 @@ svn_diff__lcs(svn_diff__position_t *position_list1, /* pointer to tail (ring) */
               svn_diff__token_index_t num_tokens, /* length of count arrays */
               apr_off_t prefix_lines,
               apr_off_t suffix_lines,
+              svn_diff_file_algorithm_t algorithm,
               apr_pool_t *pool);
 
 
 /*
- * Returns number of tokens in a tree
+ * Returns number of distinct tokens in TREE
  */
 svn_diff__token_index_t
 svn_diff__get_node_count(svn_diff__tree_t *tree);
 
 /*
- * Support functions to build a tree of token positions
+ * Create the table that maps tokens to their token index.  (For historical
+ * reasons, it is called a tree; it is a hash table now.)
  */
 void
 svn_diff__tree_create(svn_diff__tree_t **tree, apr_pool_t *pool);
@@ -158,6 +161,23 @@ svn_diff__diff(svn_diff__lcs_t *lcs,
                svn_boolean_t want_common,
                apr_pool_t *pool);
 
+/* Like svn_diff_diff_2(), but calculate the LCS with ALGORITHM. */
+svn_error_t *
+svn_diff__diff_2(svn_diff_t **diff,
+                 void *diff_baton,
+                 const svn_diff_fns2_t *vtable,
+                 svn_diff_file_algorithm_t algorithm,
+                 apr_pool_t *pool);
+
+/* Like svn_diff_diff3_2(), but calculate the LCS of the original and
+ * either of the other sources with ALGORITHM. */
+svn_error_t *
+svn_diff__diff3_2(svn_diff_t **diff,
+                  void *diff_baton,
+                  const svn_diff_fns2_t *vtable,
+                  svn_diff_file_algorithm_t algorithm,
+                  apr_pool_t *pool);
+
 void
 svn_diff__resolve_conflict(svn_diff_t *hunk,
                            svn_diff__position_t **position_list1,
@@ -184,6 +204,31 @@ svn_diff__normalize_buffer(char **tgt,
                            const char *buf,
                            const svn_diff_file_options_t *opts);
 
+/* State of an incremental token hash, see svn_diff__hash_update().
+ * Initialize all members to 0 before the first update. */
+typedef struct svn_diff__hash_t
+{
+  apr_uint32_t value;   /* hash over all complete 4-byte words */
+  apr_uint32_t tail;    /* bytes of the incomplete last word */
+  apr_uint32_t length;  /* number of bytes hashed so far */
+} svn_diff__hash_t;
+
+/* Add the LEN bytes at DATA to the token hash STATE.
+ *
+ * Datasources use this to hash the normalized token contents for
+ * svn_diff_fns2_t::datasource_get_next_token.  The result does not depend
+ * on how the contents get split into pieces, so tokens that cross buffer
+ * boundaries hash the same as contiguous ones.
+ */
+void
+svn_diff__hash_update(svn_diff__hash_t *state,
+                      const char *data,
+                      apr_off_t len);
+
+/* Return the final hash value for STATE, which includes the length. */
+apr_uint32_t
+svn_diff__hash_final(const svn_diff__hash_t *state);
+
 /* Set *OUT_STR to a newline followed by a "\ No newline at end of file" line.
  *
  * The text will be encoded into HEADER_ENCODING.
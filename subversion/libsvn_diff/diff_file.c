@@ -49,7 +49,6 @@
 #include "private/svn_utf_private.h"
 #include "private/svn_eol_private.h"
 #include "private/svn_dep_compat.h"
-#include "private/svn_adler32.h"
 #include "private/svn_diff_private.h"
 
 /* A token, i.e. a line read from a file. */
@@ -152,82 +151,6 @@ read_chunk(apr_file_t *file,
 }
 
 
-/* Map or read a file at PATH. *BUFFER will point to the file
- * contents; if the file was mapped, *FILE and *MM will contain the
- * mmap context; otherwise they will be NULL.  SIZE will contain the
- * file size.  Allocate from POOL.
- */
-#if APR_HAS_MMAP
-#define MMAP_T_PARAM(NAME) apr_mmap_t **NAME,
-#define MMAP_T_ARG(NAME)   &(NAME),
-#else
-#define MMAP_T_PARAM(NAME)
-#define MMAP_T_ARG(NAME)
-#endif
-
-static svn_error_t *
-map_or_read_file(apr_file_t **file,
-                 MMAP_T_PARAM(mm)
-                 char **buffer, apr_size_t *size_p,
-                 const char *path, apr_pool_t *pool)
-{
-  apr_finfo_t finfo;
-  apr_status_t rv;
-  apr_size_t size;
-
-  *buffer = NULL;
-
-  SVN_ERR(svn_io_file_open(file, path, APR_READ, APR_OS_DEFAULT, pool));
-  SVN_ERR(svn_io_file_info_get(&finfo, APR_FINFO_SIZE, *file, pool));
-
-  if (finfo.size > APR_SIZE_MAX)
-    {
-      return svn_error_createf(APR_ENOMEM, NULL,
-                               _("File '%s' is too large to be read in "
-                                 "to memory"), path);
-    }
-
-  size = (apr_size_t) finfo.size;
-#if APR_HAS_MMAP
-  if (size > APR_MMAP_THRESHOLD)
-    {
-      rv = apr_mmap_create(mm, *file, 0, size, APR_MMAP_READ, pool);
-      if (rv == APR_SUCCESS)
-        {
-          *buffer = (*mm)->mm;
-        }
-      else
-        {
-          /* Clear *MM because output parameters are undefined on error. */
-          *mm = NULL;
-        }
-
-      /* On failure we just fall through and try reading the file into
-       * memory instead.
-       */
-    }
-#endif /* APR_HAS_MMAP */
-
-   if (*buffer == NULL && size > 0)
-    {
-      *buffer = apr_palloc(pool, size);
-
-      SVN_ERR(svn_io_file_read_full2(*file, *buffer, size, NULL, NULL, pool));
-
-      /* Since we have the entire contents of the file we can
-       * close it now.
-       */
-      SVN_ERR(svn_io_file_close(*file, pool));
-
-      *file = NULL;
-    }
-
-  *size_p = size;
-
-  return SVN_NO_ERROR;
-}
-
-
 /* For all files in the FILE array, increment the curp pointer.  If a file
  * points before the beginning of file, let it point at the first byte again.
  * If the end of the current chunk is reached, read the next chunk in the
@@ -372,6 +295,110 @@ static svn_boolean_t contains_eol(apr_uintptr_t chunk)
 }
 #endif
 
+/* Identical prefixes and suffixes are first compared in blocks of this
+ * many bytes with memcmp(), which the C library typically vectorizes.
+ * Only the blocks that match get scanned for eols.
+ */
+#define SCAN_BLOCK_SIZE 4096
+
+/* Advance the curp's of all FILEs past those of the following blocks of
+ * SCAN_BLOCK_SIZE bytes that are identical in all of them, as long as they
+ * leave at least one byte in the current chunk of each FILE.  Add the
+ * number of lines ending in them to *LINES, updating *HAD_CR, as
+ * find_identical_prefix() would.
+ *
+ * Return FALSE if a block was found to differ, TRUE otherwise.
+ */
+static svn_boolean_t
+skip_identical_prefix_blocks(apr_off_t *lines, svn_boolean_t *had_cr,
+                             struct file_info file[], apr_size_t file_len)
+{
+  apr_off_t max_delta = file[0].endp - file[0].curp;
+  apr_size_t i;
+
+  for (i = 1; i < file_len; i++)
+    if (file[i].endp - file[i].curp < max_delta)
+      max_delta = file[i].endp - file[i].curp;
+
+  for (; max_delta > SCAN_BLOCK_SIZE; max_delta -= SCAN_BLOCK_SIZE)
+    {
+      char *curp = file[0].curp;
+      char *endp = curp + SCAN_BLOCK_SIZE;
+
+      for (i = 1; i < file_len; i++)
+        if (memcmp(curp, file[i].curp, SCAN_BLOCK_SIZE) != 0)
+          return FALSE;
+
+      /* A '\n' only ends a line if it doesn't complete a "\r\n". */
+      while (curp < endp)
+        {
+          char *eol = svn_eol__find_eol_start(curp, endp - curp);
+
+          if (!eol)
+            break;
+
+          if (*eol == '\r'
+              || (eol > file[0].curp ? eol[-1] != '\r' : !*had_cr))
+            (*lines)++;
+
+          curp = eol + 1;
+        }
+      *had_cr = (endp[-1] == '\r');
+
+      for (i = 0; i < file_len; i++)
+        file[i].curp += SCAN_BLOCK_SIZE;
+    }
+
+  return TRUE;
+}
+
+/* Like skip_identical_prefix_blocks() but for find_identical_suffix(),
+ * going backward from the curp's of all FILEs to just above MIN_CURP and
+ * updating *HAD_NL.
+ */
+static svn_boolean_t
+skip_identical_suffix_blocks(apr_off_t *lines, svn_boolean_t *had_nl,
+                             struct file_info file[],
+                             const char *min_curp[], apr_size_t file_len)
+{
+  apr_size_t i;
+
+  while (TRUE)
+    {
+      char *startp = file[0].curp + 1 - SCAN_BLOCK_SIZE;
+      char *endp = file[0].curp + 1;
+      char *curp = startp;
+
+      for (i = 0; i < file_len; i++)
+        if (file[i].curp - min_curp[i] <= SCAN_BLOCK_SIZE - 1)
+          return TRUE;
+
+      for (i = 1; i < file_len; i++)
+        if (memcmp(startp, file[i].curp + 1 - SCAN_BLOCK_SIZE,
+                   SCAN_BLOCK_SIZE) != 0)
+          return FALSE;
+
+      /* A '\r' only ends a line if it doesn't start a "\r\n". */
+      while (curp < endp)
+        {
+          char *eol = svn_eol__find_eol_start(curp, endp - curp);
+
+          if (!eol)
+            break;
+
+          if (*eol == '\n'
+              || (eol + 1 < endp ? eol[1] != '\n' : !*had_nl))
+            (*lines)++;
+
+          curp = eol + 1;
+        }
+      *had_nl = (*startp == '\n');
+
+      for (i = 0; i < file_len; i++)
+        file[i].curp -= SCAN_BLOCK_SIZE;
+    }
+}
+
 /* Find the prefix which is identical between all elements of the FILE array.
  * Return the number of prefix lines in PREFIX_LINES.  REACHED_ONE_EOF will be
  * set to TRUE if one of the FILEs reached its end while scanning prefix,
@@ -387,6 +414,7 @@ find_identical_prefix(svn_boolean_t *reached_one_eof, apr_off_t *prefix_lines,
 {
   svn_boolean_t had_cr = FALSE;
   svn_boolean_t is_match;
+  svn_boolean_t try_blocks = TRUE;
   apr_off_t lines = 0;
   apr_size_t i;
 
@@ -419,6 +447,11 @@ find_identical_prefix(svn_boolean_t *reached_one_eof, apr_off_t *prefix_lines,
 
       INCREMENT_POINTERS(file, file_len, pool);
 
+      /* Once a block differs, the prefix ends within it. */
+      if (try_blocks && !is_one_at_eof(file, file_len))
+        try_blocks = skip_identical_prefix_blocks(&lines, &had_cr,
+                                                  file, file_len);
+
 #if SVN_UNALIGNED_ACCESS_IS_OK
 
       /* Try to advance as far as possible with machine-word granularity.
@@ -543,6 +576,7 @@ find_identical_suffix(apr_off_t *suffix_lines, struct file_info file[],
   apr_off_t min_file_size;
   int suffix_lines_to_keep = SUFFIX_LINES_TO_KEEP;
   svn_boolean_t is_match;
+  svn_boolean_t try_blocks = TRUE;
   apr_off_t lines = 0;
   svn_boolean_t had_nl;
   apr_size_t i;
@@ -611,9 +645,9 @@ find_identical_suffix(apr_off_t *suffix_lines, struct file_info file[],
   while (is_match)
     {
       svn_boolean_t reached_prefix;
-#if SVN_UNALIGNED_ACCESS_IS_OK
       /* Initialize the minimum pointer positions. */
       const char *min_curp[4];
+#if SVN_UNALIGNED_ACCESS_IS_OK
       svn_boolean_t can_read_word;
 #endif /* SVN_UNALIGNED_ACCESS_IS_OK */
 
@@ -636,7 +670,6 @@ find_identical_suffix(apr_off_t *suffix_lines, struct file_info file[],
 
       DECREMENT_POINTERS(file_for_suffix, file_len, pool);
 
-#if SVN_UNALIGNED_ACCESS_IS_OK
       for (i = 0; i < file_len; i++)
         min_curp[i] = file_for_suffix[i].buffer;
 
@@ -646,6 +679,13 @@ find_identical_suffix(apr_off_t *suffix_lines, struct file_info file[],
       if (file_for_suffix[0].chunk == suffix_min_chunk0)
         min_curp[0] += suffix_min_offset0;
 
+      /* Once a block differs, the suffix starts within it. */
+      if (try_blocks && !is_one_at_bof(file_for_suffix, file_len))
+        try_blocks = skip_identical_suffix_blocks(&lines, &had_nl,
+                                                  file_for_suffix, min_curp,
+                                                  file_len);
+
+#if SVN_UNALIGNED_ACCESS_IS_OK
       /* Scan quickly by reading with machine-word granularity. */
       for (i = 0, can_read_word = TRUE; can_read_word && i < file_len; i++)
         can_read_word = ((file_for_suffix[i].curp + 1 - sizeof(apr_uintptr_t))
@@ -863,7 +903,7 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
   char *eol;
   apr_off_t last_chunk;
   apr_off_t length;
-  apr_uint32_t h = 0;
+  svn_diff__hash_t h = { 0 };
   /* Did the last chunk end in a CR character? */
   svn_boolean_t had_cr = FALSE;
 
@@ -950,7 +990,7 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
             file_token->norm_offset += (c - curp);
           }
         file_token->length += length;
-        h = svn__adler32(h, c, length);
+        svn_diff__hash_update(&h, c, length);
       }
 
       curp = endp = file->buffer;
@@ -1007,7 +1047,8 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
 
       file_token->length += length;
 
-      *hash = svn__adler32(h, c, length);
+      svn_diff__hash_update(&h, c, length);
+      *hash = svn_diff__hash_final(&h);
       *token = file_token;
     }
 
@@ -1179,8 +1220,11 @@ static const svn_diff_fns2_t svn_diff__file_vtable =
   token_discard_all
 };
 
-/* Id for the --ignore-eol-style option, which doesn't have a short name. */
+/* Ids for the options which don't have a short name. */
 #define SVN_DIFF__OPT_IGNORE_EOL_STYLE 256
+#define SVN_DIFF__OPT_DIFF_ALGORITHM 257
+#define SVN_DIFF__OPT_PATIENCE 258
+#define SVN_DIFF__OPT_HISTOGRAM 259
 
 /* Options supported by svn_diff_file_options_parse(). */
 static const apr_getopt_option_t diff_options[] =
@@ -1193,6 +1237,9 @@ static const apr_getopt_option_t diff_options[] =
    * ### we don't have optional argument support. */
   { "unified", 'u', 0, NULL },
   { "context", 'U', 1, NULL },
+  { "diff-algorithm", SVN_DIFF__OPT_DIFF_ALGORITHM, 1, NULL },
+  { "patience", SVN_DIFF__OPT_PATIENCE, 0, NULL },
+  { "histogram", SVN_DIFF__OPT_HISTOGRAM, 0, NULL },
   { NULL, 0, 0, NULL }
 };
 
@@ -1298,6 +1345,24 @@ svn_diff_file_options_parse(svn_diff_file_options_t *options,
         case 'U':
           SVN_ERR(svn_cstring_atoi(&options->context_size, opt_arg));
           break;
+        case SVN_DIFF__OPT_DIFF_ALGORITHM:
+          if (strcmp(opt_arg, "myers") == 0)
+            options->algorithm = svn_diff_file_algorithm_myers;
+          else if (strcmp(opt_arg, "patience") == 0)
+            options->algorithm = svn_diff_file_algorithm_patience;
+          else if (strcmp(opt_arg, "histogram") == 0)
+            options->algorithm = svn_diff_file_algorithm_histogram;
+          else
+            return svn_error_createf(SVN_ERR_INVALID_DIFF_OPTION, NULL,
+                                     _("Unknown diff algorithm '%s'"),
+                                     opt_arg);
+          break;
+        case SVN_DIFF__OPT_PATIENCE:
+          options->algorithm = svn_diff_file_algorithm_patience;
+          break;
+        case SVN_DIFF__OPT_HISTOGRAM:
+          options->algorithm = svn_diff_file_algorithm_histogram;
+          break;
         default:
           break;
         }
@@ -1326,7 +1391,8 @@ svn_diff_file_diff_2(svn_diff_t **diff,
   baton.files[1].path = modified;
   baton.pool = svn_pool_create(pool);
 
-  SVN_ERR(svn_diff_diff_2(diff, &baton, &svn_diff__file_vtable, pool));
+  SVN_ERR(svn_diff__diff_2(diff, &baton, &svn_diff__file_vtable,
+                           options->algorithm, pool));
 
   svn_pool_destroy(baton.pool);
   return SVN_NO_ERROR;
@@ -1348,7 +1414,8 @@ svn_diff_file_diff3_2(svn_diff_t **diff,
   baton.files[2].path = latest;
   baton.pool = svn_pool_create(pool);
 
-  SVN_ERR(svn_diff_diff3_2(diff, &baton, &svn_diff__file_vtable, pool));
+  SVN_ERR(svn_diff__diff3_2(diff, &baton, &svn_diff__file_vtable,
+                            options->algorithm, pool));
 
   svn_pool_destroy(baton.pool);
   return SVN_NO_ERROR;
@@ -1973,16 +2040,16 @@ svn_diff_file_output_unified4(svn_stream_t *output_stream,
 
 /** Display diff3 **/
 
-/* A stream to remember *leading* context.  Note that this stream does
-   *not* copy the data that it is remembering; it just saves
-   *pointers! */
+/* A stream to remember *leading* context.  The lines are copied, since
+   the window of the file they were read from may have moved on by the
+   time they are needed. */
 typedef struct context_saver_t {
   svn_stream_t *stream;
   int context_size;
-  const char **data; /* const char *data[context_size] */
-  apr_size_t *len;   /* apr_size_t len[context_size] */
+  svn_stringbuf_t **data; /* svn_stringbuf_t *data[context_size] */
   apr_size_t next_slot;
   apr_ssize_t total_writes;
+  apr_pool_t *pool;
 } context_saver_t;
 
 
@@ -1995,8 +2062,14 @@ context_saver_stream_write(void *baton,
 
   if (cs->context_size > 0)
     {
-      cs->data[cs->next_slot] = data;
-      cs->len[cs->next_slot] = *len;
+      svn_stringbuf_t **slot = &cs->data[cs->next_slot];
+
+      if (*slot)
+        svn_stringbuf_setempty(*slot);
+      else
+        *slot = svn_stringbuf_create_ensure(*len, cs->pool);
+
+      svn_stringbuf_appendbytes(*slot, data, *len);
       cs->next_slot = (cs->next_slot + 1) % cs->context_size;
       cs->total_writes++;
     }
@@ -2015,6 +2088,17 @@ typedef struct svn_diff3__file_output_baton_t
   char       *endp[3];
   char       *curp[3];
 
+  /* BUFFER holds the part of FILE starting at WINDOW_OFFSET, which is
+     at most WINDOW_SIZE bytes long.  See map_window(). */
+  apr_file_t *file[3];
+  apr_off_t   size[3];
+  apr_off_t   window_offset[3];
+  apr_size_t  window_size[3];
+#if APR_HAS_MMAP
+  apr_mmap_t *mm[3];
+#endif
+  apr_pool_t *window_pool[3];
+
   /* The following four members are in the encoding used for the output. */
   const char *conflict_modified;
   const char *conflict_original;
@@ -2053,8 +2137,9 @@ flush_context_saver(context_saver_t *cs,
       apr_size_t slot = (i + cs->next_slot) % cs->context_size;
       if (cs->data[slot])
         {
-          apr_size_t len = cs->len[slot];
-          SVN_ERR(svn_stream_write(output_stream, cs->data[slot], &len));
+          apr_size_t len = cs->data[slot]->len;
+          SVN_ERR(svn_stream_write(output_stream, cs->data[slot]->data,
+                                   &len));
         }
     }
   return SVN_NO_ERROR;
@@ -2076,7 +2161,7 @@ make_context_saver(svn_diff3__file_output_baton_t *fob)
   fob->output_stream = cs->stream;
   cs->context_size = fob->context_size;
   cs->data = apr_pcalloc(fob->pool, sizeof(*cs->data) * cs->context_size);
-  cs->len = apr_pcalloc(fob->pool, sizeof(*cs->len) * cs->context_size);
+  cs->pool = fob->pool;
 }
 
 
@@ -2132,6 +2217,100 @@ typedef enum svn_diff3__file_output_type_e
 } svn_diff3__file_output_type_e;
 
 
+/* Files are mapped or read in windows of (at least) this size, so that
+ * merging huge files needs a bounded amount of address space.  It is a
+ * multiple of CHUNK_SIZE, which keeps window offsets aligned to pages and
+ * to the mapping granularity on Windows. */
+/* If you change this number, update test_merge_window_edges() in diff-diff3-test.c */
+#ifndef OUTPUT_WINDOW_SIZE
+#define OUTPUT_WINDOW_SIZE (128 * CHUNK_SIZE)
+#endif
+
+/* Let the window of file IDX in BATON start at OFFSET, rounded down to
+ * a multiple of CHUNK_SIZE, and point BATON->CURP[IDX] at OFFSET.  The
+ * window is mapped if possible and read into memory otherwise.
+ */
+static svn_error_t *
+map_window(svn_diff3__file_output_baton_t *baton, int idx, apr_off_t offset)
+{
+  apr_off_t start = chunk_to_offset(offset_to_chunk(offset));
+  apr_size_t length = baton->window_size[idx];
+
+  if (baton->size[idx] - start < (apr_off_t) length)
+    length = (apr_size_t) (baton->size[idx] - start);
+
+#if APR_HAS_MMAP
+  if (baton->mm[idx])
+    {
+      apr_status_t rv = apr_mmap_delete(baton->mm[idx]);
+      if (rv != APR_SUCCESS)
+        {
+          return svn_error_wrap_apr(rv, _("Failed to delete mmap '%s'"),
+                                    baton->path[idx]);
+        }
+    }
+#endif /* APR_HAS_MMAP */
+
+  svn_pool_clear(baton->window_pool[idx]);
+  baton->buffer[idx] = NULL;
+
+#if APR_HAS_MMAP
+  baton->mm[idx] = NULL;
+  if (length > APR_MMAP_THRESHOLD)
+    {
+      apr_status_t rv = apr_mmap_create(&baton->mm[idx], baton->file[idx],
+                                        start, length, APR_MMAP_READ,
+                                        baton->window_pool[idx]);
+      if (rv == APR_SUCCESS)
+        baton->buffer[idx] = baton->mm[idx]->mm;
+      else
+        baton->mm[idx] = NULL;
+
+      /* On failure we just fall through and try reading the window into
+       * memory instead.
+       */
+    }
+#endif /* APR_HAS_MMAP */
+
+  if (baton->buffer[idx] == NULL)
+    {
+      baton->buffer[idx] = apr_palloc(baton->window_pool[idx], length);
+      if (length > 0)
+        SVN_ERR(read_chunk(baton->file[idx], baton->buffer[idx], length,
+                           start, baton->window_pool[idx]));
+    }
+
+  baton->window_offset[idx] = start;
+  baton->curp[idx] = baton->buffer[idx] + (offset - start);
+  baton->endp[idx] = baton->buffer[idx] + length;
+
+  return SVN_NO_ERROR;
+}
+
+/* Return TRUE if the window of file IDX in BATON extends to EOF. */
+static APR_INLINE svn_boolean_t
+window_at_eof(svn_diff3__file_output_baton_t *baton, int idx)
+{
+  return baton->window_offset[idx]
+           + (baton->endp[idx] - baton->buffer[idx]) == baton->size[idx];
+}
+
+/* Move the window of file IDX in BATON forward to BATON->CURP[IDX], or
+ * grow it if it can't move forward, because the line starting there does
+ * not fit in it.
+ */
+static svn_error_t *
+advance_window(svn_diff3__file_output_baton_t *baton, int idx)
+{
+  apr_off_t offset = baton->window_offset[idx]
+                       + (baton->curp[idx] - baton->buffer[idx]);
+
+  if (offset - baton->window_offset[idx] < CHUNK_SIZE)
+    baton->window_size[idx] *= 2;
+
+  return map_window(baton, idx, offset);
+}
+
 static svn_error_t *
 output_line(svn_diff3__file_output_baton_t *baton,
             svn_diff3__file_output_type_e type, int idx)
@@ -2141,17 +2320,28 @@ output_line(svn_diff3__file_output_baton_t *baton,
   char *eol;
   apr_size_t len;
 
-  curp = baton->curp[idx];
-  endp = baton->endp[idx];
-
   /* Lazily update the current line even if we're at EOF.
    */
   baton->current_line[idx]++;
 
+  while (TRUE)
+    {
+      curp = baton->curp[idx];
+      endp = baton->endp[idx];
+      eol = svn_eol__find_eol_start(curp, endp - curp);
+
+      /* Stop once the whole line is in the window.  A CR at the end of
+         the window may still be followed by a LF. */
+      if ((eol && (*eol == '\n' || eol + 1 != endp))
+          || window_at_eof(baton, idx))
+        break;
+
+      SVN_ERR(advance_window(baton, idx));
+    }
+
   if (curp == endp)
     return SVN_NO_ERROR;
 
-  eol = svn_eol__find_eol_start(curp, endp - curp);
   if (!eol)
     eol = endp;
   else
@@ -2389,11 +2579,7 @@ svn_diff_file_output_merge3(svn_stream_t *output_stream,
                             apr_pool_t *scratch_pool)
 {
   svn_diff3__file_output_baton_t baton;
-  apr_file_t *file[3];
   int idx;
-#if APR_HAS_MMAP
-  apr_mmap_t *mm[3] = { 0 };
-#endif /* APR_HAS_MMAP */
   const char *eol;
   svn_boolean_t conflicts_only =
     (style == svn_diff_conflict_display_only_conflicts);
@@ -2434,25 +2620,42 @@ svn_diff_file_output_merge3(svn_stream_t *output_stream,
 
   for (idx = 0; idx < 3; idx++)
     {
-      apr_size_t size;
+      apr_finfo_t finfo;
 
-      SVN_ERR(map_or_read_file(&file[idx],
-                               MMAP_T_ARG(mm[idx])
-                               &baton.buffer[idx], &size,
-                               baton.path[idx], scratch_pool));
+      SVN_ERR(svn_io_file_open(&baton.file[idx], baton.path[idx],
+                               APR_READ, APR_OS_DEFAULT, scratch_pool));
+      SVN_ERR(svn_io_file_info_get(&finfo, APR_FINFO_SIZE, baton.file[idx],
+                                   scratch_pool));
 
-      baton.curp[idx] = baton.buffer[idx];
-      baton.endp[idx] = baton.buffer[idx];
-
-      if (baton.endp[idx])
-        baton.endp[idx] += size;
+      baton.size[idx] = finfo.size;
+      baton.window_size[idx] = OUTPUT_WINDOW_SIZE;
+      baton.window_pool[idx] = svn_pool_create(scratch_pool);
+      SVN_ERR(map_window(&baton, idx, 0));
     }
 
   /* Check what eol marker we should use for conflict markers.
      We use the eol marker of the modified file and fall back on the
-     platform's eol marker if that file doesn't contain any newlines. */
-  eol = svn_eol__detect_eol(baton.buffer[1], baton.endp[1] - baton.buffer[1],
-                            NULL);
+     platform's eol marker if that file doesn't contain any newlines.
+     Look beyond the first window if necessary. */
+  while (TRUE)
+    {
+      char *eolp;
+
+      eol = svn_eol__detect_eol(baton.curp[1], baton.endp[1] - baton.curp[1],
+                                &eolp);
+      if ((eol && (*eolp == '\n' || eolp + 1 != baton.endp[1]))
+          || window_at_eof(&baton, 1))
+        break;
+
+      baton.curp[1] = eol ? eolp : baton.endp[1];
+      SVN_ERR(advance_window(&baton, 1));
+    }
+
+  /* Start the output at the beginning of the file again. */
+  if (baton.window_offset[1] > 0)
+    SVN_ERR(map_window(&baton, 1, 0));
+  baton.curp[1] = baton.buffer[1];
+
   if (! eol)
     eol = APR_EOL_STR;
   baton.marker_eol = eol;
@@ -2467,9 +2670,9 @@ svn_diff_file_output_merge3(svn_stream_t *output_stream,
   for (idx = 0; idx < 3; idx++)
     {
 #if APR_HAS_MMAP
-      if (mm[idx])
+      if (baton.mm[idx])
         {
-          apr_status_t rv = apr_mmap_delete(mm[idx]);
+          apr_status_t rv = apr_mmap_delete(baton.mm[idx]);
           if (rv != APR_SUCCESS)
             {
               return svn_error_wrap_apr(rv, _("Failed to delete mmap '%s'"),
@@ -2478,10 +2681,8 @@ svn_diff_file_output_merge3(svn_stream_t *output_stream,
         }
 #endif /* APR_HAS_MMAP */
 
-      if (file[idx])
-        {
-          SVN_ERR(svn_io_file_close(file[idx], scratch_pool));
-        }
+      svn_pool_destroy(baton.window_pool[idx]);
+      SVN_ERR(svn_io_file_close(baton.file[idx], scratch_pool));
     }
 
   if (conflicts_only)
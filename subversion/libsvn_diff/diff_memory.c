@@ -36,7 +36,6 @@
 #include "svn_utf.h"
 #include "diff.h"
 #include "svn_private_config.h"
-#include "private/svn_adler32.h"
 #include "private/svn_diff_private.h"
 
 typedef struct source_tokens_t
@@ -135,10 +134,12 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
       apr_off_t len = tok->len;
       svn_diff__normalize_state_t state
         = svn_diff__normalize_state_normal;
+      svn_diff__hash_t h = { 0 };
 
       svn_diff__normalize_buffer(&buf, &len, &state, tok->data,
                                  mem_baton->normalization_options);
-      *hash = svn__adler32(0, buf, len);
+      svn_diff__hash_update(&h, buf, len);
+      *hash = svn_diff__hash_final(&h);
       src->next_token++;
     }
   else
@@ -293,7 +294,8 @@ svn_diff_mem_string_diff(svn_diff_t **diff,
 
   baton.normalization_options = options;
 
-  return svn_diff_diff_2(diff, &baton, &svn_diff__mem_vtable, pool);
+  return svn_diff__diff_2(diff, &baton, &svn_diff__mem_vtable,
+                          options->algorithm, pool);
 }
 
 svn_error_t *
@@ -313,7 +315,8 @@ svn_diff_mem_string_diff3(svn_diff_t **diff,
 
   baton.normalization_options = options;
 
-  return svn_diff_diff3_2(diff, &baton, &svn_diff__mem_vtable, pool);
+  return svn_diff__diff3_2(diff, &baton, &svn_diff__mem_vtable,
+                           options->algorithm, pool);
 }
 
 
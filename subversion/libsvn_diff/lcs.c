@@ -25,6 +25,9 @@
 #include <apr.h>
 #include <apr_pools.h>
 #include <apr_general.h>
+#include <apr_tables.h>
+
+#include "svn_pools.h"
 
 #include "diff.h"
 
@@ -228,66 +231,31 @@ prepend_lcs(svn_diff__lcs_t *lcs, apr_off_t lines,
 }
 
 
-svn_diff__lcs_t *
-svn_diff__lcs(svn_diff__position_t *position_list1, /* pointer to tail (ring) */
-              svn_diff__position_t *position_list2, /* pointer to tail (ring) */
-              svn_diff__token_index_t *token_counts_list1, /* array of counts */
-              svn_diff__token_index_t *token_counts_list2, /* array of counts */
-              svn_diff__token_index_t num_tokens,
-              apr_off_t prefix_lines,
-              apr_off_t suffix_lines,
-              apr_pool_t *pool)
+
+/* Calculate the LCS of the rings POSITION_LIST1 and POSITION_LIST2 (both
+ * pointing to their tail) with the Wu/Manber/Myers algorithm.
+ *
+ * TOKEN_COUNTS[] are the per-token counts of both rings and UNIQUE_COUNT[]
+ * the number of positions in each ring whose token doesn't occur in the
+ * other one.  Return the common chunks in reverse order, without the EOF
+ * chunk.  The rings are restored before returning.
+ */
+static svn_diff__lcs_t *
+lcs_myers(svn_diff__position_t *position_list1,
+          svn_diff__position_t *position_list2,
+          svn_diff__token_index_t *token_counts[2],
+          const svn_diff__token_index_t unique_count[2],
+          apr_pool_t *pool)
 {
   apr_off_t length[2];
-  svn_diff__token_index_t *token_counts[2];
-  svn_diff__token_index_t unique_count[2];
-  svn_diff__token_index_t token_index;
   svn_diff__snake_t *fp;
   apr_off_t d;
   apr_off_t k;
   apr_off_t p = 0;
-  svn_diff__lcs_t *lcs, *lcs_freelist = NULL;
+  svn_diff__lcs_t *lcs_freelist = NULL;
 
   svn_diff__position_t sentinel_position[2];
 
-  /* Since EOF is always a sync point we tack on an EOF link
-   * with sentinel positions
-   */
-  lcs = apr_palloc(pool, sizeof(*lcs));
-  lcs->position[0] = apr_pcalloc(pool, sizeof(*lcs->position[0]));
-  lcs->position[0]->offset = position_list1
-                             ? position_list1->offset + suffix_lines + 1
-                             : prefix_lines + suffix_lines + 1;
-  lcs->position[1] = apr_pcalloc(pool, sizeof(*lcs->position[1]));
-  lcs->position[1]->offset = position_list2
-                             ? position_list2->offset + suffix_lines + 1
-                             : prefix_lines + suffix_lines + 1;
-  lcs->length = 0;
-  lcs->refcount = 1;
-  lcs->next = NULL;
-
-  if (position_list1 == NULL || position_list2 == NULL)
-    {
-      if (suffix_lines)
-        lcs = prepend_lcs(lcs, suffix_lines,
-                          lcs->position[0]->offset - suffix_lines,
-                          lcs->position[1]->offset - suffix_lines,
-                          pool);
-      if (prefix_lines)
-        lcs = prepend_lcs(lcs, prefix_lines, 1, 1, pool);
-
-      return lcs;
-    }
-
-  unique_count[1] = unique_count[0] = 0;
-  for (token_index = 0; token_index < num_tokens; token_index++)
-    {
-      if (token_counts_list1[token_index] == 0)
-        unique_count[1] += token_counts_list2[token_index];
-      if (token_counts_list2[token_index] == 0)
-        unique_count[0] += token_counts_list1[token_index];
-    }
-
   /* Calculate lengths M and N of the sequences to be compared. Do not
    * count tokens unique to one file, as those are ignored in __snake.
    */
@@ -313,12 +281,10 @@ svn_diff__lcs(svn_diff__position_t *position_list1, /* pointer to tail (ring) */
   sentinel_position[0].next = position_list1->next;
   position_list1->next = &sentinel_position[0];
   sentinel_position[0].offset = position_list1->offset + 1;
-  token_counts[0] = token_counts_list1;
 
   sentinel_position[1].next = position_list2->next;
   position_list2->next = &sentinel_position[1];
   sentinel_position[1].offset = position_list2->offset + 1;
-  token_counts[1] = token_counts_list2;
 
   /* Negative indices will not be used elsewhere
    */
@@ -355,19 +321,633 @@ svn_diff__lcs(svn_diff__position_t *position_list1, /* pointer to tail (ring) */
     }
   while (fp[0].position[1] != &sentinel_position[1]);
 
+  position_list1->next = sentinel_position[0].next;
+  position_list2->next = sentinel_position[1].next;
+
+  return fp[0].lcs;
+}
+
+
+/*
+ * Patience and histogram diff.
+ *
+ * Both algorithms split the sources recursively at 'anchors': lines that
+ * are known to be good sync points.  After stripping the common prefix and
+ * suffix of a range, patience diff uses the longest increasing sequence of
+ * lines that occur exactly once in either side of the range, while
+ * histogram diff uses the longest run of matching lines among those with
+ * the lowest number of occurrences in the first source.  Anchors are cheap
+ * to find, so this is close to linear for typical inputs and does not
+ * degrade for heavily reordered ones.  Patience diff uses the histogram
+ * anchor for ranges without unique lines, and small ranges with only
+ * frequent lines in common fall back to the Myers algorithm above.
+ *
+ * Unlike the Myers code, these work on arrays of positions; a line's index
+ * in the array is its offset relative to the first position of the ring.
+ */
+
+/* Histogram diff prefers lines that occur at most this often in the range
+ * of the first source, and never tries more occurrences of a line. */
+#define HISTOGRAM_MAX_CHAIN_LENGTH 64
+
+/* Ranges without sufficiently rare common lines are compared with the
+ * Myers algorithm only up to this many lines in total. */
+#define HISTOGRAM_MAX_MYERS_LINES 4096
+
+/* A range of lines still to be compared, or known to be equal. */
+typedef struct anchored_range_t
+{
+  /* Start and (exclusive) end indexes in either source. */
+  apr_off_t start[2];
+  apr_off_t end[2];
+
+  /* If set, the range is known to be equal in both sources. */
+  svn_boolean_t is_match;
+} anchored_range_t;
+
+typedef struct anchored_baton_t
+{
+  svn_diff_file_algorithm_t algorithm;
+
+  /* The positions of either source, in order. */
+  svn_diff__position_t **positions[2];
+
+  /* Scratch arrays indexed by token index.  All COUNTS are 0 and all
+   * INDEXES are -1 between calls to process_range(). */
+  svn_diff__token_index_t *counts[2];
+  apr_off_t *indexes;
+
+  /* Next occurrence of the same token in the first source, indexed by
+   * position.  Used by histogram_split(). */
+  apr_off_t *chain;
+
+  /* Stack of anchored_range_t still to be processed. */
+  apr_array_header_t *stack;
+
+  /* The last common chunk found so far and where to link the next one. */
+  svn_diff__lcs_t *last_lcs;
+  svn_diff__lcs_t **lcs_ref;
+
+  apr_pool_t *pool;
+} anchored_baton_t;
+
+/* Token index of line I in source IDX. */
+#define TOKEN(b, idx, i) ((b)->positions[idx][i]->token_index)
+
+/* Append LENGTH common lines starting at START0 and START1 to the result,
+ * merging them into the previous chunk if they are adjacent. */
+static void
+emit_match(anchored_baton_t *b,
+           apr_off_t start0,
+           apr_off_t start1,
+           apr_off_t length)
+{
+  svn_diff__lcs_t *lcs = b->last_lcs;
+
+  if (length <= 0)
+    return;
+
+  if (lcs
+      && lcs->position[0]->offset + lcs->length
+           == b->positions[0][start0]->offset
+      && lcs->position[1]->offset + lcs->length
+           == b->positions[1][start1]->offset)
+    {
+      lcs->length += length;
+      return;
+    }
+
+  lcs = apr_palloc(b->pool, sizeof(*lcs));
+  lcs->position[0] = b->positions[0][start0];
+  lcs->position[1] = b->positions[1][start1];
+  lcs->length = length;
+  lcs->refcount = 1;
+  lcs->next = NULL;
+
+  *b->lcs_ref = lcs;
+  b->lcs_ref = &lcs->next;
+  b->last_lcs = lcs;
+}
+
+/* Push the range [START0, END0) x [START1, END1) onto B's stack, unless
+ * it is empty. */
+static void
+push_range(anchored_baton_t *b,
+           apr_off_t start0, apr_off_t start1,
+           apr_off_t end0, apr_off_t end1,
+           svn_boolean_t is_match)
+{
+  anchored_range_t *range;
+
+  if (start0 == end0 && start1 == end1)
+    return;
+
+  range = apr_array_push(b->stack);
+  range->start[0] = start0;
+  range->start[1] = start1;
+  range->end[0] = end0;
+  range->end[1] = end1;
+  range->is_match = is_match;
+}
+
+/* Compare the given range of lines with lcs_myers() and emit the result.
+ * Use SCRATCH_POOL for temporary allocations. */
+static void
+fallback_myers(anchored_baton_t *b,
+               apr_off_t start0, apr_off_t start1,
+               apr_off_t end0, apr_off_t end1,
+               apr_pool_t *scratch_pool)
+{
+  svn_diff__position_t *tail[2];
+  svn_diff__position_t *saved_next[2];
+  svn_diff__token_index_t unique_count[2] = { 0, 0 };
+  svn_diff__lcs_t *lcs;
+  apr_off_t i;
+
+  for (i = start0; i < end0; i++)
+    b->counts[0][TOKEN(b, 0, i)]++;
+  for (i = start1; i < end1; i++)
+    b->counts[1][TOKEN(b, 1, i)]++;
+
+  for (i = start0; i < end0; i++)
+    if (b->counts[1][TOKEN(b, 0, i)] == 0)
+      unique_count[0]++;
+  for (i = start1; i < end1; i++)
+    if (b->counts[0][TOKEN(b, 1, i)] == 0)
+      unique_count[1]++;
+
+  /* Temporarily close both ranges into rings. */
+  tail[0] = b->positions[0][end0 - 1];
+  saved_next[0] = tail[0]->next;
+  tail[0]->next = b->positions[0][start0];
+  tail[1] = b->positions[1][end1 - 1];
+  saved_next[1] = tail[1]->next;
+  tail[1]->next = b->positions[1][start1];
+
+  lcs = lcs_myers(tail[0], tail[1], b->counts, unique_count, scratch_pool);
+
+  tail[0]->next = saved_next[0];
+  tail[1]->next = saved_next[1];
+
+  for (i = start0; i < end0; i++)
+    b->counts[0][TOKEN(b, 0, i)] = 0;
+  for (i = start1; i < end1; i++)
+    b->counts[1][TOKEN(b, 1, i)] = 0;
+
+  for (lcs = svn_diff__lcs_reverse(lcs); lcs; lcs = lcs->next)
+    emit_match(b,
+               lcs->position[0]->offset - b->positions[0][0]->offset,
+               lcs->position[1]->offset - b->positions[1][0]->offset,
+               lcs->length);
+}
+
+/* Find the patience diff anchors of the given range and push the ranges
+ * between them onto B's stack.  Return FALSE if there are no anchors.
+ * Use SCRATCH_POOL for temporary allocations. */
+static svn_boolean_t
+patience_split(anchored_baton_t *b,
+               apr_off_t start0, apr_off_t start1,
+               apr_off_t end0, apr_off_t end1,
+               apr_pool_t *scratch_pool)
+{
+  apr_off_t *anchors[2];
+  apr_off_t *piles;
+  apr_off_t *prev;
+  apr_off_t count = 0;
+  apr_off_t pile_count = 0;
+  apr_off_t i, j;
+
+  for (i = start0; i < end0; i++)
+    {
+      b->counts[0][TOKEN(b, 0, i)]++;
+      b->indexes[TOKEN(b, 0, i)] = i;
+    }
+  for (j = start1; j < end1; j++)
+    b->counts[1][TOKEN(b, 1, j)]++;
+
+  /* Collect the lines unique to both sides, in the order of the second
+   * source. */
+  anchors[0] = apr_palloc(scratch_pool,
+                          sizeof(*anchors[0]) * (apr_size_t)(end1 - start1));
+  anchors[1] = apr_palloc(scratch_pool,
+                          sizeof(*anchors[1]) * (apr_size_t)(end1 - start1));
+  for (j = start1; j < end1; j++)
+    {
+      svn_diff__token_index_t token_index = TOKEN(b, 1, j);
+
+      if (b->counts[0][token_index] == 1 && b->counts[1][token_index] == 1)
+        {
+          anchors[0][count] = b->indexes[token_index];
+          anchors[1][count] = j;
+          count++;
+        }
+    }
+
+  for (i = start0; i < end0; i++)
+    {
+      b->counts[0][TOKEN(b, 0, i)] = 0;
+      b->indexes[TOKEN(b, 0, i)] = -1;
+    }
+  for (j = start1; j < end1; j++)
+    b->counts[1][TOKEN(b, 1, j)] = 0;
+
+  if (count == 0)
+    return FALSE;
+
+  /* Patience sorting: find the longest sequence of anchors that is
+   * increasing in the first source as well.  PILES holds the anchor on
+   * top of each pile, PREV the top of the previous pile at the time an
+   * anchor was placed. */
+  piles = apr_palloc(scratch_pool, sizeof(*piles) * (apr_size_t)count);
+  prev = apr_palloc(scratch_pool, sizeof(*prev) * (apr_size_t)count);
+  for (i = 0; i < count; i++)
+    {
+      apr_off_t lo = 0;
+      apr_off_t hi = pile_count;
+
+      while (lo < hi)
+        {
+          apr_off_t mid = lo + (hi - lo) / 2;
+
+          if (anchors[0][piles[mid]] < anchors[0][i])
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+      prev[i] = lo ? piles[lo - 1] : -1;
+      piles[lo] = i;
+      if (lo == pile_count)
+        pile_count++;
+    }
+
+  /* Walk the sequence backwards, so the leftmost range ends up on top of
+   * the stack. */
+  for (i = piles[pile_count - 1]; i >= 0; i = prev[i])
+    {
+      push_range(b, anchors[0][i] + 1, anchors[1][i] + 1, end0, end1, FALSE);
+      push_range(b, anchors[0][i], anchors[1][i],
+                 anchors[0][i] + 1, anchors[1][i] + 1, TRUE);
+      end0 = anchors[0][i];
+      end1 = anchors[1][i];
+    }
+  push_range(b, start0, start1, end0, end1, FALSE);
+
+  return TRUE;
+}
+
+/* Scan the given range for the longest run of common lines whose least
+ * frequent line occurs at most MAX_COUNT times in the first source, and
+ * among those prefer the ones with the least frequent lines.  Only the
+ * first HISTOGRAM_MAX_CHAIN_LENGTH occurrences of each line are tried.
+ *
+ * Set *BEST_START and *BEST_LENGTH to the run found, *BEST_LENGTH being 0
+ * if there is none.  Return TRUE if there are any common lines at all.
+ */
+static svn_boolean_t
+histogram_scan(apr_off_t best_start[2],
+               apr_off_t *best_length,
+               anchored_baton_t *b,
+               apr_off_t start0, apr_off_t start1,
+               apr_off_t end0, apr_off_t end1,
+               svn_diff__token_index_t max_count)
+{
+  svn_diff__token_index_t *counts = b->counts[0];
+  svn_diff__token_index_t best_count = max_count;
+  svn_boolean_t has_common = FALSE;
+  apr_off_t i, j;
+
+  *best_length = 0;
+
+  j = start1;
+  while (j < end1)
+    {
+      svn_diff__token_index_t token_index = TOKEN(b, 1, j);
+      apr_off_t next_j = j + 1;
+      int tries = 0;
+
+      if (counts[token_index] == 0)
+        {
+          j = next_j;
+          continue;
+        }
+
+      has_common = TRUE;
+      if (counts[token_index] > best_count)
+        {
+          j = next_j;
+          continue;
+        }
+
+      for (i = b->indexes[token_index];
+           i >= 0 && tries < HISTOGRAM_MAX_CHAIN_LENGTH;
+           i = b->chain[i], tries++)
+        {
+          apr_off_t s0 = i, s1 = j, e0 = i + 1, e1 = j + 1;
+          svn_diff__token_index_t region_count = counts[token_index];
+
+          while (s0 > start0 && s1 > start1
+                 && TOKEN(b, 0, s0 - 1) == TOKEN(b, 1, s1 - 1))
+            {
+              s0--;
+              s1--;
+              if (counts[TOKEN(b, 0, s0)] < region_count)
+                region_count = counts[TOKEN(b, 0, s0)];
+            }
+          while (e0 < end0 && e1 < end1
+                 && TOKEN(b, 0, e0) == TOKEN(b, 1, e1))
+            {
+              if (counts[TOKEN(b, 0, e0)] < region_count)
+                region_count = counts[TOKEN(b, 0, e0)];
+              e0++;
+              e1++;
+            }
+
+          if (e1 > next_j)
+            next_j = e1;
+
+          if (e0 - s0 > *best_length || region_count < best_count)
+            {
+              best_start[0] = s0;
+              best_start[1] = s1;
+              *best_length = e0 - s0;
+              best_count = region_count;
+            }
+        }
+
+      j = next_j;
+    }
+
+  return has_common;
+}
+
+/* Find the histogram diff anchor of the given range and push it and the
+ * ranges around it onto B's stack.  Return FALSE if the range should be
+ * compared with the Myers algorithm instead. */
+static svn_boolean_t
+histogram_split(anchored_baton_t *b,
+                apr_off_t start0, apr_off_t start1,
+                apr_off_t end0, apr_off_t end1)
+{
+  apr_off_t best_start[2] = { 0, 0 };
+  apr_off_t best_length;
+  svn_boolean_t has_common;
+  apr_off_t i;
+
+  /* Chain the occurrences of each token in the first source, in order. */
+  for (i = end0 - 1; i >= start0; i--)
+    {
+      svn_diff__token_index_t token_index = TOKEN(b, 0, i);
+
+      b->chain[i] = b->indexes[token_index];
+      b->indexes[token_index] = i;
+      b->counts[0][token_index]++;
+    }
+
+  has_common = histogram_scan(best_start, &best_length, b,
+                              start0, start1, end0, end1,
+                              HISTOGRAM_MAX_CHAIN_LENGTH);
+
+  /* Only frequent lines in common.  Small ranges get a minimal diff,
+   * but for large ones that could take quadratic time, so settle for
+   * the best run of frequent lines instead. */
+  if (best_length == 0 && has_common
+      && (end0 - start0) + (end1 - start1) > HISTOGRAM_MAX_MYERS_LINES)
+    histogram_scan(best_start, &best_length, b,
+                   start0, start1, end0, end1,
+                   end0 - start0);
+
+  for (i = start0; i < end0; i++)
+    {
+      b->counts[0][TOKEN(b, 0, i)] = 0;
+      b->indexes[TOKEN(b, 0, i)] = -1;
+    }
+
+  if (best_length == 0)
+    /* Without any common lines, the whole range is one change. */
+    return !has_common;
+
+  push_range(b, best_start[0] + best_length, best_start[1] + best_length,
+             end0, end1, FALSE);
+  push_range(b, best_start[0], best_start[1],
+             best_start[0] + best_length, best_start[1] + best_length, TRUE);
+  push_range(b, start0, start1, best_start[0], best_start[1], FALSE);
+
+  return TRUE;
+}
+
+/* Compare RANGE, emitting its common lines or pushing its subranges onto
+ * B's stack.  Use SCRATCH_POOL for temporary allocations. */
+static void
+process_range(anchored_baton_t *b,
+              const anchored_range_t *range,
+              apr_pool_t *scratch_pool)
+{
+  apr_off_t start0 = range->start[0];
+  apr_off_t start1 = range->start[1];
+  apr_off_t end0 = range->end[0];
+  apr_off_t end1 = range->end[1];
+  svn_boolean_t split;
+
+  if (range->is_match)
+    {
+      emit_match(b, start0, start1, end0 - start0);
+      return;
+    }
+
+  while (start0 < end0 && start1 < end1
+         && TOKEN(b, 0, start0) == TOKEN(b, 1, start1))
+    {
+      start0++;
+      start1++;
+    }
+  emit_match(b, range->start[0], range->start[1], start0 - range->start[0]);
+
+  while (end0 > start0 && end1 > start1
+         && TOKEN(b, 0, end0 - 1) == TOKEN(b, 1, end1 - 1))
+    {
+      end0--;
+      end1--;
+    }
+  push_range(b, end0, end1, range->end[0], range->end[1], TRUE);
+
+  /* Pure insertions and deletions need no further work. */
+  if (start0 == end0 || start1 == end1)
+    return;
+
+  /* Without unique lines, patience diff is no better than histogram diff
+   * for the same range. */
+  if (b->algorithm == svn_diff_file_algorithm_patience)
+    split = (patience_split(b, start0, start1, end0, end1, scratch_pool)
+             || histogram_split(b, start0, start1, end0, end1));
+  else
+    split = histogram_split(b, start0, start1, end0, end1);
+
+  if (!split)
+    fallback_myers(b, start0, start1, end0, end1, scratch_pool);
+}
+
+/* Return the positions of the ring POSITION_LIST (pointing to its tail)
+ * as an array of *LENGTH elements allocated in POOL. */
+static svn_diff__position_t **
+ring_to_array(apr_off_t *length,
+              svn_diff__position_t *position_list,
+              apr_pool_t *pool)
+{
+  svn_diff__position_t **positions;
+  svn_diff__position_t *position = position_list->next;
+  apr_off_t i;
+
+  *length = position_list->offset - position->offset + 1;
+  positions = apr_palloc(pool, sizeof(*positions) * (apr_size_t)*length);
+  for (i = 0; i < *length; i++)
+    {
+      positions[i] = position;
+      position = position->next;
+    }
+
+  return positions;
+}
+
+/* Calculate the LCS of the rings POSITION_LIST1 and POSITION_LIST2 (both
+ * pointing to their tail) with the patience or histogram diff ALGORITHM.
+ * Return the common chunks in order, followed by NEXT.  Allocate the
+ * result in POOL.
+ */
+static svn_diff__lcs_t *
+lcs_anchored(svn_diff__position_t *position_list1,
+             svn_diff__position_t *position_list2,
+             svn_diff__token_index_t num_tokens,
+             svn_diff_file_algorithm_t algorithm,
+             svn_diff__lcs_t *next,
+             apr_pool_t *pool)
+{
+  anchored_baton_t b = { 0 };
+  svn_diff__lcs_t *lcs = NULL;
+  anchored_range_t range;
+  apr_pool_t *scratch_pool = svn_pool_create(pool);
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  apr_off_t length[2];
+  svn_diff__token_index_t token_index;
+
+  b.algorithm = algorithm;
+  b.positions[0] = ring_to_array(&length[0], position_list1, scratch_pool);
+  b.positions[1] = ring_to_array(&length[1], position_list2, scratch_pool);
+  b.counts[0] = apr_pcalloc(scratch_pool, sizeof(*b.counts[0]) * num_tokens);
+  b.counts[1] = apr_pcalloc(scratch_pool, sizeof(*b.counts[1]) * num_tokens);
+  b.indexes = apr_palloc(scratch_pool, sizeof(*b.indexes) * num_tokens);
+  for (token_index = 0; token_index < num_tokens; token_index++)
+    b.indexes[token_index] = -1;
+  b.chain = apr_palloc(scratch_pool,
+                         sizeof(*b.chain) * (apr_size_t)length[0]);
+  b.stack = apr_array_make(scratch_pool, 16, sizeof(anchored_range_t));
+  b.lcs_ref = &lcs;
+  b.pool = pool;
+
+  push_range(&b, 0, 0, length[0], length[1], FALSE);
+  while (b.stack->nelts)
+    {
+      svn_pool_clear(iterpool);
+
+      /* Copy the range; processing it may push new ones. */
+      range = *(anchored_range_t *)apr_array_pop(b.stack);
+      process_range(&b, &range, iterpool);
+    }
+
+  svn_pool_destroy(scratch_pool);
+
+  *b.lcs_ref = next;
+  return lcs;
+}
+
+
+svn_diff__lcs_t *
+svn_diff__lcs(svn_diff__position_t *position_list1, /* pointer to tail (ring) */
+              svn_diff__position_t *position_list2, /* pointer to tail (ring) */
+              svn_diff__token_index_t *token_counts_list1, /* array of counts */
+              svn_diff__token_index_t *token_counts_list2, /* array of counts */
+              svn_diff__token_index_t num_tokens,
+              apr_off_t prefix_lines,
+              apr_off_t suffix_lines,
+              svn_diff_file_algorithm_t algorithm,
+              apr_pool_t *pool)
+{
+  svn_diff__token_index_t *token_counts[2];
+  svn_diff__token_index_t unique_count[2];
+  svn_diff__token_index_t token_index;
+  svn_diff__lcs_t *lcs;
+
+  /* Since EOF is always a sync point we tack on an EOF link
+   * with sentinel positions
+   */
+  lcs = apr_palloc(pool, sizeof(*lcs));
+  lcs->position[0] = apr_pcalloc(pool, sizeof(*lcs->position[0]));
+  lcs->position[0]->offset = position_list1
+                             ? position_list1->offset + suffix_lines + 1
+                             : prefix_lines + suffix_lines + 1;
+  lcs->position[1] = apr_pcalloc(pool, sizeof(*lcs->position[1]));
+  lcs->position[1]->offset = position_list2
+                             ? position_list2->offset + suffix_lines + 1
+                             : prefix_lines + suffix_lines + 1;
+  lcs->length = 0;
+  lcs->refcount = 1;
+  lcs->next = NULL;
+
+  if (position_list1 == NULL || position_list2 == NULL)
+    {
+      if (suffix_lines)
+        lcs = prepend_lcs(lcs, suffix_lines,
+                          lcs->position[0]->offset - suffix_lines,
+                          lcs->position[1]->offset - suffix_lines,
+                          pool);
+      if (prefix_lines)
+        lcs = prepend_lcs(lcs, prefix_lines, 1, 1, pool);
+
+      return lcs;
+    }
+
+  if (algorithm != svn_diff_file_algorithm_myers)
+    {
+      if (suffix_lines)
+        lcs = prepend_lcs(lcs, suffix_lines,
+                          lcs->position[0]->offset - suffix_lines,
+                          lcs->position[1]->offset - suffix_lines,
+                          pool);
+
+      lcs = lcs_anchored(position_list1, position_list2, num_tokens,
+                         algorithm, lcs, pool);
+
+      if (prefix_lines)
+        return prepend_lcs(lcs, prefix_lines, 1, 1, pool);
+      else
+        return lcs;
+    }
+
+  unique_count[1] = unique_count[0] = 0;
+  for (token_index = 0; token_index < num_tokens; token_index++)
+    {
+      if (token_counts_list1[token_index] == 0)
+        unique_count[1] += token_counts_list2[token_index];
+      if (token_counts_list2[token_index] == 0)
+        unique_count[0] += token_counts_list1[token_index];
+    }
+
+  token_counts[0] = token_counts_list1;
+  token_counts[1] = token_counts_list2;
+
   if (suffix_lines)
-    lcs->next = prepend_lcs(fp[0].lcs, suffix_lines,
+    lcs->next = prepend_lcs(lcs_myers(position_list1, position_list2,
+                                      token_counts, unique_count, pool),
+                            suffix_lines,
                             lcs->position[0]->offset - suffix_lines,
                             lcs->position[1]->offset - suffix_lines,
                             pool);
   else
-    lcs->next = fp[0].lcs;
+    lcs->next = lcs_myers(position_list1, position_list2,
+                          token_counts, unique_count, pool);
 
   lcs = svn_diff__lcs_reverse(lcs);
 
-  position_list1->next = sentinel_position[0].next;
-  position_list2->next = sentinel_position[1].next;
-
   if (prefix_lines)
     return prepend_lcs(lcs, prefix_lines, 1, 1, pool);
   else
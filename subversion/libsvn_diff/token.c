@@ -25,6 +25,7 @@
 #include <apr.h>
 #include <apr_pools.h>
 #include <apr_general.h>
+#include <string.h>
 
 #include "svn_error.h"
 #include "svn_diff.h"
@@ -34,32 +35,41 @@
 
 
 /*
- * Prime number to use as the size of the hash table.  This number was
- * not selected by testing of any kind and may need tweaking.
+ * The token table starts with 1 << TOKEN_TABLE_INITIAL_BITS slots.  This
+ * number was chosen to cover small diffs without reallocation.
  */
-#define SVN_DIFF__HASH_SIZE 127
+#define TOKEN_TABLE_INITIAL_BITS 8
 
-struct svn_diff__node_t
+/*
+ * One slot of the open-addressed token table.  Probing only needs to look
+ * at the hash values stored inline, so a cache line covers several slots.
+ * The token itself is only fetched for comparison when the hashes match.
+ */
+typedef struct token_slot_t
 {
-  svn_diff__node_t       *parent;
-  svn_diff__node_t       *left;
-  svn_diff__node_t       *right;
-
   apr_uint32_t            hash;
-  svn_diff__token_index_t index;
-  void                   *token;
-};
+  svn_diff__token_index_t index;  /* -1 for unused slots */
+} token_slot_t;
 
 struct svn_diff__tree_t
 {
-  svn_diff__node_t       *root[SVN_DIFF__HASH_SIZE];
+  /* Linearly probed hash table with 1 << (32 - SHIFT) slots, of which at
+     most half are in use. */
+  token_slot_t           *slots;
+  apr_uint32_t            mask;
+  unsigned int            shift;
+
+  /* The most recently seen token for each token index.  Has room for
+     half as many tokens as there are SLOTS. */
+  void                  **tokens;
+
   apr_pool_t             *pool;
   svn_diff__token_index_t node_count;
 };
 
 
 /*
- * Returns number of tokens in a tree
+ * Returns number of distinct tokens in TREE
  */
 svn_diff__token_index_t
 svn_diff__get_node_count(svn_diff__tree_t *tree)
@@ -67,9 +77,60 @@ svn_diff__get_node_count(svn_diff__tree_t *tree)
   return tree->node_count;
 }
 
-/*
- * Support functions to build a tree of token positions
+/* Allocate empty SLOTS and TOKENS arrays for a table of SIZE slots in TREE.
+ * SIZE must be a power of two.
+ */
+static void
+token_table_alloc(svn_diff__tree_t *tree, apr_uint32_t size)
+{
+  apr_uint32_t i;
+
+  tree->slots = apr_palloc(tree->pool, size * sizeof(*tree->slots));
+  for (i = 0; i < size; ++i)
+    tree->slots[i].index = -1;
+
+  tree->tokens = apr_palloc(tree->pool, size / 2 * sizeof(*tree->tokens));
+  tree->mask = size - 1;
+}
+
+/* Return the slot at which to start probing for HASH in TREE.
+ *
+ * Datasources outside this library may provide poorly distributed hashes,
+ * so use the upper bits of a multiplicative scramble.
  */
+static APR_INLINE apr_uint32_t
+token_table_start(const svn_diff__tree_t *tree, apr_uint32_t hash)
+{
+  return (apr_uint32_t)(hash * 0x9e3779b1) >> tree->shift;
+}
+
+/* Double the number of slots in TREE.  The old arrays remain allocated in
+ * TREE->POOL, which wastes less memory than the final table needs.
+ */
+static void
+token_table_grow(svn_diff__tree_t *tree)
+{
+  token_slot_t *old_slots = tree->slots;
+  void **old_tokens = tree->tokens;
+  apr_uint32_t old_size = tree->mask + 1;
+  apr_uint32_t i;
+
+  token_table_alloc(tree, old_size * 2);
+  tree->shift--;
+
+  /* All tokens are known to be distinct, so just find a free slot. */
+  for (i = 0; i < old_size; ++i)
+    if (old_slots[i].index >= 0)
+      {
+        apr_uint32_t k = token_table_start(tree, old_slots[i].hash);
+        while (tree->slots[k].index >= 0)
+          k = (k + 1) & tree->mask;
+
+        tree->slots[k] = old_slots[i];
+      }
+
+  memcpy(tree->tokens, old_tokens, tree->node_count * sizeof(*old_tokens));
+}
 
 void
 svn_diff__tree_create(svn_diff__tree_t **tree, apr_pool_t *pool)
@@ -77,66 +138,63 @@ svn_diff__tree_create(svn_diff__tree_t **tree, apr_pool_t *pool)
   *tree = apr_pcalloc(pool, sizeof(**tree));
   (*tree)->pool = pool;
   (*tree)->node_count = 0;
+  (*tree)->shift = 32 - TOKEN_TABLE_INITIAL_BITS;
+
+  token_table_alloc(*tree, 1 << TOKEN_TABLE_INITIAL_BITS);
 }
 
 
+/* Find TOKEN with the given HASH in TREE, adding it if it is new, and
+ * return its token index in *INDEX.
+ */
 static svn_error_t *
-tree_insert_token(svn_diff__node_t **node, svn_diff__tree_t *tree,
+tree_insert_token(svn_diff__token_index_t *index, svn_diff__tree_t *tree,
                   void *diff_baton,
                   const svn_diff_fns2_t *vtable,
                   apr_uint32_t hash, void *token)
 {
-  svn_diff__node_t *new_node;
-  svn_diff__node_t **node_ref;
-  svn_diff__node_t *parent;
-  int rv;
+  token_slot_t *slot;
+  apr_uint32_t i;
 
   SVN_ERR_ASSERT(token);
 
-  parent = NULL;
-  node_ref = &tree->root[hash % SVN_DIFF__HASH_SIZE];
-
-  while (*node_ref != NULL)
+  for (i = token_table_start(tree, hash); ; i = (i + 1) & tree->mask)
     {
-      parent = *node_ref;
-
-      rv = hash - parent->hash;
-      if (!rv)
-        SVN_ERR(vtable->token_compare(diff_baton, parent->token, token, &rv));
-
-      if (rv == 0)
-        {
-          /* Discard the previous token.  This helps in cases where
-           * only recently read tokens are still in memory.
-           */
-          if (vtable->token_discard != NULL)
-            vtable->token_discard(diff_baton, parent->token);
-
-          parent->token = token;
-          *node = parent;
+      slot = &tree->slots[i];
+      if (slot->index < 0)
+        break;
 
-          return SVN_NO_ERROR;
-        }
-      else if (rv > 0)
-        {
-          node_ref = &parent->left;
-        }
-      else
+      if (slot->hash == hash)
         {
-          node_ref = &parent->right;
+          void *known = tree->tokens[slot->index];
+          int rv;
+
+          SVN_ERR(vtable->token_compare(diff_baton, known, token, &rv));
+          if (rv == 0)
+            {
+              /* Discard the previous token.  This helps in cases where
+               * only recently read tokens are still in memory.
+               */
+              if (vtable->token_discard != NULL)
+                vtable->token_discard(diff_baton, known);
+
+              tree->tokens[slot->index] = token;
+              *index = slot->index;
+
+              return SVN_NO_ERROR;
+            }
         }
     }
 
-  /* Create a new node */
-  new_node = apr_palloc(tree->pool, sizeof(*new_node));
-  new_node->parent = parent;
-  new_node->left = NULL;
-  new_node->right = NULL;
-  new_node->hash = hash;
-  new_node->token = token;
-  new_node->index = tree->node_count++;
+  /* Use the free slot at the end of the probe sequence. */
+  slot->hash = hash;
+  slot->index = tree->node_count;
+  tree->tokens[tree->node_count] = token;
+  *index = tree->node_count++;
 
-  *node = *node_ref = new_node;
+  /* Keep probe sequences short. */
+  if ((apr_uint32_t)tree->node_count * 2 >= tree->mask + 1)
+    token_table_grow(tree);
 
   return SVN_NO_ERROR;
 }
@@ -158,7 +216,7 @@ svn_diff__get_tokens(svn_diff__position_t **position_list,
   svn_diff__position_t *start_position;
   svn_diff__position_t *position = NULL;
   svn_diff__position_t **position_ref;
-  svn_diff__node_t *node;
+  svn_diff__token_index_t token_index;
   void *token;
   apr_off_t offset;
   apr_uint32_t hash;
@@ -176,12 +234,13 @@ svn_diff__get_tokens(svn_diff__position_t **position_list,
         break;
 
       offset++;
-      SVN_ERR(tree_insert_token(&node, tree, diff_baton, vtable, hash, token));
+      SVN_ERR(tree_insert_token(&token_index, tree, diff_baton, vtable,
+                                hash, token));
 
       /* Create a new position */
       position = apr_palloc(pool, sizeof(*position));
       position->next = NULL;
-      position->token_index = node->index;
+      position->token_index = token_index;
       position->offset = offset;
 
       *position_ref = position;
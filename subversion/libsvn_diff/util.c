@@ -348,6 +348,96 @@ svn_diff__normalize_buffer(char **tgt,
 #undef COPY_INCLUDED_SECTION
 }
 
+/* Constants of the MurmurHash3 32 bit mixing function. */
+#define HASH_C1 0xcc9e2d51
+#define HASH_C2 0x1b873593
+
+/* Return the hash state H updated with the 4-byte word K. */
+static APR_INLINE apr_uint32_t
+hash_mix(apr_uint32_t h, apr_uint32_t k)
+{
+  k *= HASH_C1;
+  k = (k << 15) | (k >> 17);
+  k *= HASH_C2;
+
+  h ^= k;
+  h = (h << 13) | (h >> 19);
+  return h * 5 + 0xe6546b64;
+}
+
+void
+svn_diff__hash_update(svn_diff__hash_t *state,
+                      const char *data,
+                      apr_off_t len)
+{
+  const unsigned char *p = (const unsigned char *)data;
+  const unsigned char *end = p + len;
+  apr_uint32_t h = state->value;
+  apr_uint32_t tail = state->tail;
+  unsigned int tail_len = state->length & 3;
+
+  state->length += (apr_uint32_t)len;
+
+  /* Complete the word left over from the previous piece, if any. */
+  if (tail_len)
+    {
+      while (tail_len < 4 && p < end)
+        tail |= (apr_uint32_t)*p++ << (8 * tail_len++);
+
+      if (tail_len < 4)
+        {
+          state->tail = tail;
+          return;
+        }
+
+      h = hash_mix(h, tail);
+      tail = 0;
+    }
+
+  /* Process whole words.  Assembling them byte-wise keeps the result
+     independent of alignment and byte order; compilers turn this into
+     plain loads where possible. */
+  for (; end - p >= 4; p += 4)
+    h = hash_mix(h, (apr_uint32_t)p[0]
+                    | ((apr_uint32_t)p[1] << 8)
+                    | ((apr_uint32_t)p[2] << 16)
+                    | ((apr_uint32_t)p[3] << 24));
+
+  /* Keep the remainder for the next piece or svn_diff__hash_final(). */
+  for (tail_len = 0; p < end; ++tail_len)
+    tail |= (apr_uint32_t)*p++ << (8 * tail_len);
+
+  state->value = h;
+  state->tail = tail;
+}
+
+apr_uint32_t
+svn_diff__hash_final(const svn_diff__hash_t *state)
+{
+  apr_uint32_t h = state->value;
+
+  if (state->length & 3)
+    {
+      apr_uint32_t k = state->tail * HASH_C1;
+      k = (k << 15) | (k >> 17);
+      h ^= k * HASH_C2;
+    }
+
+  /* Mix in the length and scramble all bits, so that any subset of them
+     can be used to index a hash table. */
+  h ^= state->length;
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+
+  return h;
+}
+
+#undef HASH_C1
+#undef HASH_C2
+
 svn_error_t *
 svn_diff__unified_append_no_newline_msg(svn_stringbuf_t *stringbuf,
                                         const char *header_encoding,
@@ -1564,6 +1564,32 @@ svn_fs_try_process_file_contents(svn_boolean_t *success,
                          processor, baton, pool));
 }
 
+svn_error_t *
+svn_fs__try_get_file_range(svn_boolean_t *success,
+                           apr_file_t **file,
+                           apr_off_t *offset,
+                           svn_filesize_t *length,
+                           int *svndiff_version,
+                           svn_fs_root_t *root,
+                           const char *path,
+                           apr_pool_t *result_pool,
+                           apr_pool_t *scratch_pool)
+{
+  /* if the FS doesn't implement this function, report a "failed" attempt */
+  if (root->vtable->try_get_file_range == NULL)
+    {
+      *success = FALSE;
+      return SVN_NO_ERROR;
+    }
+
+  return svn_error_trace(root->vtable->try_get_file_range(success, file,
+                                                          offset, length,
+                                                          svndiff_version,
+                                                          root, path,
+                                                          result_pool,
+                                                          scratch_pool));
+}
+
 svn_error_t *
 svn_fs_make_file(svn_fs_root_t *root, const char *path, apr_pool_t *pool)
 {
@@ -440,6 +440,17 @@ typedef struct root_vtable_t
                                 svn_fs_mergeinfo_receiver_t receiver,
                                 void *baton,
                                 apr_pool_t *scratch_pool);
+
+  /* Zero-copy access.  Optional, i.e. may be NULL. */
+  svn_error_t *(*try_get_file_range)(svn_boolean_t *success,
+                                     apr_file_t **file,
+                                     apr_off_t *offset,
+                                     svn_filesize_t *length,
+                                     int *svndiff_version,
+                                     svn_fs_root_t *root,
+                                     const char *path,
+                                     apr_pool_t *result_pool,
+                                     apr_pool_t *scratch_pool);
 } root_vtable_t;
 
 
@@ -1672,6 +1672,42 @@ skip_plain_window(rep_state_t *rs,
   return SVN_NO_ERROR;
 }
 
+/* Read the delta windows for chunk RB->CHUNK_INDEX of the reps in
+   RB->RS_LIST and append them to the empty array WINDOWS, stopping after
+   the first window that does not depend on its predecessors.  Allocate
+   the windows in RESULT_POOL and use SCRATCH_POOL for temporaries.
+
+   Windows are read in chain order.  Whether a window is self-contained
+   is only known after reading it, so any reordering of the I/O would
+   read windows behind that point that will never be used. */
+static svn_error_t *
+read_delta_windows(apr_array_header_t *windows,
+                   struct rep_read_baton *rb,
+                   apr_pool_t *result_pool,
+                   apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  for (i = 0; i < rb->rs_list->nelts; ++i)
+    {
+      rep_state_t *rs = APR_ARRAY_IDX(rb->rs_list, i, rep_state_t *);
+      svn_txdelta_window_t *window;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(read_delta_window(&window, rb->chunk_index, rs, result_pool,
+                                iterpool));
+
+      APR_ARRAY_PUSH(windows, svn_txdelta_window_t *) = window;
+      if (window->src_ops == 0)
+        break;
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
 /* Get the undeltified window that is a result of combining all deltas
    from the current desired representation identified in *RB with its
    base representation.  Store the window in *RESULT. */
@@ -1691,25 +1727,11 @@ get_combined_window(svn_stringbuf_t **result,
      delta limits the number of deltas in a chain to well under 100.
      Stop early if one of them does not depend on its predecessors. */
   window_pool = svn_pool_create(rb->pool);
-  windows = apr_array_make(window_pool, 0, sizeof(svn_txdelta_window_t *));
+  windows = apr_array_make(window_pool, rb->rs_list->nelts,
+                           sizeof(svn_txdelta_window_t *));
   iterpool = svn_pool_create(rb->pool);
-  for (i = 0; i < rb->rs_list->nelts; ++i)
-    {
-      svn_txdelta_window_t *window;
-
-      svn_pool_clear(iterpool);
-
-      rs = APR_ARRAY_IDX(rb->rs_list, i, rep_state_t *);
-      SVN_ERR(read_delta_window(&window, rb->chunk_index, rs, window_pool,
-                                iterpool));
-
-      APR_ARRAY_PUSH(windows, svn_txdelta_window_t *) = window;
-      if (window->src_ops == 0)
-        {
-          ++i;
-          break;
-        }
-    }
+  SVN_ERR(read_delta_windows(windows, rb, window_pool, iterpool));
+  i = windows->nelts;
 
   /* Combine in the windows from the other delta reps. */
   pool = svn_pool_create(rb->pool);
@@ -2419,6 +2441,68 @@ svn_fs_fs__try_process_file_contents(svn_boolean_t *success,
 }
 
 
+svn_error_t *
+svn_fs_fs__try_get_file_range(svn_boolean_t *success,
+                              apr_file_t **file,
+                              apr_off_t *offset,
+                              svn_filesize_t *length,
+                              int *svndiff_version,
+                              svn_fs_t *fs,
+                              node_revision_t *noderev,
+                              apr_pool_t *result_pool,
+                              apr_pool_t *scratch_pool)
+{
+  representation_t *rep = noderev->data_rep;
+  svn_fs_fs__revision_file_t *rev_file;
+  svn_fs_fs__rep_header_t *rep_header;
+  apr_off_t item_offset;
+
+  *success = FALSE;
+
+  /* Data in txns may still change and is not worth the effort. */
+  if (rep == NULL || svn_fs_fs__id_txn_used(&rep->txn_id))
+    return SVN_NO_ERROR;
+
+  SVN_ERR(svn_fs_fs__ensure_revision_exists(rep->revision, fs,
+                                            scratch_pool));
+  SVN_ERR(svn_fs_fs__open_pack_or_rev_file(&rev_file, fs, rep->revision,
+                                           result_pool, scratch_pool));
+  SVN_ERR(svn_fs_fs__item_offset(&item_offset, fs, rev_file, rep->revision,
+                                 NULL, rep->item_index, scratch_pool));
+  SVN_ERR(aligned_seek(fs, rev_file->file, NULL, item_offset, scratch_pool));
+  SVN_ERR(svn_fs_fs__read_rep_header(&rep_header, rev_file->stream,
+                                     scratch_pool, scratch_pool));
+
+  /* Deltas against other reps need to be combined first. */
+  if (rep_header->type == svn_fs_fs__rep_delta)
+    return svn_error_trace(svn_fs_fs__close_revision_file(rev_file));
+
+  /* The svndiff format version is part of the data itself. */
+  *svndiff_version = -1;
+  if (rep_header->type == svn_fs_fs__rep_self_delta)
+    {
+      char svndiff_header[4];
+      apr_size_t len = sizeof(svndiff_header);
+
+      SVN_ERR(svn_stream_read_full(rev_file->stream, svndiff_header, &len));
+      if (   len != sizeof(svndiff_header)
+          || memcmp(svndiff_header, "SVN", 3) != 0)
+        return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
+                                 _("Malformed svndiff data in "
+                                   "representation at offset %s"),
+                                 apr_off_t_toa(scratch_pool, item_offset));
+
+      *svndiff_version = svndiff_header[3];
+    }
+
+  *file = rev_file->file;
+  *offset = item_offset + rep_header->header_size;
+  *length = rep->size;
+  *success = TRUE;
+
+  return SVN_NO_ERROR;
+}
+
 /* Baton used when reading delta windows. */
 struct delta_read_baton
 {
@@ -3498,7 +3582,8 @@ block_read_contents(svn_fs_t *fs,
 
 /* For the given REV_FILE in FS, in *STREAM return a stream covering the
  * item specified by ENTRY.  Also, verify the item's content by low-level
- * checksum.  Allocate the result in POOL.
+ * checksum.  If REV_FILE has been mapped into memory, the stream will
+ * read directly from the mapped pages.  Allocate the result in POOL.
  */
 static svn_error_t *
 read_item(svn_stream_t **stream,
@@ -3511,16 +3596,35 @@ read_item(svn_stream_t **stream,
   svn_checksum_t *expected, *actual;
   apr_uint32_t plain_digest;
 
-  /* Read item into string buffer. */
-  svn_stringbuf_t *text = svn_stringbuf_create_ensure(entry->size, pool);
-  text->len = entry->size;
-  text->data[text->len] = 0;
-  SVN_ERR(svn_io_file_read_full2(rev_file->file, text->data, text->len,
-                                 NULL, NULL, pool));
+  if (   rev_file->mapped_data
+      && entry->offset + entry->size <= rev_file->mapped_size)
+    {
+      /* No need to copy the data.  The mapping lives as long as
+       * REV_FILE, i.e. longer than any stream that we return here. */
+      svn_string_t *text = apr_palloc(pool, sizeof(*text));
+      text->data = (const char *)rev_file->mapped_data + entry->offset;
+      text->len = (apr_size_t)entry->size;
+
+      *stream = svn_stream_from_string(text, pool);
+      digest = svn__fnv1a_32x4(text->data, text->len);
+    }
+  else
+    {
+      /* Read item into string buffer.  Mapped files will only get here
+       * for corrupted index data.  Let the file I/O report the problem. */
+      svn_stringbuf_t *text = svn_stringbuf_create_ensure(entry->size, pool);
+      text->len = entry->size;
+      text->data[text->len] = 0;
+      if (rev_file->mapped_data)
+        SVN_ERR(svn_io_file_seek(rev_file->file, APR_SET, &entry->offset,
+                                 pool));
+      SVN_ERR(svn_io_file_read_full2(rev_file->file, text->data, text->len,
+                                     NULL, NULL, pool));
 
-  /* Return (construct, calculate) stream and checksum. */
-  *stream = svn_stream_from_stringbuf(text, pool);
-  digest = svn__fnv1a_32x4(text->data, text->len);
+      /* Return (construct, calculate) stream and checksum. */
+      *stream = svn_stream_from_stringbuf(text, pool);
+      digest = svn__fnv1a_32x4(text->data, text->len);
+    }
 
   /* Checksums will match most of the time. */
   if (entry->fnv1_checksum == digest)
@@ -3658,11 +3762,483 @@ block_read_noderev(node_revision_t **noderev_p,
   return SVN_NO_ERROR;
 }
 
+/* Read the block containing *OFFSET in REVISION_FILE of FS and put all
+ * items that start within that block and are smaller than the block
+ * size into the cache.  REVISION may be any revision in REVISION_FILE.
+ *
+ * If RESULT is not NULL, the item identified by REVISION, ITEM_INDEX and
+ * WANTED_OFFSET will always be read, even if it does not fit into the
+ * block.  For noderevs, it is allocated in RESULT_POOL and returned in
+ * *RESULT.  Otherwise, that item only gets read if it is within the block
+ * like any other.  Pass -1 for WANTED_OFFSET to only read the block
+ * contents.
+ *
+ * Set *OFFSET to the end of the last item read and increment *RUN_COUNT
+ * if that item extends beyond the end of the block.  Use SCRATCH_POOL
+ * for temporary allocations.
+ */
+static svn_error_t *
+read_block(void **result,
+           apr_off_t *offset,
+           int *run_count,
+           svn_fs_t *fs,
+           svn_revnum_t revision,
+           apr_uint64_t item_index,
+           apr_off_t wanted_offset,
+           svn_fs_fs__revision_file_t *revision_file,
+           apr_pool_t *result_pool,
+           apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_off_t block_start;
+  apr_array_header_t *entries;
+  int i;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+
+  /* fetch list of items in the block surrounding OFFSET */
+  block_start = *offset - (*offset % ffd->block_size);
+  SVN_ERR(svn_fs_fs__p2l_index_lookup(&entries, fs, revision_file,
+                                      revision, block_start,
+                                      ffd->block_size, scratch_pool,
+                                      scratch_pool));
+
+  SVN_ERR(aligned_seek(fs, revision_file->file, &block_start, *offset,
+                       iterpool));
+
+  /* read all items from the block */
+  for (i = 0; i < entries->nelts; ++i)
+    {
+      svn_boolean_t is_result, is_wanted;
+      apr_pool_t *pool;
+      svn_fs_fs__p2l_entry_t* entry;
+
+      svn_pool_clear(iterpool);
+
+      /* skip empty sections */
+      entry = &APR_ARRAY_IDX(entries, i, svn_fs_fs__p2l_entry_t);
+      if (entry->type == SVN_FS_FS__ITEM_TYPE_UNUSED)
+        continue;
+
+      /* the item / container we were looking for? */
+      is_wanted =    entry->offset == wanted_offset
+                  && entry->item.revision == revision
+                  && entry->item.number == item_index;
+      is_result = result && is_wanted;
+
+      /* select the pool that we want the item to be allocated in */
+      pool = is_result ? result_pool : iterpool;
+
+      /* handle all items that start within this block and are relatively
+       * small (i.e. < block size).  Always read the item we need to return.
+       */
+      if (is_result || (   entry->offset >= block_start
+                        && entry->size < ffd->block_size))
+        {
+          void *item = NULL;
+
+          /* Items read through read_item() don't need the file
+           * pointer if we can take them from the mapped file. */
+          if (   !revision_file->mapped_data
+              || entry->type == SVN_FS_FS__ITEM_TYPE_FILE_REP
+              || entry->type == SVN_FS_FS__ITEM_TYPE_DIR_REP
+              || entry->type == SVN_FS_FS__ITEM_TYPE_FILE_PROPS
+              || entry->type == SVN_FS_FS__ITEM_TYPE_DIR_PROPS)
+            SVN_ERR(svn_io_file_seek(revision_file->file, APR_SET,
+                                     &entry->offset, iterpool));
+          switch (entry->type)
+            {
+              case SVN_FS_FS__ITEM_TYPE_FILE_REP:
+              case SVN_FS_FS__ITEM_TYPE_DIR_REP:
+              case SVN_FS_FS__ITEM_TYPE_FILE_PROPS:
+              case SVN_FS_FS__ITEM_TYPE_DIR_PROPS:
+                SVN_ERR(block_read_contents(fs, revision_file, entry,
+                                            is_wanted
+                                              ? -1
+                                              : block_start + ffd->block_size,
+                                            iterpool));
+                break;
+
+              case SVN_FS_FS__ITEM_TYPE_NODEREV:
+                if (ffd->node_revision_cache || is_result)
+                  SVN_ERR(block_read_noderev((node_revision_t **)&item,
+                                             fs, revision_file,
+                                             entry, is_result, pool,
+                                             iterpool));
+                break;
+
+              case SVN_FS_FS__ITEM_TYPE_CHANGES:
+                SVN_ERR(block_read_changes(fs, revision_file,
+                                           entry, iterpool));
+                break;
+
+              default:
+                break;
+            }
+
+          if (is_result)
+            *result = item;
+
+          /* if we crossed a block boundary, read the remainder of
+           * the last block as well */
+          *offset = entry->offset + entry->size;
+          if (*offset - block_start > ffd->block_size)
+            ++*run_count;
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Block-read read-ahead.
+ *
+ * Whenever block_read() gets called, the cache did not contain the data
+ * that we wanted.  The next miss is often predictable:  History walks as
+ * in 'svn log' and 'svn blame' want the same item in the next older
+ * revision and data access in pack files tends to walk consecutive blocks.
+ * We track both patterns per svn_fs_t and, once a pattern has been
+ * confirmed, read the blocks that it is going to hit next into the cache.
+ * The read-ahead depth doubles whenever the pattern reaches the blocks
+ * read ahead and gets halved when it breaks before.
+ *
+ * Read-ahead is synchronous, i.e. part of the block_read() call that
+ * triggered it, because neither svn_fs_t nor its caches and open files
+ * are thread-safe.
+ */
+
+/* Number of consecutive accesses following the same stride before we
+ * start reading ahead. */
+#define READ_AHEAD_MIN_CONFIDENCE 2
+
+/* Number of items for which we track revision walks independently. */
+#define READ_AHEAD_ITEM_TRACKERS 4
+
+/* Tracks accesses along a single dimension (block number or revision)
+ * and detects sequences with a stride of +1 or -1.
+ */
+typedef struct stride_tracker_t
+{
+  /* Identifies the sequence (file or item) being tracked. */
+  apr_uint64_t key;
+
+  /* Position of the last access. */
+  apr_int64_t last;
+
+  /* Direction of the current sequence.  0 if unknown. */
+  int stride;
+
+  /* Number of accesses that followed STRIDE so far. */
+  int confidence;
+
+  /* Number of positions to read ahead of LAST.  Adapts to the hit rate. */
+  int depth;
+
+  /* Number of positions following LAST that have already been read ahead
+   * but not been passed by the access pattern yet. */
+  int pending;
+} stride_tracker_t;
+
+/* Per-svn_fs_t read-ahead state. */
+struct svn_fs_fs__read_ahead_t
+{
+  /* Consecutive blocks within the same rev / pack file. */
+  stride_tracker_t blocks;
+
+  /* The same item number in consecutive revisions, e.g. changed paths
+   * lists or root noderevs.  Indexed by item number modulo array size. */
+  stride_tracker_t items[READ_AHEAD_ITEM_TRACKERS];
+
+  /* Counters reported by svn_fs_fs__get_read_ahead_stats(). */
+  svn_fs_fs__read_ahead_stats_t stats;
+};
+
+/* Record an access to POSITION of the sequence identified by KEY in
+ * TRACKER.  MAX_DEPTH is the maximum read-ahead depth.  Update the hit
+ * and miss counters in STATS accordingly.  Return the number of positions
+ * that should be read ahead, starting at TRACKER->LAST + (TRACKER->PENDING
+ * + 1) * TRACKER->STRIDE.
+ */
+static int
+track_access(stride_tracker_t *tracker,
+             apr_uint64_t key,
+             apr_int64_t position,
+             int max_depth,
+             svn_fs_fs__read_ahead_stats_t *stats)
+{
+  apr_int64_t distance = (position - tracker->last) * tracker->stride;
+
+  if (tracker->key == key && tracker->stride && distance > 0)
+    {
+      /* Still walking in the same direction.  Any positions read ahead
+       * that we skipped have been served from the cache, i.e. they have
+       * been read ahead in time. */
+      apr_int64_t skipped = MIN(distance - 1, tracker->pending);
+      if (skipped)
+        {
+          stats->hits += skipped;
+          tracker->depth = MIN(max_depth, 2 * tracker->depth);
+        }
+
+      /* If we read POSITION ahead as well, that didn't help. */
+      if (distance <= tracker->pending)
+        {
+          stats->misses++;
+          tracker->pending -= (int)distance;
+        }
+      else
+        {
+          tracker->pending = 0;
+        }
+
+      tracker->confidence++;
+    }
+  else
+    {
+      /* The pattern changed.  Anything read ahead was in vain. */
+      if (tracker->pending)
+        {
+          stats->misses += tracker->pending;
+          tracker->depth = MAX(1, tracker->depth / 2);
+          tracker->pending = 0;
+        }
+
+      /* Maybe, this is the start of a new sequence. */
+      if (   tracker->key == key
+          && (position == tracker->last + 1 || position == tracker->last - 1))
+        {
+          tracker->stride = (int)(position - tracker->last);
+          tracker->confidence = 1;
+        }
+      else
+        {
+          tracker->stride = 0;
+          tracker->confidence = 0;
+        }
+
+      tracker->key = key;
+    }
+
+  tracker->last = position;
+
+  if (tracker->confidence < READ_AHEAD_MIN_CONFIDENCE)
+    return 0;
+
+  return MAX(0, MIN(tracker->depth, max_depth) - tracker->pending);
+}
+
+/* Read up to COUNT blocks of REVISION_FILE in FS ahead, as indicated by
+ * TRACKER, and put their contents into the cache.  REVISION may be any
+ * revision in REVISION_FILE.  Update TRACKER and STATS.  Use SCRATCH_POOL
+ * for temporary allocations.
+ */
+static svn_error_t *
+read_ahead_blocks(stride_tracker_t *tracker,
+                  svn_fs_fs__read_ahead_stats_t *stats,
+                  int count,
+                  svn_fs_t *fs,
+                  svn_revnum_t revision,
+                  svn_fs_fs__revision_file_t *revision_file,
+                  apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_off_t max_offset;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  SVN_ERR(svn_fs_fs__p2l_get_max_offset(&max_offset, fs, revision_file,
+                                        revision, scratch_pool));
+
+  for (i = 0; i < count; ++i)
+    {
+      apr_int64_t block
+        = tracker->last + (tracker->pending + 1) * tracker->stride;
+      apr_off_t offset = (apr_off_t)block * ffd->block_size;
+      int run_count = 0;
+      svn_error_t *err;
+
+      /* Stay within the file. */
+      if (block < 0 || offset >= max_offset)
+        break;
+
+      svn_pool_clear(iterpool);
+
+      /* Read-ahead is speculative.  If the data is broken, the actual
+       * request for it will report that. */
+      err = read_block(NULL, &offset, &run_count, fs, revision,
+                       SVN_FS_FS__ITEM_INDEX_UNUSED, -1, revision_file,
+                       iterpool, iterpool);
+      if (err)
+        {
+          svn_error_clear(err);
+          break;
+        }
+
+      tracker->pending++;
+      stats->blocks_prefetched++;
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Read the blocks containing item ITEM_INDEX in up to COUNT revisions of
+ * FS ahead, as indicated by TRACKER, and put their contents into the
+ * cache.  REVISION_FILE is the file that we are currently reading from.
+ * Update TRACKER and STATS.  Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+read_ahead_revisions(stride_tracker_t *tracker,
+                     svn_fs_fs__read_ahead_stats_t *stats,
+                     int count,
+                     svn_fs_t *fs,
+                     apr_uint64_t item_index,
+                     svn_fs_fs__revision_file_t *revision_file,
+                     apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  for (i = 0; i < count; ++i)
+    {
+      svn_revnum_t revision = (svn_revnum_t)(tracker->last
+                              + (tracker->pending + 1) * tracker->stride);
+      svn_fs_fs__revision_file_t *file = revision_file;
+      apr_off_t offset;
+      int run_count = 0;
+      svn_error_t *err;
+
+      /* Only existing revisions, please. */
+      if (revision < 0 || revision > ffd->youngest_rev_cache)
+        break;
+
+      svn_pool_clear(iterpool);
+
+      /* Consecutive revisions will often be in the same pack file. */
+      if (   !revision_file->is_packed
+          || !svn_fs_fs__is_packed_rev(fs, revision)
+          || (  revision / ffd->max_files_per_dir
+              != revision_file->start_revision / ffd->max_files_per_dir))
+        {
+          err = svn_fs_fs__open_pack_or_rev_file(&file, fs, revision,
+                                                 iterpool, iterpool);
+          if (err)
+            {
+              svn_error_clear(err);
+              break;
+            }
+        }
+
+      /* Read-ahead is speculative.  The item may not even exist in
+       * REVISION and if the data is broken, the actual request for it will
+       * report that. */
+      err = svn_fs_fs__item_offset(&offset, fs, file, revision, NULL,
+                                   item_index, iterpool);
+      if (!err)
+        err = read_block(NULL, &offset, &run_count, fs, revision,
+                         item_index, offset, file, iterpool, iterpool);
+      if (file != revision_file)
+        err = svn_error_compose_create(err,
+                                       svn_fs_fs__close_revision_file(file));
+      if (err)
+        {
+          svn_error_clear(err);
+          break;
+        }
+
+      tracker->pending++;
+      stats->blocks_prefetched++;
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Record that block_read() has been called for ITEM_INDEX in REVISION of
+ * FS, which is located at WANTED_OFFSET in REVISION_FILE.  If that offset
+ * is not known, pass -1.  If the access history suggests so, read the
+ * next blocks in the respective sequence into the cache.  Use SCRATCH_POOL
+ * for temporary allocations.
+ *
+ * As all of this is speculative, callers should discard the errors.
+ */
+static svn_error_t *
+read_ahead(svn_fs_t *fs,
+           svn_revnum_t revision,
+           apr_uint64_t item_index,
+           apr_off_t wanted_offset,
+           svn_fs_fs__revision_file_t *revision_file,
+           apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  struct svn_fs_fs__read_ahead_t *state;
+  stride_tracker_t *tracker;
+  apr_uint64_t file_key;
+  int count;
+
+  if (!ffd->block_read_ahead)
+    return SVN_NO_ERROR;
+
+  if (!ffd->read_ahead)
+    {
+      int i;
+
+      ffd->read_ahead = apr_pcalloc(fs->pool, sizeof(*ffd->read_ahead));
+      ffd->read_ahead->blocks.depth = 1;
+      for (i = 0; i < READ_AHEAD_ITEM_TRACKERS; ++i)
+        ffd->read_ahead->items[i].depth = 1;
+    }
+
+  state = ffd->read_ahead;
+  state->stats.requests++;
+
+  /* Walking the same item through consecutive revisions? */
+  tracker = &state->items[item_index % READ_AHEAD_ITEM_TRACKERS];
+  count = track_access(tracker, item_index, revision, ffd->block_read_ahead,
+                       &state->stats);
+  if (count)
+    SVN_ERR(read_ahead_revisions(tracker, &state->stats, count, fs,
+                                 item_index, revision_file, scratch_pool));
+
+  /* Walking consecutive blocks of the same file? */
+  if (wanted_offset < 0)
+    SVN_ERR(svn_fs_fs__item_offset(&wanted_offset, fs, revision_file,
+                                   revision, NULL, item_index,
+                                   scratch_pool));
+
+  file_key = (apr_uint64_t)revision_file->start_revision * 2
+           + (revision_file->is_packed ? 1 : 0);
+  tracker = &state->blocks;
+  count = track_access(tracker, file_key, wanted_offset / ffd->block_size,
+                       ffd->block_read_ahead, &state->stats);
+  if (count)
+    SVN_ERR(read_ahead_blocks(tracker, &state->stats, count, fs,
+                              revision, revision_file, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+void
+svn_fs_fs__get_read_ahead_stats(svn_fs_fs__read_ahead_stats_t *stats,
+                                svn_fs_t *fs)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  if (ffd->read_ahead)
+    *stats = ffd->read_ahead->stats;
+  else
+    memset(stats, 0, sizeof(*stats));
+}
+
 /* Read the whole (e.g. 64kB) block containing ITEM_INDEX of REVISION in FS
  * and put all data into cache.  If necessary and depending on heuristics,
  * neighboring blocks may also get read.  The data is being read from
  * already open REVISION_FILE, which must be the correct rev / pack file
- * w.r.t. REVISION.
+ * w.r.t. REVISION.  Depending on the access history, blocks may also be
+ * read ahead (see read_ahead()).
  *
  * For noderevs and changed path lists, the item fetched can be allocated
  * RESULT_POOL and returned in *RESULT.  Otherwise, RESULT must be NULL.
@@ -3676,28 +4252,27 @@ block_read(void **result,
            apr_pool_t *result_pool,
            apr_pool_t *scratch_pool)
 {
-  fs_fs_data_t *ffd = fs->fsap_data;
   apr_off_t offset, wanted_offset = 0;
-  apr_off_t block_start = 0;
-  apr_array_header_t *entries;
   int run_count = 0;
-  int i;
-  apr_pool_t *iterpool;
-
-  /* Block read is an optional feature. If the caller does not want anything
-   * specific we may not have to read anything. */
-  if (!result)
-    return SVN_NO_ERROR;
-
-  iterpool = svn_pool_create(scratch_pool);
 
   /* don't try this on transaction protorev files */
   SVN_ERR_ASSERT(SVN_IS_VALID_REVNUM(revision));
 
+  /* Block read is an optional feature. If the caller does not want anything
+   * specific we may not have to read anything.  This request may still be
+   * part of a pattern that allows us to read ahead, though.  Read-ahead is
+   * speculative, so leave any errors to the actual requests for the data. */
+  if (!result)
+    {
+      svn_error_clear(read_ahead(fs, revision, item_index, -1,
+                                 revision_file, scratch_pool));
+      return SVN_NO_ERROR;
+    }
+
   /* index lookup: find the OFFSET of the item we *must* read plus (in the
    * "do-while" block) the list of items in the same block. */
   SVN_ERR(svn_fs_fs__item_offset(&wanted_offset, fs, revision_file,
-                                 revision, NULL, item_index, iterpool));
+                                 revision, NULL, item_index, scratch_pool));
 
   offset = wanted_offset;
 
@@ -3711,96 +4286,18 @@ block_read(void **result,
    */
   do
     {
-      /* fetch list of items in the block surrounding OFFSET */
-      block_start = offset - (offset % ffd->block_size);
-      SVN_ERR(svn_fs_fs__p2l_index_lookup(&entries, fs, revision_file,
-                                          revision, block_start,
-                                          ffd->block_size, scratch_pool,
-                                          scratch_pool));
-
-      SVN_ERR(aligned_seek(fs, revision_file->file, &block_start, offset,
-                           iterpool));
-
-      /* read all items from the block */
-      for (i = 0; i < entries->nelts; ++i)
-        {
-          svn_boolean_t is_result, is_wanted;
-          apr_pool_t *pool;
-          svn_fs_fs__p2l_entry_t* entry;
-
-          svn_pool_clear(iterpool);
-
-          /* skip empty sections */
-          entry = &APR_ARRAY_IDX(entries, i, svn_fs_fs__p2l_entry_t);
-          if (entry->type == SVN_FS_FS__ITEM_TYPE_UNUSED)
-            continue;
-
-          /* the item / container we were looking for? */
-          is_wanted =    entry->offset == wanted_offset
-                      && entry->item.revision == revision
-                      && entry->item.number == item_index;
-          is_result = result && is_wanted;
-
-          /* select the pool that we want the item to be allocated in */
-          pool = is_result ? result_pool : iterpool;
-
-          /* handle all items that start within this block and are relatively
-           * small (i.e. < block size).  Always read the item we need to return.
-           */
-          if (is_result || (   entry->offset >= block_start
-                            && entry->size < ffd->block_size))
-            {
-              void *item = NULL;
-              SVN_ERR(svn_io_file_seek(revision_file->file, APR_SET,
-                                       &entry->offset, iterpool));
-              switch (entry->type)
-                {
-                  case SVN_FS_FS__ITEM_TYPE_FILE_REP:
-                  case SVN_FS_FS__ITEM_TYPE_DIR_REP:
-                  case SVN_FS_FS__ITEM_TYPE_FILE_PROPS:
-                  case SVN_FS_FS__ITEM_TYPE_DIR_PROPS:
-                    SVN_ERR(block_read_contents(fs, revision_file, entry,
-                                                is_wanted
-                                                  ? -1
-                                                  : block_start + ffd->block_size,
-                                                iterpool));
-                    break;
-
-                  case SVN_FS_FS__ITEM_TYPE_NODEREV:
-                    if (ffd->node_revision_cache || is_result)
-                      SVN_ERR(block_read_noderev((node_revision_t **)&item,
-                                                 fs, revision_file,
-                                                 entry, is_result, pool,
-                                                 iterpool));
-                    break;
-
-                  case SVN_FS_FS__ITEM_TYPE_CHANGES:
-                    SVN_ERR(block_read_changes(fs, revision_file,
-                                               entry, iterpool));
-                    break;
-
-                  default:
-                    break;
-                }
-
-              if (is_result)
-                *result = item;
-
-              /* if we crossed a block boundary, read the remainder of
-               * the last block as well */
-              offset = entry->offset + entry->size;
-              if (offset - block_start > ffd->block_size)
-                ++run_count;
-            }
-        }
-
+      SVN_ERR(read_block(result, &offset, &run_count, fs, revision,
+                         item_index, wanted_offset, revision_file,
+                         result_pool, scratch_pool));
     }
   while(run_count++ == 1); /* can only be true once and only if a block
                             * boundary got crossed */
 
   /* if the caller requested a result, we must have provided one by now */
   assert(!result || *result);
-  svn_pool_destroy(iterpool);
+
+  svn_error_clear(read_ahead(fs, revision, item_index, wanted_offset,
+                             revision_file, scratch_pool));
 
   return SVN_NO_ERROR;
 }
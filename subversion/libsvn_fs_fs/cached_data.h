@@ -119,6 +119,30 @@ svn_fs_fs__try_process_file_contents(svn_boolean_t *success,
                                      void* baton,
                                      apr_pool_t *pool);
 
+/* Attempt to locate the on-disk data of the text representation of
+   node-revision NODEREV as seen in filesystem FS.  If that representation
+   is committed and either PLAIN or a self-contained delta, set *SUCCESS
+   to TRUE, return the rev / pack file containing it in *FILE and the
+   data's position and size within that file in *OFFSET and *LENGTH.
+   For self-contained deltas, the data is an svndiff stream and its format
+   version will be returned in *SVNDIFF_VERSION.  For PLAIN reps, the data
+   is the fulltext and *SVNDIFF_VERSION will be -1.  Otherwise, set
+   *SUCCESS to FALSE and leave the other outputs untouched.
+
+   *FILE will be allocated in RESULT_POOL and remains open until that
+   pool gets cleaned up.  Use SCRATCH_POOL for temporary allocations.
+ */
+svn_error_t *
+svn_fs_fs__try_get_file_range(svn_boolean_t *success,
+                              apr_file_t **file,
+                              apr_off_t *offset,
+                              svn_filesize_t *length,
+                              int *svndiff_version,
+                              svn_fs_t *fs,
+                              node_revision_t *noderev,
+                              apr_pool_t *result_pool,
+                              apr_pool_t *scratch_pool);
+
 /* Set *STREAM_P to a delta stream turning the contents of the file SOURCE into
    the contents of the file TARGET, allocated in POOL.
    If SOURCE is null, the empty string will be used. */
@@ -188,4 +212,9 @@ svn_fs_fs__get_changes(apr_array_header_t **changes,
                        apr_pool_t *result_pool,
                        apr_pool_t *scratch_pool);
 
+/* Return the block-read read-ahead statistics of FS in *STATS. */
+void
+svn_fs_fs__get_read_ahead_stats(svn_fs_fs__read_ahead_stats_t *stats,
+                                svn_fs_t *fs);
+
 #endif
@@ -346,6 +346,49 @@ create_cache(svn_cache__t **cache_p,
   return SVN_NO_ERROR;
 }
 
+/* If FS has been configured to use a persistent cache, replace *CACHE_P
+ * with a persistent cache that uses the original *CACHE_P as its first
+ * level.  PREFIX, SERIALIZER, DESERIALIZER and KLEN must match what
+ * *CACHE_P had been created with.  NO_HANDLER is as for create_cache().
+ *
+ * Cache is allocated in RESULT_POOL, temporaries in SCRATCH_POOL.
+ */
+static svn_error_t *
+add_persistent_cache(svn_cache__t **cache_p,
+                     svn_cache__serialize_func_t serializer,
+                     svn_cache__deserialize_func_t deserializer,
+                     apr_ssize_t klen,
+                     const char *prefix,
+                     svn_fs_t *fs,
+                     svn_boolean_t no_handler,
+                     apr_pool_t *result_pool,
+                     apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  if (*cache_p == NULL || ffd->persistent_cache_dir == NULL)
+    return SVN_NO_ERROR;
+
+  /* The data will outlive this process.  The instance ID makes sure that
+   * it will not be mistaken for data of e.g. a restored backup. */
+  SVN_ERR(svn_cache__create_persistent(cache_p, *cache_p,
+                                       ffd->persistent_cache_dir,
+                                       ffd->persistent_cache_size,
+                                       serializer, deserializer, klen,
+                                       apr_pstrcat(scratch_pool, prefix, ":",
+                                                   ffd->instance_id,
+                                                   SVN_VA_NULL),
+                                       result_pool, scratch_pool));
+
+  /* Like memcached, the disk cache is optional. */
+  SVN_ERR(init_callbacks(*cache_p, fs,
+                         no_handler ? NULL
+                                    : warn_and_continue_on_cache_errors,
+                         result_pool));
+
+  return SVN_NO_ERROR;
+}
+
 svn_error_t *
 svn_fs_fs__initialize_caches(svn_fs_t *fs,
                              apr_pool_t *pool)
@@ -547,6 +590,18 @@ svn_fs_fs__initialize_caches(svn_fs_t *fs,
                            no_handler,
                            fs->pool, pool));
 
+      /* Caches with namespaces are short-lived, i.e. there is no point
+       * in persisting them. */
+      if (!has_namespace)
+        SVN_ERR(add_persistent_cache(&(ffd->fulltext_cache),
+                                     NULL, NULL,
+                                     sizeof(pair_cache_key_t),
+                                     apr_pstrcat(pool, prefix, "TEXT",
+                                                 SVN_VA_NULL),
+                                     fs,
+                                     no_handler,
+                                     fs->pool, pool));
+
       SVN_ERR(create_cache(&(ffd->mergeinfo_cache),
                            NULL,
                            membuffer,
@@ -654,6 +709,17 @@ svn_fs_fs__initialize_caches(svn_fs_t *fs,
                            fs,
                            no_handler,
                            fs->pool, pool));
+
+      if (!has_namespace)
+        SVN_ERR(add_persistent_cache(&(ffd->combined_window_cache),
+                                     NULL, NULL,
+                                     sizeof(window_cache_key_t),
+                                     apr_pstrcat(pool, prefix,
+                                                 "COMBINED_WINDOW",
+                                                 SVN_VA_NULL),
+                                     fs,
+                                     no_handler,
+                                     fs->pool, pool));
     }
   else
     {
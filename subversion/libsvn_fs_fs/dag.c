@@ -1020,6 +1020,35 @@ svn_fs_fs__dag_try_process_file_contents(svn_boolean_t *success,
 }
 
 
+svn_error_t *
+svn_fs_fs__dag_try_get_file_range(svn_boolean_t *success,
+                                  apr_file_t **file,
+                                  apr_off_t *offset,
+                                  svn_filesize_t *length,
+                                  int *svndiff_version,
+                                  dag_node_t *node,
+                                  apr_pool_t *result_pool,
+                                  apr_pool_t *scratch_pool)
+{
+  node_revision_t *noderev;
+
+  /* Make sure our node is a file. */
+  if (node->kind != svn_node_file)
+    return svn_error_createf
+      (SVN_ERR_FS_NOT_FILE, NULL,
+       "Attempted to get textual contents of a *non*-file node");
+
+  SVN_ERR(get_node_revision(&noderev, node));
+
+  return svn_error_trace(svn_fs_fs__try_get_file_range(success, file,
+                                                       offset, length,
+                                                       svndiff_version,
+                                                       node->fs, noderev,
+                                                       result_pool,
+                                                       scratch_pool));
+}
+
+
 svn_error_t *
 svn_fs_fs__dag_file_length(svn_filesize_t *length,
                            dag_node_t *file,
@@ -427,6 +427,22 @@ svn_fs_fs__dag_try_process_file_contents(svn_boolean_t *success,
                                          apr_pool_t *pool);
 
 
+/* Attempt to locate the on-disk contents of the file NODE.  See
+   svn_fs_fs__try_get_file_range() for the semantics of SUCCESS, FILE,
+   OFFSET, LENGTH and SVNDIFF_VERSION.
+
+   Allocate *FILE in RESULT_POOL and use SCRATCH_POOL for temporaries.
+ */
+svn_error_t *
+svn_fs_fs__dag_try_get_file_range(svn_boolean_t *success,
+                                  apr_file_t **file,
+                                  apr_off_t *offset,
+                                  svn_filesize_t *length,
+                                  int *svndiff_version,
+                                  dag_node_t *node,
+                                  apr_pool_t *result_pool,
+                                  apr_pool_t *scratch_pool);
+
 /* Set *STREAM_P to a delta stream that will turn the contents of SOURCE into
    the contents of TARGET, allocated in POOL.  If SOURCE is null, the empty
    string will be used.
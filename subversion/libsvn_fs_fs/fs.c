@@ -32,10 +32,13 @@
 #include "svn_delta.h"
 #include "svn_version.h"
 #include "svn_pools.h"
+#include "cached_data.h"
 #include "fs.h"
 #include "fs_fs.h"
 #include "tree.h"
 #include "lock.h"
+#include "history_index.h"
+#include "mergeinfo_index.h"
 #include "hotcopy.h"
 #include "id.h"
 #include "pack.h"
@@ -124,6 +127,10 @@ fs_serialized_init(svn_fs_t *fs, apr_pool_t *common_pool, apr_pool_t *pool)
          transaction list and free transaction pointer. */
       SVN_ERR(svn_mutex__init(&ffsd->txn_list_lock, TRUE, common_pool));
 
+      /* Commits may share their fsyncs. */
+      SVN_ERR(svn_fs_fs__fsync_group_create(&ffsd->fsync_group,
+                                            common_pool));
+
       key = apr_pstrdup(common_pool, key);
       status = apr_pool_userdata_set(ffsd, key, NULL, common_pool);
       if (status)
@@ -272,6 +279,7 @@ fs_ioctl(svn_fs_t *fs, svn_fs_ioctl_code_t ctlcode,
 
           output = apr_pcalloc(result_pool, sizeof(*output));
           SVN_ERR(svn_fs_fs__get_stats(&output->stats, fs,
+                                       input->jobs, input->state_dir,
                                        input->progress_func,
                                        input->progress_baton,
                                        cancel_func, cancel_baton,
@@ -312,6 +320,43 @@ fs_ioctl(svn_fs_t *fs, svn_fs_ioctl_code_t ctlcode,
           *output_p = output;
           return SVN_NO_ERROR;
         }
+      else if (ctlcode.code == SVN_FS_FS__IOCTL_GET_READ_AHEAD_STATS.code)
+        {
+          svn_fs_fs__ioctl_get_read_ahead_stats_output_t *output
+            = apr_pcalloc(result_pool, sizeof(*output));
+
+          svn_fs_fs__get_read_ahead_stats(&output->stats, fs);
+          *output_p = output;
+          return SVN_NO_ERROR;
+        }
+      else if (ctlcode.code == SVN_FS_FS__IOCTL_BUILD_MERGEINFO_INDEX.code)
+        {
+          svn_fs_fs__ioctl_build_mergeinfo_index_input_t *input = input_void;
+
+          SVN_ERR(svn_fs_fs__build_mergeinfo_index(fs,
+                                                   input->progress_func,
+                                                   input->progress_baton,
+                                                   cancel_func,
+                                                   cancel_baton,
+                                                   scratch_pool));
+
+          *output_p = NULL;
+          return SVN_NO_ERROR;
+        }
+      else if (ctlcode.code == SVN_FS_FS__IOCTL_BUILD_HISTORY_INDEX.code)
+        {
+          svn_fs_fs__ioctl_build_history_index_input_t *input = input_void;
+
+          SVN_ERR(svn_fs_fs__build_history_index(fs,
+                                                 input->progress_func,
+                                                 input->progress_baton,
+                                                 cancel_func,
+                                                 cancel_baton,
+                                                 scratch_pool));
+
+          *output_p = NULL;
+          return SVN_NO_ERROR;
+        }
       else if (ctlcode.code == SVN_FS_FS__IOCTL_BUILD_REP_CACHE.code)
         {
           svn_fs_fs__ioctl_build_rep_cache_input_t *input = input_void;
@@ -705,6 +750,8 @@ svn_fs_fs__init(const svn_version_t *loader_version,
                              loader_version->major);
   SVN_ERR(svn_ver_check_list2(fs_version(), checklist, svn_ver_equal));
 
+  SVN_ERR(svn_fs_fs__batch_fsync_init(common_pool));
+
   *vtable = &library_vtable;
   return SVN_NO_ERROR;
 }
@@ -37,6 +37,7 @@
 #include "private/svn_sqlite.h"
 #include "private/svn_mutex.h"
 
+#include "batch_fsync.h"
 #include "rev_file.h"
 
 #ifdef __cplusplus
@@ -64,6 +65,9 @@ extern "C" {
 #define PATH_TXN_CURRENT      "txn-current"      /* File with next txn key */
 #define PATH_TXN_CURRENT_LOCK "txn-current-lock" /* Lock for txn-current */
 #define PATH_LOCKS_DIR        "locks"            /* Directory of locks */
+#define PATH_LOCKS_DB         "locks.db"         /* Indexed lock store */
+#define PATH_HISTORY_INDEX_DB "history-index.db" /* Path history index */
+#define PATH_MERGEINFO_INDEX_DB "mergeinfo-index.db" /* Mergeinfo index */
 #define PATH_MIN_UNPACKED_REV "min-unpacked-rev" /* Oldest revision which
                                                     has not been packed. */
 #define PATH_REVPROP_GENERATION "revprop-generation"
@@ -100,8 +104,14 @@ extern "C" {
 /* Names of sections and options in fsfs.conf. */
 #define CONFIG_SECTION_CACHES            "caches"
 #define CONFIG_OPTION_FAIL_STOP          "fail-stop"
+#define CONFIG_OPTION_PERSISTENT_CACHE_DIR  "persistent-cache-dir"
+#define CONFIG_OPTION_PERSISTENT_CACHE_SIZE "persistent-cache-size"
 #define CONFIG_SECTION_REP_SHARING       "rep-sharing"
 #define CONFIG_OPTION_ENABLE_REP_SHARING "enable-rep-sharing"
+#define CONFIG_SECTION_LOCKS             "locks"
+#define CONFIG_OPTION_ENABLE_LOCK_DB     "enable-lock-db"
+#define CONFIG_SECTION_HISTORY_INDEX     "history-index"
+#define CONFIG_OPTION_ENABLE_HISTORY_INDEX "enable-history-index"
 #define CONFIG_SECTION_DELTIFICATION     "deltification"
 #define CONFIG_OPTION_ENABLE_DIR_DELTIFICATION   "enable-dir-deltification"
 #define CONFIG_OPTION_ENABLE_PROPS_DELTIFICATION "enable-props-deltification"
@@ -115,10 +125,14 @@ extern "C" {
 #define CONFIG_OPTION_BLOCK_SIZE         "block-size"
 #define CONFIG_OPTION_L2P_PAGE_SIZE      "l2p-page-size"
 #define CONFIG_OPTION_P2L_PAGE_SIZE      "p2l-page-size"
+#define CONFIG_OPTION_MMAP_PACK_FILES    "mmap-pack-files"
+#define CONFIG_OPTION_BLOCK_READ_AHEAD   "block-read-ahead"
+#define CONFIG_OPTION_GROUP_COMMIT_WINDOW "group-commit-window"
 #define CONFIG_SECTION_DEBUG             "debug"
 #define CONFIG_OPTION_PACK_AFTER_COMMIT  "pack-after-commit"
 #define CONFIG_OPTION_VERIFY_BEFORE_COMMIT "verify-before-commit"
 #define CONFIG_OPTION_COMPRESSION        "compression"
+#define CONFIG_OPTION_COMPRESSION_THREADS "compression-threads"
 
 /* The format number of this filesystem.
    This is independent of the repository format number, and
@@ -127,7 +141,7 @@ extern "C" {
    Note: If you bump this, please update the switch statement in
          svn_fs_fs__create() as well.
  */
-#define SVN_FS_FS__FORMAT_NUMBER   8
+#define SVN_FS_FS__FORMAT_NUMBER   9
 
 /* The minimum format number that supports svndiff version 1.  */
 #define SVN_FS_FS__MIN_SVNDIFF1_FORMAT 2
@@ -200,6 +214,10 @@ extern "C" {
     database. */
 #define SVN_FS_FS__MIN_REP_CACHE_SCHEMA_V2_FORMAT 8
 
+/* The minimum format number that may keep its locks in locks.db instead
+   of the digest file tree.  Older servers would not see those locks. */
+#define SVN_FS_FS__MIN_LOCK_DB_FORMAT 9
+
 /* On most operating systems apr implements file locks per process, not
    per file.  On Windows apr implements the locking as per file handle
    locks, so we don't have to add our own mutex for just in-process
@@ -275,6 +293,9 @@ typedef struct fs_fs_shared_data_t
      txn-current file. */
   svn_mutex__t *txn_current_lock;
 
+  /* Lets concurrent commits within this process share their fsyncs. */
+  svn_fs_fs__fsync_group_t *fsync_group;
+
   /* The common pool, under which this object is allocated, subpools
      of which are used to allocate the transaction objects. */
   apr_pool_t *common_pool;
@@ -347,6 +368,19 @@ typedef struct fs_fs_data_t
    * (not just the one bit that we need, atm). */
   svn_boolean_t use_block_read;
 
+  /* If set, map pack files into memory and read index data as well as
+   * block-read items directly from the mapped pages. */
+  svn_boolean_t mmap_pack_files;
+
+  /* Maximum number of blocks that block-read may speculatively read
+   * ahead once it detected a sequential access pattern.  0 disables
+   * read-ahead. */
+  int block_read_ahead;
+
+  /* Access pattern history and statistics for block-read read-ahead.
+   * Allocated on first use.  See cached_data.c. */
+  struct svn_fs_fs__read_ahead_t *read_ahead;
+
   /* The revision that was youngest, last time we checked. */
   svn_revnum_t youngest_rev_cache;
 
@@ -360,6 +394,13 @@ typedef struct fs_fs_data_t
      e.g. memcached may be ignored as caching is an optional feature. */
   svn_boolean_t fail_stop;
 
+  /* Directory of the on-disk second-level cache for fulltexts and
+     combined windows.  NULL if that cache is disabled. */
+  const char *persistent_cache_dir;
+
+  /* Size limit of PERSISTENT_CACHE_DIR in bytes. */
+  apr_uint64_t persistent_cache_size;
+
   /* A cache of revision root IDs, mapping from (svn_revnum_t *) to
      (svn_fs_id_t *).  (Not threadsafe.) */
   svn_cache__t *rev_root_id_cache;
@@ -473,6 +514,25 @@ typedef struct fs_fs_data_t
    * and allowed by the configuration. */
   svn_boolean_t rep_sharing_allowed;
 
+  /* The sqlite database used as the indexed lock store.  NULL until it
+   * has been found on disk and opened; see lock.c. */
+  svn_sqlite__db_t *lock_db;
+
+  /* Whether the configuration asks for the digest-file lock tree to be
+   * migrated into the indexed lock store. */
+  svn_boolean_t lock_db_allowed;
+
+  /* The sqlite database used as the path history index.  NULL until it
+   * has been opened; see history_index.c. */
+  svn_sqlite__db_t *history_index_db;
+
+  /* Whether the path history index shall be maintained and used. */
+  svn_boolean_t history_index_enabled;
+
+  /* The sqlite database used as the mergeinfo index.  NULL until it
+   * has been found on disk and opened; see mergeinfo_index.c. */
+  svn_sqlite__db_t *mergeinfo_index_db;
+
   /* File size limit in bytes up to which multiple revprops shall be packed
    * into a single file. */
   apr_int64_t revprop_pack_size;
@@ -499,6 +559,9 @@ typedef struct fs_fs_data_t
   /* Compression level (currently, only used with compression_type_zlib). */
   int delta_compression_level;
 
+  /* Maximum number of delta windows to compress concurrently. */
+  int delta_compression_threads;
+
   /* Pack after every commit. */
   svn_boolean_t pack_after_commit;
 
@@ -514,6 +577,13 @@ typedef struct fs_fs_data_t
   /* Ensure that all filesystem changes are written to disk. */
   svn_boolean_t flush_to_disk;
 
+  /* Time window in microseconds within which concurrent commits share a
+     single flush of their revision data.  0 disables group commit. */
+  apr_interval_time_t group_commit_window;
+
+  /* Maximum number of shards to pack concurrently. */
+  int pack_jobs;
+
   /* Pointer to svn_fs_open. */
   svn_error_t *(*svn_fs_open_)(svn_fs_t **, const char *, apr_hash_t *,
                                apr_pool_t *, apr_pool_t *);
@@ -761,6 +761,16 @@ read_config(fs_fs_data_t *ffd,
   else
     ffd->rep_sharing_allowed = FALSE;
 
+  /* Initialize ffd->lock_db_allowed. */
+  SVN_ERR(svn_config_get_bool(config, &ffd->lock_db_allowed,
+                              CONFIG_SECTION_LOCKS,
+                              CONFIG_OPTION_ENABLE_LOCK_DB, FALSE));
+
+  /* Initialize ffd->history_index_enabled. */
+  SVN_ERR(svn_config_get_bool(config, &ffd->history_index_enabled,
+                              CONFIG_SECTION_HISTORY_INDEX,
+                              CONFIG_OPTION_ENABLE_HISTORY_INDEX, FALSE));
+
   /* Initialize deltification settings in ffd. */
   if (ffd->format >= SVN_FS_FS__MIN_DELTIFICATION_FORMAT)
     {
@@ -813,6 +823,9 @@ read_config(fs_fs_data_t *ffd,
 
   if (ffd->format >= SVN_FS_FS__MIN_LOG_ADDRESSING_FORMAT)
     {
+      apr_int64_t block_read_ahead;
+      apr_int64_t group_commit_window;
+
       SVN_ERR(svn_config_get_int64(config, &ffd->block_size,
                                    CONFIG_SECTION_IO,
                                    CONFIG_OPTION_BLOCK_SIZE,
@@ -825,6 +838,18 @@ read_config(fs_fs_data_t *ffd,
                                    CONFIG_SECTION_IO,
                                    CONFIG_OPTION_P2L_PAGE_SIZE,
                                    0x400));
+      SVN_ERR(svn_config_get_bool(config, &ffd->mmap_pack_files,
+                                  CONFIG_SECTION_IO,
+                                  CONFIG_OPTION_MMAP_PACK_FILES,
+                                  FALSE));
+      SVN_ERR(svn_config_get_int64(config, &block_read_ahead,
+                                   CONFIG_SECTION_IO,
+                                   CONFIG_OPTION_BLOCK_READ_AHEAD,
+                                   4));
+      SVN_ERR(svn_config_get_int64(config, &group_commit_window,
+                                   CONFIG_SECTION_IO,
+                                   CONFIG_OPTION_GROUP_COMMIT_WINDOW,
+                                   0));
 
       /* Don't accept unreasonable or illegal values.
        * Block size and P2L page size are in kbytes;
@@ -840,6 +865,13 @@ read_config(fs_fs_data_t *ffd,
       ffd->block_size *= 0x400;
       ffd->p2l_page_size *= 0x400;
       /* L2P pages are in entries - not in (k)Bytes */
+
+      /* Negative values disable read-ahead just like 0 does. */
+      ffd->block_read_ahead = (int)MAX(0, MIN(block_read_ahead, 64));
+
+      /* The window is given in milliseconds; cap it at 1 second. */
+      ffd->group_commit_window
+        = apr_time_from_msec(MAX(0, MIN(group_commit_window, 1000)));
     }
   else
     {
@@ -847,6 +879,9 @@ read_config(fs_fs_data_t *ffd,
       ffd->block_size = 0x1000; /* Matches default APR file buffer size. */
       ffd->l2p_page_size = 0x2000;    /* Matches above default. */
       ffd->p2l_page_size = 0x100000;  /* Matches above default in bytes. */
+      ffd->mmap_pack_files = FALSE;
+      ffd->block_read_ahead = 0;
+      ffd->group_commit_window = 0;
     }
 
   if (ffd->format >= SVN_FS_FS__MIN_PACKED_FORMAT)
@@ -926,6 +961,22 @@ read_config(fs_fs_data_t *ffd,
       ffd->delta_compression_level = SVN_DELTA_COMPRESSION_LEVEL_NONE;
     }
 
+  if (ffd->format >= SVN_FS_FS__MIN_DELTIFICATION_FORMAT)
+    {
+      apr_int64_t compression_threads;
+      SVN_ERR(svn_config_get_int64(config, &compression_threads,
+                                   CONFIG_SECTION_DELTIFICATION,
+                                   CONFIG_OPTION_COMPRESSION_THREADS, 1));
+
+      /* Values smaller than 2 disable the compression pipeline. */
+      ffd->delta_compression_threads
+        = (int)MAX(1, MIN(compression_threads, 64));
+    }
+  else
+    {
+      ffd->delta_compression_threads = 1;
+    }
+
 #ifdef SVN_DEBUG
   SVN_ERR(svn_config_get_bool(config, &ffd->verify_before_commit,
                               CONFIG_SECTION_DEBUG,
@@ -946,6 +997,27 @@ read_config(fs_fs_data_t *ffd,
                               CONFIG_SECTION_CACHES, CONFIG_OPTION_FAIL_STOP,
                               FALSE));
 
+  /* Relative paths are relative to the FS directory. */
+  svn_config_get(config, &ffd->persistent_cache_dir, CONFIG_SECTION_CACHES,
+                 CONFIG_OPTION_PERSISTENT_CACHE_DIR, NULL);
+  if (ffd->persistent_cache_dir && *ffd->persistent_cache_dir)
+    {
+      apr_int64_t size;
+      SVN_ERR(svn_config_get_int64(config, &size, CONFIG_SECTION_CACHES,
+                                   CONFIG_OPTION_PERSISTENT_CACHE_SIZE, 1024));
+
+      ffd->persistent_cache_dir = svn_dirent_join(fs_path,
+                                      svn_dirent_canonicalize(
+                                        ffd->persistent_cache_dir,
+                                        scratch_pool),
+                                      result_pool);
+      ffd->persistent_cache_size = (apr_uint64_t)MAX(size, 1) * 0x100000;
+    }
+  else
+    {
+      ffd->persistent_cache_dir = NULL;
+    }
+
   return SVN_NO_ERROR;
 }
 
@@ -978,6 +1050,16 @@ write_config(svn_fs_t *fs,
 "### configured (and ignoring it with file:// access).  To make"             NL
 "### Subversion never ignore cache errors, uncomment this line."             NL
 "# " CONFIG_OPTION_FAIL_STOP " = true"                                       NL
+"### Reconstructed file contents and delta windows can also be kept in"      NL
+"### an on-disk cache that survives server restarts.  That is useful"        NL
+"### when a cold in-memory cache makes the first requests after a restart"   NL
+"### slow.  Relative paths are relative to the repository's db directory."   NL
+"### Multiple repositories and server processes may share the directory."    NL
+"### The persistent cache is disabled by default."                           NL
+"# " CONFIG_OPTION_PERSISTENT_CACHE_DIR " = cache"                           NL
+"### The size limit of the persistent cache in MB.  The least recently"      NL
+"### used entries get removed when the limit is exceeded.  Default is 1024." NL
+"# " CONFIG_OPTION_PERSISTENT_CACHE_SIZE " = 1024"                           NL
 ""                                                                           NL
 "[" CONFIG_SECTION_REP_SHARING "]"                                           NL
 "### To conserve space, the filesystem can optionally avoid storing"         NL
@@ -995,6 +1077,34 @@ write_config(svn_fs_t *fs,
 "### rep-sharing is enabled by default."                                     NL
 "# " CONFIG_OPTION_ENABLE_REP_SHARING " = true"                              NL
 ""                                                                           NL
+"[" CONFIG_SECTION_LOCKS "]"                                                 NL
+"### By default, locks are stored in a tree of small files below the"        NL
+"### 'locks' directory.  Listing the locks of a large sub-tree then has to"  NL
+"### open one file per lock and every lock or unlock rewrites the files of"  NL
+"### all parent directories.  The following parameter makes the next lock"   NL
+"### or unlock operation migrate all existing locks into a single SQLite"    NL
+"### database, 'locks.db', which is used from then on.  Once the database"   NL
+"### exists, it is used regardless of this setting.  To go back to the"      NL
+"### file tree, dump the locks, remove the database and re-create them."     NL
+"### Servers older than 1.15 do not know the database, so this requires"     NL
+"### FSFS format 9; use 'svnadmin upgrade' for older repositories."          NL
+"### The indexed lock store is disabled by default."                         NL
+"# " CONFIG_OPTION_ENABLE_LOCK_DB " = false"                                 NL
+""                                                                           NL
+"[" CONFIG_SECTION_HISTORY_INDEX "]"                                         NL
+"### Following the history of a path ('svn log', 'svn blame') normally"      NL
+"### walks the chain of node revisions, reading one of them per step from"   NL
+"### the revision files.  The following parameter makes the filesystem"      NL
+"### maintain an SQLite database, 'history-index.db', that records for"      NL
+"### every path the revisions in which it changed and the sources of all"    NL
+"### copies.  History walks then run as index lookups.  Each commit"         NL
+"### extends the index by a few revisions at most.  After enabling it for"   NL
+"### an existing repository, run 'svnadmin build-history-index' to index"    NL
+"### all existing revisions.  Revisions not covered by the index are"        NL
+"### handled the traditional way.  The index can be deleted at any time."    NL
+"### The history index is disabled by default."                              NL
+"# " CONFIG_OPTION_ENABLE_HISTORY_INDEX " = false"                           NL
+""                                                                           NL
 "[" CONFIG_SECTION_DELTIFICATION "]"                                         NL
 "### To conserve space, the filesystem stores data as differences against"   NL
 "### existing representations.  This comes at a slight cost in performance," NL
@@ -1080,6 +1190,17 @@ write_config(svn_fs_t *fs,
 "### still be used (and it will result in zlib compression with the"         NL
 "### corresponding compression level)."                                      NL
 "###   " CONFIG_OPTION_COMPRESSION_LEVEL " = 0 ... 9 (default is 5)"         NL
+"###"                                                                        NL
+"### Compressing large files may take a significant amount of time during"   NL
+"### commits and 'svnadmin load'.  This setting controls how many delta"     NL
+"### windows of the same file will be compressed concurrently.  The output"  NL
+"### is identical to the sequential compression, only the CPU load differs." NL
+"### A value of 1 disables concurrent compression.  Values are limited to"   NL
+"### 64.  It has no effect for the 'none' compression type and if APR has"   NL
+"### been built without thread support."                                     NL
+"### Versions prior to Subversion 1.15 will ignore this option."             NL
+"### The default value is 1."                                                NL
+"# " CONFIG_OPTION_COMPRESSION_THREADS " = 1"                                NL
 ""                                                                           NL
 "[" CONFIG_SECTION_PACKED_REVPROPS "]"                                       NL
 "### This parameter controls the size (in kBytes) of packed revprop files."  NL
@@ -1099,6 +1220,9 @@ write_config(svn_fs_t *fs,
 "### To save disk space, packed revprop files may be compressed.  Standard"  NL
 "### revprops tend to allow for very effective compression.  Reading and"    NL
 "### even more so writing, become significantly more CPU intensive."         NL
+"### Revprops of a single revision can only be read from uncompressed"       NL
+"### packs without reading the whole pack file.  'svnadmin upgrade' will"    NL
+"### convert compressed packs back if compression has been disabled."        NL
 "### Compressing packed revprops is disabled by default."                    NL
 "# " CONFIG_OPTION_COMPRESS_PACKED_REVPROPS " = false"                       NL
 ""                                                                           NL
@@ -1148,6 +1272,32 @@ write_config(svn_fs_t *fs,
 "### Must be a power of 2."                                                  NL
 "### p2l-page-size is given in kBytes and with a default of 1024 kBytes."    NL
 "# " CONFIG_OPTION_P2L_PAGE_SIZE " = 1024"                                   NL
+"###"                                                                        NL
+"### Pack files never change once written.  If enabled, they will be mapped" NL
+"### into memory and index lookups as well as block-read parsing will take"  NL
+"### their data directly from the OS page cache instead of issuing seek and" NL
+"### read calls.  This requires sufficient address space for the pack files" NL
+"### and is therefore only recommended for 64 bit servers."                  NL
+"### mmap-pack-files is disabled by default."                                NL
+"# " CONFIG_OPTION_MMAP_PACK_FILES " = false"                                NL
+"###"                                                                        NL
+"### If block-read has been enabled and requests follow a predictable"       NL
+"### pattern,  e.g. walking consecutive blocks of a pack file or the same"   NL
+"### item in consecutive revisions as 'svn log' and 'svn blame' do,  up to"  NL
+"### that many blocks will be read ahead and put into the cache.  The"       NL
+"### actual amount adapts to how much of the read-ahead data gets used."     NL
+"### 0 disables read-ahead.  Values larger than 64 will be capped."          NL
+"### block-read-ahead is 4 blocks by default."                               NL
+"# " CONFIG_OPTION_BLOCK_READ_AHEAD " = 4"                                   NL
+"###"                                                                        NL
+"### Commits flush their new revision data to disk before taking the"        NL
+"### repository write lock.  If group-commit-window is set, concurrent"      NL
+"### commits within the same server process that finish writing within"     NL
+"### that many milliseconds of each other will share a single flush.  This" NL
+"### trades a little commit latency for fewer fsync round-trips and is"      NL
+"### mainly useful on network storage.  Values above 1000 will be capped."   NL
+"### group-commit-window is 0 (disabled) by default."                        NL
+"# " CONFIG_OPTION_GROUP_COMMIT_WINDOW " = 0"                                NL
 ""                                                                           NL
 "[" CONFIG_SECTION_DEBUG "]"                                                 NL
 "###"                                                                        NL
@@ -1175,6 +1325,19 @@ read_global_config(svn_fs_t *fs)
                                            SVN_FS_CONFIG_NO_FLUSH_TO_DISK,
                                            FALSE);
 
+  ffd->pack_jobs = 1;
+  if (fs->config)
+    {
+      const char *pack_jobs = svn_hash_gets(fs->config,
+                                            SVN_FS_CONFIG_FSFS_PACK_JOBS);
+      if (pack_jobs)
+        {
+          apr_int64_t val;
+          SVN_ERR(svn_cstring_strtoi64(&val, pack_jobs, 1, 256, 10));
+          ffd->pack_jobs = (int)val;
+        }
+    }
+
   /* Ignore the user-specified larger block size if we don't use block-read.
      Defaulting to 4k gives us the same access granularity in format 7 as in
      older formats. */
@@ -1327,6 +1490,19 @@ upgrade_body(void *baton, apr_pool_t *pool)
                                svn_dirent_join(fs->path, PATH_CONFIG, pool));
     }
 
+  /* Unless configured otherwise, make sure that packed revprops are stored
+     uncompressed such that single revisions can be read from them without
+     inflating the whole pack.  This does not require a format bump. */
+  if (   format >= SVN_FS_FS__MIN_PACKED_REVPROP_FORMAT
+      && max_files_per_dir > 0
+      && !ffd->compress_packed_revprops)
+    SVN_ERR(svn_fs_fs__upgrade_store_packed_revprops(fs,
+                                               upgrade_baton->notify_func,
+                                               upgrade_baton->notify_baton,
+                                               upgrade_baton->cancel_func,
+                                               upgrade_baton->cancel_baton,
+                                               pool));
+
   /* If we're already up-to-date, there's nothing else to be done here. */
   if (format == SVN_FS_FS__FORMAT_NUMBER)
     return SVN_NO_ERROR;
@@ -1952,6 +2128,13 @@ svn_fs_fs__create(svn_fs_t *fs,
           case 9: format = 7;
                   break;
 
+          case 10:
+          case 11:
+          case 12:
+          case 13:
+          case 14: format = 8;
+                  break;
+
           default:format = SVN_FS_FS__FORMAT_NUMBER;
         }
 
@@ -2323,8 +2506,11 @@ svn_fs_fs__info_format(int *fs_format,
     case 8:
       (*supports_version)->minor = 10;
       break;
+    case 9:
+      (*supports_version)->minor = 15;
+      break;
 #ifdef SVN_DEBUG
-# if SVN_FS_FS__FORMAT_NUMBER != 8
+# if SVN_FS_FS__FORMAT_NUMBER != 9
 #  error "Need to add a 'case' statement here"
 # endif
 #endif
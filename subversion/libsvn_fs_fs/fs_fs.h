@@ -305,13 +305,18 @@ void
 svn_fs_fs__reset_txn_caches(svn_fs_t *fs);
 
 /* Scan all contents of the repository FS and return statistics in *STATS,
- * allocated in RESULT_POOL.  Report progress through PROGRESS_FUNC with
- * PROGRESS_BATON, if PROGRESS_FUNC is not NULL.
+ * allocated in RESULT_POOL.  Read up to JOBS pack files or shards at a time
+ * if JOBS > 1.  If STATE_DIR is not NULL, keep the results per pack file
+ * in that folder and reuse those of previous runs, so that only pack files
+ * that have been added or changed since need to be read.  Report progress
+ * through PROGRESS_FUNC with PROGRESS_BATON, if PROGRESS_FUNC is not NULL.
  * Use SCRATCH_POOL for temporary allocations.
  */
 svn_error_t *
 svn_fs_fs__get_stats(svn_fs_fs__stats_t **stats,
                      svn_fs_t *fs,
+                     int jobs,
+                     const char *state_dir,
                      svn_fs_progress_notify_func_t progress_func,
                      void *progress_baton,
                      svn_cancel_func_t cancel_func,
@@ -0,0 +1,99 @@
+/* history-index-db.sql -- schema for the FSFS path history index
+ *   This is intended for use with SQLite 3
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+-- STMT_CREATE_SCHEMA
+/* One row for every revision in which a new node got created at PATH,
+   i.e. every revision that shows up in the history of PATH.  This
+   includes the parent directories of all changed paths.  KIND is one of
+   the HISTORY_INDEX_KIND_* values in history_index.c and tells whether
+   the node continues an existing line of history, starts a new one or
+   has been copied from somewhere else. */
+CREATE TABLE node_changes (
+  path TEXT NOT NULL,
+  revision INTEGER NOT NULL,
+  kind INTEGER NOT NULL,
+  PRIMARY KEY (path, revision)
+  ) WITHOUT ROWID;
+
+/* One row for every copy destination PATH in REVISION. */
+CREATE TABLE copies (
+  path TEXT NOT NULL,
+  revision INTEGER NOT NULL,
+  copyfrom_path TEXT NOT NULL,
+  copyfrom_rev INTEGER NOT NULL,
+  PRIMARY KEY (path, revision)
+  ) WITHOUT ROWID;
+
+/* Single row table holding the youngest revision covered by the index.
+   Lookups for any revision up to that one can be answered from the
+   tables above. */
+CREATE TABLE progress (
+  revision INTEGER NOT NULL
+  );
+
+INSERT INTO progress (revision) VALUES (-1);
+
+PRAGMA USER_VERSION = 1;
+
+-- STMT_GET_PROGRESS
+SELECT revision FROM progress
+
+-- STMT_SET_PROGRESS
+UPDATE progress SET revision = ?1
+
+-- STMT_SET_NODE_CHANGE
+INSERT OR REPLACE INTO node_changes (path, revision, kind)
+VALUES (?1, ?2, ?3)
+
+-- STMT_ADD_PARENT_CHANGE
+/* Parent directories get modified implicitly.  An explicit change in the
+   same revision takes precedence. */
+INSERT OR IGNORE INTO node_changes (path, revision, kind)
+VALUES (?1, ?2, ?3)
+
+-- STMT_SET_COPY
+INSERT OR REPLACE INTO copies (path, revision, copyfrom_path, copyfrom_rev)
+VALUES (?1, ?2, ?3, ?4)
+
+-- STMT_GET_NODE_CHANGE
+/* The youngest change of ?1 in or before revision ?2. */
+SELECT revision, kind FROM node_changes
+WHERE path = ?1 AND revision <= ?2
+ORDER BY revision DESC
+LIMIT 1
+
+-- STMT_GET_COPY
+/* The youngest copy to ?1 in or before revision ?2. */
+SELECT revision, copyfrom_path, copyfrom_rev FROM copies
+WHERE path = ?1 AND revision <= ?2
+ORDER BY revision DESC
+LIMIT 1
+
+-- STMT_DEL_NODE_CHANGES_YOUNGER_THAN
+DELETE FROM node_changes
+WHERE revision > ?1
+
+-- STMT_DEL_COPIES_YOUNGER_THAN
+DELETE FROM copies
+WHERE revision > ?1
+
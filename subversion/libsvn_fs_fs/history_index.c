@@ -0,0 +1,621 @@
+/* history_index.c --- the FSFS path history index
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include "svn_pools.h"
+#include "svn_hash.h"
+#include "svn_dirent_uri.h"
+#include "svn_sorts.h"
+
+#include "svn_private_config.h"
+
+#include "fs_fs.h"
+#include "fs.h"
+#include "history_index.h"
+#include "transaction.h"
+#include "util.h"
+
+#include "private/svn_fspath.h"
+#include "private/svn_sqlite.h"
+
+#include "history-index-db.h"
+
+HISTORY_INDEX_DB_SQL_DECLARE_STATEMENTS(statements);
+
+/* Values of the KIND column in the NODE_CHANGES table. */
+
+/* The node at PATH is a modified version of its predecessor at PATH. */
+#define HISTORY_INDEX_KIND_MODIFIED 0
+
+/* The node at PATH has been added or replaced without history. */
+#define HISTORY_INDEX_KIND_ORIGIN   1
+
+/* The node at PATH has been copied; see the COPIES table. */
+#define HISTORY_INDEX_KIND_COPY     2
+
+/* Number of revisions to add to the index within a single SQLite
+   transaction.  This limits the time that concurrent readers and writers
+   may be blocked when indexing a large number of existing revisions. */
+#define HISTORY_INDEX_BATCH_SIZE    1000
+
+/* Maximum number of revisions that a single commit adds to the index.
+   Normally, that is just the new revision.  An index that lags far behind,
+   e.g. because it has just been enabled for an existing repository, gets
+   extended by this many revisions per commit at most, so commits don't
+   stall; 'svnadmin build-history-index' catches up with the rest. */
+#define HISTORY_INDEX_COMMIT_LIMIT  16
+
+
+
+/** Helper functions. **/
+
+/* Set *SDB to the history index database of FS.  If the database does
+   not exist yet, create it if CREATE is set and set *SDB to NULL
+   otherwise.  The database stays open for the lifetime of FS.
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+get_history_index(svn_sqlite__db_t **sdb,
+                  svn_fs_t *fs,
+                  svn_boolean_t create,
+                  apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  const char *db_path;
+  svn_node_kind_t kind;
+  svn_sqlite__db_t *db;
+  svn_error_t *err;
+  int version;
+
+  if (ffd->history_index_db)
+    {
+      *sdb = ffd->history_index_db;
+      return SVN_NO_ERROR;
+    }
+
+  *sdb = NULL;
+  db_path = svn_dirent_join(fs->path, PATH_HISTORY_INDEX_DB, scratch_pool);
+  SVN_ERR(svn_io_check_path(db_path, &kind, scratch_pool));
+  if (kind == svn_node_none)
+    {
+      if (!create)
+        return SVN_NO_ERROR;
+
+#ifndef WIN32
+      /* We want to extend the permissions that apply to the repository
+         as a whole when creating the index and not simply default to
+         umask. */
+      err = svn_io_file_create_empty(db_path, scratch_pool);
+      if (err && !APR_STATUS_IS_EEXIST(err->apr_err))
+        return svn_error_trace(err);
+      else if (err)
+        /* Some other thread/process created the file. */
+        svn_error_clear(err);
+      else
+        SVN_ERR(svn_io_copy_perms(svn_fs_fs__path_current(fs, scratch_pool),
+                                  db_path, scratch_pool));
+#endif
+    }
+
+  err = svn_sqlite__open(&db, db_path, svn_sqlite__mode_rwcreate,
+                         statements, 0, NULL, 0, fs->pool, scratch_pool);
+  if (err)
+    return svn_error_quick_wrapf(err,
+                                 _("Couldn't open history index '%s'"),
+                                 svn_dirent_local_style(db_path,
+                                                        scratch_pool));
+
+  /* Concurrent committers may try to initialize a new database at the
+     same time.  Make sure only one of them creates the schema. */
+  SVN_SQLITE__ERR_CLOSE(svn_sqlite__begin_immediate_transaction(db), db);
+  err = svn_sqlite__read_schema_version(&version, db, scratch_pool);
+  if (!err && version <= 0)
+    err = svn_sqlite__exec_statements(db, STMT_CREATE_SCHEMA);
+  SVN_SQLITE__ERR_CLOSE(svn_sqlite__finish_transaction(db, err), db);
+
+  /* This is used as a flag that the database is available so don't
+     set it earlier. */
+  ffd->history_index_db = db;
+  *sdb = db;
+
+  return SVN_NO_ERROR;
+}
+
+/* Close the history index database of FS, if it is open. */
+static svn_error_t *
+close_history_index(svn_fs_t *fs)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  if (ffd->history_index_db)
+    {
+      SVN_ERR(svn_sqlite__close(ffd->history_index_db));
+      ffd->history_index_db = NULL;
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *REVISION to the youngest revision covered by the index in SDB. */
+static svn_error_t *
+get_progress(svn_revnum_t *revision,
+             svn_sqlite__db_t *sdb)
+{
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_PROGRESS));
+  SVN_ERR(svn_sqlite__step_row(stmt));
+  *revision = svn_sqlite__column_revnum(stmt, 0);
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Record in SDB that the index covers all revisions up to REVISION. */
+static svn_error_t *
+set_progress(svn_sqlite__db_t *sdb,
+             svn_revnum_t revision)
+{
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_SET_PROGRESS));
+  SVN_ERR(svn_sqlite__bind_revnum(stmt, 1, revision));
+
+  return svn_error_trace(svn_sqlite__update(NULL, stmt));
+}
+
+/* Add the changes of revision REVISION in FS to the index in SDB.
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+index_revision(svn_sqlite__db_t *sdb,
+               svn_fs_t *fs,
+               svn_revnum_t revision,
+               apr_pool_t *scratch_pool)
+{
+  apr_hash_t *changes;
+  apr_hash_t *parents = apr_hash_make(scratch_pool);
+  apr_hash_index_t *hi;
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_fs_fs__paths_changed(&changes, fs, revision, scratch_pool));
+  for (hi = apr_hash_first(scratch_pool, changes); hi; hi = apr_hash_next(hi))
+    {
+      const char *path = apr_hash_this_key(hi);
+      svn_fs_path_change2_t *change = apr_hash_this_val(hi);
+      const char *parent;
+      int kind;
+
+      /* The root changes in every revision, so history walks don't need
+         the index for it. */
+      if (strcmp(path, "/") == 0)
+        continue;
+
+      switch (change->change_kind)
+        {
+          case svn_fs_path_change_delete:
+            kind = -1;
+            break;
+
+          case svn_fs_path_change_add:
+          case svn_fs_path_change_replace:
+            if (change->copyfrom_path
+                && SVN_IS_VALID_REVNUM(change->copyfrom_rev))
+              {
+                SVN_ERR(svn_sqlite__get_statement(&stmt, sdb,
+                                                  STMT_SET_COPY));
+                SVN_ERR(svn_sqlite__bindf(stmt, "srsr", path, revision,
+                                          change->copyfrom_path,
+                                          change->copyfrom_rev));
+                SVN_ERR(svn_sqlite__update(NULL, stmt));
+
+                kind = HISTORY_INDEX_KIND_COPY;
+              }
+            else
+              {
+                kind = HISTORY_INDEX_KIND_ORIGIN;
+              }
+            break;
+
+          default:
+            kind = HISTORY_INDEX_KIND_MODIFIED;
+            break;
+        }
+
+      /* A deleted node has no history at PATH in this revision. */
+      if (kind >= 0)
+        {
+          SVN_ERR(svn_sqlite__get_statement(&stmt, sdb,
+                                            STMT_SET_NODE_CHANGE));
+          SVN_ERR(svn_sqlite__bindf(stmt, "srd", path, revision, kind));
+          SVN_ERR(svn_sqlite__update(NULL, stmt));
+        }
+
+      /* All parent directories got modified as well.  Once we hit a
+         parent that we already handled, all of its parents have been
+         handled, too. */
+      for (parent = svn_fspath__dirname(path, scratch_pool);
+           strcmp(parent, "/") != 0 && !svn_hash_gets(parents, parent);
+           parent = svn_fspath__dirname(parent, scratch_pool))
+        {
+          svn_hash_sets(parents, parent, parent);
+
+          SVN_ERR(svn_sqlite__get_statement(&stmt, sdb,
+                                            STMT_ADD_PARENT_CHANGE));
+          SVN_ERR(svn_sqlite__bindf(stmt, "srd", parent, revision,
+                                    HISTORY_INDEX_KIND_MODIFIED));
+          SVN_ERR(svn_sqlite__update(NULL, stmt));
+        }
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Add all revisions in FS up to and including YOUNGEST that are not yet
+   in the index in SDB to it.  Indicate progress and check for cancellation
+   as documented for svn_fs_fs__build_history_index().  Use SCRATCH_POOL
+   for temporary allocations. */
+static svn_error_t *
+update_index(svn_sqlite__db_t *sdb,
+             svn_fs_t *fs,
+             svn_revnum_t youngest,
+             svn_fs_progress_notify_func_t progress_func,
+             void *progress_baton,
+             svn_cancel_func_t cancel_func,
+             void *cancel_baton,
+             apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  svn_revnum_t indexed;
+
+  SVN_ERR(get_progress(&indexed, sdb));
+  while (indexed < youngest)
+    {
+      svn_revnum_t last = MIN(youngest, indexed + HISTORY_INDEX_BATCH_SIZE);
+      svn_revnum_t revision;
+      svn_error_t *err = SVN_NO_ERROR;
+
+      SVN_ERR(svn_sqlite__begin_immediate_transaction(sdb));
+
+      /* Someone else may have indexed some revisions since we looked. */
+      err = get_progress(&indexed, sdb);
+      for (revision = indexed + 1; !err && revision <= last; ++revision)
+        {
+          svn_pool_clear(iterpool);
+
+          if (cancel_func)
+            err = cancel_func(cancel_baton);
+          if (!err)
+            err = index_revision(sdb, fs, revision, iterpool);
+          if (!err && progress_func)
+            progress_func(revision, progress_baton, iterpool);
+        }
+
+      if (!err && indexed < last)
+        {
+          err = set_progress(sdb, last);
+          indexed = last;
+        }
+
+      err = svn_sqlite__finish_transaction(sdb, err);
+      if (svn_error_find_cause(err, SVN_ERR_SQLITE_ROLLBACK_FAILED))
+        {
+          /* Failed rollback means that our db connection is unusable, and
+             the only thing we can do is close it.  The connection will be
+             reopened during the next operation with the index. */
+          return svn_error_trace(
+              svn_error_compose_create(err, close_history_index(fs)));
+        }
+      else if (err)
+        return svn_error_trace(err);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *KIND and *CHANGE_REV to the youngest change of PATH at or before
+   REVISION in the index SDB.  Set *CHANGE_REV to SVN_INVALID_REVNUM if
+   there is none. */
+static svn_error_t *
+get_node_change(svn_revnum_t *change_rev,
+                int *kind,
+                svn_sqlite__db_t *sdb,
+                const char *path,
+                svn_revnum_t revision)
+{
+  svn_sqlite__stmt_t *stmt;
+  svn_boolean_t have_row;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_NODE_CHANGE));
+  SVN_ERR(svn_sqlite__bindf(stmt, "sr", path, revision));
+  SVN_ERR(svn_sqlite__step(&have_row, stmt));
+  if (have_row)
+    {
+      *change_rev = svn_sqlite__column_revnum(stmt, 0);
+      *kind = svn_sqlite__column_int(stmt, 1);
+    }
+  else
+    {
+      *change_rev = SVN_INVALID_REVNUM;
+    }
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Set *COPY_REV to the revision of the youngest copy to PATH at or before
+   REVISION in the index SDB and *COPYFROM_PATH, *COPYFROM_REV to its
+   source.  Set *COPY_REV to SVN_INVALID_REVNUM if there is none.
+   Allocate *COPYFROM_PATH in RESULT_POOL. */
+static svn_error_t *
+get_copy(svn_revnum_t *copy_rev,
+         const char **copyfrom_path,
+         svn_revnum_t *copyfrom_rev,
+         svn_sqlite__db_t *sdb,
+         const char *path,
+         svn_revnum_t revision,
+         apr_pool_t *result_pool)
+{
+  svn_sqlite__stmt_t *stmt;
+  svn_boolean_t have_row;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_COPY));
+  SVN_ERR(svn_sqlite__bindf(stmt, "sr", path, revision));
+  SVN_ERR(svn_sqlite__step(&have_row, stmt));
+  if (have_row)
+    {
+      *copy_rev = svn_sqlite__column_revnum(stmt, 0);
+      *copyfrom_path = svn_sqlite__column_text(stmt, 1, result_pool);
+      *copyfrom_rev = svn_sqlite__column_revnum(stmt, 2);
+    }
+  else
+    {
+      *copy_rev = SVN_INVALID_REVNUM;
+    }
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Find the youngest copy at or before REVISION in the index SDB that
+   targeted one of the parent directories of PATH.  Set *COPY_REV to its
+   revision and *SRC_PATH, *SRC_REV to the location of PATH within the
+   copy source.  If there are multiple copies in the same revision, the
+   one closest to PATH wins.  Set *COPY_REV to SVN_INVALID_REVNUM if there
+   are no such copies.  Allocate *SRC_PATH in RESULT_POOL and use
+   SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+get_parent_copy(svn_revnum_t *copy_rev,
+                const char **src_path,
+                svn_revnum_t *src_rev,
+                svn_sqlite__db_t *sdb,
+                const char *path,
+                svn_revnum_t revision,
+                apr_pool_t *result_pool,
+                apr_pool_t *scratch_pool)
+{
+  const char *parent;
+
+  *copy_rev = SVN_INVALID_REVNUM;
+  for (parent = svn_fspath__dirname(path, scratch_pool);
+       strcmp(parent, "/") != 0;
+       parent = svn_fspath__dirname(parent, scratch_pool))
+    {
+      svn_revnum_t rev, copyfrom_rev;
+      const char *copyfrom_path;
+
+      SVN_ERR(get_copy(&rev, &copyfrom_path, &copyfrom_rev, sdb, parent,
+                       revision, scratch_pool));
+      if (SVN_IS_VALID_REVNUM(rev) && rev > *copy_rev)
+        {
+          *copy_rev = rev;
+          *src_rev = copyfrom_rev;
+          *src_path = svn_fspath__join(copyfrom_path,
+                                       svn_fspath__skip_ancestor(parent,
+                                                                 path),
+                                       result_pool);
+        }
+    }
+
+  return SVN_NO_ERROR;
+}
+
+
+/** Library-private API's. **/
+
+svn_error_t *
+svn_fs_fs__build_history_index(svn_fs_t *fs,
+                               svn_fs_progress_notify_func_t progress_func,
+                               void *progress_baton,
+                               svn_cancel_func_t cancel_func,
+                               void *cancel_baton,
+                               apr_pool_t *scratch_pool)
+{
+  svn_sqlite__db_t *sdb;
+  svn_revnum_t youngest;
+
+  SVN_ERR(svn_fs_fs__youngest_rev(&youngest, fs, scratch_pool));
+  SVN_ERR(get_history_index(&sdb, fs, TRUE, scratch_pool));
+
+  return svn_error_trace(update_index(sdb, fs, youngest,
+                                      progress_func, progress_baton,
+                                      cancel_func, cancel_baton,
+                                      scratch_pool));
+}
+
+svn_error_t *
+svn_fs_fs__history_index_update(svn_fs_t *fs,
+                                svn_revnum_t youngest,
+                                apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  svn_sqlite__db_t *sdb;
+  svn_revnum_t indexed;
+
+  if (!ffd->history_index_enabled)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(get_history_index(&sdb, fs, TRUE, scratch_pool));
+
+  /* Don't let the commit pay for catching up with a large backlog. */
+  SVN_ERR(get_progress(&indexed, sdb));
+  if (youngest - indexed > HISTORY_INDEX_COMMIT_LIMIT)
+    youngest = indexed + HISTORY_INDEX_COMMIT_LIMIT;
+
+  return svn_error_trace(update_index(sdb, fs, youngest, NULL, NULL,
+                                      NULL, NULL, scratch_pool));
+}
+
+svn_error_t *
+svn_fs_fs__history_index_truncate(svn_fs_t *fs,
+                                  svn_revnum_t youngest,
+                                  apr_pool_t *scratch_pool)
+{
+  svn_sqlite__db_t *sdb;
+  svn_sqlite__stmt_t *stmt;
+  svn_revnum_t indexed;
+  svn_error_t *err;
+
+  SVN_ERR(get_history_index(&sdb, fs, FALSE, scratch_pool));
+  if (!sdb)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(svn_sqlite__begin_immediate_transaction(sdb));
+
+  err = get_progress(&indexed, sdb);
+  if (!err && indexed > youngest)
+    {
+      err = svn_sqlite__get_statement(&stmt, sdb,
+                                      STMT_DEL_NODE_CHANGES_YOUNGER_THAN);
+      if (!err)
+        err = svn_sqlite__bind_revnum(stmt, 1, youngest);
+      if (!err)
+        err = svn_sqlite__update(NULL, stmt);
+
+      if (!err)
+        err = svn_sqlite__get_statement(&stmt, sdb,
+                                        STMT_DEL_COPIES_YOUNGER_THAN);
+      if (!err)
+        err = svn_sqlite__bind_revnum(stmt, 1, youngest);
+      if (!err)
+        err = svn_sqlite__update(NULL, stmt);
+
+      if (!err)
+        err = set_progress(sdb, youngest);
+    }
+
+  return svn_error_trace(svn_sqlite__finish_transaction(sdb, err));
+}
+
+svn_error_t *
+svn_fs_fs__history_index_prev(svn_boolean_t *handled,
+                              const char **prev_path,
+                              svn_revnum_t *prev_rev,
+                              svn_fs_t *fs,
+                              const char *path,
+                              svn_revnum_t revision,
+                              svn_boolean_t reported,
+                              svn_boolean_t cross_copies,
+                              apr_pool_t *result_pool,
+                              apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  svn_sqlite__db_t *sdb;
+  svn_revnum_t indexed, change_rev, copy_rev, src_rev;
+  const char *src_path;
+  int kind;
+
+  *handled = FALSE;
+  if (!ffd->history_index_enabled)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(get_history_index(&sdb, fs, FALSE, scratch_pool));
+  if (!sdb)
+    return SVN_NO_ERROR;
+
+  /* The index may lag behind HEAD.  Revisions that it covers never
+     change, though. */
+  SVN_ERR(get_progress(&indexed, sdb));
+  if (revision > indexed)
+    return SVN_NO_ERROR;
+
+  if (reported)
+    {
+      /* We already reported PATH@REVISION.  Find out how the node got
+         there and continue with the previous location of its history. */
+      SVN_ERR(get_node_change(&change_rev, &kind, sdb, path, revision));
+      if (change_rev == revision && kind == HISTORY_INDEX_KIND_ORIGIN)
+        {
+          /* That is where this line of history started. */
+          *handled = TRUE;
+          *prev_path = NULL;
+          return SVN_NO_ERROR;
+        }
+
+      if (change_rev == revision && kind == HISTORY_INDEX_KIND_COPY)
+        {
+          SVN_ERR(get_copy(&copy_rev, &src_path, &src_rev, sdb, path,
+                           revision, scratch_pool));
+          if (copy_rev != revision)
+            return SVN_NO_ERROR;
+        }
+      else
+        {
+          SVN_ERR(get_parent_copy(&copy_rev, &src_path, &src_rev, sdb,
+                                  path, revision, scratch_pool,
+                                  scratch_pool));
+        }
+
+      if (copy_rev == revision)
+        {
+          /* Continue at the copy source, if we may. */
+          if (!cross_copies)
+            {
+              *handled = TRUE;
+              *prev_path = NULL;
+              return SVN_NO_ERROR;
+            }
+
+          path = src_path;
+          revision = src_rev;
+        }
+      else
+        {
+          /* Plain modification.  Continue with whatever came before. */
+          revision--;
+        }
+    }
+
+  /* The youngest interesting location at or before PATH@REVISION is
+     either the youngest node change at PATH or a copy of one of its
+     parents, whichever is younger. */
+  SVN_ERR(get_node_change(&change_rev, &kind, sdb, path, revision));
+  SVN_ERR(get_parent_copy(&copy_rev, &src_path, &src_rev, sdb, path,
+                          revision, scratch_pool, scratch_pool));
+
+  /* PATH@REVISION exists, so we should always find something.  If we
+     don't, let the caller find out what happened. */
+  if (!SVN_IS_VALID_REVNUM(change_rev) && !SVN_IS_VALID_REVNUM(copy_rev))
+    return SVN_NO_ERROR;
+
+  *handled = TRUE;
+  *prev_path = apr_pstrdup(result_pool, path);
+  *prev_rev = MAX(change_rev, copy_rev);
+
+  return SVN_NO_ERROR;
+}
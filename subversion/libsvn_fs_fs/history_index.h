@@ -0,0 +1,109 @@
+/* history_index.h : interface to the FSFS path history index
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#ifndef SVN_LIBSVN_FS_FS_HISTORY_INDEX_H
+#define SVN_LIBSVN_FS_FS_HISTORY_INDEX_H
+
+#include "svn_error.h"
+#include "svn_fs.h"
+
+#include "fs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* The path history index records, for every path in FS, the revisions
+ * in which a new node got created at that path as well as the sources
+ * of all copies.  It allows history walks to skip the node revision
+ * chain.  The index always covers a contiguous range of revisions,
+ * starting at r0.  Everything here is a no-op unless the index has been
+ * enabled in the FS configuration. */
+
+/* Create the history index of FS, if necessary, and add all revisions
+ * up to HEAD that it does not cover yet.  This works regardless of
+ * whether the index has been enabled, so it may be built before enabling
+ * it.
+ *
+ * Indicate progress via the optional PROGRESS_FUNC callback using
+ * PROGRESS_BATON.  The optional CANCEL_FUNC will periodically be called
+ * with CANCEL_BATON to allow cancellation.  Use SCRATCH_POOL for temporary
+ * allocations. */
+svn_error_t *
+svn_fs_fs__build_history_index(svn_fs_t *fs,
+                               svn_fs_progress_notify_func_t progress_func,
+                               void *progress_baton,
+                               svn_cancel_func_t cancel_func,
+                               void *cancel_baton,
+                               apr_pool_t *scratch_pool);
+
+/* Extend the history index of FS towards YOUNGEST, creating the index if
+ * necessary.  This is called after each commit.  Revisions already indexed
+ * are skipped.  If the index lags far behind YOUNGEST, only add a limited
+ * number of revisions, leaving the rest to later calls or to
+ * svn_fs_fs__build_history_index().
+ *
+ * Use SCRATCH_POOL for temporary allocations. */
+svn_error_t *
+svn_fs_fs__history_index_update(svn_fs_t *fs,
+                                svn_revnum_t youngest,
+                                apr_pool_t *scratch_pool);
+
+/* Remove all entries for revisions younger than YOUNGEST from the history
+ * index of FS, if it exists.  This is used after copying the index from
+ * a repository that may contain more revisions than FS.
+ *
+ * Use SCRATCH_POOL for temporary allocations. */
+svn_error_t *
+svn_fs_fs__history_index_truncate(svn_fs_t *fs,
+                                  svn_revnum_t youngest,
+                                  apr_pool_t *scratch_pool);
+
+/* Find the previous interesting location in the history of PATH@REVISION
+ * in FS, as svn_fs_history_prev2() would.  REPORTED tells whether
+ * PATH@REVISION itself has already been reported to the caller; if it has
+ * not, it may be the result.  CROSS_COPIES is as for svn_fs_history_prev2().
+ *
+ * If the history index can answer the query, set *HANDLED to TRUE and
+ * return the location in *PREV_PATH and *PREV_REV.  Set *PREV_PATH to
+ * NULL if there is no further history.  Otherwise, set *HANDLED to FALSE
+ * and leave the other outputs untouched.
+ *
+ * Allocate *PREV_PATH in RESULT_POOL and use SCRATCH_POOL for temporary
+ * allocations. */
+svn_error_t *
+svn_fs_fs__history_index_prev(svn_boolean_t *handled,
+                              const char **prev_path,
+                              svn_revnum_t *prev_rev,
+                              svn_fs_t *fs,
+                              const char *path,
+                              svn_revnum_t revision,
+                              svn_boolean_t reported,
+                              svn_boolean_t cross_copies,
+                              apr_pool_t *result_pool,
+                              apr_pool_t *scratch_pool);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SVN_LIBSVN_FS_FS_HISTORY_INDEX_H */
@@ -29,6 +29,8 @@
 #include "recovery.h"
 #include "revprops.h"
 #include "rep-cache.h"
+#include "history_index.h"
+#include "mergeinfo_index.h"
 
 #include "../libsvn_fs/fs-loader.h"
 
@@ -959,6 +961,49 @@ hotcopy_body(void *baton, apr_pool_t *pool)
                                         PATH_LOCKS_DIR, TRUE,
                                         cancel_func, cancel_baton, pool));
 
+  /* Replace the indexed lock store in the same way.  If the source got
+     migrated to it while we were copying the tree above, the database
+     takes precedence over the stale digest files. */
+  dst_subdir = svn_dirent_join(dst_fs->path, PATH_LOCKS_DB, pool);
+  SVN_ERR(svn_io_remove_file2(dst_subdir, TRUE, pool));
+  src_subdir = svn_dirent_join(src_fs->path, PATH_LOCKS_DB, pool);
+  SVN_ERR(svn_io_check_path(src_subdir, &kind, pool));
+  if (kind == svn_node_file)
+    {
+      SVN_ERR(svn_sqlite__hotcopy(src_subdir, dst_subdir, pool));
+
+      /* The source might have r/o flags set on it - which would be
+         carried over to the copy. */
+      SVN_ERR(svn_io_set_file_read_write(dst_subdir, FALSE, pool));
+    }
+
+  /* Copy the path history index and then remove entries for revisions
+     that did not make it into the destination. */
+  dst_subdir = svn_dirent_join(dst_fs->path, PATH_HISTORY_INDEX_DB, pool);
+  SVN_ERR(svn_io_remove_file2(dst_subdir, TRUE, pool));
+  src_subdir = svn_dirent_join(src_fs->path, PATH_HISTORY_INDEX_DB, pool);
+  SVN_ERR(svn_io_check_path(src_subdir, &kind, pool));
+  if (kind == svn_node_file)
+    {
+      SVN_ERR(svn_sqlite__hotcopy(src_subdir, dst_subdir, pool));
+      SVN_ERR(svn_io_set_file_read_write(dst_subdir, FALSE, pool));
+      SVN_ERR(svn_fs_fs__history_index_truncate(dst_fs, src_youngest,
+                                                pool));
+    }
+
+  /* Same for the mergeinfo index. */
+  dst_subdir = svn_dirent_join(dst_fs->path, PATH_MERGEINFO_INDEX_DB, pool);
+  SVN_ERR(svn_io_remove_file2(dst_subdir, TRUE, pool));
+  src_subdir = svn_dirent_join(src_fs->path, PATH_MERGEINFO_INDEX_DB, pool);
+  SVN_ERR(svn_io_check_path(src_subdir, &kind, pool));
+  if (kind == svn_node_file)
+    {
+      SVN_ERR(svn_sqlite__hotcopy(src_subdir, dst_subdir, pool));
+      SVN_ERR(svn_io_set_file_read_write(dst_subdir, FALSE, pool));
+      SVN_ERR(svn_fs_fs__mergeinfo_index_truncate(dst_fs, src_youngest,
+                                                  pool));
+    }
+
   /* Now copy the node-origins cache tree. */
   src_subdir = svn_dirent_join(src_fs->path, PATH_NODE_ORIGINS_DIR, pool);
   SVN_ERR(svn_io_check_path(src_subdir, &kind, pool));
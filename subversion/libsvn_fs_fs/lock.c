@@ -42,8 +42,13 @@
 #include "private/svn_fs_util.h"
 #include "private/svn_fspath.h"
 #include "private/svn_sorts_private.h"
+#include "private/svn_sqlite.h"
 #include "svn_private_config.h"
 
+#include "locks-db.h"
+
+LOCKS_DB_SQL_DECLARE_STATEMENTS(statements);
+
 /* Names of hash keys used to store a lock for writing to disk. */
 #define PATH_KEY "path"
 #define TOKEN_KEY "token"
@@ -160,7 +165,12 @@ digest_path_from_path(const char **digest_path,
    empty, if the versioned path in FS represented by DIGEST_PATH has
    no children) and LOCK (which may be NULL if that versioned path is
    lock itself locked).  Set the permissions of DIGEST_PATH to those of
-   PERMS_REFERENCE.  Use POOL for all allocations.
+   PERMS_REFERENCE.
+
+   If KNOWN_DIRS is not NULL, it is the set of digest subdirectories that
+   are already known to exist.  Those are not checked again and a newly
+   checked subdirectory gets added to the set.  Use POOL for all
+   allocations.
  */
 static svn_error_t *
 write_digest_file(apr_hash_t *children,
@@ -168,6 +178,7 @@ write_digest_file(apr_hash_t *children,
                   const char *fs_path,
                   const char *digest_path,
                   const char *perms_reference,
+                  apr_hash_t *known_dirs,
                   apr_pool_t *pool)
 {
   svn_error_t *err = SVN_NO_ERROR;
@@ -175,11 +186,21 @@ write_digest_file(apr_hash_t *children,
   apr_hash_index_t *hi;
   apr_hash_t *hash = apr_hash_make(pool);
   const char *tmp_path;
+  const char *digest_dir = svn_dirent_dirname(digest_path, pool);
 
-  SVN_ERR(svn_fs_fs__ensure_dir_exists(svn_dirent_join(fs_path, PATH_LOCKS_DIR,
-                                                       pool), fs_path, pool));
-  SVN_ERR(svn_fs_fs__ensure_dir_exists(svn_dirent_dirname(digest_path, pool),
-                                       fs_path, pool));
+  if (!known_dirs || !svn_hash_gets(known_dirs, digest_dir))
+    {
+      SVN_ERR(svn_fs_fs__ensure_dir_exists(svn_dirent_join(fs_path,
+                                                           PATH_LOCKS_DIR,
+                                                           pool),
+                                           fs_path, pool));
+      SVN_ERR(svn_fs_fs__ensure_dir_exists(digest_dir, fs_path, pool));
+
+      if (known_dirs)
+        svn_hash_sets(known_dirs,
+                      apr_pstrdup(apr_hash_pool_get(known_dirs), digest_dir),
+                      (void *)1);
+    }
 
   if (lock)
     {
@@ -217,8 +238,7 @@ write_digest_file(apr_hash_t *children,
                  children_list->data, children_list->len, pool);
     }
 
-  SVN_ERR(svn_stream_open_unique(&stream, &tmp_path,
-                                 svn_dirent_dirname(digest_path, pool),
+  SVN_ERR(svn_stream_open_unique(&stream, &tmp_path, digest_dir,
                                  svn_io_file_del_none, pool, pool));
   if ((err = svn_hash_write2(hash, stream, SVN_HASH_TERMINATOR, pool)))
     {
@@ -331,6 +351,278 @@ read_digest_file(apr_hash_t **children_p,
 }
 
 
+
+/*** Indexed lock store. ***/
+
+/* If the lock database exists, it replaces the digest file tree as a
+   whole.  It is only ever created by migrate_to_lock_db(), which moves
+   it into place fully populated, and only in repositories whose format
+   keeps older servers from opening them and missing the locks. */
+
+/* Set *SDB to the lock database of FS or to NULL if FS still keeps its
+   locks in the digest file tree.  The database gets opened the first
+   time it is found on disk and then stays open for the lifetime of FS.
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+get_lock_db(svn_sqlite__db_t **sdb,
+            svn_fs_t *fs,
+            apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  if (!ffd->lock_db && ffd->format >= SVN_FS_FS__MIN_LOCK_DB_FORMAT)
+    {
+      const char *db_path = svn_dirent_join(fs->path, PATH_LOCKS_DB,
+                                            scratch_pool);
+      svn_node_kind_t kind;
+
+      SVN_ERR(svn_io_check_path(db_path, &kind, scratch_pool));
+      if (kind == svn_node_file)
+        {
+          svn_sqlite__db_t *db;
+          svn_error_t *err = svn_sqlite__open(&db, db_path,
+                                              svn_sqlite__mode_readwrite,
+                                              statements, 0, NULL, 0,
+                                              fs->pool, scratch_pool);
+          if (err)
+            return svn_error_quick_wrapf(err,
+                                         _("Couldn't open lock database '%s'"),
+                                         svn_dirent_local_style(db_path,
+                                                                scratch_pool));
+
+          ffd->lock_db = db;
+        }
+    }
+
+  *sdb = ffd->lock_db;
+  return SVN_NO_ERROR;
+}
+
+/* Return the lock described by the current row of STMT, which must be
+   one of the lock queries from locks-db.sql.  Allocate the result in
+   RESULT_POOL. */
+static svn_lock_t *
+lock_from_row(svn_sqlite__stmt_t *stmt,
+              apr_pool_t *result_pool)
+{
+  svn_lock_t *lock = svn_lock_create(result_pool);
+
+  lock->path = svn_sqlite__column_text(stmt, 0, result_pool);
+  lock->token = svn_sqlite__column_text(stmt, 1, result_pool);
+  lock->owner = svn_sqlite__column_text(stmt, 2, result_pool);
+  lock->comment = svn_sqlite__column_text(stmt, 3, result_pool);
+  lock->is_dav_comment = svn_sqlite__column_boolean(stmt, 4);
+  lock->creation_date = svn_sqlite__column_int64(stmt, 5);
+  lock->expiration_date = svn_sqlite__column_int64(stmt, 6);
+
+  return lock;
+}
+
+/* Set *LOCK_P to the lock on PATH in SDB or to NULL if there is none.
+   Allocate the result in RESULT_POOL. */
+static svn_error_t *
+db_get_lock(svn_lock_t **lock_p,
+            svn_sqlite__db_t *sdb,
+            const char *path,
+            apr_pool_t *result_pool)
+{
+  svn_sqlite__stmt_t *stmt;
+  svn_boolean_t have_row;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_LOCK));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 1, path));
+  SVN_ERR(svn_sqlite__step(&have_row, stmt));
+
+  *lock_p = have_row ? lock_from_row(stmt, result_pool) : NULL;
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Set *LOCKS to an array of svn_lock_t * holding, in path order, the
+   locks in SDB on PATH and on all paths below it.  Allocate the result
+   in RESULT_POOL and use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+db_get_locks(apr_array_header_t **locks,
+             svn_sqlite__db_t *sdb,
+             const char *path,
+             apr_pool_t *result_pool,
+             apr_pool_t *scratch_pool)
+{
+  svn_sqlite__stmt_t *stmt;
+  svn_boolean_t have_row;
+  char *lower, *upper;
+
+  /* All paths below PATH sort after PATH + "/" and before PATH + "0". */
+  if (svn_fspath__is_root(path, strlen(path)))
+    lower = apr_pstrdup(scratch_pool, path);
+  else
+    lower = apr_pstrcat(scratch_pool, path, "/", SVN_VA_NULL);
+
+  upper = apr_pstrdup(scratch_pool, lower);
+  upper[strlen(upper) - 1] = '/' + 1;
+
+  *locks = apr_array_make(result_pool, 16, sizeof(svn_lock_t *));
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_LOCKS_RECURSIVE));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 1, path));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 2, lower));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 3, upper));
+  SVN_ERR(svn_sqlite__step(&have_row, stmt));
+
+  while (have_row)
+    {
+      APR_ARRAY_PUSH(*locks, svn_lock_t *) = lock_from_row(stmt, result_pool);
+      SVN_ERR(svn_sqlite__step(&have_row, stmt));
+    }
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Store LOCK in SDB, replacing any lock on the same path. */
+static svn_error_t *
+db_set_lock(svn_sqlite__db_t *sdb,
+            const svn_lock_t *lock)
+{
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_SET_LOCK));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 1, lock->path));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 2, lock->token));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 3, lock->owner));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 4, lock->comment));
+  SVN_ERR(svn_sqlite__bind_int(stmt, 5, lock->is_dav_comment ? 1 : 0));
+  SVN_ERR(svn_sqlite__bind_int64(stmt, 6, lock->creation_date));
+  if (lock->expiration_date)
+    SVN_ERR(svn_sqlite__bind_int64(stmt, 7, lock->expiration_date));
+
+  return svn_error_trace(svn_sqlite__step_done(stmt));
+}
+
+/* Remove the lock on PATH from SDB, if there is one. */
+static svn_error_t *
+db_delete_lock(svn_sqlite__db_t *sdb,
+               const char *path)
+{
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_DELETE_LOCK));
+  SVN_ERR(svn_sqlite__bind_text(stmt, 1, path));
+
+  return svn_error_trace(svn_sqlite__step_done(stmt));
+}
+
+/* Copy all locks of FS from the digest file tree into SDB.
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+import_digest_locks(svn_sqlite__db_t *sdb,
+                    svn_fs_t *fs,
+                    apr_pool_t *scratch_pool)
+{
+  const char *digest_path;
+  apr_hash_t *children;
+  svn_lock_t *lock;
+  apr_hash_index_t *hi;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+
+  /* The root's digest file lists the digests of all locked paths. */
+  SVN_ERR(digest_path_from_path(&digest_path, fs->path, "/", scratch_pool));
+  SVN_ERR(read_digest_file(&children, &lock, fs->path, digest_path,
+                           scratch_pool));
+  if (lock)
+    SVN_ERR(db_set_lock(sdb, lock));
+
+  for (hi = apr_hash_first(scratch_pool, children); hi; hi = apr_hash_next(hi))
+    {
+      const char *digest = apr_hash_this_key(hi);
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(read_digest_file(NULL, &lock, fs->path,
+                               digest_path_from_digest(fs->path, digest,
+                                                       iterpool),
+                               iterpool));
+
+      /* Children without a lock are left-overs of interrupted updates. */
+      if (lock)
+        SVN_ERR(db_set_lock(sdb, lock));
+    }
+
+  svn_pool_destroy(iterpool);
+  return SVN_NO_ERROR;
+}
+
+/* Create the lock database of FS, fill it with all locks from the digest
+   file tree and remove that tree.  The database is built under a temporary
+   name and only moved into place once it is complete, so concurrent readers
+   will either see the old tree or the full database.
+
+   The caller must hold the FS write lock.  Use SCRATCH_POOL for temporary
+   allocations. */
+static svn_error_t *
+migrate_to_lock_db(svn_fs_t *fs,
+                   apr_pool_t *scratch_pool)
+{
+  const char *db_path = svn_dirent_join(fs->path, PATH_LOCKS_DB,
+                                        scratch_pool);
+  const char *tmp_path = apr_pstrcat(scratch_pool, db_path, ".tmp",
+                                     SVN_VA_NULL);
+  svn_sqlite__db_t *sdb;
+
+  /* Get rid of the remains of an interrupted migration. */
+  SVN_ERR(svn_io_remove_file2(tmp_path, TRUE, scratch_pool));
+
+#ifndef WIN32
+  /* Extend the permissions that apply to the repository as a whole
+     to the new database instead of simply defaulting to umask. */
+  SVN_ERR(svn_io_file_create_empty(tmp_path, scratch_pool));
+  SVN_ERR(svn_io_copy_perms(svn_fs_fs__path_current(fs, scratch_pool),
+                            tmp_path, scratch_pool));
+#endif
+
+  SVN_ERR(svn_sqlite__open(&sdb, tmp_path, svn_sqlite__mode_rwcreate,
+                           statements, 0, NULL, 0,
+                           scratch_pool, scratch_pool));
+  SVN_SQLITE__ERR_CLOSE(svn_sqlite__exec_statements(sdb, STMT_CREATE_SCHEMA),
+                        sdb);
+  SVN_SQLITE__ERR_CLOSE(svn_sqlite__begin_transaction(sdb), sdb);
+  SVN_SQLITE__ERR_CLOSE(svn_sqlite__finish_transaction(
+                          sdb, import_digest_locks(sdb, fs, scratch_pool)),
+                        sdb);
+  SVN_ERR(svn_sqlite__close(sdb));
+
+  SVN_ERR(svn_io_file_rename2(tmp_path, db_path, TRUE, scratch_pool));
+
+  /* The digest files are stale from now on. */
+  return svn_error_trace(svn_io_remove_dir2(
+                           svn_dirent_join(fs->path, PATH_LOCKS_DIR,
+                                           scratch_pool),
+                           TRUE, NULL, NULL, scratch_pool));
+}
+
+/* Like get_lock_db() but if the configuration of FS asks for it and its
+   format supports it, migrate the digest file tree into a new lock
+   database first.
+
+   The caller must hold the FS write lock. */
+static svn_error_t *
+get_lock_db_for_writing(svn_sqlite__db_t **sdb,
+                        svn_fs_t *fs,
+                        apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  SVN_ERR(get_lock_db(sdb, fs, scratch_pool));
+  if (   !*sdb
+      && ffd->lock_db_allowed
+      && ffd->format >= SVN_FS_FS__MIN_LOCK_DB_FORMAT)
+    {
+      SVN_ERR(migrate_to_lock_db(fs, scratch_pool));
+      SVN_ERR(get_lock_db(sdb, fs, scratch_pool));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+
 
 /*** Lock helper functions (path here are still FS paths, not on-disk
      schema-supporting paths) ***/
@@ -339,11 +631,13 @@ read_digest_file(apr_hash_t **children_p,
 /* Write LOCK in FS to the actual OS filesystem.
 
    Use PERMS_REFERENCE for the permissions of any digest files.
+   KNOWN_DIRS is passed through to write_digest_file().
  */
 static svn_error_t *
 set_lock(const char *fs_path,
          svn_lock_t *lock,
          const char *perms_reference,
+         apr_hash_t *known_dirs,
          apr_pool_t *pool)
 {
   const char *digest_path;
@@ -356,7 +650,7 @@ set_lock(const char *fs_path,
   SVN_ERR(read_digest_file(&children, NULL, fs_path, digest_path, pool));
 
   SVN_ERR(write_digest_file(children, lock, fs_path, digest_path,
-                            perms_reference, pool));
+                            perms_reference, known_dirs, pool));
 
   return SVN_NO_ERROR;
 }
@@ -375,11 +669,18 @@ delete_lock(const char *fs_path,
   return SVN_NO_ERROR;
 }
 
+/* Add the DIGESTS of locked descendants of INDEX_PATH to the list of
+   children in the digest file of INDEX_PATH.  The file is rewritten at
+   most once, no matter how many DIGESTS there are.
+
+   Use PERMS_REFERENCE for the permissions of the digest file.
+   KNOWN_DIRS is passed through to write_digest_file(). */
 static svn_error_t *
 add_to_digest(const char *fs_path,
-              apr_array_header_t *paths,
+              apr_array_header_t *digests,
               const char *index_path,
               const char *perms_reference,
+              apr_hash_t *known_dirs,
               apr_pool_t *pool)
 {
   const char *index_digest_path;
@@ -394,52 +695,49 @@ add_to_digest(const char *fs_path,
 
   original_count = apr_hash_count(children);
 
-  for (i = 0; i < paths->nelts; ++i)
-    {
-      const char *path = APR_ARRAY_IDX(paths, i, const char *);
-      const char *digest_path, *digest_file;
-
-      SVN_ERR(digest_path_from_path(&digest_path, fs_path, path, pool));
-      digest_file = svn_dirent_basename(digest_path, NULL);
-      svn_hash_sets(children, digest_file, (void *)1);
-    }
+  for (i = 0; i < digests->nelts; ++i)
+    svn_hash_sets(children, APR_ARRAY_IDX(digests, i, const char *),
+                  (void *)1);
 
   if (apr_hash_count(children) != original_count)
     SVN_ERR(write_digest_file(children, lock, fs_path, index_digest_path,
-                              perms_reference, pool));
+                              perms_reference, known_dirs, pool));
 
   return SVN_NO_ERROR;
 }
 
+/* Like add_to_digest() but remove the DIGESTS from the children of
+   INDEX_PATH.  Remove the digest file if it is left without children
+   and lock. */
 static svn_error_t *
 delete_from_digest(const char *fs_path,
-                   apr_array_header_t *paths,
+                   apr_array_header_t *digests,
                    const char *index_path,
                    const char *perms_reference,
+                   apr_hash_t *known_dirs,
                    apr_pool_t *pool)
 {
   const char *index_digest_path;
   apr_hash_t *children;
   svn_lock_t *lock;
   int i;
+  unsigned int original_count;
 
   SVN_ERR(digest_path_from_path(&index_digest_path, fs_path, index_path, pool));
 
   SVN_ERR(read_digest_file(&children, &lock, fs_path, index_digest_path, pool));
 
-  for (i = 0; i < paths->nelts; ++i)
-    {
-      const char *path = APR_ARRAY_IDX(paths, i, const char *);
-      const char *digest_path, *digest_file;
+  original_count = apr_hash_count(children);
 
-      SVN_ERR(digest_path_from_path(&digest_path, fs_path, path, pool));
-      digest_file = svn_dirent_basename(digest_path, NULL);
-      svn_hash_sets(children, digest_file, NULL);
-    }
+  for (i = 0; i < digests->nelts; ++i)
+    svn_hash_sets(children, APR_ARRAY_IDX(digests, i, const char *), NULL);
+
+  if (apr_hash_count(children) == original_count)
+    return SVN_NO_ERROR;
 
   if (apr_hash_count(children) || lock)
     SVN_ERR(write_digest_file(children, lock, fs_path, index_digest_path,
-                              perms_reference, pool));
+                              perms_reference, known_dirs, pool));
   else
     SVN_ERR(svn_io_remove_file2(index_digest_path, TRUE, pool));
 
@@ -472,15 +770,24 @@ get_lock(svn_lock_t **lock_p,
          apr_pool_t *pool)
 {
   svn_lock_t *lock = NULL;
-  const char *digest_path;
-  svn_node_kind_t kind;
-
-  SVN_ERR(digest_path_from_path(&digest_path, fs->path, path, pool));
-  SVN_ERR(svn_io_check_path(digest_path, &kind, pool));
+  svn_sqlite__db_t *sdb;
 
   *lock_p = NULL;
-  if (kind != svn_node_none)
-    SVN_ERR(read_digest_file(NULL, &lock, fs->path, digest_path, pool));
+  SVN_ERR(get_lock_db(&sdb, fs, pool));
+  if (sdb)
+    {
+      SVN_ERR(db_get_lock(&lock, sdb, path, pool));
+    }
+  else
+    {
+      const char *digest_path;
+      svn_node_kind_t kind;
+
+      SVN_ERR(digest_path_from_path(&digest_path, fs->path, path, pool));
+      SVN_ERR(svn_io_check_path(digest_path, &kind, pool));
+      if (kind != svn_node_none)
+        SVN_ERR(read_digest_file(NULL, &lock, fs->path, digest_path, pool));
+    }
 
   if (! lock)
     return must_exist ? SVN_FS__ERR_NO_SUCH_LOCK(fs, path) : SVN_NO_ERROR;
@@ -539,7 +846,7 @@ get_lock_helper(svn_fs_t *fs,
    has the FS write lock. */
 static svn_error_t *
 walk_locks(svn_fs_t *fs,
-           const char *digest_path,
+           const char *path,
            svn_fs_get_locks_callback_t get_locks_func,
            void *get_locks_baton,
            svn_boolean_t have_write_lock,
@@ -549,8 +856,43 @@ walk_locks(svn_fs_t *fs,
   apr_hash_t *children;
   apr_pool_t *subpool;
   svn_lock_t *lock;
+  svn_sqlite__db_t *sdb;
+  const char *digest_path;
+
+  SVN_ERR(get_lock_db(&sdb, fs, pool));
+  if (sdb)
+    {
+      apr_array_header_t *locks;
+      int i;
+
+      /* Fetch the whole range first such that the callbacks and lock
+         expiry don't run while the query is still active. */
+      SVN_ERR(db_get_locks(&locks, sdb, path, pool, pool));
+
+      subpool = svn_pool_create(pool);
+      for (i = 0; i < locks->nelts; ++i)
+        {
+          lock = APR_ARRAY_IDX(locks, i, svn_lock_t *);
+          svn_pool_clear(subpool);
+
+          if (lock_expired(lock))
+            {
+              /* Only remove the lock if we have the write lock.
+                 Read operations shouldn't change the filesystem. */
+              if (have_write_lock)
+                SVN_ERR(unlock_single(fs, lock, subpool));
+            }
+          else
+            {
+              SVN_ERR(get_locks_func(get_locks_baton, lock, subpool));
+            }
+        }
+      svn_pool_destroy(subpool);
+      return SVN_NO_ERROR;
+    }
 
   /* First, send up any locks in the current digest file. */
+  SVN_ERR(digest_path_from_path(&digest_path, fs->path, path, pool));
   SVN_ERR(read_digest_file(&children, &lock, fs->path, digest_path, pool));
 
   if (lock && lock_expired(lock))
@@ -652,9 +994,7 @@ svn_fs_fs__allow_locked_operation(const char *path,
   if (recurse)
     {
       /* Discover all locks at or below the path. */
-      const char *digest_path;
-      SVN_ERR(digest_path_from_path(&digest_path, fs->path, path, pool));
-      SVN_ERR(walk_locks(fs, digest_path, get_locks_callback,
+      SVN_ERR(walk_locks(fs, path, get_locks_callback,
                          fs, have_write_lock, pool));
     }
   else
@@ -670,15 +1010,22 @@ svn_fs_fs__allow_locked_operation(const char *path,
 
 /* Helper function called from the lock and unlock code.
    UPDATES is a map from "const char *" parent paths to "apr_array_header_t *"
-   arrays of child paths.  For all of the parent paths of PATH this function
-   adds PATH to the corresponding array of child paths. */
-static void
+   arrays of child digests.  For all of the parent paths of PATH this function
+   adds the digest of PATH to the corresponding array of child digests.
+
+   This groups all updates by parent, such that every parent digest file
+   gets rewritten only once per batch, and calculates the digest of PATH
+   only once instead of once per parent. */
+static svn_error_t *
 schedule_index_update(apr_hash_t *updates,
                       const char *path,
                       apr_pool_t *scratch_pool)
 {
   apr_pool_t *hashpool = apr_hash_pool_get(updates);
   const char *parent_path = path;
+  const char *digest;
+
+  SVN_ERR(make_digest(&digest, path, hashpool));
 
   while (! svn_fspath__is_root(parent_path, strlen(parent_path)))
     {
@@ -693,8 +1040,10 @@ schedule_index_update(apr_hash_t *updates,
           svn_hash_sets(updates, apr_pstrdup(hashpool, parent_path), children);
         }
 
-      APR_ARRAY_PUSH(children, const char *) = path;
+      APR_ARRAY_PUSH(children, const char *) = digest;
     }
+
+  return SVN_NO_ERROR;
 }
 
 /* The effective arguments for lock_body() below. */
@@ -823,6 +1172,68 @@ struct lock_info_t {
   svn_error_t *fs_err;
 };
 
+/* Create and store the locks for all entries in LB->infos that passed
+   check_lock().  Write them to SDB if that is not NULL, otherwise to the
+   digest file tree using REV_0_PATH as the permissions reference and
+   KNOWN_DIRS as described for write_digest_file().
+
+   When writing to SDB, return the first error immediately; otherwise
+   record per-path failures in the respective INFO->FS_ERR.
+
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+write_locks(struct lock_baton *lb,
+            svn_sqlite__db_t *sdb,
+            const char *rev_0_path,
+            apr_hash_t *known_dirs,
+            apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  for (i = 0; i < lb->infos->nelts; ++i)
+    {
+      struct lock_info_t *info = &APR_ARRAY_IDX(lb->infos, i,
+                                                struct lock_info_t);
+      svn_sort__item_t *item = &APR_ARRAY_IDX(lb->targets, i, svn_sort__item_t);
+      svn_fs_lock_target_t *target = item->value;
+
+      svn_pool_clear(iterpool);
+
+      if (! info->fs_err)
+        {
+          info->lock = svn_lock_create(lb->result_pool);
+          if (target->token)
+            info->lock->token = apr_pstrdup(lb->result_pool, target->token);
+          else
+            SVN_ERR(svn_fs_fs__generate_lock_token(&(info->lock->token), lb->fs,
+                                                   lb->result_pool));
+
+          /* The INFO->PATH is already allocated in LB->RESULT_POOL as a result
+             of svn_fspath__canonicalize() (see svn_fs_fs__lock()). */
+          info->lock->path = info->path;
+          info->lock->owner = apr_pstrdup(lb->result_pool,
+                                          lb->fs->access_ctx->username);
+          info->lock->comment = apr_pstrdup(lb->result_pool, lb->comment);
+          info->lock->is_dav_comment = lb->is_dav_comment;
+          info->lock->creation_date = apr_time_now();
+          info->lock->expiration_date = lb->expiration_date;
+
+          /* A database failure aborts the whole batch so that the
+             caller's transaction rolls back instead of committing a
+             partial set of locks. */
+          if (sdb)
+            SVN_ERR(db_set_lock(sdb, info->lock));
+          else
+            info->fs_err = set_lock(lb->fs->path, info->lock, rev_0_path,
+                                    known_dirs, iterpool);
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+  return SVN_NO_ERROR;
+}
+
 /* The body of svn_fs_fs__lock(), which see.
 
    BATON is a 'struct lock_baton *' holding the effective arguments.
@@ -843,8 +1254,10 @@ lock_body(void *baton, apr_pool_t *pool)
   const char *rev_0_path;
   int i;
   apr_hash_t *index_updates = apr_hash_make(pool);
+  apr_hash_t *known_dirs = apr_hash_make(pool);
   apr_hash_index_t *hi;
   apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_sqlite__db_t *sdb;
 
   /* Until we implement directory locks someday, we only allow locks
      on files. */
@@ -852,6 +1265,7 @@ lock_body(void *baton, apr_pool_t *pool)
      library dependencies, which are not portable. */
   SVN_ERR(lb->fs->vtable->youngest_rev(&youngest, lb->fs, pool));
   SVN_ERR(lb->fs->vtable->revision_root(&root, lb->fs, youngest, pool));
+  SVN_ERR(get_lock_db_for_writing(&sdb, lb->fs, pool));
 
   for (i = 0; i < lb->targets->nelts; ++i)
     {
@@ -869,13 +1283,31 @@ lock_body(void *baton, apr_pool_t *pool)
                          youngest, iterpool));
 
       /* If no error occurred while pre-checking, schedule the index updates for
-         this path. */
-      if (!info.fs_err)
-        schedule_index_update(index_updates, info.path, iterpool);
+         this path.  The lock database needs no such indexes. */
+      if (!info.fs_err && !sdb)
+        SVN_ERR(schedule_index_update(index_updates, info.path, iterpool));
 
       APR_ARRAY_PUSH(lb->infos, struct lock_info_t) = info;
     }
 
+  /* Write all locks to the database in a single transaction. */
+  if (sdb)
+    {
+      svn_error_t *err;
+
+      svn_pool_destroy(iterpool);
+      SVN_ERR(svn_sqlite__begin_transaction(sdb));
+      err = write_locks(lb, sdb, NULL, NULL, pool);
+      err = svn_sqlite__finish_transaction(sdb, err);
+
+      /* Nothing has been written if the transaction got rolled back. */
+      if (err)
+        for (i = 0; i < lb->infos->nelts; ++i)
+          APR_ARRAY_IDX(lb->infos, i, struct lock_info_t).lock = NULL;
+
+      return svn_error_trace(err);
+    }
+
   rev_0_path = svn_fs_fs__path_rev_absolute(lb->fs, 0, pool);
 
   /* We apply the scheduled index updates before writing the actual locks.
@@ -894,41 +1326,10 @@ lock_body(void *baton, apr_pool_t *pool)
 
       svn_pool_clear(iterpool);
       SVN_ERR(add_to_digest(lb->fs->path, children, path, rev_0_path,
-                            iterpool));
+                            known_dirs, iterpool));
     }
 
-  for (i = 0; i < lb->infos->nelts; ++i)
-    {
-      struct lock_info_t *info = &APR_ARRAY_IDX(lb->infos, i,
-                                                struct lock_info_t);
-      svn_sort__item_t *item = &APR_ARRAY_IDX(lb->targets, i, svn_sort__item_t);
-      svn_fs_lock_target_t *target = item->value;
-
-      svn_pool_clear(iterpool);
-
-      if (! info->fs_err)
-        {
-          info->lock = svn_lock_create(lb->result_pool);
-          if (target->token)
-            info->lock->token = apr_pstrdup(lb->result_pool, target->token);
-          else
-            SVN_ERR(svn_fs_fs__generate_lock_token(&(info->lock->token), lb->fs,
-                                                   lb->result_pool));
-
-          /* The INFO->PATH is already allocated in LB->RESULT_POOL as a result
-             of svn_fspath__canonicalize() (see svn_fs_fs__lock()). */
-          info->lock->path = info->path;
-          info->lock->owner = apr_pstrdup(lb->result_pool,
-                                          lb->fs->access_ctx->username);
-          info->lock->comment = apr_pstrdup(lb->result_pool, lb->comment);
-          info->lock->is_dav_comment = lb->is_dav_comment;
-          info->lock->creation_date = apr_time_now();
-          info->lock->expiration_date = lb->expiration_date;
-
-          info->fs_err = set_lock(lb->fs->path, info->lock, rev_0_path,
-                                  iterpool);
-        }
-    }
+  SVN_ERR(write_locks(lb, NULL, rev_0_path, known_dirs, pool));
 
   svn_pool_destroy(iterpool);
   return SVN_NO_ERROR;
@@ -975,6 +1376,38 @@ struct unlock_info_t {
   svn_boolean_t done;
 };
 
+/* Remove the locks for all entries in UB->infos that passed
+   check_unlock() from SDB if that is not NULL, otherwise from the
+   digest file tree.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+delete_locks(struct unlock_baton *ub,
+             svn_sqlite__db_t *sdb,
+             apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  for (i = 0; i < ub->infos->nelts; ++i)
+    {
+      struct unlock_info_t *info = &APR_ARRAY_IDX(ub->infos, i,
+                                                  struct unlock_info_t);
+
+      svn_pool_clear(iterpool);
+
+      if (! info->fs_err)
+        {
+          if (sdb)
+            SVN_ERR(db_delete_lock(sdb, info->path));
+          else
+            SVN_ERR(delete_lock(ub->fs->path, info->path, iterpool));
+          info->done = TRUE;
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+  return SVN_NO_ERROR;
+}
+
 /* The body of svn_fs_fs__unlock(), which see.
 
    BATON is a 'struct unlock_baton *' holding the effective arguments.
@@ -995,11 +1428,14 @@ unlock_body(void *baton, apr_pool_t *pool)
   const char *rev_0_path;
   int i;
   apr_hash_t *indices_updates = apr_hash_make(pool);
+  apr_hash_t *known_dirs = apr_hash_make(pool);
   apr_hash_index_t *hi;
   apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_sqlite__db_t *sdb;
 
   SVN_ERR(ub->fs->vtable->youngest_rev(&youngest, ub->fs, pool));
   SVN_ERR(ub->fs->vtable->revision_root(&root, ub->fs, youngest, pool));
+  SVN_ERR(get_lock_db_for_writing(&sdb, ub->fs, pool));
 
   for (i = 0; i < ub->targets->nelts; ++i)
     {
@@ -1019,32 +1455,37 @@ unlock_body(void *baton, apr_pool_t *pool)
                              iterpool));
 
       /* If no error occurred while pre-checking, schedule the index updates for
-         this path. */
-      if (!info.fs_err)
-        schedule_index_update(indices_updates, info.path, iterpool);
+         this path.  The lock database needs no such indexes. */
+      if (!info.fs_err && !sdb)
+        SVN_ERR(schedule_index_update(indices_updates, info.path, iterpool));
 
       APR_ARRAY_PUSH(ub->infos, struct unlock_info_t) = info;
     }
 
-  rev_0_path = svn_fs_fs__path_rev_absolute(ub->fs, 0, pool);
-
-  /* Unlike the lock_body(), we need to delete locks *before* we start to
-     update indices. */
-
-  for (i = 0; i < ub->infos->nelts; ++i)
+  /* Remove all locks from the database in a single transaction. */
+  if (sdb)
     {
-      struct unlock_info_t *info = &APR_ARRAY_IDX(ub->infos, i,
-                                                  struct unlock_info_t);
+      svn_error_t *err;
 
-      svn_pool_clear(iterpool);
+      svn_pool_destroy(iterpool);
+      SVN_ERR(svn_sqlite__begin_transaction(sdb));
+      err = delete_locks(ub, sdb, pool);
+      err = svn_sqlite__finish_transaction(sdb, err);
 
-      if (! info->fs_err)
-        {
-          SVN_ERR(delete_lock(ub->fs->path, info->path, iterpool));
-          info->done = TRUE;
-        }
+      /* Nothing has been removed if the transaction got rolled back. */
+      if (err)
+        for (i = 0; i < ub->infos->nelts; ++i)
+          APR_ARRAY_IDX(ub->infos, i, struct unlock_info_t).done = FALSE;
+
+      return svn_error_trace(err);
     }
 
+  rev_0_path = svn_fs_fs__path_rev_absolute(ub->fs, 0, pool);
+
+  /* Unlike the lock_body(), we need to delete locks *before* we start to
+     update indices. */
+  SVN_ERR(delete_locks(ub, NULL, pool));
+
   for (hi = apr_hash_first(pool, indices_updates); hi; hi = apr_hash_next(hi))
     {
       const char *path = apr_hash_this_key(hi);
@@ -1052,7 +1493,7 @@ unlock_body(void *baton, apr_pool_t *pool)
 
       svn_pool_clear(iterpool);
       SVN_ERR(delete_from_digest(ub->fs->path, children, path, rev_0_path,
-                                 iterpool));
+                                 known_dirs, iterpool));
     }
 
   svn_pool_destroy(iterpool);
@@ -1348,7 +1789,6 @@ svn_fs_fs__get_locks(svn_fs_t *fs,
                      void *get_locks_baton,
                      apr_pool_t *pool)
 {
-  const char *digest_path;
   get_locks_filter_baton_t glfb;
 
   SVN_ERR(svn_fs__check_fs(fs, TRUE));
@@ -1359,9 +1799,8 @@ svn_fs_fs__get_locks(svn_fs_t *fs,
   glfb.get_locks_func = get_locks_func;
   glfb.get_locks_baton = get_locks_baton;
 
-  /* Get the top digest path in our tree of interest, and then walk it. */
-  SVN_ERR(digest_path_from_path(&digest_path, fs->path, path, pool));
-  SVN_ERR(walk_locks(fs, digest_path, get_locks_filter_func, &glfb,
+  /* Walk all locks in our tree of interest. */
+  SVN_ERR(walk_locks(fs, path, get_locks_filter_func, &glfb,
                      FALSE, pool));
   return SVN_NO_ERROR;
 }
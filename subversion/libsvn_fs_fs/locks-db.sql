@@ -0,0 +1,67 @@
+/* locks-db.sql -- schema for the indexed FSFS lock store
+ *   This is intended for use with SQLite 3
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+-- STMT_CREATE_SCHEMA
+/* A table mapping absolute FS paths to the lock on that path.  The dates
+   are apr_time_t values; a NULL expiration date means "never expires".
+
+   Since PATH is the primary key of a WITHOUT ROWID table, the rows are
+   stored in path order and all locks within a sub-tree form a single,
+   contiguous key range. */
+CREATE TABLE locks (
+  path TEXT NOT NULL PRIMARY KEY,
+  token TEXT NOT NULL,
+  owner TEXT NOT NULL,
+  comment TEXT,
+  is_dav_comment INTEGER NOT NULL,
+  creation_date INTEGER NOT NULL,
+  expiration_date INTEGER
+  ) WITHOUT ROWID;
+
+PRAGMA USER_VERSION = 1;
+
+-- STMT_GET_LOCK
+SELECT path, token, owner, comment, is_dav_comment, creation_date,
+       expiration_date
+FROM locks
+WHERE path = ?1
+
+-- STMT_GET_LOCKS_RECURSIVE
+/* Return the lock on ?1 and all locks on paths that start with ?2 and
+   sort before ?3.  The caller passes ?1 with a trailing '/' in ?2 and
+   with that '/' replaced by '0', the next character in sort order, in ?3.
+   This keeps the query a simple range scan over the primary key. */
+SELECT path, token, owner, comment, is_dav_comment, creation_date,
+       expiration_date
+FROM locks
+WHERE path = ?1 OR (path > ?2 AND path < ?3)
+ORDER BY path
+
+-- STMT_SET_LOCK
+INSERT OR REPLACE INTO locks (path, token, owner, comment, is_dav_comment,
+                              creation_date, expiration_date)
+VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7)
+
+-- STMT_DELETE_LOCK
+DELETE FROM locks
+WHERE path = ?1
@@ -0,0 +1,80 @@
+/* mergeinfo-index-db.sql -- schema for the FSFS mergeinfo index
+ *   This is intended for use with SQLite 3
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+-- STMT_CREATE_SCHEMA
+/* One row for every revision in which the svn:mergeinfo property of PATH
+   changed, including the revisions in which PATH got copied or deleted.
+   MERGEINFO is the unparsed property value from REVISION on; NULL means
+   that PATH has no mergeinfo (or does not exist) from REVISION on.
+
+   Since (PATH, REVISION) is the primary key of a WITHOUT ROWID table,
+   the rows for all paths within a sub-tree form a single, contiguous
+   key range. */
+CREATE TABLE mergeinfo (
+  path TEXT NOT NULL,
+  revision INTEGER NOT NULL,
+  mergeinfo TEXT,
+  PRIMARY KEY (path, revision)
+  ) WITHOUT ROWID;
+
+/* Single row table holding the youngest revision covered by the index. */
+CREATE TABLE progress (
+  revision INTEGER NOT NULL
+  );
+
+INSERT INTO progress (revision) VALUES (-1);
+
+PRAGMA USER_VERSION = 1;
+
+-- STMT_GET_PROGRESS
+SELECT revision FROM progress
+
+-- STMT_SET_PROGRESS
+UPDATE progress SET revision = ?1
+
+-- STMT_SET_MERGEINFO
+INSERT OR REPLACE INTO mergeinfo (path, revision, mergeinfo)
+VALUES (?1, ?2, ?3)
+
+-- STMT_GET_MERGEINFO
+/* The mergeinfo of ?1 as of revision ?2. */
+SELECT mergeinfo FROM mergeinfo
+WHERE path = ?1 AND revision <= ?2
+ORDER BY revision DESC
+LIMIT 1
+
+-- STMT_GET_SUBTREE_MERGEINFO
+/* Return the mergeinfo as of revision ?4 of ?1 and all paths that sort
+   between ?2 and ?3.  The caller passes ?1 with a trailing '/' in ?2
+   and with that '/' replaced by '0', the next character in sort order,
+   in ?3.  Paths without mergeinfo in revision ?4 are skipped. */
+SELECT path, mergeinfo FROM mergeinfo AS m
+WHERE (path = ?1 OR (path > ?2 AND path < ?3))
+  AND revision = (SELECT MAX(revision) FROM mergeinfo
+                  WHERE path = m.path AND revision <= ?4)
+  AND mergeinfo IS NOT NULL
+ORDER BY path
+
+-- STMT_DEL_MERGEINFO_YOUNGER_THAN
+DELETE FROM mergeinfo
+WHERE revision > ?1
@@ -0,0 +1,598 @@
+/* mergeinfo_index.c --- the FSFS mergeinfo index
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include "svn_pools.h"
+#include "svn_dirent_uri.h"
+#include "svn_mergeinfo.h"
+#include "svn_props.h"
+#include "svn_sorts.h"
+
+#include "svn_private_config.h"
+
+#include "fs_fs.h"
+#include "fs.h"
+#include "mergeinfo_index.h"
+#include "transaction.h"
+#include "tree.h"
+#include "util.h"
+#include "../libsvn_fs/fs-loader.h"
+
+#include "private/svn_fspath.h"
+#include "private/svn_sorts_private.h"
+#include "private/svn_sqlite.h"
+
+#include "mergeinfo-index-db.h"
+
+MERGEINFO_INDEX_DB_SQL_DECLARE_STATEMENTS(statements);
+
+/* Number of revisions to add to the index within a single SQLite
+   transaction.  This limits the time that concurrent readers and writers
+   may be blocked when indexing a large number of existing revisions. */
+#define MERGEINFO_INDEX_BATCH_SIZE 1000
+
+/* Maximum number of revisions that a single commit adds to the index.
+   Normally, that is just the new revision.  An index that lags far behind
+   gets extended by this many revisions per commit at most, so commits
+   don't stall; 'svnadmin build-mergeinfo-index' catches up with the rest.
+   If you change this number, update mergeinfo_index() in
+   fs-fs-private-test.c. */
+#define MERGEINFO_INDEX_COMMIT_LIMIT 16
+
+/* A path and its unparsed mergeinfo, as found in the index. */
+typedef struct path_mergeinfo_t
+{
+  const char *path;
+  const char *mergeinfo;
+} path_mergeinfo_t;
+
+
+
+/** Helper functions. **/
+
+/* Set *SDB to the mergeinfo index database of FS.  If the database does
+   not exist yet, create it if CREATE is set and set *SDB to NULL
+   otherwise.  The database stays open for the lifetime of FS.
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+get_mergeinfo_index(svn_sqlite__db_t **sdb,
+                    svn_fs_t *fs,
+                    svn_boolean_t create,
+                    apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  const char *db_path;
+  svn_node_kind_t kind;
+  svn_sqlite__db_t *db;
+  svn_error_t *err;
+  int version;
+
+  if (ffd->mergeinfo_index_db)
+    {
+      *sdb = ffd->mergeinfo_index_db;
+      return SVN_NO_ERROR;
+    }
+
+  *sdb = NULL;
+  db_path = svn_dirent_join(fs->path, PATH_MERGEINFO_INDEX_DB, scratch_pool);
+  SVN_ERR(svn_io_check_path(db_path, &kind, scratch_pool));
+  if (kind == svn_node_none)
+    {
+      if (!create)
+        return SVN_NO_ERROR;
+
+#ifndef WIN32
+      /* We want to extend the permissions that apply to the repository
+         as a whole when creating the index and not simply default to
+         umask. */
+      err = svn_io_file_create_empty(db_path, scratch_pool);
+      if (err && !APR_STATUS_IS_EEXIST(err->apr_err))
+        return svn_error_trace(err);
+      else if (err)
+        /* Some other thread/process created the file. */
+        svn_error_clear(err);
+      else
+        SVN_ERR(svn_io_copy_perms(svn_fs_fs__path_current(fs, scratch_pool),
+                                  db_path, scratch_pool));
+#endif
+    }
+
+  err = svn_sqlite__open(&db, db_path, svn_sqlite__mode_rwcreate,
+                         statements, 0, NULL, 0, fs->pool, scratch_pool);
+  if (err)
+    return svn_error_quick_wrapf(err,
+                                 _("Couldn't open mergeinfo index '%s'"),
+                                 svn_dirent_local_style(db_path,
+                                                        scratch_pool));
+
+  /* Only one of several concurrent processes shall create the schema. */
+  SVN_SQLITE__ERR_CLOSE(svn_sqlite__begin_immediate_transaction(db), db);
+  err = svn_sqlite__read_schema_version(&version, db, scratch_pool);
+  if (!err && version <= 0)
+    err = svn_sqlite__exec_statements(db, STMT_CREATE_SCHEMA);
+  SVN_SQLITE__ERR_CLOSE(svn_sqlite__finish_transaction(db, err), db);
+
+  ffd->mergeinfo_index_db = db;
+  *sdb = db;
+
+  return SVN_NO_ERROR;
+}
+
+/* Close the mergeinfo index database of FS, if it is open. */
+static svn_error_t *
+close_mergeinfo_index(svn_fs_t *fs)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  if (ffd->mergeinfo_index_db)
+    {
+      SVN_ERR(svn_sqlite__close(ffd->mergeinfo_index_db));
+      ffd->mergeinfo_index_db = NULL;
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *REVISION to the youngest revision covered by the index in SDB. */
+static svn_error_t *
+get_progress(svn_revnum_t *revision,
+             svn_sqlite__db_t *sdb)
+{
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_PROGRESS));
+  SVN_ERR(svn_sqlite__step_row(stmt));
+  *revision = svn_sqlite__column_revnum(stmt, 0);
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Record in SDB that the index covers all revisions up to REVISION. */
+static svn_error_t *
+set_progress(svn_sqlite__db_t *sdb,
+             svn_revnum_t revision)
+{
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_SET_PROGRESS));
+  SVN_ERR(svn_sqlite__bind_revnum(stmt, 1, revision));
+
+  return svn_error_trace(svn_sqlite__update(NULL, stmt));
+}
+
+/* Record in SDB that PATH has the unparsed MERGEINFO from REVISION on.
+   MERGEINFO may be NULL. */
+static svn_error_t *
+set_mergeinfo(svn_sqlite__db_t *sdb,
+              const char *path,
+              svn_revnum_t revision,
+              const char *mergeinfo)
+{
+  svn_sqlite__stmt_t *stmt;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_SET_MERGEINFO));
+  SVN_ERR(svn_sqlite__bindf(stmt, "srs", path, revision, mergeinfo));
+
+  return svn_error_trace(svn_sqlite__update(NULL, stmt));
+}
+
+/* Set *HAS_MERGEINFO to TRUE if PATH has mergeinfo in REVISION according
+   to the index in SDB. */
+static svn_error_t *
+has_mergeinfo(svn_boolean_t *has_mergeinfo,
+              svn_sqlite__db_t *sdb,
+              const char *path,
+              svn_revnum_t revision)
+{
+  svn_sqlite__stmt_t *stmt;
+  svn_boolean_t have_row;
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_MERGEINFO));
+  SVN_ERR(svn_sqlite__bindf(stmt, "sr", path, revision));
+  SVN_ERR(svn_sqlite__step(&have_row, stmt));
+  *has_mergeinfo = have_row && !svn_sqlite__column_is_null(stmt, 0);
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Return in *RESULT the mergeinfo of PATH and all paths below it as of
+   REVISION according to the index in SDB, as an array of
+   path_mergeinfo_t *, sorted by path.  Paths without mergeinfo are not
+   included.  Allocate the result in RESULT_POOL. */
+static svn_error_t *
+get_subtree_mergeinfo(apr_array_header_t **result,
+                      svn_sqlite__db_t *sdb,
+                      const char *path,
+                      svn_revnum_t revision,
+                      apr_pool_t *result_pool)
+{
+  svn_sqlite__stmt_t *stmt;
+  svn_boolean_t have_row;
+  const char *lower, *upper;
+
+  /* All paths below PATH sort between PATH + "/" and PATH + "0".  The root
+     is the exception because its name already ends with a '/'. */
+  if (strcmp(path, "/") == 0)
+    {
+      lower = "/";
+      upper = "0";
+    }
+  else
+    {
+      lower = apr_pstrcat(result_pool, path, "/", SVN_VA_NULL);
+      upper = apr_pstrcat(result_pool, path, "0", SVN_VA_NULL);
+    }
+
+  *result = apr_array_make(result_pool, 4, sizeof(path_mergeinfo_t *));
+
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb, STMT_GET_SUBTREE_MERGEINFO));
+  SVN_ERR(svn_sqlite__bindf(stmt, "sssr", path, lower, upper, revision));
+  SVN_ERR(svn_sqlite__step(&have_row, stmt));
+  while (have_row)
+    {
+      path_mergeinfo_t *entry = apr_palloc(result_pool, sizeof(*entry));
+      entry->path = svn_sqlite__column_text(stmt, 0, result_pool);
+      entry->mergeinfo = svn_sqlite__column_text(stmt, 1, result_pool);
+      APR_ARRAY_PUSH(*result, path_mergeinfo_t *) = entry;
+
+      SVN_ERR(svn_sqlite__step(&have_row, stmt));
+    }
+
+  return svn_error_trace(svn_sqlite__reset(stmt));
+}
+
+/* Record in SDB that PATH and all paths below it got removed in
+   REVISION.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+remove_subtree(svn_sqlite__db_t *sdb,
+               const char *path,
+               svn_revnum_t revision,
+               apr_pool_t *scratch_pool)
+{
+  apr_array_header_t *entries;
+  int i;
+
+  /* Fetch everything first.  We should not modify the table while
+     iterating over a query result. */
+  SVN_ERR(get_subtree_mergeinfo(&entries, sdb, path, revision,
+                                scratch_pool));
+  for (i = 0; i < entries->nelts; ++i)
+    {
+      path_mergeinfo_t *entry = APR_ARRAY_IDX(entries, i, path_mergeinfo_t *);
+      SVN_ERR(set_mergeinfo(sdb, entry->path, revision, NULL));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Record in SDB that PATH in REVISION got copied from COPYFROM_PATH in
+   COPYFROM_REV, i.e. that it inherits all mergeinfo within that sub-tree.
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+copy_subtree(svn_sqlite__db_t *sdb,
+             const char *path,
+             svn_revnum_t revision,
+             const char *copyfrom_path,
+             svn_revnum_t copyfrom_rev,
+             apr_pool_t *scratch_pool)
+{
+  apr_array_header_t *entries;
+  int i;
+
+  SVN_ERR(get_subtree_mergeinfo(&entries, sdb, copyfrom_path, copyfrom_rev,
+                                scratch_pool));
+  for (i = 0; i < entries->nelts; ++i)
+    {
+      path_mergeinfo_t *entry = APR_ARRAY_IDX(entries, i, path_mergeinfo_t *);
+      const char *relpath = svn_fspath__skip_ancestor(copyfrom_path,
+                                                      entry->path);
+
+      SVN_ERR(set_mergeinfo(sdb,
+                            svn_fspath__join(path, relpath, scratch_pool),
+                            revision, entry->mergeinfo));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Add the mergeinfo changes of revision REVISION in FS to the index in
+   SDB.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+index_revision(svn_sqlite__db_t *sdb,
+               svn_fs_t *fs,
+               svn_revnum_t revision,
+               apr_pool_t *scratch_pool)
+{
+  apr_hash_t *changes;
+  apr_array_header_t *sorted;
+  svn_fs_root_t *root;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  SVN_ERR(svn_fs_fs__paths_changed(&changes, fs, revision, scratch_pool));
+  SVN_ERR(svn_fs_fs__revision_root(&root, fs, revision, scratch_pool));
+
+  /* Process parents before their children, so that copies and deletions
+     within copied sub-trees get applied in the right order. */
+  sorted = svn_sort__hash(changes, svn_sort_compare_items_as_paths,
+                          scratch_pool);
+  for (i = 0; i < sorted->nelts; ++i)
+    {
+      svn_sort__item_t *item = &APR_ARRAY_IDX(sorted, i, svn_sort__item_t);
+      const char *path = item->key;
+      svn_fs_path_change2_t *change = item->value;
+      svn_string_t *value;
+
+      svn_pool_clear(iterpool);
+
+      /* Anything previously at PATH is gone. */
+      if (   change->change_kind == svn_fs_path_change_delete
+          || change->change_kind == svn_fs_path_change_replace)
+        SVN_ERR(remove_subtree(sdb, path, revision, iterpool));
+
+      if (change->change_kind == svn_fs_path_change_delete)
+        continue;
+
+      /* Copies bring the mergeinfo of their whole source sub-tree. */
+      if (   change->copyfrom_known
+          && change->copyfrom_path
+          && SVN_IS_VALID_REVNUM(change->copyfrom_rev))
+        SVN_ERR(copy_subtree(sdb, path, revision, change->copyfrom_path,
+                             change->copyfrom_rev, iterpool));
+
+      /* Explicit modifications. */
+      if (!change->prop_mod || change->mergeinfo_mod == svn_tristate_false)
+        continue;
+
+      SVN_ERR(root->vtable->node_prop(&value, root, path,
+                                      SVN_PROP_MERGEINFO, iterpool));
+      if (value)
+        {
+          SVN_ERR(set_mergeinfo(sdb, path, revision, value->data));
+        }
+      else
+        {
+          /* Only record removals, not all the other property changes. */
+          svn_boolean_t had_mergeinfo;
+
+          SVN_ERR(has_mergeinfo(&had_mergeinfo, sdb, path, revision));
+          if (had_mergeinfo)
+            SVN_ERR(set_mergeinfo(sdb, path, revision, NULL));
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Add all revisions in FS up to and including YOUNGEST that are not yet
+   in the index in SDB to it.  Indicate progress and check for cancellation
+   as documented for svn_fs_fs__build_mergeinfo_index().  Use SCRATCH_POOL
+   for temporary allocations. */
+static svn_error_t *
+update_index(svn_sqlite__db_t *sdb,
+             svn_fs_t *fs,
+             svn_revnum_t youngest,
+             svn_fs_progress_notify_func_t progress_func,
+             void *progress_baton,
+             svn_cancel_func_t cancel_func,
+             void *cancel_baton,
+             apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  svn_revnum_t indexed;
+
+  SVN_ERR(get_progress(&indexed, sdb));
+  while (indexed < youngest)
+    {
+      svn_revnum_t last = MIN(youngest,
+                              indexed + MERGEINFO_INDEX_BATCH_SIZE);
+      svn_revnum_t revision;
+      svn_error_t *err = SVN_NO_ERROR;
+
+      SVN_ERR(svn_sqlite__begin_immediate_transaction(sdb));
+
+      /* Someone else may have indexed some revisions since we looked. */
+      err = get_progress(&indexed, sdb);
+      for (revision = indexed + 1; !err && revision <= last; ++revision)
+        {
+          svn_pool_clear(iterpool);
+
+          if (cancel_func)
+            err = cancel_func(cancel_baton);
+          if (!err)
+            err = index_revision(sdb, fs, revision, iterpool);
+          if (!err && progress_func)
+            progress_func(revision, progress_baton, iterpool);
+        }
+
+      if (!err && indexed < last)
+        {
+          err = set_progress(sdb, last);
+          indexed = last;
+        }
+
+      err = svn_sqlite__finish_transaction(sdb, err);
+      if (svn_error_find_cause(err, SVN_ERR_SQLITE_ROLLBACK_FAILED))
+        {
+          /* Failed rollback means that our db connection is unusable, and
+             the only thing we can do is close it.  The connection will be
+             reopened during the next operation with the index. */
+          return svn_error_trace(
+              svn_error_compose_create(err, close_mergeinfo_index(fs)));
+        }
+      else if (err)
+        return svn_error_trace(err);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+
+/** Library-private API's. **/
+
+svn_error_t *
+svn_fs_fs__build_mergeinfo_index(svn_fs_t *fs,
+                                 svn_fs_progress_notify_func_t progress_func,
+                                 void *progress_baton,
+                                 svn_cancel_func_t cancel_func,
+                                 void *cancel_baton,
+                                 apr_pool_t *scratch_pool)
+{
+  svn_sqlite__db_t *sdb;
+  svn_revnum_t youngest;
+
+  if (! svn_fs_fs__fs_supports_mergeinfo(fs))
+    return svn_error_createf(SVN_ERR_UNSUPPORTED_FEATURE, NULL,
+                             _("FSFS format (%d) too old for mergeinfo; "
+                               "please upgrade the filesystem."),
+                             ((fs_fs_data_t *)fs->fsap_data)->format);
+
+  SVN_ERR(svn_fs_fs__youngest_rev(&youngest, fs, scratch_pool));
+  SVN_ERR(get_mergeinfo_index(&sdb, fs, TRUE, scratch_pool));
+
+  return svn_error_trace(update_index(sdb, fs, youngest,
+                                      progress_func, progress_baton,
+                                      cancel_func, cancel_baton,
+                                      scratch_pool));
+}
+
+svn_error_t *
+svn_fs_fs__mergeinfo_index_update(svn_fs_t *fs,
+                                  svn_revnum_t youngest,
+                                  apr_pool_t *scratch_pool)
+{
+  svn_sqlite__db_t *sdb;
+  svn_revnum_t indexed;
+
+  SVN_ERR(get_mergeinfo_index(&sdb, fs, FALSE, scratch_pool));
+  if (!sdb)
+    return SVN_NO_ERROR;
+
+  /* Don't let the commit pay for catching up with a large backlog. */
+  SVN_ERR(get_progress(&indexed, sdb));
+  if (youngest - indexed > MERGEINFO_INDEX_COMMIT_LIMIT)
+    youngest = indexed + MERGEINFO_INDEX_COMMIT_LIMIT;
+
+  return svn_error_trace(update_index(sdb, fs, youngest, NULL, NULL,
+                                      NULL, NULL, scratch_pool));
+}
+
+svn_error_t *
+svn_fs_fs__mergeinfo_index_truncate(svn_fs_t *fs,
+                                    svn_revnum_t youngest,
+                                    apr_pool_t *scratch_pool)
+{
+  svn_sqlite__db_t *sdb;
+  svn_sqlite__stmt_t *stmt;
+  svn_revnum_t indexed;
+  svn_error_t *err;
+
+  SVN_ERR(get_mergeinfo_index(&sdb, fs, FALSE, scratch_pool));
+  if (!sdb)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(svn_sqlite__begin_immediate_transaction(sdb));
+
+  err = get_progress(&indexed, sdb);
+  if (!err && indexed > youngest)
+    {
+      err = svn_sqlite__get_statement(&stmt, sdb,
+                                      STMT_DEL_MERGEINFO_YOUNGER_THAN);
+      if (!err)
+        err = svn_sqlite__bind_revnum(stmt, 1, youngest);
+      if (!err)
+        err = svn_sqlite__update(NULL, stmt);
+      if (!err)
+        err = set_progress(sdb, youngest);
+    }
+
+  return svn_error_trace(svn_sqlite__finish_transaction(sdb, err));
+}
+
+svn_error_t *
+svn_fs_fs__mergeinfo_index_get_descendants(svn_boolean_t *handled,
+                                           svn_fs_t *fs,
+                                           svn_revnum_t revision,
+                                           const char *path,
+                                           svn_fs_mergeinfo_receiver_t receiver,
+                                           void *baton,
+                                           apr_pool_t *scratch_pool)
+{
+  svn_sqlite__db_t *sdb;
+  svn_revnum_t indexed;
+  apr_array_header_t *entries;
+  apr_pool_t *iterpool;
+  int i;
+
+  *handled = FALSE;
+
+  SVN_ERR(get_mergeinfo_index(&sdb, fs, FALSE, scratch_pool));
+  if (!sdb)
+    return SVN_NO_ERROR;
+
+  /* The index may lag behind HEAD.  Revisions that it covers never
+     change, though. */
+  SVN_ERR(get_progress(&indexed, sdb));
+  if (revision > indexed)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(get_subtree_mergeinfo(&entries, sdb, path, revision,
+                                scratch_pool));
+
+  iterpool = svn_pool_create(scratch_pool);
+  for (i = 0; i < entries->nelts; ++i)
+    {
+      path_mergeinfo_t *entry = APR_ARRAY_IDX(entries, i, path_mergeinfo_t *);
+      svn_mergeinfo_t mergeinfo;
+      svn_error_t *err;
+
+      /* We only report descendants. */
+      if (strcmp(entry->path, path) == 0)
+        continue;
+
+      svn_pool_clear(iterpool);
+
+      /* Issue #3896: If a node has syntactically invalid mergeinfo, then
+         treat it as if no mergeinfo is present rather than raising a parse
+         error. */
+      err = svn_mergeinfo_parse(&mergeinfo, entry->mergeinfo, iterpool);
+      if (err)
+        {
+          if (err->apr_err == SVN_ERR_MERGEINFO_PARSE_ERROR)
+            svn_error_clear(err);
+          else
+            return svn_error_trace(err);
+        }
+      else
+        {
+          SVN_ERR(receiver(entry->path, mergeinfo, baton, iterpool));
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+  *handled = TRUE;
+
+  return SVN_NO_ERROR;
+}
@@ -0,0 +1,98 @@
+/* mergeinfo_index.h : interface to the FSFS mergeinfo index
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#ifndef SVN_LIBSVN_FS_FS_MERGEINFO_INDEX_H
+#define SVN_LIBSVN_FS_FS_MERGEINFO_INDEX_H
+
+#include "svn_error.h"
+#include "svn_fs.h"
+
+#include "fs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* The mergeinfo index records the value of the svn:mergeinfo property
+ * of every path in FS for every revision in which it changed.  It allows
+ * all mergeinfo within a sub-tree to be found without crawling the DAG.
+ * The index always covers a contiguous range of revisions, starting at
+ * r0.  It only exists after svn_fs_fs__build_mergeinfo_index() has been
+ * called; from then on, every commit keeps it up to date. */
+
+/* Create the mergeinfo index of FS, if necessary, and add all revisions
+ * up to HEAD that it does not cover yet.
+ *
+ * Indicate progress via the optional PROGRESS_FUNC callback using
+ * PROGRESS_BATON.  The optional CANCEL_FUNC will periodically be called
+ * with CANCEL_BATON to allow cancellation.  Use SCRATCH_POOL for temporary
+ * allocations. */
+svn_error_t *
+svn_fs_fs__build_mergeinfo_index(svn_fs_t *fs,
+                                 svn_fs_progress_notify_func_t progress_func,
+                                 void *progress_baton,
+                                 svn_cancel_func_t cancel_func,
+                                 void *cancel_baton,
+                                 apr_pool_t *scratch_pool);
+
+/* If FS has a mergeinfo index, add the revisions up to and including
+ * YOUNGEST to it.  Add no more than a small, fixed number of revisions,
+ * though, and leave any larger backlog to svn_fs_fs__build_mergeinfo_index.
+ * Use SCRATCH_POOL for temporary allocations. */
+svn_error_t *
+svn_fs_fs__mergeinfo_index_update(svn_fs_t *fs,
+                                  svn_revnum_t youngest,
+                                  apr_pool_t *scratch_pool);
+
+/* Remove all entries for revisions younger than YOUNGEST from the
+ * mergeinfo index of FS, if it exists.  This is used after copying the
+ * index from a repository that may contain more revisions than FS.
+ *
+ * Use SCRATCH_POOL for temporary allocations. */
+svn_error_t *
+svn_fs_fs__mergeinfo_index_truncate(svn_fs_t *fs,
+                                    svn_revnum_t youngest,
+                                    apr_pool_t *scratch_pool);
+
+/* Invoke RECEIVER with BATON for each mergeinfo found on descendants of
+ * PATH (but not PATH itself) in revision REVISION of FS, skipping values
+ * that cannot be parsed.
+ *
+ * If the mergeinfo index of FS covers REVISION, set *HANDLED to TRUE.
+ * Otherwise, set it to FALSE and don't invoke RECEIVER at all.
+ *
+ * Use SCRATCH_POOL for temporary allocations, including the mergeinfo
+ * hashes passed to RECEIVER. */
+svn_error_t *
+svn_fs_fs__mergeinfo_index_get_descendants(svn_boolean_t *handled,
+                                           svn_fs_t *fs,
+                                           svn_revnum_t revision,
+                                           const char *path,
+                                           svn_fs_mergeinfo_receiver_t receiver,
+                                           void *baton,
+                                           apr_pool_t *scratch_pool);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SVN_LIBSVN_FS_FS_MERGEINFO_INDEX_H */
@@ -22,9 +22,16 @@
 #include <assert.h>
 #include <string.h>
 
+#if APR_HAS_THREADS
+#include <apr_thread_pool.h>
+#include <apr_thread_cond.h>
+#endif
+
 #include "svn_pools.h"
 #include "svn_dirent_uri.h"
 #include "svn_sorts.h"
+#include "private/svn_atomic.h"
+#include "private/svn_mutex.h"
 #include "private/svn_temp_serializer.h"
 #include "private/svn_sorts_private.h"
 #include "private/svn_subr_private.h"
@@ -81,6 +88,12 @@
  * Step 4 copies the items from the temporary buckets into the final
  * pack file and writes the temporary index files.
  *
+ * The P2L entries of the first three buckets as well as the index
+ * information of all items written to the pack file don't need to be
+ * held in memory.  They are collected by bounded-memory external sorters
+ * that spill sorted runs to temporary files and merge them when the
+ * entries are being read back in sort order.
+ *
  * Finally, after the last range of revisions, create the final indexes.
  */
 
@@ -131,6 +144,324 @@ typedef struct reference_t
   svn_fs_fs__id_part_t from;
 } reference_t;
 
+/* Maximum number of P2L entries that an entry_sorter_t keeps in memory.
+ */
+#define MAX_SORT_RUN_SIZE 0x4000
+
+/* Number of entry_sorter_t instances in a pack_context_t.  They share the
+ * memory of one P2L entry per item that PER_ITEM_MEM accounts for.
+ */
+#define SORTER_COUNT 4
+
+/* Number of P2L entries that we read at once from a spilled run.
+ */
+#define SORT_READ_BLOCK_SIZE 64
+
+/* Comparison function for svn_fs_fs__p2l_entry_t.
+ */
+typedef int (*entry_compare_func_t)(const svn_fs_fs__p2l_entry_t *lhs,
+                                    const svn_fs_fs__p2l_entry_t *rhs);
+
+/* External sorter for svn_fs_fs__p2l_entry_t.  Entries get buffered in
+ * memory until RUN_SIZE is reached.  The buffer is then sorted and spilled
+ * to RUNS_FILE.  Reading the entries back performs a k-way merge over all
+ * runs.  The memory consumption is thus independent of the number of
+ * entries being sorted.
+ */
+typedef struct entry_sorter_t
+{
+  /* Defines the ordering of the entries. */
+  entry_compare_func_t compare_func;
+
+  /* svn_fs_fs__p2l_entry_t elements (by value) not spilled, yet. */
+  apr_array_header_t *buffer;
+
+  /* Number of entries in BUFFER that triggers a spill. */
+  int run_size;
+
+  /* All runs spilled so far, one after another.  NULL if there was none. */
+  apr_file_t *runs_file;
+
+  /* Number of entries in each run in RUNS_FILE (int). */
+  apr_array_header_t *run_lengths;
+
+  /* Pool owning RUNS_FILE.  Will be cleared by entry_sorter_reset(). */
+  apr_pool_t *file_pool;
+} entry_sorter_t;
+
+/* Read cursor into a single run of an entry_sorter_t.
+ */
+typedef struct run_cursor_t
+{
+  /* Defines the ordering of the entries.  Copied from the sorter because
+   * the priority queue does not support comparison batons. */
+  entry_compare_func_t compare_func;
+
+  /* Offset of the next entry to read from the sorter's RUNS_FILE. */
+  apr_off_t next_offset;
+
+  /* Number of entries in the run not read into BLOCK, yet. */
+  int remaining;
+
+  /* Entries read from the run. */
+  svn_fs_fs__p2l_entry_t *block;
+
+  /* Number of valid entries in BLOCK and current position within it. */
+  int block_length;
+  int block_pos;
+} run_cursor_t;
+
+/* Callback invoked by entry_sorter_read() for each ENTRY in order.
+ * ENTRY may be modified by the callee.  Use SCRATCH_POOL for temporary
+ * allocations.
+ */
+typedef svn_error_t *
+(*entry_receiver_t)(void *baton,
+                    svn_fs_fs__p2l_entry_t *entry,
+                    apr_pool_t *scratch_pool);
+
+/* implements entry_compare_func_t. Place LHS before RHS, if the latter is
+ * older.
+ */
+static int
+compare_p2l_info(const svn_fs_fs__p2l_entry_t *lhs,
+                 const svn_fs_fs__p2l_entry_t *rhs)
+{
+  if (lhs->item.revision == rhs->item.revision)
+    {
+      if (lhs->item.number == rhs->item.number)
+        return 0;
+
+      return lhs->item.number > rhs->item.number ? -1 : 1;
+    }
+
+  return lhs->item.revision > rhs->item.revision ? -1 : 1;
+}
+
+/* implements entry_compare_func_t. Place LHS before RHS, if the latter
+ * belongs to a newer revision.
+ */
+static int
+compare_p2l_info_rev(const svn_fs_fs__p2l_entry_t *lhs,
+                     const svn_fs_fs__p2l_entry_t *rhs)
+{
+  if (lhs->item.revision == rhs->item.revision)
+    return 0;
+
+  return lhs->item.revision < rhs->item.revision ? -1 : 1;
+}
+
+/* Return a new external sorter for svn_fs_fs__p2l_entry_t using
+ * COMPARE_FUNC to define the ordering.  Keep no more than RUN_SIZE entries
+ * in memory.  Allocate the sorter in RESULT_POOL.
+ */
+static entry_sorter_t *
+entry_sorter_create(entry_compare_func_t compare_func,
+                    int run_size,
+                    apr_pool_t *result_pool)
+{
+  entry_sorter_t *sorter = apr_pcalloc(result_pool, sizeof(*sorter));
+
+  sorter->compare_func = compare_func;
+  sorter->run_size = MAX(1, MIN(run_size, MAX_SORT_RUN_SIZE));
+  sorter->buffer = apr_array_make(result_pool, sorter->run_size,
+                                  sizeof(svn_fs_fs__p2l_entry_t));
+  sorter->run_lengths = apr_array_make(result_pool, 16, sizeof(int));
+  sorter->file_pool = svn_pool_create(result_pool);
+
+  return sorter;
+}
+
+/* Remove all entries from SORTER and delete its temporary file.
+ */
+static void
+entry_sorter_reset(entry_sorter_t *sorter)
+{
+  apr_array_clear(sorter->buffer);
+  apr_array_clear(sorter->run_lengths);
+  svn_pool_clear(sorter->file_pool);
+  sorter->runs_file = NULL;
+}
+
+/* Sort the buffered entries in SORTER.
+ */
+static void
+sort_buffer(entry_sorter_t *sorter)
+{
+  svn_sort__array(sorter->buffer,
+                  (int (*)(const void *, const void *))sorter->compare_func);
+}
+
+/* Sort the buffered entries in SORTER and append them as a new run to
+ * the sorter's temporary file.  Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+spill_run(entry_sorter_t *sorter,
+          apr_pool_t *scratch_pool)
+{
+  if (sorter->buffer->nelts == 0)
+    return SVN_NO_ERROR;
+
+  if (sorter->runs_file == NULL)
+    {
+      const char *temp_dir;
+      SVN_ERR(svn_io_temp_dir(&temp_dir, scratch_pool));
+      SVN_ERR(svn_io_open_unique_file3(&sorter->runs_file, NULL, temp_dir,
+                                       svn_io_file_del_on_close,
+                                       sorter->file_pool, scratch_pool));
+    }
+
+  sort_buffer(sorter);
+  SVN_ERR(svn_io_file_write_full(sorter->runs_file, sorter->buffer->elts,
+                                 sorter->buffer->nelts
+                                   * sorter->buffer->elt_size,
+                                 NULL, scratch_pool));
+
+  APR_ARRAY_PUSH(sorter->run_lengths, int) = sorter->buffer->nelts;
+  apr_array_clear(sorter->buffer);
+
+  return SVN_NO_ERROR;
+}
+
+/* Add a copy of ENTRY to SORTER.  Use SCRATCH_POOL for temporary
+ * allocations.
+ */
+static svn_error_t *
+entry_sorter_add(entry_sorter_t *sorter,
+                 const svn_fs_fs__p2l_entry_t *entry,
+                 apr_pool_t *scratch_pool)
+{
+  if (sorter->buffer->nelts >= sorter->run_size)
+    SVN_ERR(spill_run(sorter, scratch_pool));
+
+  APR_ARRAY_PUSH(sorter->buffer, svn_fs_fs__p2l_entry_t) = *entry;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements the comparison function of svn_priority_queue__t for
+ * run_cursor_t, ordering them by their current entry.
+ */
+static int
+compare_run_cursors(const run_cursor_t *lhs,
+                    const run_cursor_t *rhs)
+{
+  return lhs->compare_func(&lhs->block[lhs->block_pos],
+                           &rhs->block[rhs->block_pos]);
+}
+
+/* Read the next block of entries from FILE into CURSOR.
+ * Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+fill_run_cursor(run_cursor_t *cursor,
+                apr_file_t *file,
+                apr_pool_t *scratch_pool)
+{
+  apr_size_t to_read;
+
+  cursor->block_length = MIN(cursor->remaining, SORT_READ_BLOCK_SIZE);
+  cursor->block_pos = 0;
+  cursor->remaining -= cursor->block_length;
+
+  to_read = cursor->block_length * sizeof(*cursor->block);
+  SVN_ERR(svn_io_file_seek(file, APR_SET, &cursor->next_offset,
+                           scratch_pool));
+  SVN_ERR(svn_io_file_read_full2(file, cursor->block, to_read, NULL, NULL,
+                                 scratch_pool));
+  cursor->next_offset += to_read;
+
+  return SVN_NO_ERROR;
+}
+
+/* Call RECEIVER with RECEIVER_BATON for all entries in SORTER in sort
+ * order.  Afterwards, SORTER will be empty.  Use SCRATCH_POOL for
+ * temporary allocations.
+ */
+static svn_error_t *
+entry_sorter_read(entry_sorter_t *sorter,
+                  entry_receiver_t receiver,
+                  void *receiver_baton,
+                  apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  apr_array_header_t *cursors;
+  svn_priority_queue__t *queue;
+  apr_off_t offset = 0;
+  int i;
+
+  /* Simple case: everything is still in memory. */
+  if (sorter->runs_file == NULL)
+    {
+      sort_buffer(sorter);
+      for (i = 0; i < sorter->buffer->nelts; ++i)
+        {
+          svn_pool_clear(iterpool);
+          SVN_ERR(receiver(receiver_baton,
+                           &APR_ARRAY_IDX(sorter->buffer, i,
+                                          svn_fs_fs__p2l_entry_t),
+                           iterpool));
+        }
+
+      svn_pool_destroy(iterpool);
+      entry_sorter_reset(sorter);
+
+      return SVN_NO_ERROR;
+    }
+
+  /* Merge all runs, including what is left in the buffer. */
+  SVN_ERR(spill_run(sorter, scratch_pool));
+
+  cursors = apr_array_make(scratch_pool, sorter->run_lengths->nelts,
+                           sizeof(run_cursor_t));
+  for (i = 0; i < sorter->run_lengths->nelts; ++i)
+    {
+      run_cursor_t *cursor = apr_array_push(cursors);
+      int length = APR_ARRAY_IDX(sorter->run_lengths, i, int);
+
+      cursor->compare_func = sorter->compare_func;
+      cursor->next_offset = offset;
+      cursor->remaining = length;
+      cursor->block = apr_palloc(scratch_pool, SORT_READ_BLOCK_SIZE
+                                                 * sizeof(*cursor->block));
+      SVN_ERR(fill_run_cursor(cursor, sorter->runs_file, iterpool));
+
+      offset += length * sizeof(*cursor->block);
+    }
+
+  queue = svn_priority_queue__create(cursors,
+              (int (*)(const void *, const void *))compare_run_cursors);
+
+  while (svn_priority_queue__size(queue))
+    {
+      run_cursor_t *cursor = svn_priority_queue__peek(queue);
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(receiver(receiver_baton, &cursor->block[cursor->block_pos],
+                       iterpool));
+
+      /* Advance the cursor and re-prioritize it. */
+      if (++cursor->block_pos < cursor->block_length)
+        {
+          svn_priority_queue__update(queue);
+        }
+      else if (cursor->remaining > 0)
+        {
+          SVN_ERR(fill_run_cursor(cursor, sorter->runs_file, iterpool));
+          svn_priority_queue__update(queue);
+        }
+      else
+        {
+          svn_priority_queue__pop(queue);
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+  entry_sorter_reset(sorter);
+
+  return SVN_NO_ERROR;
+}
+
 /* This structure keeps track of all the temporary data and status that
  * needs to be kept around during the creation of one pack file.  After
  * each revision range (in case we can't process all revs at once due to
@@ -180,25 +511,25 @@ typedef struct pack_context_t
   /* the pack file to ultimately write all data to */
   apr_file_t *pack_file;
 
-  /* array of svn_fs_fs__p2l_entry_t *, all referring to change lists.
+  /* P2L entries of all change lists.
    * Will be filled in phase 2 and be cleared after each revision range. */
-  apr_array_header_t *changes;
+  entry_sorter_t *changes;
 
   /* temp file receiving all change list items (referenced by CHANGES).
    * Will be filled in phase 2 and be cleared after each revision range. */
   apr_file_t *changes_file;
 
-  /* array of svn_fs_fs__p2l_entry_t *, all referring to file properties.
+  /* P2L entries of all file properties.
    * Will be filled in phase 2 and be cleared after each revision range. */
-  apr_array_header_t *file_props;
+  entry_sorter_t *file_props;
 
   /* temp file receiving all file prop items (referenced by FILE_PROPS).
    * Will be filled in phase 2 and be cleared after each revision range.*/
   apr_file_t *file_props_file;
 
-  /* array of svn_fs_fs__p2l_entry_t *, all referring to directory properties.
+  /* P2L entries of all directory properties.
    * Will be filled in phase 2 and be cleared after each revision range. */
-  apr_array_header_t *dir_props;
+  entry_sorter_t *dir_props;
 
   /* temp file receiving all directory prop items (referenced by DIR_PROPS).
    * Will be filled in phase 2 and be cleared after each revision range.*/
@@ -230,6 +561,11 @@ typedef struct pack_context_t
    * Will be filled in phase 2 and be cleared after each revision range.*/
   apr_file_t *reps_file;
 
+  /* P2L entries of all items written to the pack file, used to create
+   * the L2P index.  Will be filled in phase 4 and be cleared after each
+   * revision range. */
+  entry_sorter_t *placed_items;
+
   /* pool used for temporary data structures that will be cleaned up when
    * the next range of revisions is being processed */
   apr_pool_t *info_pool;
@@ -260,6 +596,7 @@ initialize_pack_context(pack_context_t *context,
   fs_fs_data_t *ffd = fs->fsap_data;
   const char *temp_dir;
   int max_revs = MIN(ffd->max_files_per_dir, max_items);
+  int run_size = max_items / SORTER_COUNT;
 
   SVN_ERR_ASSERT(ffd->format >= SVN_FS_FS__MIN_LOG_ADDRESSING_FORMAT);
   SVN_ERR_ASSERT(shard_rev % ffd->max_files_per_dir == 0);
@@ -307,18 +644,17 @@ initialize_pack_context(pack_context_t *context,
              pool));
 
   /* item buckets: one item info array and one temp file per bucket */
-  context->changes = apr_array_make(pool, max_items,
-                                    sizeof(svn_fs_fs__p2l_entry_t *));
+  context->changes = entry_sorter_create(compare_p2l_info, run_size, pool);
   SVN_ERR(svn_io_open_unique_file3(&context->changes_file, NULL, temp_dir,
                                    svn_io_file_del_on_close,
                                    context->info_pool, pool));
-  context->file_props = apr_array_make(pool, max_items,
-                                       sizeof(svn_fs_fs__p2l_entry_t *));
+  context->file_props = entry_sorter_create(compare_p2l_info, run_size,
+                                            pool);
   SVN_ERR(svn_io_open_unique_file3(&context->file_props_file, NULL, temp_dir,
                                    svn_io_file_del_on_close,
                                    context->info_pool, pool));
-  context->dir_props = apr_array_make(pool, max_items,
-                                      sizeof(svn_fs_fs__p2l_entry_t *));
+  context->dir_props = entry_sorter_create(compare_p2l_info, run_size,
+                                           pool);
   SVN_ERR(svn_io_open_unique_file3(&context->dir_props_file, NULL, temp_dir,
                                    svn_io_file_del_on_close,
                                    context->info_pool, pool));
@@ -333,6 +669,8 @@ initialize_pack_context(pack_context_t *context,
                                  sizeof(svn_fs_fs__p2l_entry_t *));
   SVN_ERR(svn_io_open_unique_file3(&context->reps_file, NULL, temp_dir,
                                    svn_io_file_del_on_close, pool, pool));
+  context->placed_items = entry_sorter_create(compare_p2l_info_rev,
+                                              run_size, pool);
 
   return SVN_NO_ERROR;
 }
@@ -346,11 +684,11 @@ reset_pack_context(pack_context_t *context,
 {
   const char *temp_dir;
 
-  apr_array_clear(context->changes);
+  entry_sorter_reset(context->changes);
   SVN_ERR(svn_io_file_close(context->changes_file, pool));
-  apr_array_clear(context->file_props);
+  entry_sorter_reset(context->file_props);
   SVN_ERR(svn_io_file_close(context->file_props_file, pool));
-  apr_array_clear(context->dir_props);
+  entry_sorter_reset(context->dir_props);
   SVN_ERR(svn_io_file_close(context->dir_props_file, pool));
 
   apr_array_clear(context->rev_offsets);
@@ -358,6 +696,7 @@ reset_pack_context(pack_context_t *context,
   apr_array_clear(context->references);
   apr_array_clear(context->reps);
   SVN_ERR(svn_io_file_close(context->reps_file, pool));
+  entry_sorter_reset(context->placed_items);
 
   svn_pool_clear(context->info_pool);
 
@@ -501,17 +840,16 @@ write_null_bytes(apr_file_t *dest,
  */
 static svn_error_t *
 copy_item_to_temp(pack_context_t *context,
-                  apr_array_header_t *entries,
+                  entry_sorter_t *entries,
                   apr_file_t *temp_file,
                   apr_file_t *rev_file,
                   svn_fs_fs__p2l_entry_t *entry,
                   apr_pool_t *pool)
 {
-  svn_fs_fs__p2l_entry_t *new_entry
-    = apr_pmemdup(context->info_pool, entry, sizeof(*entry));
+  svn_fs_fs__p2l_entry_t new_entry = *entry;
 
-  SVN_ERR(svn_io_file_get_offset(&new_entry->offset, temp_file, pool));
-  APR_ARRAY_PUSH(entries, svn_fs_fs__p2l_entry_t *) = new_entry;
+  SVN_ERR(svn_io_file_get_offset(&new_entry.offset, temp_file, pool));
+  SVN_ERR(entry_sorter_add(entries, &new_entry, pool));
 
   SVN_ERR(copy_file_data(context, temp_file, rev_file, entry->size, pool));
 
@@ -1050,30 +1388,6 @@ sort_reps(pack_context_t *context)
   svn_pool_destroy(temp_pool);
 }
 
-/* implements compare_fn_t. Place LHS before RHS, if the latter is older.
- */
-static int
-compare_p2l_info(const svn_fs_fs__p2l_entry_t * const * lhs,
-                 const svn_fs_fs__p2l_entry_t * const * rhs)
-{
-  assert(*lhs != *rhs);
-
-  if ((*lhs)->item.revision == (*rhs)->item.revision)
-    return (*lhs)->item.number > (*rhs)->item.number ? -1 : 1;
-
-  return (*lhs)->item.revision > (*rhs)->item.revision ? -1 : 1;
-}
-
-/* Sort svn_fs_fs__p2l_entry_t * array ENTRIES by age.  Place the latest
- * items first.
- */
-static void
-sort_items(apr_array_header_t *entries)
-{
-  svn_sort__array(entries,
-                  (int (*)(const void *, const void *))compare_p2l_info);
-}
-
 /* Return the remaining unused bytes in the current block in CONTEXT's
  * pack file.
  */
@@ -1164,35 +1478,49 @@ store_item(pack_context_t *context,
   SVN_ERR(svn_fs_fs__p2l_proto_index_add_entry(context->proto_p2l_index,
                                                item, pool));
 
-  APR_ARRAY_PUSH(context->reps, svn_fs_fs__p2l_entry_t *) = item;
+  SVN_ERR(entry_sorter_add(context->placed_items, item, pool));
 
   return SVN_NO_ERROR;
 }
 
+/* Baton type for store_item_receiver().
+ */
+typedef struct store_items_baton_t
+{
+  pack_context_t *context;
+  apr_file_t *temp_file;
+} store_items_baton_t;
+
+/* Implements entry_receiver_t.  Call store_item() for ENTRY with the
+ * store_items_baton_t given in BATON.
+ */
+static svn_error_t *
+store_item_receiver(void *baton,
+                    svn_fs_fs__p2l_entry_t *entry,
+                    apr_pool_t *scratch_pool)
+{
+  store_items_baton_t *b = baton;
+  return svn_error_trace(store_item(b->context, b->temp_file, entry,
+                                    scratch_pool));
+}
+
 /* Read the contents of the non-empty items in ITEMS from TEMP_FILE and
- * write them to CONTEXT->PACK_FILE.  Use POOL for allocations.
+ * write them to CONTEXT->PACK_FILE.  ITEMS will be empty afterwards.
+ * Use POOL for allocations.
  */
 static svn_error_t *
 store_items(pack_context_t *context,
             apr_file_t *temp_file,
-            apr_array_header_t *items,
+            entry_sorter_t *items,
             apr_pool_t *pool)
 {
-  int i;
-  apr_pool_t *iterpool = svn_pool_create(pool);
+  store_items_baton_t baton;
+  baton.context = context;
+  baton.temp_file = temp_file;
 
   /* copy all items in strict order */
-  for (i = 0; i < items->nelts; ++i)
-    {
-      svn_pool_clear(iterpool);
-      SVN_ERR(store_item(context, temp_file,
-                         APR_ARRAY_IDX(items, i, svn_fs_fs__p2l_entry_t *),
-                         iterpool));
-    }
-
-  svn_pool_destroy(iterpool);
-
-  return SVN_NO_ERROR;
+  return svn_error_trace(entry_sorter_read(items, store_item_receiver,
+                                           &baton, pool));
 }
 
 /* Copy (append) the items identified by svn_fs_fs__p2l_entry_t * elements
@@ -1249,20 +1577,39 @@ copy_reps_from_temp(pack_context_t *context,
   return SVN_NO_ERROR;
 }
 
-/* implements compare_fn_t. Place LHS before RHS, if the latter belongs to
- * a newer revision.
+/* Baton type for l2p_entry_receiver().
  */
-static int
-compare_p2l_info_rev(const svn_fs_fs__p2l_entry_t * const * lhs_p,
-                     const svn_fs_fs__p2l_entry_t * const * rhs_p)
+typedef struct write_l2p_baton_t
 {
-  const svn_fs_fs__p2l_entry_t * lhs = *lhs_p;
-  const svn_fs_fs__p2l_entry_t * rhs = *rhs_p;
+  pack_context_t *context;
+  svn_revnum_t prev_rev;
+} write_l2p_baton_t;
 
-  if (lhs->item.revision == rhs->item.revision)
-    return 0;
+/* Implements entry_receiver_t.  Add P2L_ENTRY to the log-to-phys proto
+ * index using the write_l2p_baton_t given in BATON.
+ */
+static svn_error_t *
+l2p_entry_receiver(void *baton,
+                   svn_fs_fs__p2l_entry_t *p2l_entry,
+                   apr_pool_t *scratch_pool)
+{
+  write_l2p_baton_t *b = baton;
 
-  return lhs->item.revision < rhs->item.revision ? -1 : 1;
+  /* next revision? */
+  if (b->prev_rev != p2l_entry->item.revision)
+    {
+      b->prev_rev = p2l_entry->item.revision;
+      SVN_ERR(svn_fs_fs__l2p_proto_index_add_revision(
+                   b->context->proto_l2p_index, scratch_pool));
+    }
+
+  /* add entry */
+  SVN_ERR(svn_fs_fs__l2p_proto_index_add_entry(b->context->proto_l2p_index,
+                                               p2l_entry->offset,
+                                               p2l_entry->item.number,
+                                               scratch_pool));
+
+  return SVN_NO_ERROR;
 }
 
 /* Write the log-to-phys proto index file for CONTEXT and use POOL for
@@ -1273,55 +1620,24 @@ static svn_error_t *
 write_l2p_index(pack_context_t *context,
                 apr_pool_t *pool)
 {
-  apr_pool_t *iterpool = svn_pool_create(pool);
-  svn_revnum_t prev_rev = SVN_INVALID_REVNUM;
-  int i, dest;
+  write_l2p_baton_t baton;
+  int i;
 
-  /* eliminate empty entries from CONTEXT->REPS */
-  for (i = 0, dest = 0; i < context->reps->nelts; ++i)
+  /* add all items that have not been placed */
+  for (i = 0; i < context->reps->nelts; ++i)
     {
       svn_fs_fs__p2l_entry_t *entry
         = APR_ARRAY_IDX(context->reps, i, svn_fs_fs__p2l_entry_t *);
       if (entry)
-        APR_ARRAY_IDX(context->reps, dest++, svn_fs_fs__p2l_entry_t *)
-          = entry;
+        SVN_ERR(entry_sorter_add(context->placed_items, entry, pool));
     }
-  context->reps->nelts = dest;
 
   /* we need to write the l2p index revision by revision */
-  svn_sort__array(context->reps,
-                  (int (*)(const void *, const void *))compare_p2l_info_rev);
-
-  /* write index entries */
-  for (i = 0; i < context->reps->nelts; ++i)
-    {
-      svn_fs_fs__p2l_entry_t *p2l_entry
-        = APR_ARRAY_IDX(context->reps, i, svn_fs_fs__p2l_entry_t *);
-      if (p2l_entry == NULL)
-        continue;
-
-      /* next revision? */
-      if (prev_rev != p2l_entry->item.revision)
-        {
-          prev_rev = p2l_entry->item.revision;
-          SVN_ERR(svn_fs_fs__l2p_proto_index_add_revision(
-                       context->proto_l2p_index, iterpool));
-        }
-
-      /* add entry */
-      SVN_ERR(svn_fs_fs__l2p_proto_index_add_entry(context->proto_l2p_index,
-                                                   p2l_entry->offset,
-                                                   p2l_entry->item.number,
-                                                   iterpool));
-
-      /* keep memory usage in check */
-      if (i % 256 == 0)
-        svn_pool_clear(iterpool);
-    }
-
-  svn_pool_destroy(iterpool);
-
-  return SVN_NO_ERROR;
+  baton.context = context;
+  baton.prev_rev = SVN_INVALID_REVNUM;
+  return svn_error_trace(entry_sorter_read(context->placed_items,
+                                           l2p_entry_receiver, &baton,
+                                           pool));
 }
 
 /* Pack the current revision range of CONTEXT, i.e. this covers phases 2
@@ -1428,12 +1744,8 @@ pack_range(pack_context_t *context,
   svn_pool_destroy(iterpool);
 
   /* phase 3: placement.
-   * Use "newest first" placement for simple items. */
-  sort_items(context->changes);
-  sort_items(context->file_props);
-  sort_items(context->dir_props);
-
-  /* follow dependencies recursively for noderevs and data representations */
+   * Simple items will be placed "newest first" by their entry sorters.
+   * Follow dependencies recursively for noderevs and data representations */
   sort_reps(context);
 
   /* phase 4: copy bucket data to pack file.  Write P2L index. */
@@ -1957,6 +2269,54 @@ synced_pack_shard(void *baton,
   return SVN_NO_ERROR;
 }
 
+/* Set *REV_PACK_FILE_DIR and *REV_SHARD_PATH to the packed and non-packed
+ * folders of SHARD in REVS_DIR.  Allocate them in RESULT_POOL.
+ */
+static void
+get_shard_paths(const char **rev_pack_file_dir,
+                const char **rev_shard_path,
+                const char *revs_dir,
+                apr_int64_t shard,
+                apr_pool_t *result_pool)
+{
+  *rev_pack_file_dir = svn_dirent_join(revs_dir,
+                  apr_psprintf(result_pool,
+                               "%" APR_INT64_T_FMT PATH_EXT_PACKED_SHARD,
+                               shard),
+                  result_pool);
+  *rev_shard_path = svn_dirent_join(revs_dir,
+                                    apr_psprintf(result_pool,
+                                                 "%" APR_INT64_T_FMT,
+                                                 shard),
+                                    result_pool);
+}
+
+/* Switch the shard described by BATON over to its packed revision data,
+ * which has already been written.  Pack its revprops as well.
+ */
+static svn_error_t *
+switch_to_packed_shard(struct pack_baton *baton,
+                       apr_pool_t *pool)
+{
+  fs_fs_data_t *ffd = baton->fs->fsap_data;
+
+  /* For newer repo formats, we only acquired the pack lock so far.
+     Before modifying the repo state by switching over to the packed
+     data, we need to acquire the global (write) lock. */
+  if (ffd->format >= SVN_FS_FS__MIN_PACK_LOCK_FORMAT)
+    SVN_ERR(svn_fs_fs__with_write_lock(baton->fs, synced_pack_shard, baton,
+                                       pool));
+  else
+    SVN_ERR(synced_pack_shard(baton, pool));
+
+  /* Notify caller we're starting to pack this shard. */
+  if (baton->notify_func)
+    SVN_ERR(baton->notify_func(baton->notify_baton, baton->shard,
+                               svn_fs_pack_notify_end, pool));
+
+  return SVN_NO_ERROR;
+}
+
 /* Pack the shard described by BATON.
  *
  * If for some reason we detect a partial packing already performed,
@@ -1975,16 +2335,8 @@ pack_shard(struct pack_baton *baton,
                                svn_fs_pack_notify_start, pool));
 
   /* Some useful paths. */
-  rev_pack_file_dir = svn_dirent_join(baton->revs_dir,
-                  apr_psprintf(pool,
-                               "%" APR_INT64_T_FMT PATH_EXT_PACKED_SHARD,
-                               baton->shard),
-                  pool);
-  baton->rev_shard_path = svn_dirent_join(baton->revs_dir,
-                                          apr_psprintf(pool,
-                                                       "%" APR_INT64_T_FMT,
-                                                       baton->shard),
-                                          pool);
+  get_shard_paths(&rev_pack_file_dir, &baton->rev_shard_path,
+                  baton->revs_dir, baton->shard, pool);
 
   /* pack the revision content */
   SVN_ERR(pack_rev_shard(baton->fs, rev_pack_file_dir, baton->rev_shard_path,
@@ -1992,23 +2344,316 @@ pack_shard(struct pack_baton *baton,
                          baton->max_mem, ffd->flush_to_disk,
                          baton->cancel_func, baton->cancel_baton, pool));
 
-  /* For newer repo formats, we only acquired the pack lock so far.
-     Before modifying the repo state by switching over to the packed
-     data, we need to acquire the global (write) lock. */
-  if (ffd->format >= SVN_FS_FS__MIN_PACK_LOCK_FORMAT)
-    SVN_ERR(svn_fs_fs__with_write_lock(baton->fs, synced_pack_shard, baton,
-                                       pool));
-  else
-    SVN_ERR(synced_pack_shard(baton, pool));
+  return svn_error_trace(switch_to_packed_shard(baton, pool));
+}
+
+#if APR_HAS_THREADS
+
+/* Number of microseconds between two checks for cancellation while we
+   wait for concurrent shard packing to progress. */
+#define PACK_JOB_POLL_INTERVAL 100000
+
+struct pack_jobs_t;
+
+/* A single shard being packed by some worker thread. */
+typedef struct pack_job_t
+{
+  /* The shard to pack. */
+  apr_int64_t shard;
+
+  /* Private filesystem instance used to read the shard's revisions.
+     The caches of the original FS object can't be used concurrently. */
+  svn_fs_t *fs;
+
+  /* Packed and non-packed folder of SHARD. */
+  const char *rev_pack_file_dir;
+  const char *rev_shard_path;
+
+  /* Result of pack_rev_shard(). */
+  svn_error_t *err;
+
+  /* Set under the MUTEX in JOBS once ERR is valid. */
+  svn_boolean_t done;
+
+  /* Thread-safe root pool owning this job and all its data. */
+  apr_pool_t *pool;
+
+  /* The context that this job belongs to. */
+  struct pack_jobs_t *jobs;
+} pack_job_t;
+
+/* Context of a concurrent pack run. */
+typedef struct pack_jobs_t
+{
+  /* Describes the pack run as a whole.  Only to be used by the thread
+     that called pack_body(). */
+  struct pack_baton *pb;
+
+  /* Workers executing the jobs. */
+  apr_thread_pool_t *thread_pool;
+
+  /* Signal the completion of jobs. */
+  svn_mutex__t *mutex;
+  apr_thread_cond_t *cond;
+
+  /* Non-zero if the workers shall bail out as soon as possible. */
+  volatile svn_atomic_t cancelled;
+
+  /* Ring buffer of MAX_JOBS entries.  COUNT jobs, starting at index FIRST,
+     are in flight in shard order. */
+  pack_job_t **queue;
+  int max_jobs;
+  int first;
+  int count;
+} pack_jobs_t;
+
+/* Implements svn_cancel_func_t for the workers.  BATON is a pack_jobs_t. */
+static svn_error_t *
+pack_job_cancel(void *baton)
+{
+  pack_jobs_t *jobs = baton;
+  if (svn_atomic_read(&jobs->cancelled))
+    return svn_error_create(SVN_ERR_CANCELLED, NULL, _("Caught signal"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread-pool task packing the revisions of the pack_job_t given by DATA. */
+static void * APR_THREAD_FUNC
+pack_job_task(apr_thread_t *tid,
+              void *data)
+{
+  pack_job_t *job = data;
+  pack_jobs_t *jobs = job->jobs;
+  fs_fs_data_t *ffd = job->fs->fsap_data;
+  svn_error_t *err;
+
+  job->err = pack_rev_shard(job->fs, job->rev_pack_file_dir,
+                            job->rev_shard_path, job->shard,
+                            ffd->max_files_per_dir, jobs->pb->max_mem,
+                            ffd->flush_to_disk, pack_job_cancel, jobs,
+                            job->pool);
+
+  /* There is nobody to report errors to. */
+  err = svn_mutex__lock(jobs->mutex);
+  if (!err)
+    {
+      job->done = TRUE;
+      apr_thread_cond_broadcast(jobs->cond);
+      err = svn_mutex__unlock(jobs->mutex, SVN_NO_ERROR);
+    }
+  svn_error_clear(err);
+
+  return NULL;
+}
+
+/* Queue the packing of SHARD in JOBS.  Use SCRATCH_POOL for temporary
+   allocations. */
+static svn_error_t *
+start_pack_job(pack_jobs_t *jobs,
+               apr_int64_t shard,
+               apr_pool_t *scratch_pool)
+{
+  struct pack_baton *pb = jobs->pb;
+  fs_fs_data_t *ffd = pb->fs->fsap_data;
+  apr_pool_t *pool = svn_pool_create(NULL);
+  pack_job_t *job = apr_pcalloc(pool, sizeof(*job));
+  apr_status_t status;
+  svn_error_t *err;
+
+  job->shard = shard;
+  job->pool = pool;
+  job->jobs = jobs;
+  get_shard_paths(&job->rev_pack_file_dir, &job->rev_shard_path,
+                  pb->revs_dir, shard, pool);
 
   /* Notify caller we're starting to pack this shard. */
-  if (baton->notify_func)
-    SVN_ERR(baton->notify_func(baton->notify_baton, baton->shard,
-                               svn_fs_pack_notify_end, pool));
+  if (pb->notify_func)
+    {
+      err = pb->notify_func(pb->notify_baton, shard,
+                            svn_fs_pack_notify_start, scratch_pool);
+      if (err)
+        {
+          svn_pool_destroy(pool);
+          return svn_error_trace(err);
+        }
+    }
+
+  /* Opening the FS is not necessarily thread-safe, so do it here. */
+  err = ffd->svn_fs_open_(&job->fs, pb->fs->path, pb->fs->config, pool,
+                          scratch_pool);
+  if (err)
+    {
+      svn_pool_destroy(pool);
+      return svn_error_trace(err);
+    }
+
+  jobs->queue[(jobs->first + jobs->count) % jobs->max_jobs] = job;
+  jobs->count++;
+
+  status = apr_thread_pool_push(jobs->thread_pool, pack_job_task, job, 0,
+                                jobs);
+  if (status)
+    {
+      /* Pack the shard in this thread, then. */
+      job->err = pack_rev_shard(job->fs, job->rev_pack_file_dir,
+                                job->rev_shard_path, job->shard,
+                                ffd->max_files_per_dir, pb->max_mem,
+                                ffd->flush_to_disk, pb->cancel_func,
+                                pb->cancel_baton, job->pool);
+      job->done = TRUE;
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Wait for the oldest job in JOBS to complete and remove it from JOBS.
+   Return it in *JOB_P.  If CHECK_CANCEL is set, periodically call the
+   cancellation function of the pack run while waiting. */
+static svn_error_t *
+wait_for_pack_job(pack_job_t **job_p,
+                  pack_jobs_t *jobs,
+                  svn_boolean_t check_cancel)
+{
+  struct pack_baton *pb = jobs->pb;
+  pack_job_t *job = jobs->queue[jobs->first];
+  svn_error_t *err = SVN_NO_ERROR;
+
+  SVN_ERR(svn_mutex__lock(jobs->mutex));
+  while (!job->done && !err)
+    {
+      apr_status_t status
+        = apr_thread_cond_timedwait(jobs->cond, svn_mutex__get(jobs->mutex),
+                                    PACK_JOB_POLL_INTERVAL);
+      if (status && !APR_STATUS_IS_TIMEUP(status))
+        err = svn_error_wrap_apr(status,
+                                 _("Can't wait on condition variable"));
+      else if (check_cancel && pb->cancel_func)
+        err = pb->cancel_func(pb->cancel_baton);
+    }
+  SVN_ERR(svn_mutex__unlock(jobs->mutex, err));
+
+  jobs->first = (jobs->first + 1) % jobs->max_jobs;
+  jobs->count--;
+  *job_p = job;
 
   return SVN_NO_ERROR;
 }
 
+/* Make all workers in JOBS stop, wait for them to finish and release all
+   job data.  Errors will be ignored. */
+static void
+abort_pack_jobs(pack_jobs_t *jobs)
+{
+  svn_atomic_set(&jobs->cancelled, TRUE);
+  while (jobs->count > 0)
+    {
+      pack_job_t *job;
+      svn_error_t *err = wait_for_pack_job(&job, jobs, FALSE);
+      if (err)
+        {
+          /* We can't release a job that might still be in use. */
+          svn_error_clear(err);
+          return;
+        }
+
+      svn_error_clear(job->err);
+      svn_pool_destroy(job->pool);
+    }
+}
+
+/* Wait for the oldest job in JOBS and switch its shard over to the
+   packed data.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+finish_pack_job(pack_jobs_t *jobs,
+                apr_pool_t *scratch_pool)
+{
+  struct pack_baton *pb = jobs->pb;
+  pack_job_t *job;
+  svn_error_t *err;
+
+  SVN_ERR(wait_for_pack_job(&job, jobs, TRUE));
+
+  err = job->err;
+  if (!err)
+    {
+      pb->shard = job->shard;
+      pb->rev_shard_path = job->rev_shard_path;
+      err = switch_to_packed_shard(pb, scratch_pool);
+    }
+
+  svn_pool_destroy(job->pool);
+  return svn_error_trace(err);
+}
+
+/* Implement the main loop of pack_body() for PB, packing up to
+   FFD->PACK_JOBS shards at a time until all shards before
+   COMPLETED_SHARDS have been packed.  The shards will be switched over
+   to their packed data in ascending order, one at a time, just like
+   with the non-concurrent implementation.
+   Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+pack_shards_concurrently(struct pack_baton *pb,
+                         apr_int64_t completed_shards,
+                         apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = pb->fs->fsap_data;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  apr_pool_t *thread_pool_pool;
+  apr_int64_t shard = ffd->min_unpacked_rev / ffd->max_files_per_dir;
+  pack_jobs_t jobs = { 0 };
+  svn_error_t *err = SVN_NO_ERROR;
+  apr_status_t status;
+
+  jobs.pb = pb;
+  jobs.max_jobs = ffd->pack_jobs;
+  jobs.queue = apr_pcalloc(scratch_pool,
+                           jobs.max_jobs * sizeof(*jobs.queue));
+  SVN_ERR(svn_mutex__init(&jobs.mutex, TRUE, scratch_pool));
+  status = apr_thread_cond_create(&jobs.cond, scratch_pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* The thread-pool must be allocated from a thread-safe root pool. */
+  thread_pool_pool = svn_pool_create(NULL);
+  status = apr_thread_pool_create(&jobs.thread_pool, 0, jobs.max_jobs,
+                                  thread_pool_pool);
+  if (status)
+    {
+      svn_pool_destroy(thread_pool_pool);
+      return svn_error_wrap_apr(status, _("Can't create pack thread pool"));
+    }
+
+  while (!err && (shard < completed_shards || jobs.count > 0))
+    {
+      svn_pool_clear(iterpool);
+
+      /* Keep all workers busy. */
+      while (!err && shard < completed_shards && jobs.count < jobs.max_jobs)
+        {
+          if (pb->cancel_func)
+            err = pb->cancel_func(pb->cancel_baton);
+
+          if (!err)
+            err = start_pack_job(&jobs, shard++, iterpool);
+        }
+
+      /* Switch the shards over in order. */
+      if (!err)
+        err = finish_pack_job(&jobs, iterpool);
+    }
+
+  /* Don't leave any worker running. */
+  abort_pack_jobs(&jobs);
+  apr_thread_pool_destroy(jobs.thread_pool);
+  svn_pool_destroy(thread_pool_pool);
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(err);
+}
+
+#endif
+
 /* Read the youngest rev and the first non-packed rev info for FS from disk.
    Set *FULLY_PACKED when there is no completed unpacked shard.
    Use SCRATCH_POOL for temporary allocations.
@@ -2080,6 +2725,14 @@ pack_body(void *baton,
     pb->revsprops_dir = svn_dirent_join(pb->fs->path, PATH_REVPROPS_DIR,
                                         pool);
 
+#if APR_HAS_THREADS
+  /* Pack several shards at once, if we have been asked to and we are able
+     to open independent instances of FS. */
+  if (ffd->pack_jobs > 1 && ffd->svn_fs_open_)
+    return svn_error_trace(pack_shards_concurrently(pb, completed_shards,
+                                                    pool));
+#endif
+
   iterpool = svn_pool_create(pool);
   for (pb->shard = ffd->min_unpacked_rev / ffd->max_files_per_dir;
        pb->shard < completed_shards;
@@ -46,6 +46,11 @@ init_revision_file(svn_fs_fs__revision_file_t *file,
 
   file->file = NULL;
   file->stream = NULL;
+#if APR_HAS_MMAP
+  file->mmap = NULL;
+#endif
+  file->mapped_data = NULL;
+  file->mapped_size = 0;
   file->p2l_stream = NULL;
   file->l2p_stream = NULL;
   file->block_size = ffd->block_size;
@@ -120,6 +125,38 @@ auto_make_writable(const char *path,
   return SVN_NO_ERROR;
 }
 
+/* Pack files larger than this will not be mapped into memory on systems
+ * with a 32 bit address space. */
+#define MAX_MAPPED_SIZE_32BIT 0x10000000
+
+/* Try to map the open pack FILE into memory.  Mapping is an optimization
+ * only, i.e. if it fails for any reason, we simply continue to use the
+ * normal buffered file access. */
+static void
+auto_map_file(svn_fs_fs__revision_file_t *file)
+{
+#if APR_HAS_MMAP
+  apr_finfo_t finfo;
+  apr_mmap_t *mmap;
+
+  if (apr_file_info_get(&finfo, APR_FINFO_SIZE, file->file) != APR_SUCCESS)
+    return;
+
+  /* Don't exhaust the address space of 32 bit processes. */
+  if (   finfo.size <= 0
+      || (sizeof(apr_size_t) < 8 && finfo.size > MAX_MAPPED_SIZE_32BIT))
+    return;
+
+  if (apr_mmap_create(&mmap, file->file, 0, (apr_size_t)finfo.size,
+                      APR_MMAP_READ, file->pool) != APR_SUCCESS)
+    return;
+
+  file->mmap = mmap;
+  file->mapped_data = mmap->mm;
+  file->mapped_size = finfo.size;
+#endif
+}
+
 /* Core implementation of svn_fs_fs__open_pack_or_rev_file working on an
  * existing, initialized FILE structure.  If WRITABLE is TRUE, give write
  * access to the file - temporarily resetting the r/o state if necessary.
@@ -160,6 +197,11 @@ open_pack_or_rev_file(svn_fs_fs__revision_file_t *file,
                                                   result_pool);
           file->is_packed = svn_fs_fs__is_packed_rev(fs, rev);
 
+          /* Pack files are immutable, i.e. we may serve them directly
+           * from the page cache. */
+          if (file->is_packed && !writable && ffd->mmap_pack_files)
+            auto_map_file(file);
+
           return SVN_NO_ERROR;
         }
 
@@ -236,24 +278,50 @@ svn_fs_fs__auto_read_footer(svn_fs_fs__revision_file_t *file)
       unsigned char footer_length;
       svn_stringbuf_t *footer;
 
-      /* Determine file size. */
-      SVN_ERR(svn_io_file_seek(file->file, APR_END, &filesize, file->pool));
-
-      /* Read last byte (containing the length of the footer). */
-      SVN_ERR(svn_io_file_aligned_seek(file->file, file->block_size, NULL,
-                                       filesize - 1, file->pool));
-      SVN_ERR(svn_io_file_read_full2(file->file, &footer_length,
-                                     sizeof(footer_length), NULL, NULL,
-                                     file->pool));
-
-      /* Read footer. */
-      footer = svn_stringbuf_create_ensure(footer_length, file->pool);
-      SVN_ERR(svn_io_file_aligned_seek(file->file, file->block_size, NULL,
-                                       filesize - 1 - footer_length,
-                                       file->pool));
-      SVN_ERR(svn_io_file_read_full2(file->file, footer->data, footer_length,
-                                     &footer->len, NULL, file->pool));
-      footer->data[footer->len] = '\0';
+      if (file->mapped_data)
+        {
+          /* Mapped files allow us to take the footer directly from
+           * memory. */
+          filesize = file->mapped_size;
+          footer_length = file->mapped_data[filesize - 1];
+          if (footer_length >= filesize)
+            return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
+                                     _("Footer of revision file (r%ld) is "
+                                       "longer than the file"),
+                                     file->start_revision);
+
+          footer = svn_stringbuf_ncreate((const char *)file->mapped_data
+                                           + filesize - 1 - footer_length,
+                                         footer_length, file->pool);
+        }
+      else
+        {
+          /* Determine file size. */
+          SVN_ERR(svn_io_file_seek(file->file, APR_END, &filesize,
+                                   file->pool));
+
+          /* Read last byte (containing the length of the footer). */
+          SVN_ERR(svn_io_file_aligned_seek(file->file, file->block_size,
+                                           NULL, filesize - 1, file->pool));
+          SVN_ERR(svn_io_file_read_full2(file->file, &footer_length,
+                                         sizeof(footer_length), NULL, NULL,
+                                         file->pool));
+          if (footer_length >= filesize)
+            return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
+                                     _("Footer of revision file (r%ld) is "
+                                       "longer than the file"),
+                                     file->start_revision);
+
+          /* Read footer. */
+          footer = svn_stringbuf_create_ensure(footer_length, file->pool);
+          SVN_ERR(svn_io_file_aligned_seek(file->file, file->block_size,
+                                           NULL, filesize - 1 - footer_length,
+                                           file->pool));
+          SVN_ERR(svn_io_file_read_full2(file->file, footer->data,
+                                         footer_length, &footer->len, NULL,
+                                         file->pool));
+          footer->data[footer->len] = '\0';
+        }
 
       /* Extract index locations. */
       SVN_ERR(svn_fs_fs__parse_footer(&file->l2p_offset, &file->l2p_checksum,
@@ -293,6 +361,17 @@ svn_fs_fs__open_proto_rev_file(svn_fs_fs__revision_file_t **file,
 svn_error_t *
 svn_fs_fs__close_revision_file(svn_fs_fs__revision_file_t *file)
 {
+#if APR_HAS_MMAP
+  if (file->mmap)
+    {
+      apr_status_t status = apr_mmap_delete(file->mmap);
+      if (status)
+        return svn_error_wrap_apr(status, _("Can't unmap pack file"));
+    }
+
+  file->mmap = NULL;
+#endif
+
   if (file->stream)
     SVN_ERR(svn_stream_close(file->stream));
   if (file->file)
@@ -300,6 +379,8 @@ svn_fs_fs__close_revision_file(svn_fs_fs__revision_file_t *file)
 
   file->file = NULL;
   file->stream = NULL;
+  file->mapped_data = NULL;
+  file->mapped_size = 0;
   file->l2p_stream = NULL;
   file->p2l_stream = NULL;
 
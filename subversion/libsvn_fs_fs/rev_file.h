@@ -23,6 +23,8 @@
 #ifndef SVN_LIBSVN_FS__REV_FILE_H
 #define SVN_LIBSVN_FS__REV_FILE_H
 
+#include <apr_mmap.h>
+
 #include "svn_fs.h"
 #include "id.h"
 
@@ -57,6 +59,19 @@ typedef struct svn_fs_fs__revision_file_t
   /* stream based on FILE and not NULL exactly when FILE is not NULL */
   svn_stream_t *stream;
 
+#if APR_HAS_MMAP
+  /* read-only mapping of the whole FILE or NULL if not mapped */
+  apr_mmap_t *mmap;
+#endif
+
+  /* Contents of FILE as mapped into memory or NULL if not mapped.
+   * Only pack files opened for reading will get mapped and only if
+   * FS->FFD->MMAP_PACK_FILES has been set. */
+  const unsigned char *mapped_data;
+
+  /* Number of bytes in MAPPED_DATA.  0 if not mapped. */
+  apr_off_t mapped_size;
+
   /* the opened P2L index stream or NULL.  Always NULL for txns. */
   svn_fs_fs__packed_number_stream_t *p2l_stream;
 
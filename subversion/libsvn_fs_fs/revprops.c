@@ -133,6 +133,129 @@ svn_fs_fs__upgrade_cleanup_pack_revprops(svn_fs_t *fs,
   return SVN_NO_ERROR;
 }
 
+/* Set *STORED to TRUE if the revprop pack file at PATH has been stored
+ * uncompressed, i.e. if the content size prefix matches the remainder of
+ * the file.  Set it to FALSE otherwise.  Only the prefix gets read.
+ * Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+is_pack_stored(svn_boolean_t *stored,
+               const char *path,
+               apr_pool_t *scratch_pool)
+{
+  apr_file_t *file;
+  svn_filesize_t file_size;
+  unsigned char prefix[SVN__MAX_ENCODED_UINT_LEN];
+  apr_size_t len;
+  const unsigned char *p;
+  apr_uint64_t size;
+
+  SVN_ERR(svn_io_file_open(&file, path, APR_READ, APR_OS_DEFAULT,
+                           scratch_pool));
+  SVN_ERR(svn_io_file_size_get(&file_size, file, scratch_pool));
+
+  len = (apr_size_t)MIN((svn_filesize_t)sizeof(prefix), file_size);
+  SVN_ERR(svn_io_file_read_full2(file, prefix, len, NULL, NULL,
+                                 scratch_pool));
+  SVN_ERR(svn_io_file_close(file, scratch_pool));
+
+  p = svn__decode_uint(&size, prefix, prefix + len);
+  if (p == NULL)
+    return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
+                             _("Revprop pack file '%s' is corrupt"),
+                             svn_dirent_local_style(path, scratch_pool));
+
+  *stored = size == (apr_uint64_t)(file_size - (p - prefix));
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_fs_fs__upgrade_store_packed_revprops(svn_fs_t *fs,
+                                         svn_fs_upgrade_notify_t notify_func,
+                                         void *notify_baton,
+                                         svn_cancel_func_t cancel_func,
+                                         void *cancel_baton,
+                                         apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_int64_t shard;
+  apr_int64_t first_unpacked_shard;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+
+  SVN_ERR(svn_fs_fs__update_min_unpacked_rev(fs, scratch_pool));
+  first_unpacked_shard = ffd->min_unpacked_rev / ffd->max_files_per_dir;
+
+  for (shard = 0; shard < first_unpacked_shard; ++shard)
+    {
+      const char *folder;
+      svn_stringbuf_t *manifest;
+      apr_array_header_t *filenames;
+      const char *previous = "";
+      svn_boolean_t converted = FALSE;
+      int i;
+
+      svn_pool_clear(iterpool);
+
+      folder = svn_fs_fs__path_revprops_pack_shard(
+                 fs, (svn_revnum_t)(shard * ffd->max_files_per_dir),
+                 iterpool);
+      SVN_ERR(svn_fs_fs__read_content(&manifest,
+                                      svn_dirent_join(folder, PATH_MANIFEST,
+                                                      iterpool),
+                                      iterpool));
+
+      /* Consecutive revisions share the same pack file. */
+      filenames = svn_cstring_split(manifest->data, "\n", TRUE, iterpool);
+      for (i = 0; i < filenames->nelts; ++i)
+        {
+          const char *filename = APR_ARRAY_IDX(filenames, i, const char *);
+          const char *path;
+          svn_boolean_t is_stored;
+          svn_stringbuf_t *content;
+          svn_stringbuf_t *uncompressed;
+          svn_stringbuf_t *stored;
+
+          if (strcmp(filename, previous) == 0)
+            continue;
+          previous = filename;
+
+          if (cancel_func)
+            SVN_ERR(cancel_func(cancel_baton));
+
+          /* Skip packs that have already been stored uncompressed.  This
+           * is the common case once a repository has been upgraded, so
+           * don't read more than the size prefix for it. */
+          path = svn_dirent_join(folder, filename, iterpool);
+          SVN_ERR(is_pack_stored(&is_stored, path, iterpool));
+          if (is_stored)
+            continue;
+
+          /* Rewrite the pack without compression.  Its logical content
+           * does not change, so readers may see either version. */
+          SVN_ERR(svn_stringbuf_from_file2(&content, path, iterpool));
+          uncompressed = svn_stringbuf_create_empty(iterpool);
+          stored = svn_stringbuf_create_empty(iterpool);
+          SVN_ERR(svn__decompress_zlib(content->data, content->len,
+                                       uncompressed, APR_SIZE_MAX));
+          SVN_ERR(svn__compress_zlib(uncompressed->data, uncompressed->len,
+                                     stored,
+                                     SVN_DELTA_COMPRESSION_LEVEL_NONE));
+          SVN_ERR(svn_io_write_atomic2(path, stored->data, stored->len,
+                                       path, ffd->flush_to_disk, iterpool));
+          converted = TRUE;
+        }
+
+      if (notify_func && converted)
+        SVN_ERR(notify_func(notify_baton, shard,
+                            svn_fs_upgrade_pack_revprops, iterpool));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
 /* Container for all data required to access the packed revprop file
  * for a given REVISION.  This structure will be filled incrementally
  * by read_pack_revprops() its sub-routines.
@@ -440,6 +563,39 @@ same_shard(svn_fs_t *fs,
   return (r1 / ffd->max_files_per_dir) == (r2 / ffd->max_files_per_dir);
 }
 
+/* Return an error if the revprop pack header found in the pack file for
+ * REVISION in FS claims that the pack covers COUNT revisions starting at
+ * FIRST_REV and that range is not plausible.
+ */
+static svn_error_t *
+verify_pack_range(svn_fs_t *fs,
+                  svn_revnum_t revision,
+                  apr_int64_t first_rev,
+                  apr_int64_t count)
+{
+  /* Check revision range for validity. */
+  if (   !same_shard(fs, revision, first_rev)
+      || !same_shard(fs, revision, first_rev + count - 1)
+      || count < 1)
+    return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
+                             _("Revprop pack for revision r%ld"
+                               " contains revprops for r%ld .. r%ld"),
+                             revision,
+                             (svn_revnum_t)first_rev,
+                             (svn_revnum_t)(first_rev + count -1));
+
+  /* Since start & end are in the same shard, it is enough to just test
+   * the FIRST_REV for being actually packed.  That will also cover the
+   * special case of rev 0 never being packed. */
+  if (!svn_fs_fs__is_packed_revprop(fs, first_rev))
+    return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
+                             _("Revprop pack for revision r%ld"
+                               " starts at non-packed revisions r%ld"),
+                             revision, (svn_revnum_t)first_rev);
+
+  return SVN_NO_ERROR;
+}
+
 /* Given FS and the full packed file content in REVPROPS->PACKED_REVPROPS,
  * fill the START_REVISION member, and make PACKED_REVPROPS point to the
  * first serialized revprop.  If READ_ALL is set, initialize the SIZES
@@ -481,25 +637,7 @@ parse_packed_revprops(svn_fs_t *fs,
   SVN_ERR(svn_fs_fs__read_number_from_stream(&count, NULL, stream,
                                              iterpool));
 
-  /* Check revision range for validity. */
-  if (   !same_shard(fs, revprops->revision, first_rev)
-      || !same_shard(fs, revprops->revision, first_rev + count - 1)
-      || count < 1)
-    return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
-                             _("Revprop pack for revision r%ld"
-                               " contains revprops for r%ld .. r%ld"),
-                             revprops->revision,
-                             (svn_revnum_t)first_rev,
-                             (svn_revnum_t)(first_rev + count -1));
-
-  /* Since start & end are in the same shard, it is enough to just test
-   * the FIRST_REV for being actually packed.  That will also cover the
-   * special case of rev 0 never being packed. */
-  if (!svn_fs_fs__is_packed_revprop(fs, first_rev))
-    return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
-                             _("Revprop pack for revision r%ld"
-                               " starts at non-packed revisions r%ld"),
-                             revprops->revision, (svn_revnum_t)first_rev);
+  SVN_ERR(verify_pack_range(fs, revprops->revision, first_rev, count));
 
   /* make PACKED_REVPROPS point to the first char after the header.
    * This is where the serialized revprops are. */
@@ -599,10 +737,140 @@ parse_packed_revprops(svn_fs_t *fs,
   return SVN_NO_ERROR;
 }
 
+/* Read granularity used when looking for the end of a pack file header. */
+#define PACK_HEADER_BLOCK_SIZE 0x1000
+
+/* Read the revprops for REVPROPS->REVISION in FS from the pack file at
+ * FILE_PATH without reading the whole file.  This is only possible for
+ * packs that have been stored uncompressed; their header already lists
+ * the sizes of all revprops in the pack and allows us to seek directly
+ * to the revision that we want.
+ *
+ * Set *STORED to FALSE and leave REVPROPS unchanged if the pack has been
+ * compressed.  Otherwise, set *STORED to TRUE and fill the PROPERTIES,
+ * SERIALIZED_SIZE and START_REVISION members of REVPROPS.
+ *
+ * Allocate the properties in RESULT_POOL and use SCRATCH_POOL for
+ * temporary allocations.
+ */
+static svn_error_t *
+read_stored_revprop(svn_boolean_t *stored,
+                    packed_revprops_t *revprops,
+                    svn_fs_t *fs,
+                    const char *file_path,
+                    apr_pool_t *result_pool,
+                    apr_pool_t *scratch_pool)
+{
+  apr_file_t *file;
+  svn_filesize_t file_size;
+  svn_stringbuf_t *header;
+  apr_size_t content_start = 0;
+  const char *header_end = NULL;
+  apr_uint64_t content_size;
+  apr_int64_t first_rev, count, i;
+  apr_int64_t size = 0;
+  apr_off_t offset;
+  svn_stream_t *stream;
+  svn_stringbuf_t *serialized;
+
+  SVN_ERR(svn_io_file_open(&file, file_path, APR_READ | APR_BUFFERED,
+                           APR_OS_DEFAULT, scratch_pool));
+  SVN_ERR(svn_io_file_size_get(&file_size, file, scratch_pool));
+
+  /* Read the pack file block by block until we found the end of its
+   * header.  It is usually contained in the first block. */
+  header = svn_stringbuf_create_ensure(PACK_HEADER_BLOCK_SIZE, scratch_pool);
+  while (header_end == NULL)
+    {
+      apr_size_t to_read
+        = (apr_size_t)MIN(PACK_HEADER_BLOCK_SIZE, file_size - header->len);
+      if (to_read == 0)
+        return svn_error_create(SVN_ERR_FS_CORRUPT, NULL,
+                                _("Header end not found"));
+
+      svn_stringbuf_ensure(header, header->len + to_read);
+      SVN_ERR(svn_io_file_read_full2(file, header->data + header->len,
+                                     to_read, NULL, NULL, scratch_pool));
+      header->len += to_read;
+      header->data[header->len] = '\0';
+
+      /* The pack content is prefixed by its uncompressed size.  If that
+       * does not match the remainder of the file, the pack is compressed
+       * and we can't access individual revprops without inflating it. */
+      if (content_start == 0)
+        {
+          const unsigned char *data = (const unsigned char *)header->data;
+          const unsigned char *p = svn__decode_uint(&content_size, data,
+                                                    data + header->len);
+          if (p == NULL)
+            return svn_error_create(SVN_ERR_FS_CORRUPT, NULL,
+                                    _("Revprop pack size not found"));
+
+          content_start = p - data;
+          if (content_size != (apr_uint64_t)(file_size - content_start))
+            {
+              *stored = FALSE;
+              return svn_error_trace(svn_io_file_close(file, scratch_pool));
+            }
+        }
+
+      header_end = strstr(header->data + content_start, "\n\n");
+    }
+
+  /* Parse first revision number and number of revisions in the pack. */
+  stream = svn_stream_from_string(
+             svn_string_ncreate(header->data + content_start,
+                                header_end - header->data - content_start + 1,
+                                scratch_pool),
+             scratch_pool);
+  SVN_ERR(svn_fs_fs__read_number_from_stream(&first_rev, NULL, stream,
+                                             scratch_pool));
+  SVN_ERR(svn_fs_fs__read_number_from_stream(&count, NULL, stream,
+                                             scratch_pool));
+  SVN_ERR(verify_pack_range(fs, revprops->revision, first_rev, count));
+  if (   revprops->revision < first_rev
+      || revprops->revision >= first_rev + count)
+    return svn_error_createf(SVN_ERR_FS_CORRUPT, NULL,
+                             _("Revprop pack does not contain r%ld"),
+                             revprops->revision);
+
+  /* Sum up the sizes of all revprops stored in front of ours. */
+  offset = header_end - header->data + 2;
+  for (i = first_rev; i <= revprops->revision; ++i)
+    {
+      SVN_ERR(svn_fs_fs__read_number_from_stream(&size, NULL, stream,
+                                                 scratch_pool));
+      if (size < 0 || size > file_size - offset)
+        return svn_error_create(SVN_ERR_FS_CORRUPT, NULL,
+                        _("Packed revprop size exceeds pack file size"));
+      if (i < revprops->revision)
+        offset += (apr_off_t)size;
+    }
+
+  /* Read and parse just the revprops of the revision we want. */
+  serialized = svn_stringbuf_create_ensure((apr_size_t)size, scratch_pool);
+  SVN_ERR(svn_io_file_seek(file, APR_SET, &offset, scratch_pool));
+  SVN_ERR(svn_io_file_read_full2(file, serialized->data, (apr_size_t)size,
+                                 NULL, NULL, scratch_pool));
+  serialized->len = (apr_size_t)size;
+  serialized->data[serialized->len] = '\0';
+  SVN_ERR(svn_io_file_close(file, scratch_pool));
+
+  SVN_ERR(parse_revprop(&revprops->properties, fs, revprops->revision,
+                        svn_stringbuf__morph_into_string(serialized),
+                        result_pool, scratch_pool));
+  revprops->serialized_size = (apr_size_t)size;
+  revprops->start_revision = (svn_revnum_t)first_rev;
+  *stored = TRUE;
+
+  return SVN_NO_ERROR;
+}
+
 /* In filesystem FS, read the packed revprops for revision REV into
  * *REVPROPS. Populate the revprop cache, if POPULATE_CACHE is set.
  * If you want to modify revprop contents / update REVPROPS, READ_ALL
- * must be set.  Otherwise, only the properties of REV are being provided.
+ * must be set.  Otherwise, only the properties of REV are being provided
+ * and, if the pack is stored uncompressed, only they will be read from it.
  * Allocate data in POOL.
  */
 static svn_error_t *
@@ -613,12 +881,19 @@ read_pack_revprop(packed_revprops_t **revprops,
                   svn_boolean_t populate_cache,
                   apr_pool_t *pool)
 {
+  fs_fs_data_t *ffd = fs->fsap_data;
   apr_pool_t *iterpool = svn_pool_create(pool);
   svn_boolean_t missing = FALSE;
   svn_error_t *err;
   packed_revprops_t *result;
   int i;
 
+  /* Reading the whole pack is only worth it if we want all of its
+   * contents, either for modification or for populating the cache. */
+  svn_boolean_t read_single
+    = !read_all
+    && !(populate_cache && svn_cache__is_cachable(ffd->revprop_cache, 1));
+
   /* someone insisted that REV is packed. Double-check if necessary */
   if (!svn_fs_fs__is_packed_revprop(fs, rev))
      SVN_ERR(svn_fs_fs__update_min_unpacked_rev(fs, iterpool));
@@ -647,6 +922,46 @@ read_pack_revprop(packed_revprops_t **revprops,
       file_path  = svn_dirent_join(result->folder,
                                    result->filename,
                                    iterpool);
+
+      /* Try to pick just the revprops for REV from the pack file. */
+      if (read_single)
+        {
+          svn_boolean_t stored;
+
+          err = read_stored_revprop(&stored, result, fs, file_path, pool,
+                                    iterpool);
+          if (!err)
+            {
+              if (stored)
+                {
+                  svn_pool_destroy(iterpool);
+                  *revprops = result;
+                  return SVN_NO_ERROR;
+                }
+
+              /* The pack is compressed. Read it as a whole. */
+              read_single = FALSE;
+            }
+          else if (   APR_STATUS_IS_ENOENT(err->apr_err)
+                   && i + 1 < SVN_FS_FS__RECOVERABLE_RETRY_COUNT)
+            {
+              /* The pack file got replaced.  Re-read the manifest. */
+              svn_error_clear(err);
+              continue;
+            }
+          else if (APR_STATUS_IS_ENOENT(err->apr_err))
+            {
+              svn_error_clear(err);
+              break;
+            }
+          else
+            {
+              svn_pool_destroy(iterpool);
+              return svn_error_createf(SVN_ERR_FS_CORRUPT, err,
+                          _("Revprop pack file for r%ld is corrupt"), rev);
+            }
+        }
+
       SVN_ERR(svn_fs_fs__try_stringbuf_from_file(&result->packed_revprops,
                                 &missing,
                                 file_path,
@@ -717,14 +1032,10 @@ svn_fs_fs__get_revision_props_size(apr_off_t *props_size_p,
   {
     packed_revprops_t *revprops;
 
-    /* ### This is inefficient -- reading all the revprops in a pack. We
-       should just read the index. */
     SVN_ERR(read_pack_revprop(&revprops, fs, rev,
-                              TRUE /*read_all*/, FALSE /*populate_cache*/,
+                              FALSE /*read_all*/, FALSE /*populate_cache*/,
                               scratch_pool));
-    *props_size_p = (apr_off_t)APR_ARRAY_IDX(revprops->sizes,
-                                             rev - revprops->start_revision,
-                                             apr_size_t);
+    *props_size_p = (apr_off_t)revprops->serialized_size;
   }
 
   return SVN_NO_ERROR;
@@ -58,6 +58,23 @@ svn_fs_fs__upgrade_cleanup_pack_revprops(svn_fs_t *fs,
                                          void *cancel_baton,
                                          apr_pool_t *scratch_pool);
 
+/* In the filesystem FS, rewrite all compressed revprop pack files up to
+ * min_unpacked_rev such that they are stored uncompressed.  Revprops in
+ * such packs can be read one revision at a time without inflating the
+ * whole pack.  NOTIFY_FUNC will be called for every shard that has been
+ * rewritten.
+ *
+ * NOTIFY_FUNC and NOTIFY_BATON as well as CANCEL_FUNC and CANCEL_BATON are
+ * used in the usual way.  Temporary allocations are done in SCRATCH_POOL.
+ */
+svn_error_t *
+svn_fs_fs__upgrade_store_packed_revprops(svn_fs_t *fs,
+                                         svn_fs_upgrade_notify_t notify_func,
+                                         void *notify_baton,
+                                         svn_cancel_func_t cancel_func,
+                                         void *cancel_baton,
+                                         apr_pool_t *scratch_pool);
+
 /* Invalidate the revprop cache in FS. */
 void
 svn_fs_fs__reset_revprop_cache(svn_fs_t *fs);
@@ -20,12 +20,20 @@
  * ====================================================================
  */
 
+#if APR_HAS_THREADS
+#include <apr_thread_pool.h>
+#include <apr_thread_cond.h>
+#endif
+
 #include "svn_dirent_uri.h"
 #include "svn_fs.h"
 #include "svn_pools.h"
 #include "svn_sorts.h"
 
+#include "private/svn_atomic.h"
 #include "private/svn_cache.h"
+#include "private/svn_mutex.h"
+#include "private/svn_packed_data.h"
 #include "private/svn_sorts_private.h"
 #include "private/svn_string_private.h"
 
@@ -123,6 +131,32 @@ typedef struct rep_ref_t
 
 } rep_ref_t;
 
+/* A noderev's reference to a representation that lies before the range of
+ * revisions being read.  Whether this is the first reference to that rep
+ * can only be decided when merging the results in revision order. */
+typedef struct foreign_ref_t
+{
+  /* Revision that contains the representation. */
+  svn_revnum_t revision;
+
+  /* Item index of the representation within REVISION. */
+  apr_uint64_t item_index;
+
+  /* On-disk and expanded size of the representation. */
+  apr_uint64_t size;
+  apr_uint64_t expanded_size;
+
+  /* Path of the referencing node. */
+  const char *path;
+
+  /* Classification of the representation as seen by the referencing node.
+   * Values of rep_kind_t. */
+  char kind;
+
+  /* Whether the referencing node has no predecessor. */
+  svn_boolean_t plain_added;
+} foreign_ref_t;
+
 /* Represents a single revision.
  * There will be only one instance per revision. */
 typedef struct revision_info_t
@@ -173,7 +207,12 @@ typedef struct query_t
   /* FS API object*/
   svn_fs_t *fs;
 
-  /* The HEAD revision. */
+  /* First revision to read, i.e. the revision stored at index 0 in
+   * REVISIONS. */
+  svn_revnum_t first_rev;
+
+  /* Last revision to read.  This is the HEAD revision unless we only read
+   * a part of the repository. */
   svn_revnum_t head;
 
   /* Number of revs per shard; 0 for non-sharded repos. */
@@ -189,9 +228,21 @@ typedef struct query_t
    * Used as a dummy base for DELTA reps without base. */
   rep_stats_t *null_base;
 
+  /* Delta chain links (rep_ref_t *) whose base could not be resolved
+   * within the revisions read, in the order they were found. */
+  apr_array_header_t *deferred_links;
+
+  /* References to reps before FIRST_REV (foreign_ref_t *), in the order
+   * they were found. */
+  apr_array_header_t *foreign_refs;
+
   /* collected statistics */
   svn_fs_fs__stats_t *stats;
 
+  /* Folder to keep the results per pack file in, so later runs don't need
+   * to read them again.  NULL if the results shall not be kept. */
+  const char *state_dir;
+
   /* Progress notification callback to call after each shard.  May be NULL. */
   svn_fs_progress_notify_func_t progress_func;
 
@@ -255,24 +306,18 @@ add_to_histogram(svn_fs_fs__histogram_t *histogram,
   histogram->lines[(apr_size_t)shift].sum += size;
 }
 
-/* Update data aggregators in STATS with this representation of type KIND,
- * on-disk REP_SIZE and expanded node size EXPANDED_SIZE for PATH in REVSION.
- * PLAIN_ADDED indicates whether the node has a deltification predecessor.
+/* Add the change of REP_SIZE for PATH in REVISION to LARGEST_CHANGES,
+ * if it is large enough.
  */
 static void
-add_change(svn_fs_fs__stats_t *stats,
-           apr_uint64_t rep_size,
-           apr_uint64_t expanded_size,
-           svn_revnum_t revision,
-           const char *path,
-           rep_kind_t kind,
-           svn_boolean_t plain_added)
+add_largest_change(svn_fs_fs__largest_changes_t *largest_changes,
+                   apr_uint64_t rep_size,
+                   svn_revnum_t revision,
+                   const char *path)
 {
-  /* identify largest reps */
-  if (rep_size >= stats->largest_changes->min_size)
+  if (rep_size >= largest_changes->min_size)
     {
       apr_size_t i;
-      svn_fs_fs__largest_changes_t *largest_changes = stats->largest_changes;
       svn_fs_fs__large_change_info_t *info
         = largest_changes->changes[largest_changes->count - 1];
       info->size = rep_size;
@@ -291,6 +336,46 @@ add_change(svn_fs_fs__stats_t *stats,
       largest_changes->min_size
         = largest_changes->changes[largest_changes->count-1]->size;
     }
+}
+
+/* Return the entry for file name EXTENSION in STATS.  Auto-create it if
+ * it does not exist, yet.
+ */
+static svn_fs_fs__extension_info_t *
+get_extension_info(svn_fs_fs__stats_t *stats,
+                   const char *extension)
+{
+  svn_fs_fs__extension_info_t *info
+    = apr_hash_get(stats->by_extension, extension, APR_HASH_KEY_STRING);
+
+  if (info == NULL)
+    {
+      apr_pool_t *pool = apr_hash_pool_get(stats->by_extension);
+      info = apr_pcalloc(pool, sizeof(*info));
+      info->extension = apr_pstrdup(pool, extension);
+
+      apr_hash_set(stats->by_extension, info->extension,
+                   APR_HASH_KEY_STRING, info);
+    }
+
+  return info;
+}
+
+/* Update data aggregators in STATS with this representation of type KIND,
+ * on-disk REP_SIZE and expanded node size EXPANDED_SIZE for PATH in REVSION.
+ * PLAIN_ADDED indicates whether the node has a deltification predecessor.
+ */
+static void
+add_change(svn_fs_fs__stats_t *stats,
+           apr_uint64_t rep_size,
+           apr_uint64_t expanded_size,
+           svn_revnum_t revision,
+           const char *path,
+           rep_kind_t kind,
+           svn_boolean_t plain_added)
+{
+  /* identify largest reps */
+  add_largest_change(stats->largest_changes, rep_size, revision, path);
 
   /* global histograms */
   add_to_histogram(&stats->rep_size_histogram, rep_size);
@@ -338,16 +423,7 @@ add_change(svn_fs_fs__stats_t *stats,
         extension = "(none)";
 
       /* get / auto-insert entry for this extension */
-      info = apr_hash_get(stats->by_extension, extension, APR_HASH_KEY_STRING);
-      if (info == NULL)
-        {
-          apr_pool_t *pool = apr_hash_pool_get(stats->by_extension);
-          info = apr_pcalloc(pool, sizeof(*info));
-          info->extension = apr_pstrdup(pool, extension);
-
-          apr_hash_set(stats->by_extension, info->extension,
-                       APR_HASH_KEY_STRING, info);
-        }
+      info = get_extension_info(stats, extension);
 
       /* update per-extension histogram */
       add_to_histogram(&info->node_histogram, expanded_size);
@@ -393,7 +469,14 @@ find_representation(int *idx,
   info = revision_info ? *revision_info : NULL;
   if (info == NULL || info->revision != revision)
     {
-      info = APR_ARRAY_IDX(query->revisions, revision, revision_info_t*);
+      /* Revisions that have not been read are not available. */
+      if (   revision < query->first_rev
+          || revision - query->first_rev >= query->revisions->nelts)
+        info = NULL;
+      else
+        info = APR_ARRAY_IDX(query->revisions, revision - query->first_rev,
+                             revision_info_t*);
+
       if (revision_info)
         *revision_info = info;
     }
@@ -470,7 +553,9 @@ parse_representation(rep_stats_t **representation,
 
           result->header_size = header->header_size;
 
-          /* Determine length of the delta chain. */
+          /* Determine length of the delta chain.  If we have not read
+           * the base rep or don't know its chain length, yet, resolve the
+           * link when merging the results. */
           if (header->type == svn_fs_fs__rep_delta)
             {
               int base_idx;
@@ -479,8 +564,22 @@ parse_representation(rep_stats_t **representation,
                                       header->base_revision,
                                       header->base_item_index);
 
-              result->chain_length = 1 + MIN(base_rep->chain_length,
-                                             (apr_byte_t)0xfe);
+              if (base_rep && base_rep->chain_length)
+                {
+                  result->chain_length = 1 + MIN(base_rep->chain_length,
+                                                 (apr_byte_t)0xfe);
+                }
+              else
+                {
+                  rep_ref_t *ref = apr_pcalloc(result_pool, sizeof(*ref));
+                  ref->revision = rep->revision;
+                  ref->item_index = rep->item_index;
+                  ref->base_revision = header->base_revision;
+                  ref->base_item_index = header->base_item_index;
+                  ref->header_size = header->header_size;
+
+                  APR_ARRAY_PUSH(query->deferred_links, rep_ref_t *) = ref;
+                }
             }
           else
             {
@@ -497,6 +596,32 @@ parse_representation(rep_stats_t **representation,
 }
 
 
+/* Record in QUERY that a node at PATH references the representation REP
+ * that lies before the revisions being read.  KIND is the classification
+ * that REP would get if this was its first reference and PLAIN_ADDED
+ * indicates whether the node has no deltification predecessor.  Allocate
+ * the record in RESULT_POOL.
+ */
+static void
+add_foreign_ref(query_t *query,
+                representation_t *rep,
+                rep_kind_t kind,
+                const char *path,
+                svn_boolean_t plain_added,
+                apr_pool_t *result_pool)
+{
+  foreign_ref_t *ref = apr_pcalloc(result_pool, sizeof(*ref));
+  ref->revision = rep->revision;
+  ref->item_index = rep->item_index;
+  ref->size = rep->size;
+  ref->expanded_size = rep->expanded_size;
+  ref->path = apr_pstrdup(result_pool, path);
+  ref->kind = (char)kind;
+  ref->plain_added = plain_added;
+
+  APR_ARRAY_PUSH(query->foreign_refs, foreign_ref_t *) = ref;
+}
+
 /* forward declaration */
 static svn_error_t *
 read_noderev(query_t *query,
@@ -622,7 +747,14 @@ read_noderev(query_t *query,
   SVN_ERR(svn_fs_fs__fixup_expanded_size(query->fs, noderev->prop_rep,
                                          scratch_pool));
 
-  if (noderev->data_rep)
+  if (noderev->data_rep && noderev->data_rep->revision < query->first_rev)
+    {
+      add_foreign_ref(query, noderev->data_rep,
+                      noderev->kind == svn_node_dir ? dir_rep : file_rep,
+                      noderev->created_path, !noderev->predecessor_id,
+                      result_pool);
+    }
+  else if (noderev->data_rep)
     {
       SVN_ERR(parse_representation(&text, query,
                                    noderev->data_rep, revision_info,
@@ -633,7 +765,15 @@ read_noderev(query_t *query,
         text->kind = noderev->kind == svn_node_dir ? dir_rep : file_rep;
     }
 
-  if (noderev->prop_rep)
+  if (noderev->prop_rep && noderev->prop_rep->revision < query->first_rev)
+    {
+      add_foreign_ref(query, noderev->prop_rep,
+                      noderev->kind == svn_node_dir ? dir_property_rep
+                                                    : file_property_rep,
+                      noderev->created_path, !noderev->predecessor_id,
+                      result_pool);
+    }
+  else if (noderev->prop_rep)
     {
       SVN_ERR(parse_representation(&props, query,
                                    noderev->prop_rep, revision_info,
@@ -817,10 +957,6 @@ read_phys_pack_file(query_t *query,
   /* Done with this pack file. */
   SVN_ERR(svn_fs_fs__close_revision_file(rev_file));
 
-  /* one more pack file processed */
-  if (query->progress_func)
-    query->progress_func(base, query->progress_baton, scratch_pool);
-
   return SVN_NO_ERROR;
 }
 
@@ -866,15 +1002,6 @@ read_phys_revision_file(query_t *query,
   /* put it into our container */
   APR_ARRAY_PUSH(query->revisions, revision_info_t*) = info;
 
-  /* show progress every 1000 revs or so */
-  if (query->progress_func)
-    {
-      if (query->shard_size && (revision % query->shard_size == 0))
-        query->progress_func(revision, query->progress_baton, scratch_pool);
-      if (!query->shard_size && (revision % 1000 == 0))
-        query->progress_func(revision, query->progress_baton, scratch_pool);
-    }
-
   return SVN_NO_ERROR;
 }
 
@@ -940,11 +1067,14 @@ compare_representation_refs(const void *lhs, const void *rhs)
 
 /* Given all the presentations found in a single rev / pack file as
  * rep_ref_t * in REP_REFS, update the delta chain lengths in QUERY.
- * REP_REFS and its contents can then be discarded.
+ * Links whose base has not been read are being copied into RESULT_POOL
+ * and get deferred to when the results are being merged.  REP_REFS and
+ * its contents can then be discarded.
  */
 static svn_error_t *
 resolve_representation_refs(query_t *query,
-                            apr_array_header_t *rep_refs)
+                            apr_array_header_t *rep_refs,
+                            apr_pool_t *result_pool)
 {
   int i;
 
@@ -978,10 +1108,12 @@ resolve_representation_refs(query_t *query,
 
           base = find_representation(&idx, query, NULL, ref->base_revision,
                                      ref->base_item_index);
-          SVN_ERR_ASSERT(base);
-          SVN_ERR_ASSERT(base->chain_length);
-
-          rep->chain_length = 1 + MIN(base->chain_length, (apr_byte_t)0xfe);
+          if (base && base->chain_length)
+            rep->chain_length = 1 + MIN(base->chain_length,
+                                        (apr_byte_t)0xfe);
+          else
+            APR_ARRAY_PUSH(query->deferred_links, rep_ref_t *)
+              = apr_pmemdup(result_pool, ref, sizeof(*ref));
         }
     }
 
@@ -1034,7 +1166,8 @@ read_log_rev_or_packfile(query_t *query,
 
   /* record the whole pack size in the first rev so the total sum will
      still be correct */
-  APR_ARRAY_IDX(query->revisions, base, revision_info_t*)->end = max_offset;
+  APR_ARRAY_IDX(query->revisions, base - query->first_rev,
+                revision_info_t*)->end = max_offset;
 
   /* for all offsets in the file, get the P2L index entries and process
      the interesting items (change lists, noderevs) */
@@ -1070,7 +1203,8 @@ read_log_rev_or_packfile(query_t *query,
             continue;
 
           /* read and process interesting items */
-          info = APR_ARRAY_IDX(query->revisions, entry->item.revision,
+          info = APR_ARRAY_IDX(query->revisions,
+                               entry->item.revision - query->first_rev,
                                revision_info_t*);
 
           if (entry->type == SVN_FS_FS__ITEM_TYPE_NODEREV)
@@ -1126,7 +1260,7 @@ read_log_rev_or_packfile(query_t *query,
     }
 
   /* Resolve the delta chain links. */
-  SVN_ERR(resolve_representation_refs(query, rep_refs));
+  SVN_ERR(resolve_representation_refs(query, rep_refs, result_pool));
 
   /* clean up and close file handles */
   svn_pool_destroy(iterpool);
@@ -1134,56 +1268,8 @@ read_log_rev_or_packfile(query_t *query,
   return SVN_NO_ERROR;
 }
 
-/* Read the content of the pack file staring at revision BASE logical
- * addressing mode and store it in QUERY.
- *
- * Use RESULT_POOL for persistent allocations and SCRATCH_POOL for
- * temporaries.
- */
-static svn_error_t *
-read_log_pack_file(query_t *query,
-                   svn_revnum_t base,
-                   apr_pool_t *result_pool,
-                   apr_pool_t *scratch_pool)
-{
-  SVN_ERR(read_log_rev_or_packfile(query, base, query->shard_size,
-                                   result_pool, scratch_pool));
-
-  /* one more pack file processed */
-  if (query->progress_func)
-    query->progress_func(base, query->progress_baton, scratch_pool);
-
-  return SVN_NO_ERROR;
-}
-
-/* Read the content of the file for REVISION in logical addressing mode
- * and store its contents in QUERY.
- *
- * Use RESULT_POOL for persistent allocations and SCRATCH_POOL for
- * temporaries.
- */
-static svn_error_t *
-read_log_revision_file(query_t *query,
-                       svn_revnum_t revision,
-                       apr_pool_t *result_pool,
-                       apr_pool_t *scratch_pool)
-{
-  SVN_ERR(read_log_rev_or_packfile(query, revision, 1,
-                                   result_pool, scratch_pool));
-
-  /* show progress every 1000 revs or so */
-  if (query->progress_func)
-    {
-      if (query->shard_size && (revision % query->shard_size == 0))
-        query->progress_func(revision, query->progress_baton, scratch_pool);
-      if (!query->shard_size && (revision % 1000 == 0))
-        query->progress_func(revision, query->progress_baton, scratch_pool);
-    }
-
-  return SVN_NO_ERROR;
-}
-
-/* Read the repository and collect the stats info in QUERY.
+/* Read the revisions QUERY->FIRST_REV to QUERY->HEAD and collect the
+ * stats info in QUERY.
  *
  * Use RESULT_POOL for persistent allocations and SCRATCH_POOL for
  * temporaries.
@@ -1197,14 +1283,15 @@ read_revisions(query_t *query,
   svn_revnum_t revision;
 
   /* read all packed revs */
-  for ( revision = 0
-      ; revision < query->min_unpacked_rev
+  for ( revision = query->first_rev
+      ; revision < query->min_unpacked_rev && revision <= query->head
       ; revision += query->shard_size)
     {
       svn_pool_clear(iterpool);
 
       if (svn_fs_fs__use_log_addressing(query->fs))
-        SVN_ERR(read_log_pack_file(query, revision, result_pool, iterpool));
+        SVN_ERR(read_log_rev_or_packfile(query, revision, query->shard_size,
+                                         result_pool, iterpool));
       else
         SVN_ERR(read_phys_pack_file(query, revision, result_pool, iterpool));
     }
@@ -1215,8 +1302,8 @@ read_revisions(query_t *query,
       svn_pool_clear(iterpool);
 
       if (svn_fs_fs__use_log_addressing(query->fs))
-        SVN_ERR(read_log_revision_file(query, revision, result_pool,
-                                       iterpool));
+        SVN_ERR(read_log_rev_or_packfile(query, revision, 1,
+                                         result_pool, iterpool));
       else
         SVN_ERR(read_phys_revision_file(query, revision, result_pool,
                                         iterpool));
@@ -1331,14 +1418,15 @@ create_stats(apr_pool_t *result_pool)
 }
 
 /* Create a *QUERY, allocated in RESULT_POOL, reading filesystem FS and
- * collecting results in STATS.  Store the optional PROCESS_FUNC and
- * PROGRESS_BATON as well as CANCEL_FUNC and CANCEL_BATON in *QUERY, too.
- * Use SCRATCH_POOL for temporary allocations.
+ * collecting results in STATS.  Store the optional STATE_DIR,
+ * PROCESS_FUNC and PROGRESS_BATON as well as CANCEL_FUNC and CANCEL_BATON
+ * in *QUERY, too.  Use SCRATCH_POOL for temporary allocations.
  */
 static svn_error_t *
 create_query(query_t **query,
              svn_fs_t *fs,
              svn_fs_fs__stats_t *stats,
+             const char *state_dir,
              svn_fs_progress_notify_func_t progress_func,
              void *progress_baton,
              svn_cancel_func_t cancel_func,
@@ -1360,14 +1448,20 @@ create_query(query_t **query,
    * of both the nelts field of the array and our revision numbers). This
    * means this code will fail on platforms where int is less than 32-bits
    * and the repository has more revisions than int can hold. */
+  (*query)->first_rev = 0;
   (*query)->revisions = apr_array_make(result_pool, (int) (*query)->head + 1,
                                        sizeof(revision_info_t *));
   (*query)->null_base = apr_pcalloc(result_pool,
                                     sizeof(*(*query)->null_base));
+  (*query)->deferred_links = apr_array_make(result_pool, 0,
+                                            sizeof(rep_ref_t *));
+  (*query)->foreign_refs = apr_array_make(result_pool, 0,
+                                          sizeof(foreign_ref_t *));
 
   /* Store other parameters */
   (*query)->fs = fs;
   (*query)->stats = stats;
+  (*query)->state_dir = state_dir;
   (*query)->progress_func = progress_func;
   (*query)->progress_baton = progress_baton;
   (*query)->cancel_func = cancel_func;
@@ -1376,9 +1470,1043 @@ create_query(query_t **query,
   return SVN_NO_ERROR;
 }
 
+/* Return the last revision of the unit of work in QUERY that starts at
+ * FIRST_REV.  Units are either a whole pack file or the non-packed
+ * revisions of one shard.  Non-sharded repositories are being split into
+ * units of 1000 revisions.
+ */
+static svn_revnum_t
+get_unit_end(const query_t *query,
+             svn_revnum_t first_rev)
+{
+  svn_revnum_t unit_size = query->shard_size ? query->shard_size : 1000;
+  svn_revnum_t last_rev = (first_rev / unit_size + 1) * unit_size - 1;
+
+  return MIN(last_rev, query->head);
+}
+
+/* Create a *UNIT, allocated in RESULT_POOL, for the unit of work in QUERY
+ * that starts at FIRST_REV.  The unit collects its results independently
+ * from QUERY and reads the repository through FS, which may be a separate
+ * instance of QUERY->FS.
+ */
+static void
+create_unit(query_t **unit,
+            const query_t *query,
+            svn_fs_t *fs,
+            svn_revnum_t first_rev,
+            apr_pool_t *result_pool)
+{
+  query_t *result = apr_pmemdup(result_pool, query, sizeof(*result));
+
+  result->fs = fs;
+  result->first_rev = first_rev;
+  result->head = get_unit_end(query, first_rev);
+  result->revisions = apr_array_make(result_pool,
+                                     (int)(result->head - first_rev + 1),
+                                     sizeof(revision_info_t *));
+  result->null_base = apr_pcalloc(result_pool, sizeof(*result->null_base));
+  result->deferred_links = apr_array_make(result_pool, 16,
+                                          sizeof(rep_ref_t *));
+  result->foreign_refs = apr_array_make(result_pool, 16,
+                                        sizeof(foreign_ref_t *));
+  result->stats = create_stats(result_pool);
+
+  /* Only QUERY reports progress. */
+  result->progress_func = NULL;
+  result->progress_baton = NULL;
+
+  *unit = result;
+}
+
+/* Number of histograms in svn_fs_fs__stats_t, not counting those per
+ * file extension. */
+#define STATS_HISTOGRAM_COUNT 13
+
+/* Set the elements of HISTOGRAMS to the addresses of all histograms in
+ * STATS, except those per file extension.
+ */
+static void
+get_histograms(svn_fs_fs__histogram_t *histograms[STATS_HISTOGRAM_COUNT],
+               svn_fs_fs__stats_t *stats)
+{
+  histograms[0] = &stats->rep_size_histogram;
+  histograms[1] = &stats->node_size_histogram;
+  histograms[2] = &stats->added_rep_size_histogram;
+  histograms[3] = &stats->added_node_size_histogram;
+  histograms[4] = &stats->unused_rep_histogram;
+  histograms[5] = &stats->file_histogram;
+  histograms[6] = &stats->file_rep_histogram;
+  histograms[7] = &stats->file_prop_histogram;
+  histograms[8] = &stats->file_prop_rep_histogram;
+  histograms[9] = &stats->dir_histogram;
+  histograms[10] = &stats->dir_rep_histogram;
+  histograms[11] = &stats->dir_prop_histogram;
+  histograms[12] = &stats->dir_prop_rep_histogram;
+}
+
+/* Add the contents of histogram SOURCE to TARGET.
+ */
+static void
+merge_histogram(svn_fs_fs__histogram_t *target,
+                const svn_fs_fs__histogram_t *source)
+{
+  apr_size_t i;
+
+  target->total.count += source->total.count;
+  target->total.sum += source->total.sum;
+  for (i = 0; i < sizeof(target->lines) / sizeof(target->lines[0]); ++i)
+    {
+      target->lines[i].count += source->lines[i].count;
+      target->lines[i].sum += source->lines[i].sum;
+    }
+}
+
+/* Add the largest changes, histograms and per-extension info in SOURCE
+ * to TARGET.  SOURCE must cover revisions younger than those in TARGET.
+ */
+static void
+merge_stats(svn_fs_fs__stats_t *target,
+            svn_fs_fs__stats_t *source,
+            apr_pool_t *scratch_pool)
+{
+  svn_fs_fs__histogram_t *target_histograms[STATS_HISTOGRAM_COUNT];
+  svn_fs_fs__histogram_t *source_histograms[STATS_HISTOGRAM_COUNT];
+  apr_hash_index_t *hi;
+  apr_size_t i;
+
+  /* Inserting the changes in their original order gives the same result
+   * as if TARGET had seen them itself. */
+  for (i = 0; i < source->largest_changes->count; ++i)
+    {
+      svn_fs_fs__large_change_info_t *info
+        = source->largest_changes->changes[i];
+      if (info->revision == SVN_INVALID_REVNUM)
+        break;
+
+      add_largest_change(target->largest_changes, info->size,
+                         info->revision, info->path->data);
+    }
+
+  get_histograms(target_histograms, target);
+  get_histograms(source_histograms, source);
+  for (i = 0; i < STATS_HISTOGRAM_COUNT; ++i)
+    merge_histogram(target_histograms[i], source_histograms[i]);
+
+  for (hi = apr_hash_first(scratch_pool, source->by_extension);
+       hi;
+       hi = apr_hash_next(hi))
+    {
+      svn_fs_fs__extension_info_t *source_info = apr_hash_this_val(hi);
+      svn_fs_fs__extension_info_t *target_info
+        = get_extension_info(target, source_info->extension);
+
+      merge_histogram(&target_info->rep_histogram,
+                      &source_info->rep_histogram);
+      merge_histogram(&target_info->node_histogram,
+                      &source_info->node_histogram);
+    }
+}
+
+/* Append the results collected in UNIT to QUERY.  UNIT must start right
+ * after the last revision in QUERY.  Resolve the delta chain links and
+ * representation references that UNIT could not resolve on its own.
+ * Allocate new rep_stats_t instances in RESULT_POOL and use SCRATCH_POOL
+ * for temporary allocations.
+ */
+static svn_error_t *
+merge_unit(query_t *query,
+           query_t *unit,
+           apr_pool_t *result_pool,
+           apr_pool_t *scratch_pool)
+{
+  int i;
+
+  SVN_ERR_ASSERT(unit->first_rev
+                 == query->first_rev + query->revisions->nelts);
+  apr_array_cat(query->revisions, unit->revisions);
+
+  /* Bases have been found before the deltas that use them, i.e. we see
+   * the links in chain order. */
+  for (i = 0; i < unit->deferred_links->nelts; ++i)
+    {
+      int idx;
+      rep_ref_t *ref = APR_ARRAY_IDX(unit->deferred_links, i, rep_ref_t *);
+      rep_stats_t *rep = find_representation(&idx, query, NULL,
+                                             ref->revision,
+                                             ref->item_index);
+      rep_stats_t *base = find_representation(&idx, query, NULL,
+                                              ref->base_revision,
+                                              ref->base_item_index);
+
+      /* No dangling pointers. */
+      SVN_ERR_ASSERT(rep);
+
+      rep->header_size = ref->header_size;
+      rep->chain_length = 1 + MIN(base ? base->chain_length : 0,
+                                  (apr_byte_t)0xfe);
+    }
+
+  /* The first reference to a rep determines its kind. */
+  for (i = 0; i < unit->foreign_refs->nelts; ++i)
+    {
+      int idx;
+      revision_info_t *info = NULL;
+      foreign_ref_t *ref = APR_ARRAY_IDX(unit->foreign_refs, i,
+                                         foreign_ref_t *);
+      rep_stats_t *rep = find_representation(&idx, query, &info,
+                                             ref->revision,
+                                             ref->item_index);
+
+      if (!rep)
+        {
+          /* Not referenced within its own revision. */
+          SVN_ERR_ASSERT(info);
+
+          rep = apr_pcalloc(result_pool, sizeof(*rep));
+          rep->revision = ref->revision;
+          rep->item_index = ref->item_index;
+          rep->size = ref->size;
+          rep->expanded_size = ref->expanded_size;
+          rep->chain_length = 1;
+
+          SVN_ERR(svn_sort__array_insert2(info->representations, &rep, idx));
+        }
+
+      if (++rep->ref_count == 1)
+        {
+          rep->kind = ref->kind;
+          add_change(query->stats, rep->size, rep->expanded_size,
+                     rep->revision, ref->path, ref->kind, ref->plain_added);
+        }
+    }
+
+  merge_stats(query->stats, unit->stats, scratch_pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Format number of the files in the state directory. */
+#define STATS_STATE_FORMAT 1
+
+/* Set *PATH to the state file for UNIT and *PACK_SIZE to the size of the
+ * pack file that UNIT covers.  Allocate *PATH in RESULT_POOL and use
+ * SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+get_unit_state_info(const char **path,
+                    apr_off_t *pack_size,
+                    query_t *unit,
+                    apr_pool_t *result_pool,
+                    apr_pool_t *scratch_pool)
+{
+  apr_finfo_t finfo;
+
+  SVN_ERR(svn_io_stat(&finfo,
+                      svn_fs_fs__path_rev_packed(unit->fs, unit->first_rev,
+                                                 PATH_PACKED, scratch_pool),
+                      APR_FINFO_SIZE, scratch_pool));
+
+  *pack_size = finfo.size;
+  *path = svn_dirent_join(unit->state_dir,
+                          apr_psprintf(scratch_pool, "%ld.stats",
+                                       unit->first_rev / unit->shard_size),
+                          result_pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Create COUNT unsigned integer sub-streams in STREAM.
+ */
+static void
+create_substreams(svn_packed__int_stream_t *stream,
+                  int count)
+{
+  int i;
+  for (i = 0; i < count; ++i)
+    svn_packed__create_int_substream(stream, FALSE, FALSE);
+}
+
+/* Append HISTOGRAM to STREAM.
+ */
+static void
+write_histogram(svn_packed__int_stream_t *stream,
+                const svn_fs_fs__histogram_t *histogram)
+{
+  apr_size_t i;
+
+  svn_packed__add_uint(stream, histogram->total.count);
+  svn_packed__add_uint(stream, histogram->total.sum);
+  for (i = 0; i < sizeof(histogram->lines) / sizeof(histogram->lines[0]); ++i)
+    {
+      svn_packed__add_uint(stream, histogram->lines[i].count);
+      svn_packed__add_uint(stream, histogram->lines[i].sum);
+    }
+}
+
+/* Read HISTOGRAM from STREAM.
+ */
+static void
+read_histogram(svn_fs_fs__histogram_t *histogram,
+               svn_packed__int_stream_t *stream)
+{
+  apr_size_t i;
+
+  histogram->total.count = svn_packed__get_uint(stream);
+  histogram->total.sum = svn_packed__get_uint(stream);
+  for (i = 0; i < sizeof(histogram->lines) / sizeof(histogram->lines[0]); ++i)
+    {
+      histogram->lines[i].count = svn_packed__get_uint(stream);
+      histogram->lines[i].sum = svn_packed__get_uint(stream);
+    }
+}
+
+/* Store the results collected in UNIT in the state directory, so they
+ * can be reused by later runs.  Use SCRATCH_POOL for temporary
+ * allocations.
+ */
+static svn_error_t *
+write_unit_state(query_t *unit,
+                 apr_pool_t *scratch_pool)
+{
+  svn_packed__data_root_t *root = svn_packed__data_create_root(scratch_pool);
+  svn_packed__int_stream_t *header_stream
+    = svn_packed__create_int_stream(root, FALSE, FALSE);
+  svn_packed__int_stream_t *revs_stream
+    = svn_packed__create_int_stream(root, FALSE, FALSE);
+  svn_packed__int_stream_t *reps_stream
+    = svn_packed__create_int_stream(root, FALSE, FALSE);
+  svn_packed__int_stream_t *links_stream
+    = svn_packed__create_int_stream(root, FALSE, FALSE);
+  svn_packed__int_stream_t *refs_stream
+    = svn_packed__create_int_stream(root, FALSE, FALSE);
+  svn_packed__int_stream_t *changes_stream
+    = svn_packed__create_int_stream(root, FALSE, FALSE);
+  svn_packed__int_stream_t *histograms_stream
+    = svn_packed__create_int_stream(root, FALSE, FALSE);
+  svn_packed__byte_stream_t *uuid_stream
+    = svn_packed__create_bytes_stream(root);
+  svn_packed__byte_stream_t *ref_paths_stream
+    = svn_packed__create_bytes_stream(root);
+  svn_packed__byte_stream_t *change_paths_stream
+    = svn_packed__create_bytes_stream(root);
+  svn_packed__byte_stream_t *extensions_stream
+    = svn_packed__create_bytes_stream(root);
+
+  svn_fs_fs__histogram_t *histograms[STATS_HISTOGRAM_COUNT];
+  svn_fs_fs__largest_changes_t *largest_changes
+    = unit->stats->largest_changes;
+  svn_stringbuf_t *buffer = svn_stringbuf_create_empty(scratch_pool);
+  apr_hash_index_t *hi;
+  const char *path;
+  apr_off_t pack_size;
+  apr_size_t i;
+  int k;
+
+  SVN_ERR(get_unit_state_info(&path, &pack_size, unit, scratch_pool,
+                              scratch_pool));
+
+  /* Identify the data the results have been collected from. */
+  svn_packed__add_uint(header_stream, STATS_STATE_FORMAT);
+  svn_packed__add_uint(header_stream, unit->first_rev);
+  svn_packed__add_uint(header_stream, unit->revisions->nelts);
+  svn_packed__add_uint(header_stream, pack_size);
+  svn_packed__add_bytes(uuid_stream, unit->fs->uuid, strlen(unit->fs->uuid));
+
+  /* Revisions and the reps within them. */
+  create_substreams(revs_stream, 9);
+  create_substreams(reps_stream, 7);
+  for (k = 0; k < unit->revisions->nelts; ++k)
+    {
+      int r;
+      revision_info_t *info = APR_ARRAY_IDX(unit->revisions, k,
+                                            revision_info_t *);
+
+      svn_packed__add_uint(revs_stream, info->offset);
+      svn_packed__add_uint(revs_stream, info->end);
+      svn_packed__add_uint(revs_stream, info->changes_len);
+      svn_packed__add_uint(revs_stream, info->change_count);
+      svn_packed__add_uint(revs_stream, info->dir_noderev_count);
+      svn_packed__add_uint(revs_stream, info->file_noderev_count);
+      svn_packed__add_uint(revs_stream, info->dir_noderev_size);
+      svn_packed__add_uint(revs_stream, info->file_noderev_size);
+      svn_packed__add_uint(revs_stream, info->representations->nelts);
+
+      for (r = 0; r < info->representations->nelts; ++r)
+        {
+          rep_stats_t *rep = APR_ARRAY_IDX(info->representations, r,
+                                           rep_stats_t *);
+
+          svn_packed__add_uint(reps_stream, rep->item_index);
+          svn_packed__add_uint(reps_stream, rep->size);
+          svn_packed__add_uint(reps_stream, rep->expanded_size);
+          svn_packed__add_uint(reps_stream, rep->ref_count);
+          svn_packed__add_uint(reps_stream, rep->header_size);
+          svn_packed__add_uint(reps_stream, (unsigned char)rep->kind);
+          svn_packed__add_uint(reps_stream, rep->chain_length);
+        }
+    }
+
+  /* Everything that has to be resolved when merging. */
+  create_substreams(links_stream, 5);
+  for (k = 0; k < unit->deferred_links->nelts; ++k)
+    {
+      rep_ref_t *ref = APR_ARRAY_IDX(unit->deferred_links, k, rep_ref_t *);
+
+      svn_packed__add_uint(links_stream, ref->revision);
+      svn_packed__add_uint(links_stream, ref->item_index);
+      svn_packed__add_uint(links_stream, ref->base_revision);
+      svn_packed__add_uint(links_stream, ref->base_item_index);
+      svn_packed__add_uint(links_stream, ref->header_size);
+    }
+
+  create_substreams(refs_stream, 6);
+  for (k = 0; k < unit->foreign_refs->nelts; ++k)
+    {
+      foreign_ref_t *ref = APR_ARRAY_IDX(unit->foreign_refs, k,
+                                         foreign_ref_t *);
+
+      svn_packed__add_uint(refs_stream, ref->revision);
+      svn_packed__add_uint(refs_stream, ref->item_index);
+      svn_packed__add_uint(refs_stream, ref->size);
+      svn_packed__add_uint(refs_stream, ref->expanded_size);
+      svn_packed__add_uint(refs_stream, (unsigned char)ref->kind);
+      svn_packed__add_uint(refs_stream, ref->plain_added);
+      svn_packed__add_bytes(ref_paths_stream, ref->path, strlen(ref->path));
+    }
+
+  /* Aggregated stats, in the same order as in the merge. */
+  create_substreams(changes_stream, 2);
+  for (i = 0; i < largest_changes->count; ++i)
+    {
+      svn_fs_fs__large_change_info_t *info = largest_changes->changes[i];
+      if (info->revision == SVN_INVALID_REVNUM)
+        break;
+
+      svn_packed__add_uint(changes_stream, info->size);
+      svn_packed__add_uint(changes_stream, info->revision);
+      svn_packed__add_bytes(change_paths_stream, info->path->data,
+                            info->path->len);
+    }
+
+  create_substreams(histograms_stream, 2);
+  get_histograms(histograms, unit->stats);
+  for (i = 0; i < STATS_HISTOGRAM_COUNT; ++i)
+    write_histogram(histograms_stream, histograms[i]);
+
+  for (hi = apr_hash_first(scratch_pool, unit->stats->by_extension);
+       hi;
+       hi = apr_hash_next(hi))
+    {
+      svn_fs_fs__extension_info_t *info = apr_hash_this_val(hi);
+
+      svn_packed__add_bytes(extensions_stream, info->extension,
+                            strlen(info->extension));
+      write_histogram(histograms_stream, &info->rep_histogram);
+      write_histogram(histograms_stream, &info->node_histogram);
+    }
+
+  /* Replace any previous state atomically. */
+  SVN_ERR(svn_packed__data_write(svn_stream_from_stringbuf(buffer,
+                                                           scratch_pool),
+                                 root, scratch_pool));
+  SVN_ERR(svn_io_write_atomic2(path, buffer->data, buffer->len, NULL, FALSE,
+                               scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Return the next byte sequence from STREAM as a NUL-terminated string
+ * allocated in RESULT_POOL.
+ */
+static const char *
+get_string(svn_packed__byte_stream_t *stream,
+           apr_pool_t *result_pool)
+{
+  apr_size_t len;
+  const char *data = svn_packed__get_bytes(stream, &len);
+
+  return apr_pstrmemdup(result_pool, data, len);
+}
+
+/* If the state directory contains valid results of a previous run for
+ * UNIT, read them into UNIT and set *FOUND.  Otherwise, leave UNIT
+ * untouched and set *FOUND to FALSE.  Allocate the results in RESULT_POOL
+ * and use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+read_unit_state(svn_boolean_t *found,
+                query_t *unit,
+                apr_pool_t *result_pool,
+                apr_pool_t *scratch_pool)
+{
+  svn_packed__data_root_t *root;
+  svn_packed__int_stream_t *header_stream;
+  svn_packed__int_stream_t *revs_stream;
+  svn_packed__int_stream_t *reps_stream;
+  svn_packed__int_stream_t *links_stream;
+  svn_packed__int_stream_t *refs_stream;
+  svn_packed__int_stream_t *changes_stream;
+  svn_packed__int_stream_t *histograms_stream;
+  svn_packed__byte_stream_t *uuid_stream;
+  svn_packed__byte_stream_t *ref_paths_stream;
+  svn_packed__byte_stream_t *change_paths_stream;
+  svn_packed__byte_stream_t *extensions_stream;
+
+  svn_fs_fs__histogram_t *histograms[STATS_HISTOGRAM_COUNT];
+  svn_stream_t *stream;
+  svn_error_t *err;
+  const char *path;
+  const char *uuid;
+  apr_off_t pack_size;
+  apr_size_t count;
+  apr_size_t i;
+
+  *found = FALSE;
+  SVN_ERR(get_unit_state_info(&path, &pack_size, unit, scratch_pool,
+                              scratch_pool));
+
+  err = svn_stream_open_readonly(&stream, path, scratch_pool, scratch_pool);
+  if (err && APR_STATUS_IS_ENOENT(err->apr_err))
+    {
+      svn_error_clear(err);
+      return SVN_NO_ERROR;
+    }
+  SVN_ERR(err);
+
+  /* A corrupt file just means that we have to read the pack file again. */
+  err = svn_packed__data_read(&root, stream, scratch_pool, scratch_pool);
+  if (err)
+    {
+      svn_error_clear(err);
+      return svn_error_trace(svn_stream_close(stream));
+    }
+  SVN_ERR(svn_stream_close(stream));
+
+  /* Is this still the data that we collected the results from? */
+  header_stream = svn_packed__first_int_stream(root);
+  uuid_stream = svn_packed__first_byte_stream(root);
+  if (   !header_stream
+      || !uuid_stream
+      || svn_packed__get_uint(header_stream) != STATS_STATE_FORMAT
+      || (svn_revnum_t)svn_packed__get_uint(header_stream) != unit->first_rev
+      || (svn_revnum_t)svn_packed__get_uint(header_stream)
+           != unit->head - unit->first_rev + 1
+      || (apr_off_t)svn_packed__get_uint(header_stream) != pack_size)
+    return SVN_NO_ERROR;
+
+  uuid = get_string(uuid_stream, scratch_pool);
+  if (strcmp(uuid, unit->fs->uuid))
+    return SVN_NO_ERROR;
+
+  revs_stream = svn_packed__next_int_stream(header_stream);
+  reps_stream = svn_packed__next_int_stream(revs_stream);
+  links_stream = svn_packed__next_int_stream(reps_stream);
+  refs_stream = svn_packed__next_int_stream(links_stream);
+  changes_stream = svn_packed__next_int_stream(refs_stream);
+  histograms_stream = svn_packed__next_int_stream(changes_stream);
+  ref_paths_stream = svn_packed__next_byte_stream(uuid_stream);
+  change_paths_stream = svn_packed__next_byte_stream(ref_paths_stream);
+  extensions_stream = svn_packed__next_byte_stream(change_paths_stream);
+
+  /* Revisions and the reps within them. */
+  for (i = 0; i <= (apr_size_t)(unit->head - unit->first_rev); ++i)
+    {
+      apr_size_t r;
+      revision_info_t *info = apr_pcalloc(result_pool, sizeof(*info));
+
+      info->revision = unit->first_rev + (svn_revnum_t)i;
+      info->offset = (apr_off_t)svn_packed__get_uint(revs_stream);
+      info->end = (apr_off_t)svn_packed__get_uint(revs_stream);
+      info->changes_len = svn_packed__get_uint(revs_stream);
+      info->change_count = svn_packed__get_uint(revs_stream);
+      info->dir_noderev_count = svn_packed__get_uint(revs_stream);
+      info->file_noderev_count = svn_packed__get_uint(revs_stream);
+      info->dir_noderev_size = svn_packed__get_uint(revs_stream);
+      info->file_noderev_size = svn_packed__get_uint(revs_stream);
+
+      count = (apr_size_t)svn_packed__get_uint(revs_stream);
+      info->representations = apr_array_make(result_pool, (int)count,
+                                             sizeof(rep_stats_t *));
+      for (r = 0; r < count; ++r)
+        {
+          rep_stats_t *rep = apr_pcalloc(result_pool, sizeof(*rep));
+
+          rep->revision = info->revision;
+          rep->item_index = svn_packed__get_uint(reps_stream);
+          rep->size = svn_packed__get_uint(reps_stream);
+          rep->expanded_size = svn_packed__get_uint(reps_stream);
+          rep->ref_count = (apr_uint32_t)svn_packed__get_uint(reps_stream);
+          rep->header_size = (apr_uint16_t)svn_packed__get_uint(reps_stream);
+          rep->kind = (char)svn_packed__get_uint(reps_stream);
+          rep->chain_length = (apr_byte_t)svn_packed__get_uint(reps_stream);
+
+          APR_ARRAY_PUSH(info->representations, rep_stats_t *) = rep;
+        }
+
+      APR_ARRAY_PUSH(unit->revisions, revision_info_t *) = info;
+    }
+
+  /* Everything that has to be resolved when merging. */
+  count = svn_packed__int_count(svn_packed__first_int_substream(links_stream));
+  for (i = 0; i < count; ++i)
+    {
+      rep_ref_t *ref = apr_pcalloc(result_pool, sizeof(*ref));
+
+      ref->revision = (svn_revnum_t)svn_packed__get_uint(links_stream);
+      ref->item_index = svn_packed__get_uint(links_stream);
+      ref->base_revision = (svn_revnum_t)svn_packed__get_uint(links_stream);
+      ref->base_item_index = svn_packed__get_uint(links_stream);
+      ref->header_size = (apr_uint16_t)svn_packed__get_uint(links_stream);
+
+      APR_ARRAY_PUSH(unit->deferred_links, rep_ref_t *) = ref;
+    }
+
+  count = svn_packed__int_count(svn_packed__first_int_substream(refs_stream));
+  for (i = 0; i < count; ++i)
+    {
+      foreign_ref_t *ref = apr_pcalloc(result_pool, sizeof(*ref));
+
+      ref->revision = (svn_revnum_t)svn_packed__get_uint(refs_stream);
+      ref->item_index = svn_packed__get_uint(refs_stream);
+      ref->size = svn_packed__get_uint(refs_stream);
+      ref->expanded_size = svn_packed__get_uint(refs_stream);
+      ref->kind = (char)svn_packed__get_uint(refs_stream);
+      ref->plain_added = (svn_boolean_t)svn_packed__get_uint(refs_stream);
+      ref->path = get_string(ref_paths_stream, result_pool);
+
+      APR_ARRAY_PUSH(unit->foreign_refs, foreign_ref_t *) = ref;
+    }
+
+  /* Aggregated stats. */
+  count = svn_packed__int_count(
+            svn_packed__first_int_substream(changes_stream));
+  for (i = 0; i < count; ++i)
+    {
+      apr_uint64_t size = svn_packed__get_uint(changes_stream);
+      svn_revnum_t revision
+        = (svn_revnum_t)svn_packed__get_uint(changes_stream);
+
+      add_largest_change(unit->stats->largest_changes, size, revision,
+                         get_string(change_paths_stream, scratch_pool));
+    }
+
+  get_histograms(histograms, unit->stats);
+  for (i = 0; i < STATS_HISTOGRAM_COUNT; ++i)
+    read_histogram(histograms[i], histograms_stream);
+
+  count = svn_packed__byte_block_count(extensions_stream);
+  for (i = 0; i < count; ++i)
+    {
+      svn_fs_fs__extension_info_t *info
+        = get_extension_info(unit->stats,
+                             get_string(extensions_stream, scratch_pool));
+
+      read_histogram(&info->rep_histogram, histograms_stream);
+      read_histogram(&info->node_histogram, histograms_stream);
+    }
+
+  *found = TRUE;
+
+  return SVN_NO_ERROR;
+}
+
+/* Collect the results for UNIT.  If UNIT covers a pack file and we have
+ * a state directory, reuse the results of a previous run or keep them for
+ * the next run.  Use RESULT_POOL for persistent allocations and
+ * SCRATCH_POOL for temporaries.
+ */
+static svn_error_t *
+process_unit(query_t *unit,
+             apr_pool_t *result_pool,
+             apr_pool_t *scratch_pool)
+{
+  svn_boolean_t keep_state = unit->state_dir
+                          && unit->first_rev < unit->min_unpacked_rev;
+
+  if (keep_state)
+    {
+      svn_boolean_t found;
+      SVN_ERR(read_unit_state(&found, unit, result_pool, scratch_pool));
+      if (found)
+        return SVN_NO_ERROR;
+    }
+
+  SVN_ERR(read_revisions(unit, result_pool, scratch_pool));
+
+  if (keep_state)
+    SVN_ERR(write_unit_state(unit, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Merge UNIT into QUERY and report the progress.  Allocate new data in
+ * RESULT_POOL and use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+finish_unit(query_t *query,
+            query_t *unit,
+            apr_pool_t *result_pool,
+            apr_pool_t *scratch_pool)
+{
+  SVN_ERR(merge_unit(query, unit, result_pool, scratch_pool));
+
+  /* one more pack file / shard processed */
+  if (query->progress_func)
+    query->progress_func(unit->first_rev, query->progress_baton,
+                         scratch_pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Read the repository and collect the stats info in QUERY, one unit of
+ * work at a time.  Use RESULT_POOL for persistent allocations and
+ * SCRATCH_POOL for temporaries.
+ */
+static svn_error_t *
+read_units(query_t *query,
+           apr_pool_t *result_pool,
+           apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  svn_revnum_t revision;
+
+  for (revision = 0; revision <= query->head; )
+    {
+      query_t *unit;
+      svn_pool_clear(iterpool);
+
+      create_unit(&unit, query, query->fs, revision, result_pool);
+      SVN_ERR(process_unit(unit, result_pool, iterpool));
+      SVN_ERR(finish_unit(query, unit, result_pool, iterpool));
+
+      revision = unit->head + 1;
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#if APR_HAS_THREADS
+
+/* Number of microseconds between two checks for cancellation while we
+   wait for concurrent units to progress. */
+#define STATS_JOB_POLL_INTERVAL 100000
+
+struct stats_jobs_t;
+
+/* A single unit of work being processed by some worker thread. */
+typedef struct stats_job_t
+{
+  /* The unit to process.  It uses a private filesystem instance because
+     the caches of the original FS object can't be used concurrently. */
+  query_t *unit;
+
+  /* Pool owning the private filesystem instance. */
+  apr_pool_t *fs_pool;
+
+  /* Result of process_unit(). */
+  svn_error_t *err;
+
+  /* Set under the MUTEX in JOBS once ERR is valid. */
+  svn_boolean_t done;
+
+  /* Thread-safe root pool owning this job and all its data. */
+  apr_pool_t *pool;
+
+  /* The context that this job belongs to. */
+  struct stats_jobs_t *jobs;
+} stats_job_t;
+
+/* Context of a concurrent stats run. */
+typedef struct stats_jobs_t
+{
+  /* Collects the results.  Only to be used by the thread that called
+     svn_fs_fs__get_stats(). */
+  query_t *query;
+
+  /* Workers executing the jobs. */
+  apr_thread_pool_t *thread_pool;
+
+  /* Signal the completion of jobs. */
+  svn_mutex__t *mutex;
+  apr_thread_cond_t *cond;
+
+  /* Non-zero if the workers shall bail out as soon as possible. */
+  volatile svn_atomic_t cancelled;
+
+  /* Ring buffer of MAX_JOBS entries.  COUNT jobs, starting at index FIRST,
+     are in flight in revision order. */
+  stats_job_t **queue;
+  int max_jobs;
+  int first;
+  int count;
+
+  /* Root pools of all merged jobs.  QUERY references their data. */
+  apr_array_header_t *merged_pools;
+} stats_jobs_t;
+
+/* Implements svn_cancel_func_t for the workers.  BATON is a stats_jobs_t. */
+static svn_error_t *
+stats_job_cancel(void *baton)
+{
+  stats_jobs_t *jobs = baton;
+  if (svn_atomic_read(&jobs->cancelled))
+    return svn_error_create(SVN_ERR_CANCELLED, NULL, _("Caught signal"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread-pool task processing the unit of the stats_job_t given by DATA. */
+static void * APR_THREAD_FUNC
+stats_job_task(apr_thread_t *tid,
+               void *data)
+{
+  stats_job_t *job = data;
+  stats_jobs_t *jobs = job->jobs;
+  apr_pool_t *scratch_pool = svn_pool_create(job->pool);
+  svn_error_t *err;
+
+  job->err = process_unit(job->unit, job->pool, scratch_pool);
+  svn_pool_destroy(scratch_pool);
+
+  /* There is nobody to report errors to. */
+  err = svn_mutex__lock(jobs->mutex);
+  if (!err)
+    {
+      job->done = TRUE;
+      apr_thread_cond_broadcast(jobs->cond);
+      err = svn_mutex__unlock(jobs->mutex, SVN_NO_ERROR);
+    }
+  svn_error_clear(err);
+
+  return NULL;
+}
+
+/* Queue the processing of the unit starting at FIRST_REV in JOBS and
+   return that unit in *UNIT.  Use SCRATCH_POOL for temporary
+   allocations. */
+static svn_error_t *
+start_stats_job(query_t **unit,
+                stats_jobs_t *jobs,
+                svn_revnum_t first_rev,
+                apr_pool_t *scratch_pool)
+{
+  query_t *query = jobs->query;
+  fs_fs_data_t *ffd = query->fs->fsap_data;
+  apr_pool_t *pool = svn_pool_create(NULL);
+  stats_job_t *job = apr_pcalloc(pool, sizeof(*job));
+  svn_fs_t *fs;
+  apr_status_t status;
+  svn_error_t *err;
+
+  job->pool = pool;
+  job->fs_pool = svn_pool_create(pool);
+  job->jobs = jobs;
+
+  /* Opening the FS is not necessarily thread-safe, so do it here. */
+  err = ffd->svn_fs_open_(&fs, query->fs->path, query->fs->config,
+                          job->fs_pool, scratch_pool);
+  if (err)
+    {
+      svn_pool_destroy(pool);
+      return svn_error_trace(err);
+    }
+
+  create_unit(&job->unit, query, fs, first_rev, pool);
+  job->unit->cancel_func = stats_job_cancel;
+  job->unit->cancel_baton = jobs;
+
+  jobs->queue[(jobs->first + jobs->count) % jobs->max_jobs] = job;
+  jobs->count++;
+
+  status = apr_thread_pool_push(jobs->thread_pool, stats_job_task, job, 0,
+                                jobs);
+  if (status)
+    {
+      /* Process the unit in this thread, then. */
+      job->unit->cancel_func = query->cancel_func;
+      job->unit->cancel_baton = query->cancel_baton;
+      job->err = process_unit(job->unit, job->pool, scratch_pool);
+      job->done = TRUE;
+    }
+
+  *unit = job->unit;
+
+  return SVN_NO_ERROR;
+}
+
+/* Wait for the oldest job in JOBS to complete and remove it from JOBS.
+   Return it in *JOB_P.  If CHECK_CANCEL is set, periodically call the
+   cancellation function of the stats run while waiting. */
+static svn_error_t *
+wait_for_stats_job(stats_job_t **job_p,
+                   stats_jobs_t *jobs,
+                   svn_boolean_t check_cancel)
+{
+  query_t *query = jobs->query;
+  stats_job_t *job = jobs->queue[jobs->first];
+  svn_error_t *err = SVN_NO_ERROR;
+
+  SVN_ERR(svn_mutex__lock(jobs->mutex));
+  while (!job->done && !err)
+    {
+      apr_status_t status
+        = apr_thread_cond_timedwait(jobs->cond, svn_mutex__get(jobs->mutex),
+                                    STATS_JOB_POLL_INTERVAL);
+      if (status && !APR_STATUS_IS_TIMEUP(status))
+        err = svn_error_wrap_apr(status,
+                                 _("Can't wait on condition variable"));
+      else if (check_cancel && query->cancel_func)
+        err = query->cancel_func(query->cancel_baton);
+    }
+  SVN_ERR(svn_mutex__unlock(jobs->mutex, err));
+
+  jobs->first = (jobs->first + 1) % jobs->max_jobs;
+  jobs->count--;
+  *job_p = job;
+
+  return SVN_NO_ERROR;
+}
+
+/* Make all workers in JOBS stop, wait for them to finish and release all
+   job data that has not been merged.  Errors will be ignored. */
+static void
+abort_stats_jobs(stats_jobs_t *jobs)
+{
+  svn_atomic_set(&jobs->cancelled, TRUE);
+  while (jobs->count > 0)
+    {
+      stats_job_t *job;
+      svn_error_t *err = wait_for_stats_job(&job, jobs, FALSE);
+      if (err)
+        {
+          /* We can't release a job that might still be in use. */
+          svn_error_clear(err);
+          return;
+        }
+
+      svn_error_clear(job->err);
+      svn_pool_destroy(job->pool);
+    }
+}
+
+/* Wait for the oldest job in JOBS and merge its results.  Allocate new
+   data in RESULT_POOL and use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+finish_stats_job(stats_jobs_t *jobs,
+                 apr_pool_t *result_pool,
+                 apr_pool_t *scratch_pool)
+{
+  stats_job_t *job;
+  svn_error_t *err;
+
+  SVN_ERR(wait_for_stats_job(&job, jobs, TRUE));
+
+  err = job->err;
+  if (!err)
+    err = finish_unit(jobs->query, job->unit, result_pool, scratch_pool);
+
+  if (err)
+    {
+      svn_pool_destroy(job->pool);
+      return svn_error_trace(err);
+    }
+
+  /* The merged results remain in use but the FS instance does not. */
+  svn_pool_destroy(job->fs_pool);
+  APR_ARRAY_PUSH(jobs->merged_pools, apr_pool_t *) = job->pool;
+
+  return SVN_NO_ERROR;
+}
+
+/* Like read_units() but process up to MAX_JOBS units at a time.  The
+   results will be merged into QUERY in revision order and aggregated in
+   STATS before they get released.  Use RESULT_POOL for persistent
+   allocations and SCRATCH_POOL for temporaries. */
+static svn_error_t *
+read_units_concurrently(query_t *query,
+                        int max_jobs,
+                        svn_fs_fs__stats_t *stats,
+                        apr_pool_t *result_pool,
+                        apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  apr_pool_t *thread_pool_pool;
+  svn_revnum_t revision = 0;
+  stats_jobs_t jobs = { 0 };
+  svn_error_t *err = SVN_NO_ERROR;
+  apr_status_t status;
+  int i;
+
+  jobs.query = query;
+  jobs.max_jobs = max_jobs;
+  jobs.queue = apr_pcalloc(scratch_pool,
+                           jobs.max_jobs * sizeof(*jobs.queue));
+  jobs.merged_pools = apr_array_make(scratch_pool, 16, sizeof(apr_pool_t *));
+  SVN_ERR(svn_mutex__init(&jobs.mutex, TRUE, scratch_pool));
+  status = apr_thread_cond_create(&jobs.cond, scratch_pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* The thread-pool must be allocated from a thread-safe root pool. */
+  thread_pool_pool = svn_pool_create(NULL);
+  status = apr_thread_pool_create(&jobs.thread_pool, 0, jobs.max_jobs,
+                                  thread_pool_pool);
+  if (status)
+    {
+      svn_pool_destroy(thread_pool_pool);
+      return svn_error_wrap_apr(status, _("Can't create stats thread pool"));
+    }
+
+  while (!err && (revision <= query->head || jobs.count > 0))
+    {
+      svn_pool_clear(iterpool);
+
+      /* Keep all workers busy. */
+      while (!err && revision <= query->head && jobs.count < jobs.max_jobs)
+        {
+          query_t *unit;
+
+          if (query->cancel_func)
+            err = query->cancel_func(query->cancel_baton);
+
+          if (!err)
+            err = start_stats_job(&unit, &jobs, revision, iterpool);
+
+          if (!err)
+            revision = unit->head + 1;
+        }
+
+      /* Merge the results in order. */
+      if (!err)
+        err = finish_stats_job(&jobs, result_pool, iterpool);
+    }
+
+  /* Don't leave any worker running. */
+  abort_stats_jobs(&jobs);
+  apr_thread_pool_destroy(jobs.thread_pool);
+  svn_pool_destroy(thread_pool_pool);
+  svn_pool_destroy(iterpool);
+
+  /* QUERY references the merged results until they have been aggregated. */
+  if (!err)
+    aggregate_stats(query->revisions, stats);
+
+  for (i = 0; i < jobs.merged_pools->nelts; ++i)
+    svn_pool_destroy(APR_ARRAY_IDX(jobs.merged_pools, i, apr_pool_t *));
+
+  return svn_error_trace(err);
+}
+
+#endif
+
 svn_error_t *
 svn_fs_fs__get_stats(svn_fs_fs__stats_t **stats,
                      svn_fs_t *fs,
+                     int jobs,
+                     const char *state_dir,
                      svn_fs_progress_notify_func_t progress_func,
                      void *progress_baton,
                      svn_cancel_func_t cancel_func,
@@ -1388,11 +2516,24 @@ svn_fs_fs__get_stats(svn_fs_fs__stats_t **stats,
 {
   query_t *query;
 
+  if (state_dir)
+    SVN_ERR(svn_io_make_dir_recursively(state_dir, scratch_pool));
+
   *stats = create_stats(result_pool);
-  SVN_ERR(create_query(&query, fs, *stats, progress_func, progress_baton,
-                       cancel_func, cancel_baton, scratch_pool,
-                       scratch_pool));
-  SVN_ERR(read_revisions(query, scratch_pool, scratch_pool));
+  SVN_ERR(create_query(&query, fs, *stats, state_dir, progress_func,
+                       progress_baton, cancel_func, cancel_baton,
+                       scratch_pool, scratch_pool));
+
+#if APR_HAS_THREADS
+  /* Read several units at once, if we have been asked to and we are able
+   * to open independent instances of FS. */
+  if (jobs > 1 && ((fs_fs_data_t *)fs->fsap_data)->svn_fs_open_)
+    return svn_error_trace(read_units_concurrently(query, jobs, *stats,
+                                                   scratch_pool,
+                                                   scratch_pool));
+#endif
+
+  SVN_ERR(read_units(query, scratch_pool, scratch_pool));
   aggregate_stats(query->revisions, *stats);
 
   return SVN_NO_ERROR;
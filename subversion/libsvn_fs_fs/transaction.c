@@ -33,6 +33,7 @@
 #include "svn_dirent_uri.h"
 
 #include "fs_fs.h"
+#include "batch_fsync.h"
 #include "index.h"
 #include "tree.h"
 #include "util.h"
@@ -42,7 +43,10 @@
 #include "cached_data.h"
 #include "lock.h"
 #include "rep-cache.h"
+#include "history_index.h"
+#include "mergeinfo_index.h"
 
+#include "private/svn_delta_private.h"
 #include "private/svn_fs_util.h"
 #include "private/svn_fspath.h"
 #include "private/svn_sorts_private.h"
@@ -2159,7 +2163,7 @@ rep_write_cleanup(void *data)
   return APR_SUCCESS;
 }
 
-static void
+static svn_error_t *
 txdelta_to_svndiff(svn_txdelta_window_handler_t *handler,
                    void **handler_baton,
                    svn_stream_t *output,
@@ -2171,12 +2175,12 @@ txdelta_to_svndiff(svn_txdelta_window_handler_t *handler,
 
   if (ffd->delta_compression_type == compression_type_lz4)
     {
-      SVN_ERR_ASSERT_NO_RETURN(ffd->format >= SVN_FS_FS__MIN_SVNDIFF2_FORMAT);
+      SVN_ERR_ASSERT(ffd->format >= SVN_FS_FS__MIN_SVNDIFF2_FORMAT);
       svndiff_version = 2;
     }
   else if (ffd->delta_compression_type == compression_type_zlib)
     {
-      SVN_ERR_ASSERT_NO_RETURN(ffd->format >= SVN_FS_FS__MIN_SVNDIFF1_FORMAT);
+      SVN_ERR_ASSERT(ffd->format >= SVN_FS_FS__MIN_SVNDIFF1_FORMAT);
       svndiff_version = 1;
     }
   else
@@ -2184,8 +2188,12 @@ txdelta_to_svndiff(svn_txdelta_window_handler_t *handler,
       svndiff_version = 0;
     }
 
-  svn_txdelta_to_svndiff3(handler, handler_baton, output, svndiff_version,
-                          ffd->delta_compression_level, pool);
+  return svn_error_trace(
+           svn_txdelta__to_svndiff_parallel(handler, handler_baton, output,
+                                            svndiff_version,
+                                            ffd->delta_compression_level,
+                                            ffd->delta_compression_threads,
+                                            pool));
 }
 
 /* Get a rep_write_baton and store it in *WB_P for the representation
@@ -2259,7 +2267,7 @@ rep_write_get_baton(struct rep_write_baton **wb_p,
                             apr_pool_cleanup_null);
 
   /* Prepare to write the svndiff data. */
-  txdelta_to_svndiff(&wh, &whb, b->rep_stream, fs, pool);
+  SVN_ERR(txdelta_to_svndiff(&wh, &whb, b->rep_stream, fs, pool));
 
   b->delta_stream = svn_txdelta_target_push(wh, whb, source,
                                             b->scratch_pool);
@@ -2947,7 +2955,8 @@ write_container_delta_rep(representation_t *rep,
   SVN_ERR(svn_io_file_get_offset(&delta_start, file, scratch_pool));
 
   /* Prepare to write the svndiff data. */
-  txdelta_to_svndiff(&diff_wh, &diff_whb, file_stream, fs, scratch_pool);
+  SVN_ERR(txdelta_to_svndiff(&diff_wh, &diff_whb, file_stream, fs,
+                             scratch_pool));
 
   whb = apr_pcalloc(scratch_pool, sizeof(*whb));
   whb->stream = svn_txdelta_target_push(diff_wh, diff_whb, source,
@@ -3100,6 +3109,17 @@ get_final_id(svn_fs_fs__id_part_t *part,
     }
 }
 
+/* A directory written by write_final_rev() ahead of time, whose contents
+   are to be cached once the revision has actually been committed. */
+typedef struct prepared_dir_t
+{
+  /* Key of the directory in the FS' DIR_CACHE. */
+  pair_cache_key_t key;
+
+  /* The directory contents, svn_fs_dirent_t * sorted by name. */
+  apr_array_header_t *entries;
+} prepared_dir_t;
+
 /* Copy a node-revision specified by id ID in fileystem FS from a
    transaction into the proto-rev-file FILE.  Set *NEW_ID_P to a
    pointer to the new node-id which will be allocated in POOL.
@@ -3115,7 +3135,10 @@ get_final_id(svn_fs_fs__id_part_t *part,
    commit_body.
 
    Collect the pair_cache_key_t of all directories written to the
-   committed cache in DIRECTORY_IDS.
+   committed cache in DIRECTORY_IDS.  If DIRECTORY_IDS is NULL, don't
+   add the directories to the cache but append a prepared_dir_t for each
+   of them to PREPARED_DIRS, allocated in its pool, instead.  Either of
+   them must be NULL.
 
    If REPS_TO_CACHE is not NULL, append to it a copy (allocated in
    REPS_POOL) of each data rep that is new in this revision.
@@ -3139,6 +3162,7 @@ write_final_rev(const svn_fs_id_t **new_id_p,
                 apr_uint64_t start_copy_id,
                 apr_off_t initial_offset,
                 apr_array_header_t *directory_ids,
+                apr_array_header_t *prepared_dirs,
                 apr_array_header_t *reps_to_cache,
                 apr_hash_t *reps_hash,
                 apr_pool_t *reps_pool,
@@ -3181,8 +3205,8 @@ write_final_rev(const svn_fs_id_t **new_id_p,
           svn_pool_clear(subpool);
           SVN_ERR(write_final_rev(&new_id, file, rev, fs, dirent->id,
                                   start_node_id, start_copy_id, initial_offset,
-                                  directory_ids, reps_to_cache, reps_hash,
-                                  reps_pool, FALSE, subpool));
+                                  directory_ids, prepared_dirs, reps_to_cache,
+                                  reps_hash, reps_pool, FALSE, subpool));
           if (new_id && (svn_fs_fs__id_rev(new_id) == rev))
             dirent->id = svn_fs_fs__id_copy(new_id, pool);
         }
@@ -3212,19 +3236,48 @@ write_final_rev(const svn_fs_id_t **new_id_p,
           /* Cache the new directory contents.  Otherwise, subsequent reads
            * or commits will likely have to reconstruct, verify and parse
            * it again. */
-          key = apr_array_push(directory_ids);
-          key->revision = noderev->data_rep->revision;
-          key->second = noderev->data_rep->item_index;
-
-          /* Store directory contents under the new revision number but mark
-           * it as "stale" by setting the file length to 0.  Committed dirs
-           * will report -1, in-txn dirs will report > 0, so that this can
-           * never match.  We reset that to -1 after the commit is complete.
-           */
-          dir_data.entries = entries;
-          dir_data.txn_filesize = 0;
-
-          SVN_ERR(svn_cache__set(ffd->dir_cache, key, &dir_data, subpool));
+          if (directory_ids)
+            {
+              key = apr_array_push(directory_ids);
+              key->revision = noderev->data_rep->revision;
+              key->second = noderev->data_rep->item_index;
+
+              /* Store directory contents under the new revision number but
+               * mark it as "stale" by setting the file length to 0.
+               * Committed dirs will report -1, in-txn dirs will report > 0,
+               * so that this can never match.  We reset that to -1 after
+               * the commit is complete.
+               */
+              dir_data.entries = entries;
+              dir_data.txn_filesize = 0;
+
+              SVN_ERR(svn_cache__set(ffd->dir_cache, key, &dir_data,
+                                     subpool));
+            }
+          else if (prepared_dirs)
+            {
+              /* The revision number is not ours, yet.  Keep a copy of
+               * the contents until it is. */
+              prepared_dir_t *dir = apr_array_push(prepared_dirs);
+              apr_pool_t *dirs_pool = prepared_dirs->pool;
+
+              dir->key.revision = noderev->data_rep->revision;
+              dir->key.second = noderev->data_rep->item_index;
+              dir->entries = apr_array_make(dirs_pool, entries->nelts,
+                                            sizeof(svn_fs_dirent_t *));
+              for (i = 0; i < entries->nelts; ++i)
+                {
+                  svn_fs_dirent_t *dirent
+                    = APR_ARRAY_IDX(entries, i, svn_fs_dirent_t *);
+                  svn_fs_dirent_t *copy = apr_palloc(dirs_pool,
+                                                     sizeof(*copy));
+
+                  copy->name = apr_pstrdup(dirs_pool, dirent->name);
+                  copy->id = svn_fs_fs__id_copy(dirent->id, dirs_pool);
+                  copy->kind = dirent->kind;
+                  APR_ARRAY_PUSH(dir->entries, svn_fs_dirent_t *) = copy;
+                }
+            }
         }
     }
   else
@@ -3593,13 +3646,14 @@ verify_locks(svn_fs_t *fs,
 }
 
 /* Writes final revision properties to file PATH applying permissions
-   from file PERMS_REFERENCE. This involves setting svn:date and
-   removing any temporary properties associated with the commit flags. */
+   from file PERMS_REFERENCE and schedules the necessary fsyncs in BATCH.
+   This involves setting svn:date and removing any temporary properties
+   associated with the commit flags. */
 static svn_error_t *
 write_final_revprop(const char *path,
                     const char *perms_reference,
                     svn_fs_txn_t *txn,
-                    svn_boolean_t flush_to_disk,
+                    svn_fs_fs__batch_fsync_t *batch,
                     apr_pool_t *pool)
 {
   apr_hash_t *txnprops;
@@ -3607,6 +3661,7 @@ write_final_revprop(const char *path,
   svn_string_t *client_date;
   apr_file_t *revprop_file;
   svn_stream_t *stream;
+  apr_off_t offset;
 
   SVN_ERR(svn_fs_fs__txn_proplist(&txnprops, txn, pool));
 
@@ -3629,19 +3684,18 @@ write_final_revprop(const char *path,
       svn_hash_sets(txnprops, SVN_PROP_REVISION_DATE, &date);
     }
 
-  /* Create new revprops file. Tell OS to truncate existing file,
-     since  file may already exists from failed transaction. */
-  SVN_ERR(svn_io_file_open(&revprop_file, path,
-                           APR_WRITE | APR_CREATE | APR_TRUNCATE
-                           | APR_BUFFERED, APR_OS_DEFAULT, pool));
+  /* Create new revprops file and schedule it for fsync in BATCH.  The
+     file may already exist from a failed transaction, so truncate it
+     after writing the new contents. */
+  SVN_ERR(svn_fs_fs__batch_fsync_open_file(&revprop_file, batch, path,
+                                           pool));
 
   stream = svn_stream_from_aprfile2(revprop_file, TRUE, pool);
   SVN_ERR(svn_hash_write2(txnprops, stream, SVN_HASH_TERMINATOR, pool));
   SVN_ERR(svn_stream_close(stream));
 
-  if (flush_to_disk)
-    SVN_ERR(svn_io_file_flush_to_disk(revprop_file, pool));
-  SVN_ERR(svn_io_file_close(revprop_file, pool));
+  SVN_ERR(svn_io_file_get_offset(&offset, revprop_file, pool));
+  SVN_ERR(svn_io_file_trunc(revprop_file, offset, pool));
 
   SVN_ERR(svn_io_copy_perms(perms_reference, path, pool));
 
@@ -3724,6 +3778,384 @@ promote_cached_directories(svn_fs_t *fs,
   return SVN_NO_ERROR;
 }
 
+/* Add the directories in PREPARED_DIRS, an array of prepared_dir_t, to
+ * the directory cache of FS.  Use SCRATCH_POOL for temporaries. */
+static svn_error_t *
+cache_prepared_directories(svn_fs_t *fs,
+                           apr_array_header_t *prepared_dirs,
+                           apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_pool_t *iterpool;
+  int i;
+
+  if (!ffd->dir_cache)
+    return SVN_NO_ERROR;
+
+  iterpool = svn_pool_create(scratch_pool);
+  for (i = 0; i < prepared_dirs->nelts; ++i)
+    {
+      prepared_dir_t *dir = &APR_ARRAY_IDX(prepared_dirs, i, prepared_dir_t);
+      svn_fs_fs__dir_data_t dir_data;
+
+      svn_pool_clear(iterpool);
+
+      /* The revision has been committed, so the contents are valid. */
+      dir_data.entries = dir->entries;
+      dir_data.txn_filesize = SVN_INVALID_FILESIZE;
+
+      SVN_ERR(svn_cache__set(ffd->dir_cache, &dir->key, &dir_data,
+                             iterpool));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Append the node-revisions, directory contents, changed-paths list and
+   index / trailer data of the new revision NEW_REV for transaction TXN_ID
+   in FS to the already locked PROTO_FILE.  Take the changes list from
+   CHANGED_PATHS.
+
+   START_NODE_ID, START_COPY_ID, DIRECTORY_IDS, PREPARED_DIRS,
+   REPS_TO_CACHE, REPS_HASH and REPS_POOL are passed through to
+   write_final_rev(), which see.
+
+   Perform temporary allocations in POOL. */
+static svn_error_t *
+write_final_proto_rev(apr_file_t *proto_file,
+                      svn_fs_t *fs,
+                      const svn_fs_fs__id_part_t *txn_id,
+                      svn_revnum_t new_rev,
+                      apr_uint64_t start_node_id,
+                      apr_uint64_t start_copy_id,
+                      apr_hash_t *changed_paths,
+                      apr_array_header_t *directory_ids,
+                      apr_array_header_t *prepared_dirs,
+                      apr_array_header_t *reps_to_cache,
+                      apr_hash_t *reps_hash,
+                      apr_pool_t *reps_pool,
+                      apr_pool_t *pool)
+{
+  const svn_fs_id_t *root_id, *new_root_id;
+  apr_off_t initial_offset, changed_path_offset;
+
+  SVN_ERR(svn_io_file_get_offset(&initial_offset, proto_file, pool));
+
+  /* Write out all the node-revisions and directory contents. */
+  root_id = svn_fs_fs__id_txn_create_root(txn_id, pool);
+  SVN_ERR(write_final_rev(&new_root_id, proto_file, new_rev, fs, root_id,
+                          start_node_id, start_copy_id, initial_offset,
+                          directory_ids, prepared_dirs, reps_to_cache,
+                          reps_hash, reps_pool, TRUE, pool));
+
+  /* Write the changed-path information. */
+  SVN_ERR(write_final_changed_path_info(&changed_path_offset, proto_file,
+                                        fs, txn_id, changed_paths, pool));
+
+  if (svn_fs_fs__use_log_addressing(fs))
+    {
+      /* Append the index data to the rev file. */
+      SVN_ERR(svn_fs_fs__add_index_data(fs, proto_file,
+                      svn_fs_fs__path_l2p_proto_index(fs, txn_id, pool),
+                      svn_fs_fs__path_p2l_proto_index(fs, txn_id, pool),
+                      new_rev, pool));
+    }
+  else
+    {
+      /* Write the final line. */
+
+      svn_stringbuf_t *trailer
+        = svn_fs_fs__unparse_revision_trailer
+                  ((apr_off_t)svn_fs_fs__id_item(new_root_id),
+                   changed_path_offset,
+                   pool);
+      SVN_ERR(svn_io_file_write_full(proto_file, trailer->data, trailer->len,
+                                     NULL, pool));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Flush the contents of PROTO_FILE of transaction TXN_ID in FS to disk,
+   if so configured.  With group commit enabled, share the flush with
+   other commits in this process.  Use SCRATCH_POOL for temporaries. */
+static svn_error_t *
+flush_proto_rev(apr_file_t *proto_file,
+                svn_fs_t *fs,
+                const svn_fs_fs__id_part_t *txn_id,
+                apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  if (!ffd->flush_to_disk)
+    return SVN_NO_ERROR;
+
+  if (ffd->group_commit_window == 0)
+    return svn_error_trace(svn_io_file_flush_to_disk(proto_file,
+                                                     scratch_pool));
+
+  SVN_ERR(svn_io_file_flush(proto_file, scratch_pool));
+  return svn_error_trace(svn_fs_fs__fsync_group_flush(
+                           ffd->shared->fsync_group,
+                           svn_fs_fs__path_txn_proto_rev(fs, txn_id,
+                                                         scratch_pool),
+                           ffd->group_commit_window,
+                           scratch_pool));
+}
+
+/* A proto-rev file that has been finalized for revision REV ahead of
+   taking the repository write lock, together with everything needed to
+   either commit it or to restore the transaction to its previous state.
+ */
+typedef struct prepared_rev_t
+{
+  /* The revision that the proto-rev file has been written for, i.e. the
+     txn's base revision + 1. */
+  svn_revnum_t rev;
+
+  /* Repository format at the time the proto-rev file got written. */
+  int format;
+
+  /* Cookie for unlock_proto_rev().  The proto-rev file stays locked
+     until it either gets committed or rolled back. */
+  void *lockcookie;
+
+  /* Sizes of the proto-rev and the two proto-index files before we
+     appended the final revision data to them. */
+  apr_off_t initial_offset;
+  svn_filesize_t l2p_proto_size;
+  svn_filesize_t p2l_proto_size;
+
+  /* Contents of the txn's item index counter file; NULL if it did not
+     exist. */
+  svn_stringbuf_t *item_index;
+
+  /* The txn's folded changes list. */
+  apr_hash_t *changed_paths;
+
+  /* The directories written to the proto-rev file, prepared_dir_t.  They
+     get cached once the revision has been committed. */
+  apr_array_header_t *directories;
+} prepared_rev_t;
+
+/* Set *SIZE to the size of the file at PATH or to 0, if it does not
+   exist.  Use SCRATCH_POOL for temporaries. */
+static svn_error_t *
+get_proto_file_size(svn_filesize_t *size,
+                    const char *path,
+                    apr_pool_t *scratch_pool)
+{
+  apr_finfo_t finfo;
+  svn_error_t *err = svn_io_stat(&finfo, path, APR_FINFO_SIZE,
+                                 scratch_pool);
+
+  if (err && APR_STATUS_IS_ENOENT(err->apr_err))
+    {
+      svn_error_clear(err);
+      *size = 0;
+      return SVN_NO_ERROR;
+    }
+
+  SVN_ERR(err);
+  *size = finfo.size;
+
+  return SVN_NO_ERROR;
+}
+
+/* Truncate the file at PATH to SIZE bytes, creating it if necessary.
+   Use SCRATCH_POOL for temporaries. */
+static svn_error_t *
+truncate_proto_file(const char *path,
+                    svn_filesize_t size,
+                    apr_pool_t *scratch_pool)
+{
+  apr_file_t *file;
+
+  SVN_ERR(svn_io_file_open(&file, path, APR_WRITE | APR_CREATE,
+                           APR_OS_DEFAULT, scratch_pool));
+  SVN_ERR(svn_io_file_trunc(file, size, scratch_pool));
+
+  return svn_error_trace(svn_io_file_close(file, scratch_pool));
+}
+
+/* Undo the effects of prepare_final_rev() for PREPARED in transaction
+   TXN_ID of FS: cut the data appended to the proto-rev and proto-index
+   files, restore the item index counter, forget all reps collected in
+   REPS_TO_CACHE and REPS_HASH and unlock the proto-rev file.
+   Use SCRATCH_POOL for temporaries. */
+static svn_error_t *
+rollback_prepared_rev(svn_fs_t *fs,
+                      const svn_fs_fs__id_part_t *txn_id,
+                      prepared_rev_t *prepared,
+                      apr_array_header_t *reps_to_cache,
+                      apr_hash_t *reps_hash,
+                      apr_pool_t *scratch_pool)
+{
+  const char *item_index_path
+    = svn_fs_fs__path_txn_item_index(fs, txn_id, scratch_pool);
+  svn_error_t *err;
+
+  err = truncate_proto_file(svn_fs_fs__path_txn_proto_rev(fs, txn_id,
+                                                          scratch_pool),
+                            prepared->initial_offset, scratch_pool);
+  if (!err)
+    err = truncate_proto_file(svn_fs_fs__path_l2p_proto_index(fs, txn_id,
+                                                              scratch_pool),
+                              prepared->l2p_proto_size, scratch_pool);
+  if (!err)
+    err = truncate_proto_file(svn_fs_fs__path_p2l_proto_index(fs, txn_id,
+                                                              scratch_pool),
+                              prepared->p2l_proto_size, scratch_pool);
+  if (!err)
+    err = svn_io_remove_file2(item_index_path, TRUE, scratch_pool);
+  if (!err && prepared->item_index)
+    err = svn_io_file_create_bytes(item_index_path,
+                                   prepared->item_index->data,
+                                   prepared->item_index->len,
+                                   scratch_pool);
+
+  if (reps_to_cache)
+    apr_array_clear(reps_to_cache);
+  if (reps_hash)
+    apr_hash_clear(reps_hash);
+
+  /* Always release the proto-rev file lock.  Otherwise, the txn would
+     become unusable. */
+  return svn_error_compose_create(err,
+                                  unlock_proto_rev(fs, txn_id,
+                                                   prepared->lockcookie,
+                                                   scratch_pool));
+}
+
+/* Record in PREPARED the current state of the proto-rev file PROTO_FILE
+   as well as of the proto-index and item index files of transaction
+   TXN_ID in FS, so rollback_prepared_rev() can restore it.  The caller
+   must hold the proto-rev lock.  Allocate the results in RESULT_POOL and
+   use SCRATCH_POOL for temporaries. */
+static svn_error_t *
+remember_proto_rev_state(prepared_rev_t *prepared,
+                         apr_file_t *proto_file,
+                         svn_fs_t *fs,
+                         const svn_fs_fs__id_part_t *txn_id,
+                         apr_pool_t *result_pool,
+                         apr_pool_t *scratch_pool)
+{
+  svn_error_t *err;
+
+  SVN_ERR(svn_io_file_get_offset(&prepared->initial_offset, proto_file,
+                                 scratch_pool));
+  SVN_ERR(get_proto_file_size(&prepared->l2p_proto_size,
+                              svn_fs_fs__path_l2p_proto_index(fs, txn_id,
+                                                              scratch_pool),
+                              scratch_pool));
+  SVN_ERR(get_proto_file_size(&prepared->p2l_proto_size,
+                              svn_fs_fs__path_p2l_proto_index(fs, txn_id,
+                                                              scratch_pool),
+                              scratch_pool));
+
+  err = svn_stringbuf_from_file2(&prepared->item_index,
+                                 svn_fs_fs__path_txn_item_index(fs, txn_id,
+                                                                scratch_pool),
+                                 result_pool);
+  if (err && APR_STATUS_IS_ENOENT(err->apr_err))
+    {
+      svn_error_clear(err);
+      prepared->item_index = NULL;
+      return SVN_NO_ERROR;
+    }
+
+  return svn_error_trace(err);
+}
+
+/* Write and flush the final contents of the proto-rev file of TXN in FS
+   assuming that TXN will become revision TXN->BASE_REV + 1.  That is the
+   only revision number a commit of TXN can succeed with, so all of this
+   can be done before acquiring the repository write lock and concurrent
+   commits will only serialize on moving the files into place.
+
+   Return the result in *PREPARED, allocated in RESULT_POOL, or NULL if
+   FS does not support writing revisions ahead of time.  The latter is
+   the case for physical addressing where the new IDs and offsets depend
+   on the 'current' file contents.  REPS_TO_CACHE, REPS_HASH and REPS_POOL
+   are as for write_final_rev().
+
+   The new directories will only be added to the directory cache once
+   the revision has been committed, because a concurrent commit might
+   claim the same revision and cache keys.
+
+   Use SCRATCH_POOL for temporaries. */
+static svn_error_t *
+prepare_final_rev(prepared_rev_t **prepared_p,
+                  svn_fs_t *fs,
+                  svn_fs_txn_t *txn,
+                  apr_array_header_t *reps_to_cache,
+                  apr_hash_t *reps_hash,
+                  apr_pool_t *reps_pool,
+                  apr_pool_t *result_pool,
+                  apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  const svn_fs_fs__id_part_t *txn_id = svn_fs_fs__txn_get_id(txn);
+  prepared_rev_t *prepared;
+  apr_file_t *proto_file;
+  svn_error_t *err;
+
+  *prepared_p = NULL;
+  if (!svn_fs_fs__use_log_addressing(fs))
+    return SVN_NO_ERROR;
+
+  prepared = apr_pcalloc(result_pool, sizeof(*prepared));
+  prepared->rev = txn->base_rev + 1;
+  prepared->format = ffd->format;
+  prepared->directories = apr_array_make(result_pool, 4,
+                                         sizeof(prepared_dir_t));
+
+  /* We need the changes list for verification as well as for writing it
+     to the final rev file. */
+  SVN_ERR(svn_fs_fs__txn_changes_fetch(&prepared->changed_paths, fs, txn_id,
+                                       result_pool));
+
+  /* Get a write handle on the proto revision file.  Keep it locked until
+     the revision has been committed or rolled back.  Other writers to
+     this txn may only append to the proto files while they hold that
+     lock, so this is when to remember the state to return to in case we
+     don't get to commit. */
+  SVN_ERR(get_writable_proto_rev(&proto_file, &prepared->lockcookie,
+                                 fs, txn_id, result_pool));
+  err = remember_proto_rev_state(prepared, proto_file, fs, txn_id,
+                                 result_pool, scratch_pool);
+  if (err)
+    {
+      svn_error_clear(svn_io_file_close(proto_file, scratch_pool));
+      return svn_error_compose_create(err,
+                                      unlock_proto_rev(fs, txn_id,
+                                                       prepared->lockcookie,
+                                                       scratch_pool));
+    }
+
+  err = write_final_proto_rev(proto_file, fs, txn_id, prepared->rev, 0, 0,
+                              prepared->changed_paths, NULL,
+                              prepared->directories, reps_to_cache,
+                              reps_hash, reps_pool, scratch_pool);
+  if (!err)
+    err = flush_proto_rev(proto_file, fs, txn_id, scratch_pool);
+  err = svn_error_compose_create(err,
+                                 svn_io_file_close(proto_file, scratch_pool));
+  if (err)
+    return svn_error_compose_create(err,
+                                    rollback_prepared_rev(fs, txn_id,
+                                                          prepared,
+                                                          reps_to_cache,
+                                                          reps_hash,
+                                                          scratch_pool));
+
+  *prepared_p = prepared;
+
+  return SVN_NO_ERROR;
+}
+
 /* Baton used for commit_body below. */
 struct commit_baton {
   svn_revnum_t *new_rev_p;
@@ -3732,6 +4164,11 @@ struct commit_baton {
   apr_array_header_t *reps_to_cache;
   apr_hash_t *reps_hash;
   apr_pool_t *reps_pool;
+
+  /* The proto-rev file contents written by prepare_final_rev().  NULL, if
+     the final revision data still needs to be written.  commit_body()
+     resets this once it has either committed or rolled back the data. */
+  prepared_rev_t *prepared;
 };
 
 /* The work-horse for svn_fs_fs__commit, called with the FS write lock.
@@ -3744,17 +4181,17 @@ commit_body(void *baton, apr_pool_t *pool)
   fs_fs_data_t *ffd = cb->fs->fsap_data;
   const char *old_rev_filename, *rev_filename, *proto_filename;
   const char *revprop_filename;
-  const svn_fs_id_t *root_id, *new_root_id;
   apr_uint64_t start_node_id;
   apr_uint64_t start_copy_id;
   svn_revnum_t old_rev, new_rev;
-  apr_file_t *proto_file;
   void *proto_file_lockcookie;
-  apr_off_t initial_offset, changed_path_offset;
   const svn_fs_fs__id_part_t *txn_id = svn_fs_fs__txn_get_id(cb->txn);
   apr_hash_t *changed_paths;
+  svn_fs_fs__batch_fsync_t *batch;
+  svn_error_t *err;
   apr_array_header_t *directory_ids = apr_array_make(pool, 4,
                                                      sizeof(pair_cache_key_t));
+  apr_array_header_t *prepared_dirs = NULL;
 
   /* Re-Read the current repository format.  All our repo upgrade and
      config evaluation strategies are such that existing information in
@@ -3785,10 +4222,28 @@ commit_body(void *baton, apr_pool_t *pool)
     return svn_error_create(SVN_ERR_FS_TXN_OUT_OF_DATE, NULL,
                             _("Transaction out of date"));
 
+  /* The data written ahead of time depends on the repository format.
+     Should that have been changed in the meantime, start over. */
+  if (cb->prepared && cb->prepared->format != ffd->format)
+    {
+      prepared_rev_t *prepared = cb->prepared;
+
+      cb->prepared = NULL;
+      SVN_ERR(rollback_prepared_rev(cb->fs, txn_id, prepared,
+                                    cb->reps_to_cache, cb->reps_hash,
+                                    pool));
+    }
+
   /* We need the changes list for verification as well as for writing it
      to the final rev file. */
-  SVN_ERR(svn_fs_fs__txn_changes_fetch(&changed_paths, cb->fs, txn_id,
-                                       pool));
+  if (cb->prepared)
+    {
+      changed_paths = cb->prepared->changed_paths;
+      prepared_dirs = cb->prepared->directories;
+    }
+  else
+    SVN_ERR(svn_fs_fs__txn_changes_fetch(&changed_paths, cb->fs, txn_id,
+                                         pool));
 
   /* Locks may have been added (or stolen) between the calling of
      previous svn_fs.h functions and svn_fs_commit_txn(), so we need
@@ -3799,52 +4254,38 @@ commit_body(void *baton, apr_pool_t *pool)
   /* We are going to be one better than this puny old revision. */
   new_rev = old_rev + 1;
 
-  /* Get a write handle on the proto revision file. */
-  SVN_ERR(get_writable_proto_rev(&proto_file, &proto_file_lockcookie,
-                                 cb->fs, txn_id, pool));
-  SVN_ERR(svn_io_file_get_offset(&initial_offset, proto_file, pool));
-
-  /* Write out all the node-revisions and directory contents. */
-  root_id = svn_fs_fs__id_txn_create_root(txn_id, pool);
-  SVN_ERR(write_final_rev(&new_root_id, proto_file, new_rev, cb->fs, root_id,
-                          start_node_id, start_copy_id, initial_offset,
-                          directory_ids, cb->reps_to_cache, cb->reps_hash,
-                          cb->reps_pool, TRUE, pool));
-
-  /* Write the changed-path information. */
-  SVN_ERR(write_final_changed_path_info(&changed_path_offset, proto_file,
-                                        cb->fs, txn_id, changed_paths,
-                                        pool));
-
-  if (svn_fs_fs__use_log_addressing(cb->fs))
+  if (cb->prepared)
     {
-      /* Append the index data to the rev file. */
-      SVN_ERR(svn_fs_fs__add_index_data(cb->fs, proto_file,
-                      svn_fs_fs__path_l2p_proto_index(cb->fs, txn_id, pool),
-                      svn_fs_fs__path_p2l_proto_index(cb->fs, txn_id, pool),
-                      new_rev, pool));
+      /* The proto-rev file is complete and already on disk. */
+      SVN_ERR_ASSERT(cb->prepared->rev == new_rev);
+      proto_file_lockcookie = cb->prepared->lockcookie;
     }
   else
     {
-      /* Write the final line. */
-
-      svn_stringbuf_t *trailer
-        = svn_fs_fs__unparse_revision_trailer
-                  ((apr_off_t)svn_fs_fs__id_item(new_root_id),
-                   changed_path_offset,
-                   pool);
-      SVN_ERR(svn_io_file_write_full(proto_file, trailer->data, trailer->len,
-                                     NULL, pool));
+      apr_file_t *proto_file;
+
+      /* Get a write handle on the proto revision file. */
+      SVN_ERR(get_writable_proto_rev(&proto_file, &proto_file_lockcookie,
+                                     cb->fs, txn_id, pool));
+
+      SVN_ERR(write_final_proto_rev(proto_file, cb->fs, txn_id, new_rev,
+                                    start_node_id, start_copy_id,
+                                    changed_paths, directory_ids, NULL,
+                                    cb->reps_to_cache, cb->reps_hash,
+                                    cb->reps_pool, pool));
+      if (ffd->flush_to_disk)
+        SVN_ERR(svn_io_file_flush_to_disk(proto_file, pool));
+      SVN_ERR(svn_io_file_close(proto_file, pool));
     }
 
-  if (ffd->flush_to_disk)
-    SVN_ERR(svn_io_file_flush_to_disk(proto_file, pool));
-  SVN_ERR(svn_io_file_close(proto_file, pool));
-
   /* We don't unlock the prototype revision file immediately to avoid a
      race with another caller writing to the prototype revision file
      before we commit it. */
 
+  /* The rev file contents are already on disk.  Collect all remaining
+     fsyncs up to the 'current' file update and run them concurrently. */
+  SVN_ERR(svn_fs_fs__batch_fsync_create(&batch, ffd->flush_to_disk, pool));
+
   /* Create the shard for the rev and revprop file, if we're sharding and
      this is the first revision of a new shard.  We don't care if this
      fails because the shard already existed for some reason. */
@@ -3854,8 +4295,7 @@ commit_body(void *baton, apr_pool_t *pool)
         {
           const char *new_dir
             = svn_fs_fs__path_rev_shard(cb->fs, new_rev, pool);
-          svn_error_t *err
-            = svn_io_dir_make(new_dir, APR_OS_DEFAULT, pool);
+          err = svn_io_dir_make(new_dir, APR_OS_DEFAULT, pool);
           if (err && !APR_STATUS_IS_EEXIST(err->apr_err))
             return svn_error_trace(err);
           svn_error_clear(err);
@@ -3863,6 +4303,7 @@ commit_body(void *baton, apr_pool_t *pool)
                                                     PATH_REVS_DIR,
                                                     pool),
                                     new_dir, pool));
+          SVN_ERR(svn_fs_fs__batch_fsync_new_path(batch, new_dir, pool));
         }
 
       /* Create the revprops shard. */
@@ -3870,8 +4311,7 @@ commit_body(void *baton, apr_pool_t *pool)
         {
           const char *new_dir
             = svn_fs_fs__path_revprops_shard(cb->fs, new_rev, pool);
-          svn_error_t *err
-            = svn_io_dir_make(new_dir, APR_OS_DEFAULT, pool);
+          err = svn_io_dir_make(new_dir, APR_OS_DEFAULT, pool);
           if (err && !APR_STATUS_IS_EEXIST(err->apr_err))
             return svn_error_trace(err);
           svn_error_clear(err);
@@ -3879,6 +4319,7 @@ commit_body(void *baton, apr_pool_t *pool)
                                                     PATH_REVPROPS_DIR,
                                                     pool),
                                     new_dir, pool));
+          SVN_ERR(svn_fs_fs__batch_fsync_new_path(batch, new_dir, pool));
         }
     }
 
@@ -3890,9 +4331,27 @@ commit_body(void *baton, apr_pool_t *pool)
   old_rev_filename = svn_fs_fs__path_rev_absolute(cb->fs, old_rev, pool);
   rev_filename = svn_fs_fs__path_rev(cb->fs, new_rev, pool);
   proto_filename = svn_fs_fs__path_txn_proto_rev(cb->fs, txn_id, pool);
-  SVN_ERR(svn_fs_fs__move_into_place(proto_filename, rev_filename,
-                                     old_rev_filename, ffd->flush_to_disk,
-                                     pool));
+  err = svn_io_file_rename2(proto_filename, rev_filename, FALSE, pool);
+  if (err && APR_STATUS_IS_EXDEV(err->apr_err))
+    {
+      /* Can't rename across devices; let the fallback code copy and
+         flush the file. */
+      svn_error_clear(err);
+      SVN_ERR(svn_fs_fs__move_into_place(proto_filename, rev_filename,
+                                         old_rev_filename,
+                                         ffd->flush_to_disk, pool));
+    }
+  else
+    {
+      SVN_ERR(err);
+
+      /* Schedule the fsync before making the file read-only. */
+      SVN_ERR(svn_fs_fs__batch_fsync_new_path(batch, rev_filename, pool));
+      SVN_ERR(svn_io_copy_perms(old_rev_filename, rev_filename, pool));
+    }
+
+  /* There is nothing left to roll back. */
+  cb->prepared = NULL;
 
   /* Now that we've moved the prototype revision file out of the way,
      we can unlock it (since further attempts to write to the file
@@ -3904,7 +4363,10 @@ commit_body(void *baton, apr_pool_t *pool)
   SVN_ERR_ASSERT(! svn_fs_fs__is_packed_revprop(cb->fs, new_rev));
   revprop_filename = svn_fs_fs__path_revprops(cb->fs, new_rev, pool);
   SVN_ERR(write_final_revprop(revprop_filename, old_rev_filename,
-                              cb->txn, ffd->flush_to_disk, pool));
+                              cb->txn, batch, pool));
+
+  /* Make the rev and revprop files as well as their names persistent. */
+  SVN_ERR(svn_fs_fs__batch_fsync_run(batch, pool));
 
   /* Run paranoia checks. */
   if (ffd->verify_before_commit)
@@ -3926,8 +4388,10 @@ commit_body(void *baton, apr_pool_t *pool)
   ffd->youngest_rev_cache = new_rev;
 
   /* Make the directory contents alreday cached for the new revision
-   * visible. */
+   * visible.  Those written ahead of time may be cached only now. */
   SVN_ERR(promote_cached_directories(cb->fs, directory_ids, pool));
+  if (prepared_dirs)
+    SVN_ERR(cache_prepared_directories(cb->fs, prepared_dirs, pool));
 
   /* Remove this transaction directory. */
   SVN_ERR(svn_fs_fs__purge_txn(cb->fs, cb->txn->id, pool));
@@ -3962,6 +4426,7 @@ svn_fs_fs__commit(svn_revnum_t *new_rev_p,
 {
   struct commit_baton cb;
   fs_fs_data_t *ffd = fs->fsap_data;
+  svn_error_t *err;
 
   cb.new_rev_p = new_rev_p;
   cb.fs = fs;
@@ -3980,15 +4445,27 @@ svn_fs_fs__commit(svn_revnum_t *new_rev_p,
       cb.reps_pool = NULL;
     }
 
-  SVN_ERR(svn_fs_fs__with_write_lock(fs, commit_body, &cb, pool));
+  /* Do all the heavy lifting before taking the write lock.  If we lose
+     the race against a concurrent commit, the txn is out of date and
+     will have to be merged and committed again, anyway. */
+  SVN_ERR(prepare_final_rev(&cb.prepared, fs, txn, cb.reps_to_cache,
+                            cb.reps_hash, cb.reps_pool, pool, pool));
+
+  err = svn_fs_fs__with_write_lock(fs, commit_body, &cb, pool);
+  if (err && cb.prepared)
+    err = svn_error_compose_create(err,
+                                   rollback_prepared_rev(fs,
+                                                  svn_fs_fs__txn_get_id(txn),
+                                                  cb.prepared,
+                                                  cb.reps_to_cache,
+                                                  cb.reps_hash, pool));
+  SVN_ERR(err);
 
   /* At this point, *NEW_REV_P has been set, so errors below won't affect
      the success of the commit.  (See svn_fs_commit_txn().)  */
 
   if (ffd->rep_sharing_allowed)
     {
-      svn_error_t *err;
-
       SVN_ERR(svn_fs_fs__open_rep_cache(fs, pool));
 
       /* Write new entries to the rep-sharing database.
@@ -4016,6 +4493,13 @@ svn_fs_fs__commit(svn_revnum_t *new_rev_p,
         return svn_error_trace(err);
     }
 
+  /* Bring the path history index up to date.  Like the rep-cache, this
+     happens outside the write lock. */
+  SVN_ERR(svn_fs_fs__history_index_update(fs, *new_rev_p, pool));
+
+  /* Same for the mergeinfo index, if it has been built. */
+  SVN_ERR(svn_fs_fs__mergeinfo_index_update(fs, *new_rev_p, pool));
+
   return SVN_NO_ERROR;
 }
 
@@ -57,7 +57,9 @@
 #include "lock.h"
 #include "tree.h"
 #include "fs_fs.h"
+#include "history_index.h"
 #include "id.h"
+#include "mergeinfo_index.h"
 #include "pack.h"
 #include "temp_serializer.h"
 #include "transaction.h"
@@ -2963,6 +2965,30 @@ fs_try_process_file_contents(svn_boolean_t *success,
 /* --- End machinery for svn_fs_try_process_file_contents() ---  */
 
 
+/* --- Machinery for svn_fs__try_get_file_range() ---  */
+
+static svn_error_t *
+fs_try_get_file_range(svn_boolean_t *success,
+                      apr_file_t **file,
+                      apr_off_t *offset,
+                      svn_filesize_t *length,
+                      int *svndiff_version,
+                      svn_fs_root_t *root,
+                      const char *path,
+                      apr_pool_t *result_pool,
+                      apr_pool_t *scratch_pool)
+{
+  dag_node_t *node;
+  SVN_ERR(get_dag(&node, root, path, scratch_pool));
+
+  return svn_fs_fs__dag_try_get_file_range(success, file, offset, length,
+                                           svndiff_version, node, result_pool,
+                                           scratch_pool);
+}
+
+/* --- End machinery for svn_fs__try_get_file_range() ---  */
+
+
 /* --- Machinery for svn_fs_apply_textdelta() ---  */
 
 
@@ -4085,7 +4111,30 @@ fs_history_prev(svn_fs_history_t **prev_history_p,
     }
   else
     {
-      apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+      apr_pool_t *iterpool;
+      svn_boolean_t handled;
+      const char *prev_path;
+      svn_revnum_t prev_rev;
+
+      /* Try the path history index first.  It can only tell locations
+         but those are all we need to continue from the next time. */
+      SVN_ERR(svn_fs_fs__history_index_prev(&handled, &prev_path, &prev_rev,
+                                            fs, fhd->path, fhd->revision,
+                                            fhd->is_interesting,
+                                            cross_copies, result_pool,
+                                            scratch_pool));
+      if (handled)
+        {
+          *prev_history_p = prev_path
+                          ? assemble_history(fs, prev_path, prev_rev, TRUE,
+                                             NULL, SVN_INVALID_REVNUM,
+                                             SVN_INVALID_REVNUM, NULL,
+                                             result_pool)
+                          : NULL;
+          return SVN_NO_ERROR;
+        }
+
+      iterpool = svn_pool_create(scratch_pool);
       prev_history = history;
 
       while (1)
@@ -4440,11 +4489,23 @@ add_descendant_mergeinfo(svn_fs_root_t *root,
 {
   dag_node_t *this_dag;
   svn_boolean_t go_down;
+  svn_boolean_t handled;
+  const char *fspath;
 
+  /* The node flag is free and rules out most sub-trees. */
   SVN_ERR(get_dag(&this_dag, root, path, scratch_pool));
   SVN_ERR(svn_fs_fs__dag_has_descendants_with_mergeinfo(&go_down,
                                                         this_dag));
-  if (go_down)
+  if (!go_down)
+    return SVN_NO_ERROR;
+
+  /* Use the mergeinfo index, if there is one that covers ROOT. */
+  fspath = svn_fs__canonicalize_abspath(path, scratch_pool);
+  SVN_ERR(svn_fs_fs__mergeinfo_index_get_descendants(&handled, root->fs,
+                                                     root->rev, fspath,
+                                                     receiver, baton,
+                                                     scratch_pool));
+  if (!handled)
     SVN_ERR(crawl_directory_dag_for_mergeinfo(root,
                                               path,
                                               this_dag,
@@ -4579,6 +4640,7 @@ static root_vtable_t root_vtable = {
   fs_get_file_delta_stream,
   fs_merge,
   fs_get_mergeinfo,
+  fs_try_get_file_range,
 };
 
 /* Construct a new root object in FS, allocated from POOL.  */
@@ -3076,6 +3076,7 @@ ra_svn_has_capability(svn_ra_session_t *session,
       {SVN_RA_CAPABILITY_GET_FILE_REVS_REVERSE,
                                        SVN_RA_SVN_CAP_GET_FILE_REVS_REVERSE},
       {SVN_RA_CAPABILITY_LIST, SVN_RA_SVN_CAP_LIST},
+      {SVN_RA_CAPABILITY_BLAME, SVN_RA_SVN_CAP_BLAME},
 
       {NULL, NULL} /* End of list marker */
   };
@@ -3258,6 +3259,101 @@ ra_svn_list(svn_ra_session_t *session,
   return SVN_NO_ERROR;
 }
 
+/* Return the protocol word for IGNORE_SPACE. */
+static const char *
+ignore_space_to_word(svn_diff_file_ignore_space_t ignore_space)
+{
+  switch (ignore_space)
+    {
+      case svn_diff_file_ignore_space_change:
+        return "change";
+      case svn_diff_file_ignore_space_all:
+        return "all";
+      default:
+        return "none";
+    }
+}
+
+static svn_error_t *
+ra_svn_blame(svn_ra_session_t *session,
+             const char *path,
+             svn_revnum_t start,
+             svn_revnum_t end,
+             const svn_diff_file_options_t *diff_options,
+             svn_ra_blame_receiver_t receiver,
+             void *receiver_baton,
+             apr_pool_t *scratch_pool)
+{
+  svn_ra_svn__session_baton_t *sess_baton = session->priv;
+  svn_ra_svn_conn_t *conn = sess_baton->conn;
+  svn_diff_file_ignore_space_t ignore_space = svn_diff_file_ignore_space_none;
+  svn_boolean_t ignore_eol_style = FALSE;
+  apr_hash_t *rev_props_cache = apr_hash_make(scratch_pool);
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+
+  if (diff_options)
+    {
+      ignore_space = diff_options->ignore_space;
+      ignore_eol_style = diff_options->ignore_eol_style;
+    }
+
+  path = reparent_path(session, path, scratch_pool);
+
+  /* Send the blame request. */
+  SVN_ERR(svn_ra_svn__write_tuple(conn, scratch_pool, "w(crrwb)", "blame",
+                                  path, start, end,
+                                  ignore_space_to_word(ignore_space),
+                                  ignore_eol_style));
+
+  /* Handle auth request by server */
+  SVN_ERR(handle_auth_request(sess_baton, scratch_pool));
+
+  /* Read and process the blame chunks. */
+  while (1)
+    {
+      svn_ra_svn__item_t *item;
+      apr_uint64_t start_line;
+      svn_revnum_t rev;
+      svn_ra_svn__list_t *proplist;
+      apr_hash_t *rev_props = NULL;
+
+      svn_pool_clear(iterpool);
+
+      /* Read the next chunk or bail out on "done", respectively */
+      SVN_ERR(svn_ra_svn__read_item(conn, iterpool, &item));
+      if (is_done_response(item))
+        break;
+      if (item->kind != SVN_RA_SVN_LIST)
+        return svn_error_create(SVN_ERR_RA_SVN_MALFORMED_DATA, NULL,
+                                _("Blame entry not a list"));
+      SVN_ERR(svn_ra_svn__parse_tuple(&item->u.list, "n(?r)l",
+                                      &start_line, &rev, &proplist));
+
+      /* The server sends the revprops only once per revision. */
+      if (SVN_IS_VALID_REVNUM(rev))
+        {
+          rev_props = apr_hash_get(rev_props_cache, &rev, sizeof(rev));
+          if (!rev_props)
+            {
+              svn_revnum_t *key = apr_pmemdup(scratch_pool, &rev,
+                                              sizeof(rev));
+
+              SVN_ERR(svn_ra_svn__parse_proplist(proplist, scratch_pool,
+                                                 &rev_props));
+              apr_hash_set(rev_props_cache, key, sizeof(*key), rev_props);
+            }
+        }
+
+      SVN_ERR(receiver(receiver_baton, (apr_int64_t)start_line, rev,
+                       rev_props, iterpool));
+    }
+  svn_pool_destroy(iterpool);
+
+  /* Read the actual command response. */
+  SVN_ERR(svn_ra_svn__read_cmd_response(conn, scratch_pool, ""));
+  return SVN_NO_ERROR;
+}
+
 static const svn_ra__vtable_t ra_svn_vtable = {
   svn_ra_svn_version,
   ra_svn_get_description,
@@ -3298,6 +3394,7 @@ static const svn_ra__vtable_t ra_svn_vtable = {
   ra_svn_get_inherited_props,
   NULL /* ra_set_svn_ra_open */,
   ra_svn_list,
+  ra_svn_blame,
   ra_svn_register_editor_shim_callbacks,
   NULL /* commit_ev2 */,
   NULL /* replay_range_ev2 */
@@ -37,6 +37,7 @@
 #include "svn_ra_svn.h"
 #include "svn_path.h"
 #include "svn_pools.h"
+#include "svn_sorts.h"
 #include "svn_private_config.h"
 
 #include "private/svn_atomic.h"
@@ -46,6 +47,7 @@
 #include "private/svn_subr_private.h"
 
 #include "ra_svn.h"
+#include "../libsvn_delta/delta.h"  /* for SVN_DELTA_WINDOW_SIZE */
 
 /*
  * Both the client and server in the svn protocol need to drive and
@@ -72,6 +74,18 @@ typedef struct ra_svn_baton_t {
   svn_string_t *token;
 } ra_svn_baton_t;
 
+/* Window handler baton returned by ra_svn_apply_textdelta.  Wraps the
+   svndiff encoder such that svn_ra_svn__try_send_file_range() can
+   recognize our handler and bypass the encoder. */
+typedef struct ra_svn_textdelta_baton_t {
+  ra_svn_baton_t *file;
+  svn_txdelta_window_handler_t handler;
+  void *handler_baton;
+
+  /* Set once anything has been sent for this text delta. */
+  svn_boolean_t started;
+} ra_svn_textdelta_baton_t;
+
 /* Forward declaration. */
 typedef struct ra_svn_token_entry_t ra_svn_token_entry_t;
 
@@ -330,6 +344,16 @@ static svn_error_t *ra_svn_svndiff_close_handler(void *baton)
   return SVN_NO_ERROR;
 }
 
+/* Implements svn_txdelta_window_handler_t for ra_svn_textdelta_baton_t. */
+static svn_error_t *ra_svn_textdelta_window(svn_txdelta_window_t *window,
+                                            void *baton)
+{
+  ra_svn_textdelta_baton_t *tb = baton;
+
+  tb->started = TRUE;
+  return svn_error_trace(tb->handler(window, tb->handler_baton));
+}
+
 static svn_error_t *ra_svn_apply_textdelta(void *file_baton,
                                            const char *base_checksum,
                                            apr_pool_t *pool,
@@ -337,6 +361,7 @@ static svn_error_t *ra_svn_apply_textdelta(void *file_baton,
                                            void **wh_baton)
 {
   ra_svn_baton_t *b = file_baton;
+  ra_svn_textdelta_baton_t *tb = apr_pcalloc(pool, sizeof(*tb));
   svn_stream_t *diff_stream;
 
   /* Tell the other side we're starting a text delta. */
@@ -351,9 +376,108 @@ static svn_error_t *ra_svn_apply_textdelta(void *file_baton,
   svn_stream_set_write(diff_stream, ra_svn_svndiff_handler);
   svn_stream_set_close(diff_stream, ra_svn_svndiff_close_handler);
 
-  svn_txdelta_to_svndiff3(wh, wh_baton, diff_stream,
+  svn_txdelta_to_svndiff3(&tb->handler, &tb->handler_baton, diff_stream,
                           svn_ra_svn__svndiff_version(b->conn),
                           b->conn->compression_level, pool);
+
+  tb->file = b;
+  *wh = ra_svn_textdelta_window;
+  *wh_baton = tb;
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_ra_svn__try_send_file_range(svn_boolean_t *sent,
+                                svn_txdelta_window_handler_t handler,
+                                void *handler_baton,
+                                apr_file_t *file,
+                                apr_off_t offset,
+                                svn_filesize_t length,
+                                int svndiff_version,
+                                apr_pool_t *scratch_pool)
+{
+  ra_svn_textdelta_baton_t *tb = handler_baton;
+  ra_svn_baton_t *b;
+
+  *sent = FALSE;
+
+  /* We can only bypass our own encoder and only before it produced
+     any output. */
+  if (handler != ra_svn_textdelta_window || tb->started)
+    return SVN_NO_ERROR;
+
+  /* Stored svndiff data can be forwarded only if the client
+     understands that format. */
+  b = tb->file;
+  if (svndiff_version > svn_ra_svn__svndiff_version(b->conn))
+    return SVN_NO_ERROR;
+
+  SVN_ERR(check_for_error(b->eb, scratch_pool));
+  tb->started = TRUE;
+
+  if (svndiff_version >= 0)
+    {
+      SVN_ERR(svn_ra_svn__write_cmd_textdelta_chunk_file(b->conn,
+                                                         scratch_pool,
+                                                         b->token, file,
+                                                         offset, length));
+    }
+  else
+    {
+      /* Wrap the fulltext into svndiff0 windows that consist of a single
+         "new data" instruction each.  The window headers go through the
+         normal write buffer while the data gets sent straight from FILE. */
+      static const svn_string_t svndiff0_header = SVN__STATIC_STRING("SVN\0");
+      unsigned char headers[5 * SVN__MAX_ENCODED_UINT_LEN + 2];
+      svn_string_t header;
+
+      SVN_ERR(svn_ra_svn__write_cmd_textdelta_chunk(b->conn, scratch_pool,
+                                                    b->token,
+                                                    &svndiff0_header));
+      header.data = (const char *)headers;
+      while (length > 0)
+        {
+          apr_size_t len = (apr_size_t)MIN(length, SVN_DELTA_WINDOW_SIZE);
+          unsigned char *p = headers;
+          unsigned char *ip;
+
+          /* sview_offset, sview_len, tview_len */
+          p = svn__encode_uint(p, 0);
+          p = svn__encode_uint(p, 0);
+          p = svn__encode_uint(p, len);
+
+          /* Instructions length (filled in below), new data length and
+             the instruction itself. */
+          ip = svn__encode_uint(p + 1, len);
+          if (len >> 6 == 0)
+            {
+              ip[0] = (unsigned char)(len + (0x2 << 6));
+              *p = 1;
+              header.len = ip + 1 - headers;
+            }
+          else
+            {
+              ip[0] = (0x2 << 6);
+              *p = (unsigned char)(svn__encode_uint(ip + 1, len) - ip);
+              header.len = ip + *p - headers;
+            }
+
+          SVN_ERR(svn_ra_svn__write_cmd_textdelta_chunk(b->conn,
+                                                        scratch_pool,
+                                                        b->token, &header));
+          SVN_ERR(svn_ra_svn__write_cmd_textdelta_chunk_file(b->conn,
+                                                             scratch_pool,
+                                                             b->token, file,
+                                                             offset, len));
+          offset += len;
+          length -= len;
+        }
+    }
+
+  SVN_ERR(svn_ra_svn__write_cmd_textdelta_end(b->conn, scratch_pool,
+                                              b->token));
+  *sent = TRUE;
+
   return SVN_NO_ERROR;
 }
 
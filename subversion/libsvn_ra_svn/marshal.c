@@ -37,6 +37,7 @@
 #include "svn_string.h"
 #include "svn_error.h"
 #include "svn_pools.h"
+#include "svn_io.h"
 #include "svn_ra_svn.h"
 #include "svn_private_config.h"
 #include "svn_ctype.h"
@@ -450,6 +451,72 @@ static svn_error_t *writebuf_write(svn_ra_svn_conn_t *conn, apr_pool_t *pool,
   return SVN_NO_ERROR;
 }
 
+/* Write LEN bytes starting at OFFSET in FILE to socket or output file as
+   appropriate.  Bypass the write buffer and, if possible, user space. */
+static svn_error_t *writebuf_output_file(svn_ra_svn_conn_t *conn,
+                                         apr_pool_t *pool,
+                                         apr_file_t *file,
+                                         apr_off_t offset,
+                                         svn_filesize_t len)
+{
+  apr_pool_t *subpool = NULL;
+  svn_filesize_t remaining = len;
+
+  /* Everything buffered so far must go out first. */
+  if (conn->write_pos > 0)
+    SVN_ERR(writebuf_flush(conn, pool));
+
+  /* Without sendfile support, copy the data through a buffer.
+     writebuf_output() takes care of the I/O accounting in that case. */
+  if (!svn_ra_svn__stream_can_sendfile(conn->stream))
+    {
+      char *buffer = apr_palloc(pool, SVN__STREAM_CHUNK_SIZE);
+
+      SVN_ERR(svn_io_file_seek(file, APR_SET, &offset, pool));
+      while (remaining > 0)
+        {
+          apr_size_t count = (apr_size_t)MIN(remaining,
+                                             SVN__STREAM_CHUNK_SIZE);
+          SVN_ERR(svn_io_file_read_full2(file, buffer, count, NULL, NULL,
+                                         pool));
+          SVN_ERR(writebuf_output(conn, pool, buffer, count));
+          remaining -= count;
+        }
+
+      return SVN_NO_ERROR;
+    }
+
+  conn->current_out += len;
+  SVN_ERR(check_io_limits(conn));
+
+  while (remaining > 0)
+    {
+      apr_size_t count = (apr_size_t)MIN(remaining, APR_SIZE_MAX);
+
+      SVN_ERR(svn_ra_svn__stream_sendfile(conn->stream, file, offset,
+                                          &count));
+      if (count == 0)
+        {
+          if (!subpool)
+            subpool = svn_pool_create(pool);
+          else
+            svn_pool_clear(subpool);
+          SVN_ERR(conn->block_handler(conn, subpool, conn->block_baton));
+        }
+
+      offset += count;
+      remaining -= count;
+    }
+
+  conn->written_since_error_check += len;
+  conn->may_check_for_error
+    = conn->written_since_error_check >= conn->error_check_interval;
+
+  if (subpool)
+    svn_pool_destroy(subpool);
+  return SVN_NO_ERROR;
+}
+
 /* Write STRING_LITERAL, which is a string literal argument.
 
    Note: The purpose of the empty string "" in the macro definition is to
@@ -2222,6 +2289,23 @@ svn_ra_svn__write_cmd_textdelta_chunk(svn_ra_svn_conn_t *conn,
   return SVN_NO_ERROR;
 }
 
+svn_error_t *
+svn_ra_svn__write_cmd_textdelta_chunk_file(svn_ra_svn_conn_t *conn,
+                                           apr_pool_t *pool,
+                                           const svn_string_t *token,
+                                           apr_file_t *file,
+                                           apr_off_t offset,
+                                           svn_filesize_t len)
+{
+  SVN_ERR(writebuf_write_literal(conn, pool, "( textdelta-chunk ( "));
+  SVN_ERR(write_tuple_string(conn, pool, token));
+  SVN_ERR(write_number(conn, pool, len, ':'));
+  SVN_ERR(writebuf_output_file(conn, pool, file, offset, len));
+  SVN_ERR(writebuf_write_literal(conn, pool, " ) ) "));
+
+  return SVN_NO_ERROR;
+}
+
 svn_error_t *
 svn_ra_svn__write_cmd_textdelta_end(svn_ra_svn_conn_t *conn,
                                     apr_pool_t *pool,
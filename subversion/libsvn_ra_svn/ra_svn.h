@@ -222,6 +222,20 @@ svn_ra_svn__stream_t *svn_ra_svn__stream_create(svn_stream_t *in_stream,
 svn_error_t *svn_ra_svn__stream_write(svn_ra_svn__stream_t *stream,
                                       const char *data, apr_size_t *len);
 
+/* Return TRUE if svn_ra_svn__stream_sendfile() may be used on STREAM,
+ * i.e. if STREAM writes to a plain socket and APR supports sendfile().
+ */
+svn_boolean_t svn_ra_svn__stream_can_sendfile(svn_ra_svn__stream_t *stream);
+
+/* Write *LEN bytes starting at OFFSET in FILE to STREAM without copying
+ * them through user space, returning the number of bytes written in *LEN.
+ * STREAM must support this, see svn_ra_svn__stream_can_sendfile().
+ */
+svn_error_t *svn_ra_svn__stream_sendfile(svn_ra_svn__stream_t *stream,
+                                         apr_file_t *file,
+                                         apr_off_t offset,
+                                         apr_size_t *len);
+
 /* Read *LEN bytes from STREAM into DATA, returning the number of bytes
  * read in *LEN.
  */
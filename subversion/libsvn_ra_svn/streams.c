@@ -42,6 +42,10 @@ struct svn_ra_svn__stream_st {
   svn_stream_t *out_stream;
   void *timeout_baton;
   ra_svn_timeout_fn_t timeout_fn;
+
+  /* The socket behind OUT_STREAM, if we may write to it directly.
+     NULL otherwise. */
+  apr_socket_t *sock;
 };
 
 typedef struct sock_baton_t {
@@ -167,6 +171,7 @@ svn_ra_svn__stream_from_sock(apr_socket_t *sock,
 {
   sock_baton_t *b = apr_palloc(result_pool, sizeof(*b));
   svn_stream_t *sock_stream;
+  svn_ra_svn__stream_t *s;
 
   b->sock = sock;
   b->pool = svn_pool_create(result_pool);
@@ -177,8 +182,11 @@ svn_ra_svn__stream_from_sock(apr_socket_t *sock,
   svn_stream_set_write(sock_stream, sock_write_cb);
   svn_stream_set_data_available(sock_stream, sock_pending_cb);
 
-  return svn_ra_svn__stream_create(sock_stream, sock_stream,
-                                   b, sock_timeout_cb, result_pool);
+  s = svn_ra_svn__stream_create(sock_stream, sock_stream,
+                                b, sock_timeout_cb, result_pool);
+  s->sock = sock;
+
+  return s;
 }
 
 svn_ra_svn__stream_t *
@@ -193,6 +201,7 @@ svn_ra_svn__stream_create(svn_stream_t *in_stream,
   s->out_stream = out_stream;
   s->timeout_baton = timeout_baton;
   s->timeout_fn = timeout_cb;
+  s->sock = NULL;
   return s;
 }
 
@@ -203,6 +212,40 @@ svn_ra_svn__stream_write(svn_ra_svn__stream_t *stream,
   return svn_error_trace(svn_stream_write(stream->out_stream, data, len));
 }
 
+svn_boolean_t
+svn_ra_svn__stream_can_sendfile(svn_ra_svn__stream_t *stream)
+{
+#if APR_HAS_SENDFILE
+  return stream->sock != NULL;
+#else
+  return FALSE;
+#endif
+}
+
+svn_error_t *
+svn_ra_svn__stream_sendfile(svn_ra_svn__stream_t *stream,
+                            apr_file_t *file,
+                            apr_off_t offset,
+                            apr_size_t *len)
+{
+#if APR_HAS_SENDFILE
+  apr_status_t status;
+
+  SVN_ERR_ASSERT(stream->sock);
+
+  status = apr_socket_sendfile(stream->sock, file, NULL, &offset, len, 0);
+
+  /* With a non-blocking socket, we may get only a partial write.
+     *LEN tells the caller how far we got. */
+  if (status && !APR_STATUS_IS_EAGAIN(status))
+    return svn_error_wrap_apr(status, _("Can't write to connection"));
+
+  return SVN_NO_ERROR;
+#else
+  return svn_error_create(SVN_ERR_UNSUPPORTED_FEATURE, NULL, NULL);
+#endif
+}
+
 svn_error_t *
 svn_ra_svn__stream_read(svn_ra_svn__stream_t *stream, char *data,
                         apr_size_t *len)
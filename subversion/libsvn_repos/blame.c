@@ -0,0 +1,455 @@
+/* blame.c : calculating line attribution on the server side
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include <string.h>
+
+#include <apr_pools.h>
+#include <apr_strings.h>
+
+#include "svn_pools.h"
+#include "svn_error.h"
+#include "svn_diff.h"
+#include "svn_io.h"
+#include "svn_fs.h"
+#include "svn_repos.h"
+
+#include "private/svn_cache.h"
+
+#include "svn_private_config.h"
+
+#include "repos.h"
+
+
+
+/* One chunk of blame: the lines starting at START up to the start of the
+ * next chunk (or the end of the file) were last changed in REVISION. */
+typedef struct blame_chunk_t
+{
+  apr_int64_t start;
+  svn_revnum_t revision;
+} blame_chunk_t;
+
+/* Baton used while walking the history of the file. */
+typedef struct blame_baton_t
+{
+  /* The repository we are working on. */
+  svn_repos_t *repos;
+
+  /* Changes in revisions older than this don't get attributed. */
+  svn_revnum_t start;
+
+  /* Options to use when diffing subsequent file contents. */
+  const svn_diff_file_options_t *diff_options;
+
+  /* Array of blame_chunk_t describing the contents of LAST_FILE. */
+  apr_array_header_t *chunks;
+
+  /* Array of blame_chunk_t being built for the current revision. */
+  apr_array_header_t *next_chunks;
+
+  /* Index of the last element in CHUNKS that starts before the ranges
+   * still to be reported by the diff. */
+  int cursor;
+
+  /* The revision that lines changed in the current diff get attributed
+   * to.  SVN_INVALID_REVNUM if that is older than START. */
+  svn_revnum_t revision;
+
+  /* Temporary file with the previous contents of the file or NULL. */
+  const char *last_file;
+
+  /* LAST_FILE lives in LAST_POOL.  The two pools get swapped for every
+   * revision that changes the file contents. */
+  apr_pool_t *last_pool;
+  apr_pool_t *curr_pool;
+} blame_baton_t;
+
+/* Append a chunk starting at line START and attributed to REVISION to
+ * CHUNKS, merging it with the last chunk if possible. */
+static void
+append_chunk(apr_array_header_t *chunks,
+             apr_int64_t start,
+             svn_revnum_t revision)
+{
+  blame_chunk_t *chunk;
+
+  if (chunks->nelts)
+    {
+      chunk = &APR_ARRAY_IDX(chunks, chunks->nelts - 1, blame_chunk_t);
+      if (chunk->revision == revision)
+        return;
+
+      /* An empty range got replaced. */
+      if (chunk->start == start)
+        {
+          chunk->revision = revision;
+          if (chunks->nelts > 1 && (chunk - 1)->revision == revision)
+            apr_array_pop(chunks);
+
+          return;
+        }
+    }
+
+  chunk = apr_array_push(chunks);
+  chunk->start = start;
+  chunk->revision = revision;
+}
+
+/* Implements svn_diff_output_fns_t.output_common.
+ * Lines that did not change keep their previous attribution. */
+static svn_error_t *
+output_common(void *baton,
+              apr_off_t original_start,
+              apr_off_t original_length,
+              apr_off_t modified_start,
+              apr_off_t modified_length,
+              apr_off_t latest_start,
+              apr_off_t latest_length)
+{
+  blame_baton_t *bb = baton;
+  apr_off_t original_end = original_start + original_length;
+  int i;
+
+  /* The diff reports ranges in ascending order, so we never need to look
+   * at chunks before the current cursor position again. */
+  while (bb->cursor + 1 < bb->chunks->nelts
+         && APR_ARRAY_IDX(bb->chunks, bb->cursor + 1, blame_chunk_t).start
+              <= original_start)
+    bb->cursor++;
+
+  for (i = bb->cursor; i < bb->chunks->nelts; ++i)
+    {
+      const blame_chunk_t *chunk = &APR_ARRAY_IDX(bb->chunks, i,
+                                                  blame_chunk_t);
+      apr_int64_t first = MAX(chunk->start, original_start);
+
+      if (chunk->start >= original_end)
+        break;
+
+      append_chunk(bb->next_chunks, modified_start + first - original_start,
+                   chunk->revision);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_output_fns_t.output_diff_modified.
+ * Lines that were added or changed get attributed to the current
+ * revision. */
+static svn_error_t *
+output_diff_modified(void *baton,
+                     apr_off_t original_start,
+                     apr_off_t original_length,
+                     apr_off_t modified_start,
+                     apr_off_t modified_length,
+                     apr_off_t latest_start,
+                     apr_off_t latest_length)
+{
+  blame_baton_t *bb = baton;
+
+  if (modified_length)
+    append_chunk(bb->next_chunks, modified_start, bb->revision);
+
+  return SVN_NO_ERROR;
+}
+
+static const svn_diff_output_fns_t output_fns = {
+  output_common,
+  output_diff_modified
+};
+
+/* Implements svn_file_rev_handler_t.
+ * Update the attribution in the blame_baton_t BATON for the contents of
+ * PATH in REVNUM.  Instead of letting the caller produce a delta, we read
+ * the fulltext directly from the repository. */
+static svn_error_t *
+file_rev_handler(void *baton,
+                 const char *path,
+                 svn_revnum_t revnum,
+                 apr_hash_t *rev_props,
+                 svn_boolean_t result_of_merge,
+                 svn_txdelta_window_handler_t *delta_handler,
+                 void **delta_baton,
+                 apr_array_header_t *prop_diffs,
+                 apr_pool_t *pool)
+{
+  blame_baton_t *bb = baton;
+  svn_fs_root_t *root;
+  svn_stream_t *contents;
+  svn_stream_t *file_stream;
+  const char *filename;
+  apr_pool_t *tmp_pool;
+
+  /* Property-only changes don't affect the attribution. */
+  if (!delta_handler)
+    return SVN_NO_ERROR;
+
+  /* Tell the caller not to bother computing a delta. */
+  *delta_handler = svn_delta_noop_window_handler;
+  *delta_baton = NULL;
+
+  /* The file existed before START; don't attribute lines to that state. */
+  bb->revision = revnum < bb->start ? SVN_INVALID_REVNUM : revnum;
+
+  /* Store the contents in a temporary file so we can diff them. */
+  svn_pool_clear(bb->curr_pool);
+  SVN_ERR(svn_fs_revision_root(&root, bb->repos->fs, revnum, pool));
+  SVN_ERR(svn_fs_file_contents(&contents, root, path, pool));
+  SVN_ERR(svn_stream_open_unique(&file_stream, &filename, NULL,
+                                 svn_io_file_del_on_pool_cleanup,
+                                 bb->curr_pool, pool));
+  SVN_ERR(svn_stream_copy3(contents, file_stream, NULL, NULL, pool));
+
+  if (bb->last_file)
+    {
+      svn_diff_t *diff;
+      apr_array_header_t *tmp;
+
+      SVN_ERR(svn_diff_file_diff_2(&diff, bb->last_file, filename,
+                                   bb->diff_options, pool));
+
+      bb->cursor = 0;
+      apr_array_clear(bb->next_chunks);
+      SVN_ERR(svn_diff_output2(diff, bb, &output_fns, NULL, NULL));
+
+      /* Never report an empty attribution, even for empty files. */
+      if (!bb->next_chunks->nelts)
+        append_chunk(bb->next_chunks, 0, bb->revision);
+
+      tmp = bb->chunks;
+      bb->chunks = bb->next_chunks;
+      bb->next_chunks = tmp;
+    }
+  else
+    {
+      /* The first revision: every line originates here. */
+      apr_array_clear(bb->chunks);
+      append_chunk(bb->chunks, 0, bb->revision);
+    }
+
+  /* Keep the file for the next revision. */
+  bb->last_file = filename;
+  tmp_pool = bb->last_pool;
+  bb->last_pool = bb->curr_pool;
+  bb->curr_pool = tmp_pool;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_cache__serialize_func_t for arrays of blame_chunk_t. */
+static svn_error_t *
+serialize_chunks(void **data,
+                 apr_size_t *data_len,
+                 void *in,
+                 apr_pool_t *pool)
+{
+  apr_array_header_t *chunks = in;
+
+  *data_len = chunks->nelts * sizeof(blame_chunk_t);
+  *data = apr_pmemdup(pool, chunks->elts, *data_len);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_cache__deserialize_func_t for arrays of blame_chunk_t. */
+static svn_error_t *
+deserialize_chunks(void **out,
+                   void *data,
+                   apr_size_t data_len,
+                   apr_pool_t *pool)
+{
+  int count = (int)(data_len / sizeof(blame_chunk_t));
+  apr_array_header_t *chunks = apr_array_make(pool, count,
+                                              sizeof(blame_chunk_t));
+
+  memcpy(chunks->elts, data, count * sizeof(blame_chunk_t));
+  chunks->nelts = count;
+  *out = chunks;
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *CACHE to a cache for blame results of REPOS, living in the global
+ * membuffer cache.  Set it to NULL if that cache has been disabled.
+ * Allocate the cache object in RESULT_POOL. */
+static svn_error_t *
+create_blame_cache(svn_cache__t **cache,
+                   svn_repos_t *repos,
+                   apr_pool_t *result_pool)
+{
+  svn_membuffer_t *membuffer = svn_cache__get_global_membuffer_cache();
+  const char *uuid;
+  const char *prefix;
+
+  *cache = NULL;
+  if (!membuffer)
+    return SVN_NO_ERROR;
+
+  /* Several repositories may share the cache and even the UUID. */
+  SVN_ERR(svn_fs_get_uuid(repos->fs, &uuid, result_pool));
+  prefix = apr_pstrcat(result_pool, "repos:blame:", uuid, "/", repos->path,
+                       ":", SVN_VA_NULL);
+
+  SVN_ERR(svn_cache__create_membuffer_cache(cache, membuffer,
+                                            serialize_chunks,
+                                            deserialize_chunks,
+                                            APR_HASH_KEY_STRING,
+                                            prefix,
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            TRUE, /* thread-safe */
+                                            FALSE, /* long-lived */
+                                            result_pool, result_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *CHUNKS to the attribution of PATH@END in REPOS as described for
+ * svn_repos_blame().  Allocate the result in RESULT_POOL and use
+ * SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+calculate_blame(apr_array_header_t **chunks,
+                svn_repos_t *repos,
+                const char *path,
+                svn_revnum_t start,
+                svn_revnum_t end,
+                const svn_diff_file_options_t *diff_options,
+                svn_repos_authz_func_t authz_read_func,
+                void *authz_read_baton,
+                apr_pool_t *result_pool,
+                apr_pool_t *scratch_pool)
+{
+  blame_baton_t bb = { 0 };
+
+  bb.repos = repos;
+  bb.start = start;
+  bb.diff_options = diff_options;
+  bb.chunks = apr_array_make(result_pool, 16, sizeof(blame_chunk_t));
+  bb.next_chunks = apr_array_make(result_pool, 16, sizeof(blame_chunk_t));
+  bb.last_pool = svn_pool_create(scratch_pool);
+  bb.curr_pool = svn_pool_create(scratch_pool);
+
+  /* Like the client-side blame, start one revision early so that we know
+   * what actually changed in START. */
+  SVN_ERR(svn_repos_get_file_revs2(repos, path, start > 0 ? start - 1 : 0,
+                                   end, FALSE,
+                                   authz_read_func, authz_read_baton,
+                                   file_rev_handler, &bb, scratch_pool));
+
+  svn_pool_destroy(bb.last_pool);
+  svn_pool_destroy(bb.curr_pool);
+
+  *chunks = bb.chunks;
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_repos_blame(svn_repos_t *repos,
+                const char *path,
+                svn_revnum_t start,
+                svn_revnum_t end,
+                const svn_diff_file_options_t *diff_options,
+                svn_repos_authz_func_t authz_read_func,
+                void *authz_read_baton,
+                svn_repos_blame_receiver_t receiver,
+                void *receiver_baton,
+                apr_pool_t *scratch_pool)
+{
+  apr_array_header_t *chunks = NULL;
+  svn_cache__t *cache = NULL;
+  const char *cache_key = NULL;
+  svn_boolean_t found = FALSE;
+  apr_hash_t *rev_props_cache;
+  apr_pool_t *iterpool;
+  int i;
+
+  if (!SVN_IS_VALID_REVNUM(end))
+    SVN_ERR(svn_fs_youngest_rev(&end, repos->fs, scratch_pool));
+  if (!SVN_IS_VALID_REVNUM(start))
+    start = 0;
+  if (start > end)
+    return svn_error_createf(SVN_ERR_INCORRECT_PARAMS, NULL,
+                             _("Invalid blame range r%ld:%ld"), start, end);
+
+  if (!diff_options)
+    diff_options = svn_diff_file_options_create(scratch_pool);
+
+  /* With path-based authz, the result depends on the user.  Only cache
+   * results that are the same for everybody. */
+  if (!authz_read_func)
+    {
+      SVN_ERR(create_blame_cache(&cache, repos, scratch_pool));
+      if (cache)
+        {
+          cache_key = apr_psprintf(scratch_pool, "%ld:%ld:%d:%d:%d:%s",
+                                   end, start,
+                                   (int)diff_options->ignore_space,
+                                   (int)diff_options->ignore_eol_style,
+                                   (int)diff_options->algorithm,
+                                   path);
+          SVN_ERR(svn_cache__get((void **)&chunks, &found, cache, cache_key,
+                                 scratch_pool));
+        }
+    }
+
+  if (!found)
+    {
+      SVN_ERR(calculate_blame(&chunks, repos, path, start, end, diff_options,
+                              authz_read_func, authz_read_baton,
+                              scratch_pool, scratch_pool));
+      if (cache)
+        SVN_ERR(svn_cache__set(cache, cache_key, chunks, scratch_pool));
+    }
+
+  /* Report the attribution.  Revision properties may change at any time,
+   * so they are not part of the cached data. */
+  rev_props_cache = apr_hash_make(scratch_pool);
+  iterpool = svn_pool_create(scratch_pool);
+  for (i = 0; i < chunks->nelts; ++i)
+    {
+      const blame_chunk_t *chunk = &APR_ARRAY_IDX(chunks, i, blame_chunk_t);
+      apr_hash_t *rev_props = NULL;
+
+      svn_pool_clear(iterpool);
+
+      if (SVN_IS_VALID_REVNUM(chunk->revision))
+        {
+          rev_props = apr_hash_get(rev_props_cache, &chunk->revision,
+                                   sizeof(chunk->revision));
+          if (!rev_props)
+            {
+              SVN_ERR(svn_repos_fs_revision_proplist(&rev_props, repos,
+                                                     chunk->revision,
+                                                     authz_read_func,
+                                                     authz_read_baton,
+                                                     scratch_pool));
+              apr_hash_set(rev_props_cache, &chunk->revision,
+                           sizeof(chunk->revision), rev_props);
+            }
+        }
+
+      SVN_ERR(receiver(receiver_baton, chunk->start, chunk->revision,
+                       rev_props, iterpool));
+    }
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
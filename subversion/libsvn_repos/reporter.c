@@ -35,7 +35,9 @@
 #include "svn_private_config.h"
 
 #include "private/svn_dep_compat.h"
+#include "private/svn_fs_private.h"
 #include "private/svn_fspath.h"
+#include "private/svn_repos_private.h"
 #include "private/svn_subr_private.h"
 #include "private/svn_string_private.h"
 
@@ -113,6 +115,9 @@ typedef struct report_baton_t
   svn_boolean_t text_deltas;   /* Whether to report text deltas */
   apr_size_t zero_copy_limit;  /* Max item size that will be sent using
                                   the zero-copy code path. */
+  svn_repos__send_file_range_func_t send_file_range_func;
+                               /* Sends larger items straight from the
+                                  rev / pack file.  May be NULL. */
 
   /* If the client requested a specific depth, record it here; if the
      client did not, then this is svn_depth_unknown, and the depth of
@@ -661,6 +666,45 @@ send_zero_copy_delta(const unsigned char *contents,
   return SVN_NO_ERROR;
 }
 
+/* Try to send the contents of B->t_root/T_PATH to the window handler
+ * DHANDLER with DBATON using B->send_file_range_func, if the item is
+ * larger than B->zero_copy_limit and stored in a suitable format.
+ * Set *SENT to TRUE if that succeeded.  Use POOL for temporaries.
+ */
+static svn_error_t *
+send_file_range(svn_boolean_t *sent,
+                report_baton_t *b,
+                const char *t_path,
+                svn_txdelta_window_handler_t dhandler,
+                void *dbaton,
+                apr_pool_t *pool)
+{
+  svn_boolean_t found;
+  apr_file_t *file;
+  apr_off_t offset;
+  svn_filesize_t length;
+  int svndiff_version;
+  apr_pool_t *subpool;
+
+  /* Small items are better served by the normal code paths. */
+  *sent = FALSE;
+  SVN_ERR(svn_fs_file_length(&length, b->t_root, t_path, pool));
+  if (length <= (svn_filesize_t)b->zero_copy_limit)
+    return SVN_NO_ERROR;
+
+  /* The file handle gets closed together with SUBPOOL. */
+  subpool = svn_pool_create(pool);
+  SVN_ERR(svn_fs__try_get_file_range(&found, &file, &offset, &length,
+                                     &svndiff_version, b->t_root, t_path,
+                                     subpool, subpool));
+  if (found)
+    SVN_ERR(b->send_file_range_func(sent, dhandler, dbaton, file, offset,
+                                    length, svndiff_version, subpool));
+
+  svn_pool_destroy(subpool);
+  return SVN_NO_ERROR;
+}
+
 
 /* Make the appropriate edits on FILE_BATON to change its contents and
    properties from those in S_REV/S_PATH to those in B->t_root/T_PATH,
@@ -730,6 +774,16 @@ delta_files(report_baton_t *b, void *file_baton, svn_revnum_t s_rev,
                  i.e. been processed? */
               if (called && baton.zero_copy_succeeded)
                 return SVN_NO_ERROR;
+
+              /* larger items may still be sent straight from disk. */
+              if (b->send_file_range_func)
+                {
+                  svn_boolean_t sent;
+                  SVN_ERR(send_file_range(&sent, b, t_path, dhandler, dbaton,
+                                          pool));
+                  if (sent)
+                    return SVN_NO_ERROR;
+                }
             }
 
           SVN_ERR(svn_fs_get_file_delta_stream(&dstream, s_root, s_path,
@@ -1620,6 +1674,7 @@ svn_repos_begin_report3(void **report_baton,
                           : svn_fspath__join(b->fs_base, s_operand, pool);
   b->text_deltas = text_deltas;
   b->zero_copy_limit = zero_copy_limit;
+  b->send_file_range_func = NULL;
   b->requested_depth = depth;
   b->ignore_ancestry = ignore_ancestry;
   b->send_copyfrom_args = send_copyfrom_args;
@@ -1639,3 +1694,12 @@ svn_repos_begin_report3(void **report_baton,
   *report_baton = b;
   return SVN_NO_ERROR;
 }
+
+void
+svn_repos__report_set_send_file_range_func(
+  void *report_baton,
+  svn_repos__send_file_range_func_t send_file_range_func)
+{
+  report_baton_t *b = report_baton;
+  b->send_file_range_func = send_file_range_func;
+}
@@ -24,6 +24,12 @@
 #include <assert.h>
 #include <apr_md5.h>
 #include <apr_thread_rwlock.h>
+#include <apr_global_mutex.h>
+#include <apr_shm.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>   /* For getpid() */
+#endif
 
 #include "svn_pools.h"
 #include "svn_checksum.h"
@@ -40,6 +46,7 @@
 
 #include "cache.h"
 #include "fnv1a.h"
+#include "pools.h"
 
 /*
  * This svn_cache__t implementation actually consists of two parts:
@@ -146,6 +153,81 @@
 #  define USE_SIMPLE_MUTEX 0
 #endif
 
+/* Even uncontended, read locks are not free and with many threads (e.g.
+ * httpd's event MPM), readers will spend significant time on the lock
+ * object's cache line.  Therefore, lookups will first be tried without
+ * taking the segment lock.
+ *
+ * This is a simple seqlock scheme: Writers hold the write lock and bump
+ * the segment's WRITE_SEQUENCE counter before and after modifying it,
+ * i.e. it is odd while a modification is in progress.  Readers remember
+ * the counter value, copy the data and then check that the counter did
+ * not change.  If it did, they discard the copy and use the read lock.
+ *
+ * That requires explicit memory barriers, which we only get from GCC-
+ * compatible compilers.  The debug code would report false positives
+ * when comparing the tags of inconsistent data.
+ */
+#if (   APR_HAS_THREADS && defined(__GNUC__) && defined(__ATOMIC_ACQUIRE) \
+     && !defined(SVN_DEBUG_CACHE_MEMBUFFER))
+#  define USE_OPTIMISTIC_READS 1
+#else
+#  define USE_OPTIMISTIC_READS 0
+#endif
+
+/* Pre-forking servers may place the cache in an anonymous shared memory
+ * segment that gets created before the first fork.  The worker processes
+ * then inherit the mapping at the very same address, i.e. all pointers
+ * within the cache structures remain valid, and share a single cache.
+ *
+ * Segment locks must then synchronize processes instead of threads, so
+ * we use global mutexes.  Because they are exclusive, the lock-free
+ * lookups (see USE_OPTIMISTIC_READS) become even more important here.
+ * Their sequence counters live in the shared segment headers and work
+ * across processes just like they do across threads.
+ *
+ * The prefix pool, however, is a process-local data structure.  Prefix
+ * indexes handed out by different processes would not be consistent.
+ * Shared caches will therefore never use them and always store and
+ * compare full keys.
+ */
+#if APR_HAS_SHARED_MEMORY && APR_HAS_FORK && defined(HAVE_UNISTD_H)
+#  define SUPPORT_SHARED_MEMBUFFER 1
+#else
+#  define SUPPORT_SHARED_MEMBUFFER 0
+#endif
+
+/* Each segment of a shared cache has its own global mutex.  Depending on
+ * the implementation, these may be a scarce system-wide resource (e.g.
+ * SysV semaphores).  So, limit the number of segments for shared caches.
+ */
+#define MAX_SHARED_SEGMENT_COUNT 64
+
+/* The mutex mechanism used for shared caches.  A worker process may die
+ * while holding a segment lock.  The kernel releases fcntl() record locks
+ * in that case, so the remaining processes can carry on (see also
+ * recover_segment()).  Moreover, the lock file is anonymous and already
+ * open in all workers, i.e. they don't need access rights to it when they
+ * run under a different user ID than the process that created the cache.
+ * Other mechanisms may leave the lock taken if its owner dies.
+ */
+#if APR_HAS_FCNTL_SERIALIZE
+#  define SHARED_LOCK_MECH APR_LOCK_FCNTL
+#else
+#  define SHARED_LOCK_MECH APR_LOCK_DEFAULT
+#endif
+
+/* Number of times a lock-free lookup will be attempted before falling
+ * back to taking the read lock.
+ */
+#define OPTIMISTIC_READ_ATTEMPTS 2
+
+/* Partial getters access the cached data in-place.  For lock-free lookups,
+ * we must copy the data first.  Don't do that for items larger than this
+ * but take the read lock instead.
+ */
+#define OPTIMISTIC_PARTIAL_READ_LIMIT 0x4000
+
 /* For more efficient copy operations, let's align all data items properly.
  * Since we can't portably align pointers, this is rather the item size
  * granularity which ensures *relative* alignment within the cache - still
@@ -805,10 +887,12 @@ struct svn_membuffer_t
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
   /* Same for read-write lock. */
   apr_thread_rwlock_t *lock;
+#endif
 
+#if (APR_HAS_THREADS && !USE_SIMPLE_MUTEX) || SUPPORT_SHARED_MEMBUFFER
   /* If set, write access will wait until they get exclusive access.
    * Otherwise, they will become no-ops if the segment is currently
-   * read-locked.  Only used when LOCK is an r/w lock.
+   * locked.  Only used when LOCK is an r/w lock or with SHARED_LOCK.
    */
   svn_boolean_t allow_blocking_writes;
 #endif
@@ -817,17 +901,159 @@ struct svn_membuffer_t
    * This one is only used in debug assertions to verify that you used
    * the correct multi-threading settings. */
   svn_atomic_t write_lock_count;
+
+#if SUPPORT_SHARED_MEMBUFFER
+  /* Cross-process lock to be used instead of LOCK if this segment lives
+   * in shared memory.  NULL for process-local caches.
+   */
+  apr_global_mutex_t *shared_lock;
+#endif
+
+#if SUPPORT_SHARED_MEMBUFFER && !USE_OPTIMISTIC_READS
+  /* Set between begin_write() and end_write().  If we find this set when
+   * acquiring SHARED_LOCK, its previous owner died while modifying the
+   * segment.  With USE_OPTIMISTIC_READS, WRITE_SEQUENCE tells us the same.
+   */
+  svn_boolean_t modifying;
+#endif
+
+#if USE_OPTIMISTIC_READS
+  /* Modification counter for lock-free readers.  Only writers holding the
+   * write lock may change it.  Odd values indicate that the segment is
+   * currently being modified.  See USE_OPTIMISTIC_READS.
+   */
+  apr_uint32_t write_sequence;
+#endif
 };
 
 /* Align integer VALUE to the next ITEM_ALIGNMENT boundary.
  */
 #define ALIGN_VALUE(value) (((value) + ITEM_ALIGNMENT-1) & -ITEM_ALIGNMENT)
 
+/* Remove all entries from the segment CACHE.  The caller must hold the
+ * write lock and call begin_write() before and end_write() after this.
+ */
+static void
+reset_segment(svn_membuffer_t *cache)
+{
+  /* Length of the group_initialized array in bytes.
+     See also svn_cache__membuffer_cache_create(). */
+  apr_size_t group_init_size
+    = 1 + (cache->group_count + cache->spare_group_count)
+            / (8 * GROUP_INIT_GRANULARITY);
+
+  /* Mark all groups as "not initialized", which implies "empty". */
+  cache->first_spare_group = NO_INDEX;
+  cache->max_spare_used = 0;
+
+  memset(cache->group_initialized, 0, group_init_size);
+
+  /* Unlink L1 contents. */
+  cache->l1.first = NO_INDEX;
+  cache->l1.last = NO_INDEX;
+  cache->l1.next = NO_INDEX;
+  cache->l1.current_data = cache->l1.start_offset;
+
+  /* Unlink L2 contents. */
+  cache->l2.first = NO_INDEX;
+  cache->l2.last = NO_INDEX;
+  cache->l2.next = NO_INDEX;
+  cache->l2.current_data = cache->l2.start_offset;
+
+  /* Reset content counters. */
+  cache->data_used = 0;
+  cache->used_entries = 0;
+}
+
+/* Signal lock-free readers that CACHE is about to be modified.
+ * The caller must hold the write lock.
+ */
+static APR_INLINE void
+begin_write(svn_membuffer_t *cache)
+{
+#if USE_OPTIMISTIC_READS
+  apr_uint32_t sequence = __atomic_load_n(&cache->write_sequence,
+                                          __ATOMIC_RELAXED);
+  __atomic_store_n(&cache->write_sequence, sequence + 1, __ATOMIC_RELAXED);
+
+  /* The counter must become odd before any of our data changes become
+   * visible to other threads. */
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+#elif SUPPORT_SHARED_MEMBUFFER
+  cache->modifying = TRUE;
+#endif
+}
+
+/* Signal lock-free readers that the modification to CACHE started with
+ * begin_write() is complete.  The caller must still hold the write lock.
+ * Return ERR.
+ */
+static APR_INLINE svn_error_t *
+end_write(svn_membuffer_t *cache, svn_error_t *err)
+{
+#if USE_OPTIMISTIC_READS
+  apr_uint32_t sequence = __atomic_load_n(&cache->write_sequence,
+                                          __ATOMIC_RELAXED);
+  __atomic_store_n(&cache->write_sequence, sequence + 1, __ATOMIC_RELEASE);
+#elif SUPPORT_SHARED_MEMBUFFER
+  cache->modifying = FALSE;
+#endif
+
+  return err;
+}
+
+#if SUPPORT_SHARED_MEMBUFFER
+
+/* Return TRUE if a modification of CACHE has been started with
+ * begin_write() but not been completed with end_write().
+ * The caller must hold the write lock.
+ */
+static APR_INLINE svn_boolean_t
+write_in_progress(svn_membuffer_t *cache)
+{
+#if USE_OPTIMISTIC_READS
+  return (__atomic_load_n(&cache->write_sequence, __ATOMIC_RELAXED) & 1)
+      != 0;
+#else
+  return cache->modifying;
+#endif
+}
+
+/* If the previous owner of the SHARED_LOCK of CACHE died while modifying
+ * the segment, its contents may be inconsistent.  Drop them in that case.
+ * The caller must hold SHARED_LOCK.
+ */
+static void
+recover_segment(svn_membuffer_t *cache)
+{
+  if (write_in_progress(cache))
+    {
+      /* Lock-free readers still consider the segment being modified. */
+      reset_segment(cache);
+      cache->write_lock_count = 0;
+      end_write(cache, SVN_NO_ERROR);
+    }
+}
+
+#endif
+
 /* If locking is supported for CACHE, acquire a read lock for it.
  */
 static svn_error_t *
 read_lock_cache(svn_membuffer_t *cache)
 {
+#if SUPPORT_SHARED_MEMBUFFER
+  if (cache->shared_lock)
+    {
+      apr_status_t status = apr_global_mutex_lock(cache->shared_lock);
+      if (status)
+        return svn_error_wrap_apr(status, _("Can't lock cache mutex"));
+
+      recover_segment(cache);
+      return SVN_NO_ERROR;
+    }
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__lock(cache->lock);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -851,6 +1077,34 @@ read_lock_cache(svn_membuffer_t *cache)
 static svn_error_t *
 write_lock_cache(svn_membuffer_t *cache, svn_boolean_t *success)
 {
+#if SUPPORT_SHARED_MEMBUFFER
+  if (cache->shared_lock)
+    {
+      apr_status_t status;
+      if (cache->allow_blocking_writes)
+        {
+          status = apr_global_mutex_lock(cache->shared_lock);
+        }
+      else
+        {
+          status = apr_global_mutex_trylock(cache->shared_lock);
+          if (SVN_LOCK_IS_BUSY(status))
+            {
+              *success = FALSE;
+              status = APR_SUCCESS;
+            }
+        }
+
+      if (status)
+        return svn_error_wrap_apr(status,
+                                  _("Can't write-lock cache mutex"));
+
+      if (*success)
+        recover_segment(cache);
+      return SVN_NO_ERROR;
+    }
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__lock(cache->lock);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -888,6 +1142,19 @@ write_lock_cache(svn_membuffer_t *cache, svn_boolean_t *success)
 static svn_error_t *
 force_write_lock_cache(svn_membuffer_t *cache)
 {
+#if SUPPORT_SHARED_MEMBUFFER
+  if (cache->shared_lock)
+    {
+      apr_status_t status = apr_global_mutex_lock(cache->shared_lock);
+      if (status)
+        return svn_error_wrap_apr(status,
+                                  _("Can't write-lock cache mutex"));
+
+      recover_segment(cache);
+      return SVN_NO_ERROR;
+    }
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__lock(cache->lock);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -908,6 +1175,20 @@ force_write_lock_cache(svn_membuffer_t *cache)
 static svn_error_t *
 unlock_cache(svn_membuffer_t *cache, svn_error_t *err)
 {
+#if SUPPORT_SHARED_MEMBUFFER
+  if (cache->shared_lock)
+    {
+      apr_status_t status = apr_global_mutex_unlock(cache->shared_lock);
+      if (err)
+        return err;
+
+      if (status)
+        return svn_error_wrap_apr(status, _("Can't unlock cache mutex"));
+
+      return SVN_NO_ERROR;
+    }
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__unlock(cache->lock, err);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -959,7 +1240,8 @@ do {                                                            \
       else                                                      \
         break;                                                  \
     }                                                           \
-  SVN_ERR(unlock_cache(cache, (expr)));                         \
+  begin_write(cache);                                           \
+  SVN_ERR(unlock_cache(cache, end_write(cache, (expr))));       \
 } while (0)
 
 /* Returns 0 if the entry group identified by GROUP_INDEX in CACHE has not
@@ -1550,6 +1832,67 @@ find_entry(svn_membuffer_t *cache,
   return entry;
 }
 
+#if USE_OPTIMISTIC_READS
+
+/* Lock-free variant of find_entry with FIND_EMPTY not set.  Because
+ * writers may modify the directory concurrently, the result may be
+ * bogus.  But we make sure that we don't access memory outside CACHE's
+ * directory and data buffer.  The caller must validate the result using
+ * CACHE->WRITE_SEQUENCE.
+ */
+static entry_t *
+find_entry_optimistic(svn_membuffer_t *cache,
+                      apr_uint32_t group_index,
+                      const full_key_t *to_find)
+{
+  apr_uint32_t group_limit = cache->group_count + cache->spare_group_count;
+  apr_uint64_t data_size = cache->l1.size + cache->l2.size;
+  apr_size_t key_len = to_find->entry_key.key_len;
+  entry_group_t *group = &cache->directory[group_index];
+  int chain_length;
+
+  if (! is_group_initialized(cache, group_index))
+    return NULL;
+
+  /* Chains can't be longer than this, unless inconsistent. */
+  for (chain_length = 0; chain_length < MAX_GROUP_CHAIN_LENGTH; ++chain_length)
+    {
+      apr_uint32_t used = group->header.used;
+      apr_uint32_t next = group->header.next;
+      apr_uint32_t i;
+
+      for (i = 0; i < used && i < GROUP_SIZE; ++i)
+        if (entry_keys_match(&group->entries[i].key, &to_find->entry_key))
+          {
+            entry_t *entry = &group->entries[i];
+            apr_uint64_t offset = entry->offset;
+
+            /* If the full key is fully defined in prefix_id & mangeled
+             * key, we are done. */
+            if (!key_len)
+              return entry;
+
+            /* Compare the full key but stay within the data buffer. */
+            if (offset > data_size || key_len > data_size - offset)
+              return NULL;
+
+            return memcmp(to_find->full_key.data, cache->data + offset,
+                          key_len) == 0
+                 ? entry
+                 : NULL;
+          }
+
+      if (next == NO_INDEX || next >= group_limit)
+        break;
+
+      group = &cache->directory[next];
+    }
+
+  return NULL;
+}
+
+#endif
+
 /* Move a surviving ENTRY from just behind the insertion window to
  * its beginning and move the insertion window up accordingly.
  */
@@ -1832,17 +2175,96 @@ ensure_data_insertable_l1(svn_membuffer_t *cache, apr_size_t size)
    * right answer. */
 }
 
-svn_error_t *
-svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
-                                  apr_size_t total_size,
-                                  apr_size_t directory_size,
-                                  apr_size_t segment_count,
-                                  svn_boolean_t thread_safe,
-                                  svn_boolean_t allow_blocking_writes,
-                                  apr_pool_t *pool)
+#if SUPPORT_SHARED_MEMBUFFER
+
+/* Process-local resources of a cache that lives in shared memory.
+ */
+typedef struct shared_resources_t
+{
+  /* Unmanaged pool containing the shared memory segment and the global
+   * mutexes.  Because it is unmanaged, it will not be cleaned up when
+   * a forked worker process terminates.
+   */
+  apr_pool_t *pool;
+
+  /* The process that created the shared resources.  Only this one may
+   * release them.
+   */
+  pid_t owner;
+} shared_resources_t;
+
+/* Pool cleanup function releasing the shared_resources_t in DATA, if
+ * we are the process that created them.  Otherwise, do nothing.
+ */
+static apr_status_t
+release_shared_resources(void *data)
+{
+  shared_resources_t *resources = data;
+  if (resources->owner == getpid())
+    svn_pool_destroy(resources->pool);
+
+  return APR_SUCCESS;
+}
+
+/* Create an anonymous shared memory segment of SIZE bytes and return its
+ * base address in *MEMORY.  Return the process-local resources in
+ * *RESOURCES and release them in the creating process when POOL gets
+ * cleaned up.
+ */
+static svn_error_t *
+allocate_shared_memory(unsigned char **memory,
+                       shared_resources_t **resources,
+                       apr_size_t size,
+                       apr_pool_t *pool)
+{
+  apr_shm_t *shm;
+  apr_status_t status;
+  shared_resources_t *result = apr_pcalloc(pool, sizeof(*result));
+
+  result->pool = svn_pool__create_unmanaged(TRUE);
+  result->owner = getpid();
+
+  /* Anonymous segments are not supported on all platforms. */
+  status = apr_shm_create(&shm, size, NULL, result->pool);
+  if (status)
+    {
+      svn_pool_destroy(result->pool);
+      return svn_error_wrap_apr(status,
+                                _("Can't create shared memory for cache"));
+    }
+
+  apr_pool_cleanup_register(pool, result, release_shared_resources,
+                            apr_pool_cleanup_null);
+
+  *memory = apr_shm_baseaddr_get(shm);
+  *resources = result;
+
+  return SVN_NO_ERROR;
+}
+
+#endif
+
+/* Implement svn_cache__membuffer_cache_create and
+ * svn_cache__membuffer_cache_create_shared.  If SHARED is set, allocate
+ * all cache structures from a shared memory segment and use global
+ * mutexes for synchronization.  THREAD_SAFE is ignored in that case.
+ */
+static svn_error_t *
+membuffer_cache_create(svn_membuffer_t **cache,
+                       apr_size_t total_size,
+                       apr_size_t directory_size,
+                       apr_size_t segment_count,
+                       svn_boolean_t thread_safe,
+                       svn_boolean_t allow_blocking_writes,
+                       svn_boolean_t shared,
+                       apr_pool_t *pool)
 {
   svn_membuffer_t *c;
   prefix_pool_t *prefix_pool;
+  unsigned char *shared_memory = NULL;
+#if SUPPORT_SHARED_MEMBUFFER
+  shared_resources_t *shared_resources = NULL;
+#endif
 
   apr_uint32_t seg;
   apr_uint32_t group_count;
@@ -1852,11 +2274,27 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
   apr_uint64_t data_size;
   apr_uint64_t max_entry_size;
 
+#if !SUPPORT_SHARED_MEMBUFFER
+  if (shared)
+    return svn_error_create(SVN_ERR_UNSUPPORTED_FEATURE, NULL,
+                            _("Shared memory caches are not supported "
+                              "on this platform"));
+#endif
+
   /* Allocate 1% of the cache capacity to the prefix string pool.
+   * Prefix indexes are process-local, so shared caches can't use them.
    */
-  SVN_ERR(prefix_pool_create(&prefix_pool, total_size / 100, thread_safe,
-                             pool));
-  total_size -= total_size / 100;
+  if (shared)
+    {
+      thread_safe = FALSE;
+      SVN_ERR(prefix_pool_create(&prefix_pool, 0, FALSE, pool));
+    }
+  else
+    {
+      SVN_ERR(prefix_pool_create(&prefix_pool, total_size / 100,
+                                 thread_safe, pool));
+      total_size -= total_size / 100;
+    }
 
   /* Limit the total size (only relevant if we can address > 4GB)
    */
@@ -1869,6 +2307,8 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
    */
   if (segment_count > MAX_SEGMENT_COUNT)
     segment_count = MAX_SEGMENT_COUNT;
+  if (shared && segment_count > MAX_SHARED_SEGMENT_COUNT)
+    segment_count = MAX_SHARED_SEGMENT_COUNT;
   if (segment_count * MIN_SEGMENT_SIZE > total_size)
     segment_count = total_size / MIN_SEGMENT_SIZE;
 
@@ -1910,9 +2350,6 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
          && segment_count < MAX_SEGMENT_COUNT)
     segment_count *= 2;
 
-  /* allocate cache as an array of segments / cache objects */
-  c = apr_palloc(pool, segment_count * sizeof(*c));
-
   /* Split total cache size into segments of equal size
    */
   total_size /= segment_count;
@@ -1963,6 +2400,35 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
   assert(spare_group_count > 0 && main_group_count > 0);
 
   group_init_size = 1 + group_count / (8 * GROUP_INIT_GRANULARITY);
+
+  /* allocate cache as an array of segments / cache objects */
+#if SUPPORT_SHARED_MEMBUFFER
+  if (shared)
+    {
+      /* Put the segment headers and all segment buffers into a single
+       * shared memory block.  Keep the directories aligned to their
+       * block size. */
+      apr_size_t header_size = APR_ALIGN(segment_count * sizeof(*c),
+                                         GROUP_BLOCK_SIZE);
+      apr_size_t segment_size
+        = group_count * sizeof(entry_group_t)
+        + APR_ALIGN(ALIGN_VALUE(data_size) + group_init_size,
+                    GROUP_BLOCK_SIZE);
+
+      SVN_ERR(allocate_shared_memory(&shared_memory, &shared_resources,
+                                     header_size
+                                       + segment_count * segment_size,
+                                     pool));
+
+      c = (svn_membuffer_t *)shared_memory;
+      shared_memory += header_size;
+    }
+  else
+#endif
+    {
+      c = apr_palloc(pool, segment_count * sizeof(*c));
+    }
+
   for (seg = 0; seg < segment_count; ++seg)
     {
       /* allocate buffers and initialize cache members
@@ -1975,15 +2441,38 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
       c[seg].first_spare_group = NO_INDEX;
       c[seg].max_spare_used = 0;
 
-      /* Allocate but don't clear / zero the directory because it would add
-         significantly to the server start-up time if the caches are large.
-         Group initialization will take care of that in stead. */
-      c[seg].directory = apr_palloc(pool,
-                                    group_count * sizeof(entry_group_t));
-
-      /* Allocate and initialize directory entries as "not initialized",
-         hence "unused" */
-      c[seg].group_initialized = apr_pcalloc(pool, group_init_size);
+      if (shared_memory)
+        {
+          /* Carve this segment's buffers from the shared memory block.
+             Mark all groups as "not initialized", hence "unused". */
+          c[seg].directory = (entry_group_t *)shared_memory;
+          shared_memory += group_count * sizeof(entry_group_t);
+
+          c[seg].data = shared_memory;
+          shared_memory += ALIGN_VALUE(data_size);
+
+          c[seg].group_initialized = shared_memory;
+          memset(c[seg].group_initialized, 0, group_init_size);
+          shared_memory = c[seg].data
+                        + APR_ALIGN(ALIGN_VALUE(data_size) + group_init_size,
+                                    GROUP_BLOCK_SIZE);
+        }
+      else
+        {
+          /* Allocate but don't clear / zero the directory because it would
+             add significantly to the server start-up time if the caches
+             are large.  Group initialization will take care of that in
+             stead. */
+          c[seg].directory = apr_palloc(pool,
+                                        group_count * sizeof(entry_group_t));
+
+          /* Allocate and initialize directory entries as "not initialized",
+             hence "unused" */
+          c[seg].group_initialized = apr_pcalloc(pool, group_init_size);
+
+          /* This cast is safe because DATA_SIZE <= MAX_SEGMENT_SIZE. */
+          c[seg].data = apr_palloc(pool, (apr_size_t)ALIGN_VALUE(data_size));
+        }
 
       /* Allocate 1/4th of the data buffer to L1
        */
@@ -2003,8 +2492,6 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
       c[seg].l2.size = ALIGN_VALUE(data_size) - c[seg].l1.size;
       c[seg].l2.current_data = c[seg].l2.start_offset;
 
-      /* This cast is safe because DATA_SIZE <= MAX_SEGMENT_SIZE. */
-      c[seg].data = apr_palloc(pool, (apr_size_t)ALIGN_VALUE(data_size));
       c[seg].data_used = 0;
       c[seg].max_entry_size = max_entry_size;
 
@@ -2040,12 +2527,33 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
             return svn_error_wrap_apr(status, _("Can't create cache mutex"));
         }
 
+#endif
+#if (APR_HAS_THREADS && !USE_SIMPLE_MUTEX) || SUPPORT_SHARED_MEMBUFFER
       /* Select the behavior of write operations.
        */
       c[seg].allow_blocking_writes = allow_blocking_writes;
+#endif
+#if SUPPORT_SHARED_MEMBUFFER
+      /* Shared caches must synchronize processes as well as threads. */
+      c[seg].shared_lock = NULL;
+      if (shared_resources)
+        {
+          apr_status_t status =
+              apr_global_mutex_create(&(c[seg].shared_lock), NULL,
+                                      SHARED_LOCK_MECH,
+                                      shared_resources->pool);
+          if (status)
+            return svn_error_wrap_apr(status,
+                                      _("Can't create shared cache mutex"));
+        }
 #endif
       /* No writers at the moment. */
       c[seg].write_lock_count = 0;
+#if USE_OPTIMISTIC_READS
+      c[seg].write_sequence = 0;
+#elif SUPPORT_SHARED_MEMBUFFER
+      c[seg].modifying = FALSE;
+#endif
     }
 
   /* done here
@@ -2054,18 +2562,91 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
   return SVN_NO_ERROR;
 }
 
+svn_error_t *
+svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
+                                  apr_size_t total_size,
+                                  apr_size_t directory_size,
+                                  apr_size_t segment_count,
+                                  svn_boolean_t thread_safe,
+                                  svn_boolean_t allow_blocking_writes,
+                                  apr_pool_t *pool)
+{
+  return svn_error_trace(membuffer_cache_create(cache, total_size,
+                                                directory_size,
+                                                segment_count, thread_safe,
+                                                allow_blocking_writes,
+                                                FALSE, pool));
+}
+
+svn_error_t *
+svn_cache__membuffer_cache_create_shared(svn_membuffer_t **cache,
+                                         apr_size_t total_size,
+                                         apr_size_t directory_size,
+                                         apr_size_t segment_count,
+                                         svn_boolean_t allow_blocking_writes,
+                                         apr_pool_t *pool)
+{
+  return svn_error_trace(membuffer_cache_create(cache, total_size,
+                                                directory_size,
+                                                segment_count, TRUE,
+                                                allow_blocking_writes,
+                                                TRUE, pool));
+}
+
+svn_error_t *
+svn_cache__membuffer_child_init(svn_membuffer_t *cache,
+                                apr_pool_t *pool)
+{
+#if SUPPORT_SHARED_MEMBUFFER
+  apr_size_t seg;
+
+  for (seg = 0; cache && seg < cache->segment_count; ++seg)
+    if (cache[seg].shared_lock)
+      {
+        /* The segment header is shared memory, i.e. we must not modify
+         * the mutex pointer in it.  APR re-initializes the mutex object
+         * in place, though, and that object is local to our process. */
+        apr_global_mutex_t *mutex = cache[seg].shared_lock;
+        apr_status_t status = apr_global_mutex_child_init(&mutex, NULL,
+                                                          pool);
+        if (status)
+          return svn_error_wrap_apr(status,
+                                    _("Can't initialize shared cache mutex"));
+
+        SVN_ERR_ASSERT(mutex == cache[seg].shared_lock);
+      }
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_cache__membuffer_visit_mutexes(svn_membuffer_t *cache,
+                                   svn_cache__mutex_visitor_t visitor,
+                                   void *baton)
+{
+#if SUPPORT_SHARED_MEMBUFFER
+  apr_size_t seg;
+
+  for (seg = 0; cache && seg < cache->segment_count; ++seg)
+    if (cache[seg].shared_lock)
+      {
+        apr_status_t status = visitor(baton, cache[seg].shared_lock);
+        if (status)
+          return svn_error_wrap_apr(status,
+                                    _("Can't set up shared cache mutex"));
+      }
+#endif
+
+  return SVN_NO_ERROR;
+}
+
 svn_error_t *
 svn_cache__membuffer_clear(svn_membuffer_t *cache)
 {
   apr_size_t seg;
   apr_size_t segment_count = cache->segment_count;
 
-  /* Length of the group_initialized array in bytes.
-     See also svn_cache__membuffer_cache_create(). */
-  apr_size_t group_init_size
-    = 1 + (cache->group_count + cache->spare_group_count)
-            / (8 * GROUP_INIT_GRANULARITY);
-
   /* Clear segment by segment.  This implies that other thread may read
      and write to other segments after we cleared them and before the
      last segment is done.
@@ -2078,31 +2659,13 @@ svn_cache__membuffer_clear(svn_membuffer_t *cache)
     {
       /* Unconditionally acquire the write lock. */
       SVN_ERR(force_write_lock_cache(&cache[seg]));
+      begin_write(&cache[seg]);
 
-      /* Mark all groups as "not initialized", which implies "empty". */
-      cache[seg].first_spare_group = NO_INDEX;
-      cache[seg].max_spare_used = 0;
-
-      memset(cache[seg].group_initialized, 0, group_init_size);
-
-      /* Unlink L1 contents. */
-      cache[seg].l1.first = NO_INDEX;
-      cache[seg].l1.last = NO_INDEX;
-      cache[seg].l1.next = NO_INDEX;
-      cache[seg].l1.current_data = cache[seg].l1.start_offset;
-
-      /* Unlink L2 contents. */
-      cache[seg].l2.first = NO_INDEX;
-      cache[seg].l2.last = NO_INDEX;
-      cache[seg].l2.next = NO_INDEX;
-      cache[seg].l2.current_data = cache[seg].l2.start_offset;
-
-      /* Reset content counters. */
-      cache[seg].data_used = 0;
-      cache[seg].used_entries = 0;
+      reset_segment(&cache[seg]);
 
       /* Segment may be used again. */
-      SVN_ERR(unlock_cache(&cache[seg], SVN_NO_ERROR));
+      SVN_ERR(unlock_cache(&cache[seg], end_write(&cache[seg],
+                                                  SVN_NO_ERROR)));
     }
 
   /* done here */
@@ -2370,6 +2933,85 @@ increment_hit_counters(svn_membuffer_t *cache, entry_t *entry)
   cache->total_hits++;
 }
 
+/* Try to find the entry identified by TO_FIND in group GROUP_INDEX of
+ * CACHE without taking any lock.  Items larger than MAX_SIZE bytes will
+ * not be read.
+ *
+ * If the lookup was not disturbed by concurrent writers, return TRUE
+ * and set *BUFFER and *ITEM_SIZE just like membuffer_cache_get_internal
+ * does.  Otherwise, return FALSE and the caller must use the locked code
+ * path instead.  Allocate *BUFFER in RESULT_POOL.
+ */
+static svn_boolean_t
+get_optimistic(char **buffer,
+               apr_size_t *item_size,
+               svn_membuffer_t *cache,
+               apr_uint32_t group_index,
+               const full_key_t *to_find,
+               apr_size_t max_size,
+               apr_pool_t *result_pool)
+{
+#if USE_OPTIMISTIC_READS
+  apr_uint64_t data_size = cache->l1.size + cache->l2.size;
+  apr_size_t key_len = to_find->entry_key.key_len;
+  int attempt;
+
+  for (attempt = 0; attempt < OPTIMISTIC_READ_ATTEMPTS; ++attempt)
+    {
+      apr_uint32_t sequence = __atomic_load_n(&cache->write_sequence,
+                                              __ATOMIC_ACQUIRE);
+      entry_t *entry;
+
+      /* Don't compete with an active writer. */
+      if (sequence & 1)
+        return FALSE;
+
+      entry = find_entry_optimistic(cache, group_index, to_find);
+      if (entry)
+        {
+          apr_uint64_t offset = entry->offset;
+          apr_size_t size = entry->size;
+          apr_size_t copy_size;
+
+          /* Bail out on large items as well as on inconsistent data. */
+          if (   size < key_len
+              || size - key_len > max_size
+              || offset > data_size
+              || ALIGN_VALUE(size) > data_size - offset)
+            return FALSE;
+
+          copy_size = ALIGN_VALUE(size) - key_len;
+          *buffer = apr_palloc(result_pool, copy_size);
+          memcpy(*buffer, cache->data + offset + key_len, copy_size);
+          *item_size = size - key_len;
+        }
+      else
+        {
+          *buffer = NULL;
+          *item_size = 0;
+        }
+
+      /* Only if no writer became active while we read the data, the copy
+       * is guaranteed to be consistent. */
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&cache->write_sequence, __ATOMIC_RELAXED)
+          == sequence)
+        {
+          /* Hit counts are heuristics.  In the rare case that ENTRY got
+           * replaced in the meantime, we simply count a hit on the
+           * wrong entry. */
+          cache->total_reads++;
+          if (entry)
+            increment_hit_counters(cache, entry);
+
+          return TRUE;
+        }
+    }
+#endif
+
+  return FALSE;
+}
+
 /* Look for the cache entry in group GROUP_INDEX of CACHE, identified
  * by the hash value TO_FIND. If no item has been stored for KEY,
  * *BUFFER will be NULL. Otherwise, return a copy of the serialized
@@ -2453,14 +3095,16 @@ membuffer_cache_get(svn_membuffer_t *cache,
   /* find the entry group that will hold the key.
    */
   group_index = get_group_index(&cache, &key->entry_key);
-  WITH_READ_LOCK(cache,
-                 membuffer_cache_get_internal(cache,
-                                              group_index,
-                                              key,
-                                              &buffer,
-                                              &size,
-                                              DEBUG_CACHE_MEMBUFFER_TAG
-                                              result_pool));
+  if (!get_optimistic(&buffer, &size, cache, group_index, key,
+                      APR_SIZE_MAX, result_pool))
+    WITH_READ_LOCK(cache,
+                   membuffer_cache_get_internal(cache,
+                                                group_index,
+                                                key,
+                                                &buffer,
+                                                &size,
+                                                DEBUG_CACHE_MEMBUFFER_TAG
+                                                result_pool));
 
   /* re-construct the original data object from its serialized form.
    */
@@ -2600,6 +3244,25 @@ membuffer_cache_get_partial(svn_membuffer_t *cache,
                             apr_pool_t *result_pool)
 {
   apr_uint32_t group_index = get_group_index(&cache, &key->entry_key);
+  char *buffer;
+  apr_size_t size;
+
+  /* Small items can be copied quickly and then be processed without
+   * blocking any other thread. */
+  if (get_optimistic(&buffer, &size, cache, group_index, key,
+                     OPTIMISTIC_PARTIAL_READ_LIMIT, result_pool))
+    {
+      if (buffer == NULL)
+        {
+          *item = NULL;
+          *found = FALSE;
+
+          return SVN_NO_ERROR;
+        }
+
+      *found = TRUE;
+      return deserializer(item, buffer, size, baton, result_pool);
+    }
 
   WITH_READ_LOCK(cache,
                  membuffer_cache_get_partial_internal
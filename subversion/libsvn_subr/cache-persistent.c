@@ -0,0 +1,648 @@
+/*
+ * cache-persistent.c: on-disk caching for Subversion
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "svn_pools.h"
+#include "svn_checksum.h"
+#include "svn_dirent_uri.h"
+#include "svn_io.h"
+#include "svn_sorts.h"
+
+#include "svn_private_config.h"
+#include "private/svn_cache.h"
+#include "private/svn_sorts_private.h"
+#include "private/svn_subr_private.h"
+
+#include "cache.h"
+
+/* A note on thread safety and sharing:
+
+   Nothing in persistent_cache_t is ever modified after construction.
+   Entries get written to temporary files first and are then renamed
+   into place atomically.  Readers treat missing entries as well as
+   entries for other keys as cache misses.  Hence, any number of threads
+   and processes may use the same cache directory concurrently.
+
+   The FRONT cache, if given, must do its own synchronization.
+*/
+
+/* Entries are stored in files named after the MD5 of their full key.
+ * To keep directories small, they get spread over 256 sub-directories
+ * named after the first byte of that digest.  Each file contains the
+ * full key prefixed by its length, followed by the FNV-1a checksum of
+ * the LZ4 compressed, serialized value and finally that value itself.
+ *
+ * Entries are not flushed to disk.  After a crash, the rename may have
+ * become persistent while the contents did not.  Such an entry fails the
+ * checksum test and counts as a miss, just like any other corruption.
+ */
+#define SUBDIR_COUNT 256
+
+/* Upper limit for the size of a single serialized entry.  Larger ones
+ * will silently not be written to disk. */
+#define MAX_ENTRY_SIZE (64 * 1024 * 1024)
+
+/* Once the cache exceeds its size limit, remove least recently used
+ * entries until it has shrunk to this many eighths of the limit. */
+#define EVICTION_TARGET 7
+
+/* The (internal) cache object. */
+typedef struct persistent_cache_t {
+  /* The first-level cache to consult before reading from disk.
+   * May be NULL. */
+  svn_cache__t *front;
+
+  /* Root directory of the cache entries. */
+  const char *directory;
+
+  /* A prefix used to differentiate our data from the data of other
+   * caches using the same DIRECTORY. */
+  const char *prefix;
+
+  /* The size of the key: either a fixed number of bytes or
+   * APR_HASH_KEY_STRING. */
+  apr_ssize_t klen;
+
+  /* Total size of all files in DIRECTORY that we try not to exceed. */
+  apr_uint64_t max_size;
+
+  /* Maximum serialized size of a single entry. */
+  apr_size_t max_entry_size;
+
+  /* Used to marshal values in and out of the cache. */
+  svn_cache__serialize_func_t serialize_func;
+  svn_cache__deserialize_func_t deserialize_func;
+} persistent_cache_t;
+
+/* An entry in the cache DIRECTORY, as seen during eviction. */
+typedef struct disk_entry_t {
+  /* Full path of the entry file. */
+  const char *path;
+
+  /* File size in bytes. */
+  svn_filesize_t size;
+
+  /* Time of last use. */
+  apr_time_t mtime;
+} disk_entry_t;
+
+/* Set *FULL_KEY to the concatenation of CACHE's prefix and KEY, *PATH to
+ * the file that entry is stored in and *HASH to some bits of its digest.
+ * Allocate the results in POOL.
+ */
+static svn_error_t *
+build_key(svn_stringbuf_t **full_key,
+          const char **path,
+          apr_uint32_t *hash,
+          persistent_cache_t *cache,
+          const void *key,
+          apr_pool_t *pool)
+{
+  apr_size_t key_len = cache->klen == APR_HASH_KEY_STRING
+                     ? strlen(key)
+                     : (apr_size_t)cache->klen;
+  svn_checksum_t *checksum;
+  const char *name;
+
+  *full_key = svn_stringbuf_create(cache->prefix, pool);
+  svn_stringbuf_appendbytes(*full_key, key, key_len);
+
+  SVN_ERR(svn_checksum(&checksum, svn_checksum_md5, (*full_key)->data,
+                       (*full_key)->len, pool));
+  name = svn_checksum_to_cstring_display(checksum, pool);
+  *path = svn_dirent_join_many(pool, cache->directory,
+                               apr_pstrmemdup(pool, name, 2), name,
+                               SVN_VA_NULL);
+  memcpy(hash, checksum->digest, sizeof(*hash));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements the qsort() comparison callback for disk_entry_t *.
+ * Order the least recently used entries first. */
+static int
+compare_entries_by_mtime(const void *lhs,
+                         const void *rhs)
+{
+  const disk_entry_t *lhs_entry = *(const disk_entry_t * const *)lhs;
+  const disk_entry_t *rhs_entry = *(const disk_entry_t * const *)rhs;
+
+  if (lhs_entry->mtime == rhs_entry->mtime)
+    return 0;
+
+  return lhs_entry->mtime < rhs_entry->mtime ? -1 : 1;
+}
+
+/* If CACHE->DIRECTORY exceeds CACHE->MAX_SIZE, remove the least recently
+ * used entries from it.  Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+evict(persistent_cache_t *cache,
+      apr_pool_t *scratch_pool)
+{
+  apr_array_header_t *entries
+    = apr_array_make(scratch_pool, 0, sizeof(disk_entry_t *));
+  apr_uint64_t total_size = 0;
+  apr_uint64_t target_size = cache->max_size / 8 * EVICTION_TARGET;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  for (i = 0; i < SUBDIR_COUNT; ++i)
+    {
+      const char *subdir;
+      apr_hash_t *dirents;
+      apr_hash_index_t *hi;
+      svn_error_t *err;
+
+      svn_pool_clear(iterpool);
+      subdir = svn_dirent_join(cache->directory,
+                               apr_psprintf(iterpool, "%02x", i),
+                               iterpool);
+
+      /* Other processes may be evicting at the same time. */
+      err = svn_io_get_dirents3(&dirents, subdir, FALSE, scratch_pool,
+                                iterpool);
+      if (err && APR_STATUS_IS_ENOENT(err->apr_err))
+        {
+          svn_error_clear(err);
+          continue;
+        }
+      SVN_ERR(err);
+
+      for (hi = apr_hash_first(iterpool, dirents); hi; hi = apr_hash_next(hi))
+        {
+          const svn_io_dirent2_t *dirent = apr_hash_this_val(hi);
+          disk_entry_t *entry;
+
+          if (dirent->kind != svn_node_file)
+            continue;
+
+          entry = apr_palloc(scratch_pool, sizeof(*entry));
+          entry->path = svn_dirent_join(subdir, apr_hash_this_key(hi),
+                                        scratch_pool);
+          entry->size = dirent->filesize;
+          entry->mtime = dirent->mtime;
+
+          total_size += entry->size;
+          APR_ARRAY_PUSH(entries, disk_entry_t *) = entry;
+        }
+    }
+
+  if (total_size > cache->max_size)
+    {
+      svn_sort__array(entries, compare_entries_by_mtime);
+      for (i = 0; i < entries->nelts && total_size > target_size; ++i)
+        {
+          disk_entry_t *entry = APR_ARRAY_IDX(entries, i, disk_entry_t *);
+
+          svn_pool_clear(iterpool);
+          SVN_ERR(svn_io_remove_file2(entry->path, TRUE, iterpool));
+          total_size -= entry->size;
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Core functionality of our getter functions: fetch the serialized value
+ * identified by KEY from the disk cache CACHE and return it in *DATA.
+ * Indicate success in FOUND.  Allocate the result in POOL.
+ */
+static svn_error_t *
+read_entry(svn_stringbuf_t **data,
+           svn_boolean_t *found,
+           persistent_cache_t *cache,
+           const void *key,
+           apr_pool_t *pool)
+{
+  svn_stringbuf_t *full_key;
+  svn_stringbuf_t *contents;
+  const char *path;
+  apr_uint32_t hash;
+  apr_uint64_t key_len;
+  apr_uint64_t checksum;
+  const unsigned char *p, *end;
+  svn_error_t *err;
+
+  *found = FALSE;
+  SVN_ERR(build_key(&full_key, &path, &hash, cache, key, pool));
+
+  err = svn_stringbuf_from_file2(&contents, path, pool);
+  if (err && APR_STATUS_IS_ENOENT(err->apr_err))
+    {
+      svn_error_clear(err);
+      return SVN_NO_ERROR;
+    }
+  SVN_ERR(err);
+
+  /* Hash collisions are not an error, just a cache miss. */
+  p = (const unsigned char *)contents->data;
+  end = p + contents->len;
+  p = svn__decode_uint(&key_len, p, end);
+  if (   p == NULL
+      || key_len != full_key->len
+      || (apr_uint64_t)(end - p) < key_len
+      || memcmp(p, full_key->data, full_key->len))
+    return SVN_NO_ERROR;
+
+  /* Truncated or otherwise corrupted entries are a miss as well. */
+  p = svn__decode_uint(&checksum, p + key_len, end);
+  if (p == NULL || checksum != svn__fnv1a_32(p, end - p))
+    {
+      svn_error_clear(svn_io_remove_file2(path, TRUE, pool));
+      return SVN_NO_ERROR;
+    }
+
+  *data = svn_stringbuf_create_empty(pool);
+  err = svn__decompress_lz4(p, end - p, *data, cache->max_entry_size);
+  if (err)
+    {
+      /* Don't trip over the same broken entry again. */
+      svn_error_clear(svn_io_remove_file2(path, TRUE, pool));
+      return svn_error_trace(err);
+    }
+
+  /* Mark the entry as recently used.  This is what eviction goes by. */
+  svn_error_clear(svn_io_set_file_affected_time(apr_time_now(), path,
+                                                pool));
+
+  *found = TRUE;
+  return SVN_NO_ERROR;
+}
+
+/* Core functionality of our setter functions: store LEN bytes of DATA to
+ * be identified by KEY in the disk cache CACHE.  Use SCRATCH_POOL for
+ * temporary allocations.
+ */
+static svn_error_t *
+write_entry(persistent_cache_t *cache,
+            const void *key,
+            const void *data,
+            apr_size_t len,
+            apr_pool_t *scratch_pool)
+{
+  svn_stringbuf_t *full_key;
+  svn_stringbuf_t *compressed;
+  svn_stringbuf_t *contents;
+  const char *path;
+  apr_uint32_t hash;
+  unsigned char buf[SVN__MAX_ENCODED_UINT_LEN];
+  unsigned char *p;
+  svn_error_t *err;
+
+  if (len > cache->max_entry_size)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(build_key(&full_key, &path, &hash, cache, key, scratch_pool));
+
+  compressed = svn_stringbuf_create_empty(scratch_pool);
+  SVN_ERR(svn__compress_lz4(data, len, compressed));
+
+  contents = svn_stringbuf_create_ensure(2 * sizeof(buf) + full_key->len
+                                           + compressed->len,
+                                         scratch_pool);
+  p = svn__encode_uint(buf, full_key->len);
+  svn_stringbuf_appendbytes(contents, (const char *)buf, p - buf);
+  svn_stringbuf_appendstr(contents, full_key);
+  p = svn__encode_uint(buf, svn__fnv1a_32(compressed->data,
+                                          compressed->len));
+  svn_stringbuf_appendbytes(contents, (const char *)buf, p - buf);
+  svn_stringbuf_appendstr(contents, compressed);
+
+  /* Concurrent writers of the same entry will write the same contents.
+   * Thus, it does not matter which one wins the final rename. */
+  err = svn_io_write_atomic2(path, contents->data, contents->len, NULL,
+                             FALSE, scratch_pool);
+  if (err && APR_STATUS_IS_ENOENT(err->apr_err))
+    {
+      /* Someone removed our sub-directory. */
+      svn_error_clear(err);
+      SVN_ERR(svn_io_make_dir_recursively(svn_dirent_dirname(path,
+                                                             scratch_pool),
+                                          scratch_pool));
+      err = svn_io_write_atomic2(path, contents->data, contents->len, NULL,
+                                 FALSE, scratch_pool);
+    }
+  SVN_ERR(err);
+
+  /* Rather than keeping track of the cache size across all processes,
+   * run the eviction with a probability proportional to the amount of
+   * data written.  On average, that happens once per 1/8 of MAX_SIZE
+   * written.  The digest bits are as good a random number as any. */
+  if (hash < ((apr_uint64_t)contents->len << 35) / cache->max_size)
+    SVN_ERR(evict(cache, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Deserialize the LEN bytes at DATA into *VALUE_P for CACHE.
+ * DATA will be modified.  Allocate the result in RESULT_POOL. */
+static svn_error_t *
+deserialize(void **value_p,
+            persistent_cache_t *cache,
+            svn_stringbuf_t *data,
+            apr_pool_t *result_pool)
+{
+  if (cache->deserialize_func)
+    SVN_ERR((cache->deserialize_func)(value_p, data->data, data->len,
+                                      result_pool));
+  else
+    *value_p = data;
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+persistent_get(void **value_p,
+               svn_boolean_t *found,
+               void *cache_void,
+               const void *key,
+               apr_pool_t *result_pool)
+{
+  persistent_cache_t *cache = cache_void;
+  svn_stringbuf_t *data;
+
+  if (cache->front)
+    {
+      SVN_ERR(svn_cache__get(value_p, found, cache->front, key,
+                             result_pool));
+      if (*found)
+        return SVN_NO_ERROR;
+    }
+
+  SVN_ERR(read_entry(&data, found, cache, key, result_pool));
+  if (*found)
+    {
+      SVN_ERR(deserialize(value_p, cache, data, result_pool));
+
+      /* Promote the entry such that we won't hit the disk next time. */
+      if (cache->front)
+        SVN_ERR(svn_cache__set(cache->front, key, *value_p, result_pool));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+persistent_has_key(svn_boolean_t *found,
+                   void *cache_void,
+                   const void *key,
+                   apr_pool_t *scratch_pool)
+{
+  persistent_cache_t *cache = cache_void;
+  svn_stringbuf_t *data;
+
+  if (cache->front)
+    {
+      SVN_ERR(svn_cache__has_key(found, cache->front, key, scratch_pool));
+      if (*found)
+        return SVN_NO_ERROR;
+    }
+
+  /* Only a full read can tell hash collisions apart from matches. */
+  SVN_ERR(read_entry(&data, found, cache, key, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+persistent_set(void *cache_void,
+               const void *key,
+               void *value,
+               apr_pool_t *scratch_pool)
+{
+  persistent_cache_t *cache = cache_void;
+  apr_pool_t *subpool;
+  void *data;
+  apr_size_t data_len;
+  svn_error_t *err;
+
+  if (cache->front)
+    SVN_ERR(svn_cache__set(cache->front, key, value, scratch_pool));
+
+  subpool = svn_pool_create(scratch_pool);
+  if (cache->serialize_func)
+    {
+      SVN_ERR((cache->serialize_func)(&data, &data_len, value, subpool));
+    }
+  else
+    {
+      svn_stringbuf_t *value_str = value;
+      data = value_str->data;
+      data_len = value_str->len;
+    }
+
+  err = write_entry(cache, key, data, data_len, subpool);
+
+  svn_pool_destroy(subpool);
+  return svn_error_trace(err);
+}
+
+static svn_error_t *
+persistent_get_partial(void **value_p,
+                       svn_boolean_t *found,
+                       void *cache_void,
+                       const void *key,
+                       svn_cache__partial_getter_func_t func,
+                       void *baton,
+                       apr_pool_t *result_pool)
+{
+  persistent_cache_t *cache = cache_void;
+  svn_stringbuf_t *data;
+  apr_pool_t *subpool;
+
+  if (cache->front)
+    {
+      SVN_ERR(svn_cache__get_partial(value_p, found, cache->front, key,
+                                     func, baton, result_pool));
+      if (*found)
+        return SVN_NO_ERROR;
+    }
+
+  subpool = svn_pool_create(result_pool);
+  SVN_ERR(read_entry(&data, found, cache, key, subpool));
+  if (*found)
+    {
+      SVN_ERR(func(value_p, data->data, data->len, baton, result_pool));
+
+      /* FUNC copied what it needed.  Promote the full entry. */
+      if (cache->front)
+        {
+          void *value;
+          SVN_ERR(deserialize(&value, cache, data, subpool));
+          SVN_ERR(svn_cache__set(cache->front, key, value, subpool));
+        }
+    }
+
+  svn_pool_destroy(subpool);
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+persistent_set_partial(void *cache_void,
+                       const void *key,
+                       svn_cache__partial_setter_func_t func,
+                       void *baton,
+                       apr_pool_t *scratch_pool)
+{
+  persistent_cache_t *cache = cache_void;
+  svn_stringbuf_t *contents;
+  svn_boolean_t found;
+  apr_pool_t *subpool;
+  void *data;
+  apr_size_t size;
+
+  if (cache->front)
+    SVN_ERR(svn_cache__set_partial(cache->front, key, func, baton,
+                                   scratch_pool));
+
+  /* If we found it, modify it and write it back to disk. */
+  subpool = svn_pool_create(scratch_pool);
+  SVN_ERR(read_entry(&contents, &found, cache, key, subpool));
+  if (found)
+    {
+      data = contents->data;
+      size = contents->len;
+      SVN_ERR(func(&data, &size, baton, subpool));
+      SVN_ERR(write_entry(cache, key, data, size, subpool));
+    }
+
+  svn_pool_destroy(subpool);
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+persistent_iter(svn_boolean_t *completed,
+                void *cache_void,
+                svn_iter_apr_hash_cb_t user_cb,
+                void *user_baton,
+                apr_pool_t *scratch_pool)
+{
+  return svn_error_create(SVN_ERR_UNSUPPORTED_FEATURE, NULL,
+                          _("Can't iterate a persistent cache"));
+}
+
+static svn_boolean_t
+persistent_is_cachable(void *cache_void, apr_size_t size)
+{
+  persistent_cache_t *cache = cache_void;
+
+  /* Items too large for the front cache will still be kept on disk. */
+  return size <= cache->max_entry_size
+      || (cache->front && svn_cache__is_cachable(cache->front, size));
+}
+
+static svn_error_t *
+persistent_get_info(void *cache_void,
+                    svn_cache__info_t *info,
+                    svn_boolean_t reset,
+                    apr_pool_t *result_pool)
+{
+  persistent_cache_t *cache = cache_void;
+
+  /* Report the memory usage of the front cache, if any.
+   * We don't track the disk usage. */
+  if (cache->front)
+    SVN_ERR((cache->front->vtable->get_info)(cache->front->cache_internal,
+                                             info, reset, result_pool));
+
+  info->id = apr_pstrdup(result_pool, cache->prefix);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_cache__vtable_t persistent_vtable = {
+  persistent_get,
+  persistent_has_key,
+  persistent_set,
+  persistent_iter,
+  persistent_is_cachable,
+  persistent_get_partial,
+  persistent_set_partial,
+  persistent_get_info
+};
+
+svn_error_t *
+svn_cache__create_persistent(svn_cache__t **cache_p,
+                             svn_cache__t *front,
+                             const char *directory,
+                             apr_uint64_t max_size,
+                             svn_cache__serialize_func_t serialize_func,
+                             svn_cache__deserialize_func_t deserialize_func,
+                             apr_ssize_t klen,
+                             const char *prefix,
+                             apr_pool_t *result_pool,
+                             apr_pool_t *scratch_pool)
+{
+  svn_cache__t *wrapper = apr_pcalloc(result_pool, sizeof(*wrapper));
+  persistent_cache_t *cache = apr_pcalloc(result_pool, sizeof(*cache));
+  svn_node_kind_t kind;
+
+  /* Create the directory structure up-front, if it does not exist yet. */
+  SVN_ERR(svn_io_check_path(directory, &kind, scratch_pool));
+  if (kind == svn_node_none)
+    {
+      apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+      int i;
+
+      for (i = 0; i < SUBDIR_COUNT; ++i)
+        {
+          svn_pool_clear(iterpool);
+          SVN_ERR(svn_io_make_dir_recursively(
+                    svn_dirent_join(directory,
+                                    apr_psprintf(iterpool, "%02x", i),
+                                    iterpool),
+                    iterpool));
+        }
+
+      svn_pool_destroy(iterpool);
+    }
+  else if (kind != svn_node_dir)
+    return svn_error_createf(SVN_ERR_BAD_FILENAME, NULL,
+                             _("'%s' is not a directory"),
+                             svn_dirent_local_style(directory,
+                                                    scratch_pool));
+
+  cache->front = front;
+  cache->directory = apr_pstrdup(result_pool, directory);
+  cache->prefix = apr_pstrdup(result_pool, prefix);
+  cache->klen = klen;
+  cache->max_size = MAX(max_size, SUBDIR_COUNT);
+  cache->max_entry_size = (apr_size_t)MIN(cache->max_size / 16,
+                                          MAX_ENTRY_SIZE);
+  cache->serialize_func = serialize_func;
+  cache->deserialize_func = deserialize_func;
+
+  wrapper->vtable = &persistent_vtable;
+  wrapper->cache_internal = cache;
+  wrapper->error_handler = 0;
+  wrapper->error_baton = 0;
+  wrapper->pretend_empty = !!getenv("SVN_X_DOES_NOT_MARK_THE_SPOT");
+
+  *cache_p = wrapper;
+  return SVN_NO_ERROR;
+}
@@ -64,6 +64,11 @@ static svn_cache_config_t cache_settings =
 #endif
 };
 
+/* If set, try to create the process-global membuffer cache in shared
+ * memory.  See svn_cache__set_global_membuffer_shared().
+ */
+static svn_boolean_t share_global_membuffer = FALSE;
+
 /* Get the current FSFS cache configuration. */
 const svn_cache_config_t *
 svn_cache_config_get(void)
@@ -120,14 +125,36 @@ initialize_cache(void *baton, apr_pool_t *unused_pool)
         return SVN_NO_ERROR;
       apr_allocator_owner_set(allocator, pool);
 
-      err = svn_cache__membuffer_cache_create(
-          &cache,
-          (apr_size_t)cache_size,
-          (apr_size_t)(cache_size / 5),
-          0,
-          ! svn_cache_config_get()->single_threaded,
-          FALSE,
-          pool);
+      /* Pre-forking servers want a single cache for all workers.
+       * If we can't have that, a process-local cache is still better
+       * than no cache at all. */
+      err = SVN_NO_ERROR;
+      if (share_global_membuffer)
+        {
+          err = svn_cache__membuffer_cache_create_shared(
+              &cache,
+              (apr_size_t)cache_size,
+              (apr_size_t)(cache_size / 5),
+              0,
+              FALSE,
+              pool);
+          if (err)
+            {
+              svn_error_clear(err);
+              svn_pool_clear(pool);
+              cache = NULL;
+            }
+        }
+
+      if (cache == NULL)
+        err = svn_cache__membuffer_cache_create(
+            &cache,
+            (apr_size_t)cache_size,
+            (apr_size_t)(cache_size / 5),
+            0,
+            ! svn_cache_config_get()->single_threaded,
+            FALSE,
+            pool);
 
       /* Some error occurred. Most likely it's an OOM error but we don't
        * really care. Simply release all cache memory and disable caching
@@ -173,6 +200,12 @@ svn_cache__get_global_membuffer_cache(void)
   return cache;
 }
 
+void
+svn_cache__set_global_membuffer_shared(svn_boolean_t shared)
+{
+  share_global_membuffer = shared;
+}
+
 void
 svn_cache_config_set(const svn_cache_config_t *settings)
 {
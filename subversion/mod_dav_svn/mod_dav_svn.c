@@ -33,6 +33,9 @@
 #include <http_log.h>
 #include <ap_provider.h>
 #include <mod_dav.h>
+#ifdef AP_NEED_SET_MUTEX_PERMS
+#include <unixd.h>
+#endif
 
 #include "svn_hash.h"
 #include "svn_version.h"
@@ -42,6 +45,7 @@
 #include "svn_dso.h"
 #include "mod_dav_svn.h"
 
+#include "private/svn_cache.h"
 #include "private/svn_fspath.h"
 #include "private/svn_subr_private.h"
 
@@ -120,6 +124,23 @@ extern module AP_MODULE_DECLARE_DATA dav_svn_module;
 /* The authz_svn provider for bypassing path authz. */
 static authz_svn__subreq_bypass_func_t pathauthz_bypass_func = NULL;
 
+/* Whether all httpd child processes shall share one in-memory cache. */
+static svn_boolean_t share_memory_cache = FALSE;
+
+#ifdef AP_NEED_SET_MUTEX_PERMS
+/* Implements svn_cache__mutex_visitor_t, granting httpd's child processes
+ * access to MUTEX after they changed their user ID. */
+static apr_status_t
+set_mutex_perms(void *baton, apr_global_mutex_t *mutex)
+{
+#if AP_MODULE_MAGIC_AT_LEAST(20091119,0)
+  return ap_unixd_set_global_mutex_perms(mutex);
+#else
+  return unixd_set_global_mutex_perms(mutex);
+#endif
+}
+#endif
+
 static int
 init(apr_pool_t *p, apr_pool_t *plog, apr_pool_t *ptemp, server_rec *s)
 {
@@ -150,9 +171,52 @@ init(apr_pool_t *p, apr_pool_t *plog, apr_pool_t *ptemp, server_rec *s)
   conf = ap_get_module_config(s->module_config, &dav_svn_module);
   svn_utf_initialize2(conf->use_utf8, p);
 
+  /* A shared cache must be allocated before httpd forks its children. */
+  if (share_memory_cache)
+    {
+      svn_membuffer_t *membuffer;
+
+      svn_cache__set_global_membuffer_shared(TRUE);
+      membuffer = svn_cache__get_global_membuffer_cache();
+
+#ifdef AP_NEED_SET_MUTEX_PERMS
+      serr = svn_cache__membuffer_visit_mutexes(membuffer, set_mutex_perms,
+                                                NULL);
+      if (serr)
+        {
+          ap_log_perror(APLOG_MARK, APLOG_ERR, serr->apr_err, p,
+                        "mod_dav_svn: error setting up the shared cache: "
+                        "'%s'",
+                        serr->message ? serr->message : "(no more info)");
+          return HTTP_INTERNAL_SERVER_ERROR;
+        }
+#endif
+    }
+
   return OK;
 }
 
+/* Implements the #child_init hook.  Attaches the child process to the
+ * cross-process locks of the shared in-memory cache. */
+static void
+child_init(apr_pool_t *p, server_rec *s)
+{
+  svn_error_t *serr;
+
+  if (! share_memory_cache)
+    return;
+
+  serr = svn_cache__membuffer_child_init(
+           svn_cache__get_global_membuffer_cache(), p);
+  if (serr)
+    {
+      ap_log_error(APLOG_MARK, APLOG_ERR, serr->apr_err, s,
+                   "mod_dav_svn: error initializing the shared cache: '%s'",
+                   serr->message ? serr->message : "(no more info)");
+      svn_error_clear(serr);
+    }
+}
+
 static svn_error_t *
 malfunction_handler(svn_boolean_t can_return,
                     const char *file, int line,
@@ -631,6 +695,14 @@ SVNInMemoryCacheSize_cmd(cmd_parms *cmd, void *config, const char *arg1)
   return NULL;
 }
 
+static const char *
+SVNInMemoryCacheShared_cmd(cmd_parms *cmd, void *config, int arg)
+{
+  share_memory_cache = arg;
+
+  return NULL;
+}
+
 static const char *
 SVNCompressionLevel_cmd(cmd_parms *cmd, void *config, const char *arg1)
 {
@@ -1396,6 +1468,12 @@ static const command_rec cmds[] =
                 "in-memory object cache (default value is 16384; 0 switches "
                 "to dynamically sized caches)."),
   /* per server */
+  AP_INIT_FLAG("SVNInMemoryCacheShared", SVNInMemoryCacheShared_cmd, NULL,
+               RSRC_CONF,
+               "enables sharing the in-memory object cache between all "
+               "httpd child processes of a forking MPM; the cache size "
+               "then applies to all processes together (default is Off)."),
+  /* per server */
   AP_INIT_TAKE1("SVNCompressionLevel", SVNCompressionLevel_cmd, NULL,
                 RSRC_CONF,
                 "specifies the compression level used before sending file "
@@ -1436,6 +1514,7 @@ register_hooks(apr_pool_t *pconf)
 {
   ap_hook_pre_config(init_dso, NULL, NULL, APR_HOOK_REALLY_FIRST);
   ap_hook_post_config(init, NULL, NULL, APR_HOOK_MIDDLE);
+  ap_hook_child_init(child_init, NULL, NULL, APR_HOOK_MIDDLE);
 
   /* our provider */
   dav_register_provider(pconf, "svn", &provider);
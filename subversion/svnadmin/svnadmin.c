@@ -97,6 +97,8 @@ check_lib_versions(void)
 /** Subcommands. **/
 
 static svn_opt_subcommand_t
+  subcommand_build_history_index,
+  subcommand_build_mergeinfo_index,
   subcommand_build_repcache,
   subcommand_crashtest,
   subcommand_create,
@@ -159,7 +161,8 @@ enum svnadmin__cmdline_options_t
     svnadmin__normalize_props,
     svnadmin__exclude,
     svnadmin__include,
-    svnadmin__glob
+    svnadmin__glob,
+    svnadmin__jobs
   };
 
 /* Option codes and descriptions.
@@ -292,6 +295,11 @@ static const apr_getopt_option_t options_table[] =
     {"include", svnadmin__include, 1,
      N_("filter out nodes without given prefix(es) from dump")},
 
+    {"jobs", svnadmin__jobs, 1,
+     N_("pack up to ARG shards concurrently. Every shard\n"
+        "                             may use the memory given by -M.\n"
+        "                             [used for FSFS repositories only]")},
+
     {"pattern", svnadmin__glob, 0,
      N_("treat the path prefixes as file glob patterns.\n"
         "                             Glob special characters are '*' '?' '[]' and '\\'.\n"
@@ -307,6 +315,27 @@ static const apr_getopt_option_t options_table[] =
  */
 static const svn_opt_subcommand_desc3_t cmd_table[] =
 {
+  {"build-history-index", subcommand_build_history_index, {0}, {N_(
+    "usage: svnadmin build-history-index REPOS_PATH\n"
+    "\n"), N_(
+    "Create the path history index for the repository at REPOS_PATH, or\n"
+    "bring an existing one up to date.  Commits extend the index only by a\n"
+    "few revisions each, so run this after enabling the index for an\n"
+    "existing repository.  The index is used only while it is enabled in\n"
+    "the repository's fsfs.conf.\n"
+   )},
+   {'q', 'M'} },
+
+  {"build-mergeinfo-index", subcommand_build_mergeinfo_index, {0}, {N_(
+    "usage: svnadmin build-mergeinfo-index REPOS_PATH\n"
+    "\n"), N_(
+    "Create the mergeinfo index for the repository at REPOS_PATH, or bring\n"
+    "an existing one up to date.  Once the index exists, every commit adds\n"
+    "its revision to it and mergeinfo queries for whole sub-trees no longer\n"
+    "need to crawl the directory tree.\n"
+   )},
+   {'q', 'M'} },
+
   {"build-repcache", subcommand_build_repcache, {0}, {N_(
     "usage: svnadmin build-repcache REPOS_PATH [-r LOWER[:UPPER]]\n"
     "\n"), N_(
@@ -520,7 +549,7 @@ static const svn_opt_subcommand_desc3_t cmd_table[] =
     "Possibly compact the repository into a more efficient storage model.\n"
     "This may not apply to all repositories, in which case, exit.\n"
    )},
-   {'q', 'M'} },
+   {'q', 'M', svnadmin__jobs} },
 
   {"recover", subcommand_recover, {0}, {N_(
     "usage: svnadmin recover REPOS_PATH\n"
@@ -673,6 +702,7 @@ struct svnadmin_opt_state
   apr_array_header_t *exclude;                      /* --exclude */
   apr_array_header_t *include;                      /* --include */
   svn_boolean_t glob;                               /* --pattern */
+  int jobs;                                         /* --jobs */
 
   const char *config_dir;    /* Overriding Configuration Directory */
 };
@@ -702,6 +732,9 @@ open_repos(svn_repos_t **repos,
                            use_block_read ? "1" : "0");
   svn_hash_sets(fs_config, SVN_FS_CONFIG_NO_FLUSH_TO_DISK,
                            opt_state->no_flush_to_disk ? "1" : "0");
+  if (opt_state->jobs > 1)
+    svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_PACK_JOBS,
+                             apr_itoa(pool, opt_state->jobs));
 
   /* now, open the requested repository */
   SVN_ERR(svn_repos_open3(repos, path, fs_config, pool, pool));
@@ -3035,6 +3068,96 @@ subcommand_build_repcache(apr_getopt_t *os, void *baton, apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+static void
+build_history_index_progress_func(svn_revnum_t revision,
+                                  void *baton,
+                                  apr_pool_t *pool)
+{
+  svn_error_clear(svn_cmdline_printf(pool,
+                                     _("* Indexed revision %ld.\n"),
+                                     revision));
+}
+
+/* This implements `svn_opt_subcommand_t'. */
+static svn_error_t *
+subcommand_build_history_index(apr_getopt_t *os, void *baton,
+                               apr_pool_t *pool)
+{
+  struct svnadmin_opt_state *opt_state = baton;
+  svn_repos_t *repos;
+  svn_fs_t *fs;
+  svn_fs_fs__ioctl_build_history_index_input_t input = {0};
+  svn_error_t *err;
+
+  /* Expect no more arguments. */
+  SVN_ERR(parse_args(NULL, os, 0, 0, pool));
+
+  SVN_ERR(open_repos(&repos, opt_state->repository_path, opt_state, pool));
+  fs = svn_repos_fs(repos);
+
+  if (! opt_state->quiet)
+    input.progress_func = build_history_index_progress_func;
+
+  err = svn_fs_ioctl(fs, SVN_FS_FS__IOCTL_BUILD_HISTORY_INDEX,
+                     &input, NULL,
+                     check_cancel, NULL, pool, pool);
+  if (err && err->apr_err == SVN_ERR_FS_UNRECOGNIZED_IOCTL_CODE)
+    {
+      return svn_error_quick_wrapf(err,
+                                   _("Building the path history index is "
+                                     "not implemented for the filesystem "
+                                     "type found in '%s'"),
+                                   svn_fs_path(fs, pool));
+    }
+
+  return svn_error_trace(err);
+}
+
+static void
+build_mergeinfo_index_progress_func(svn_revnum_t revision,
+                                    void *baton,
+                                    apr_pool_t *pool)
+{
+  svn_error_clear(svn_cmdline_printf(pool,
+                                     _("* Indexed revision %ld.\n"),
+                                     revision));
+}
+
+/* This implements `svn_opt_subcommand_t'. */
+static svn_error_t *
+subcommand_build_mergeinfo_index(apr_getopt_t *os, void *baton,
+                                 apr_pool_t *pool)
+{
+  struct svnadmin_opt_state *opt_state = baton;
+  svn_repos_t *repos;
+  svn_fs_t *fs;
+  svn_fs_fs__ioctl_build_mergeinfo_index_input_t input = {0};
+  svn_error_t *err;
+
+  /* Expect no more arguments. */
+  SVN_ERR(parse_args(NULL, os, 0, 0, pool));
+
+  SVN_ERR(open_repos(&repos, opt_state->repository_path, opt_state, pool));
+  fs = svn_repos_fs(repos);
+
+  if (! opt_state->quiet)
+    input.progress_func = build_mergeinfo_index_progress_func;
+
+  err = svn_fs_ioctl(fs, SVN_FS_FS__IOCTL_BUILD_MERGEINFO_INDEX,
+                     &input, NULL,
+                     check_cancel, NULL, pool, pool);
+  if (err && err->apr_err == SVN_ERR_FS_UNRECOGNIZED_IOCTL_CODE)
+    {
+      return svn_error_quick_wrapf(err,
+                                   _("Building the mergeinfo index is not "
+                                     "implemented for the filesystem type "
+                                     "found in '%s'"),
+                                   svn_fs_path(fs, pool));
+    }
+
+  return svn_error_trace(err);
+}
+
 
 /** Main. **/
 
@@ -3290,6 +3413,12 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
       case svnadmin__glob:
         opt_state.glob = TRUE;
         break;
+      case svnadmin__jobs:
+        SVN_ERR(svn_cstring_atoi(&opt_state.jobs, opt_arg));
+        if (opt_state.jobs < 1)
+          return svn_error_create(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+                                  _("--jobs must be a positive number"));
+        break;
       default:
         {
           SVN_ERR(subcommand_help(NULL, NULL, pool));
@@ -3417,7 +3546,8 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
     svn_cache_config_t settings = *svn_cache_config_get();
 
     settings.cache_size = opt_state.memory_cache_size;
-    settings.single_threaded = TRUE;
+    /* Concurrent packing requires thread-safe caches. */
+    settings.single_threaded = opt_state.jobs <= 1;
 
     svn_cache_config_set(&settings);
   }
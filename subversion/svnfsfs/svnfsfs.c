@@ -76,7 +76,9 @@ check_lib_versions(void)
 
 enum svnfsfs__cmdline_options_t
   {
-    svnfsfs__version = SVN_OPT_FIRST_LONGOPT_ID
+    svnfsfs__version = SVN_OPT_FIRST_LONGOPT_ID,
+    svnfsfs__jobs,
+    svnfsfs__state_dir
   };
 
 /* Option codes and descriptions.
@@ -104,6 +106,13 @@ static const apr_getopt_option_t options_table[] =
      N_("size of the extra in-memory cache in MB used to\n"
         "                             minimize redundant operations. Default: 16.")},
 
+    {"jobs",          svnfsfs__jobs, 1,
+     N_("read up to ARG pack files or shards concurrently")},
+
+    {"state-dir",     svnfsfs__state_dir, 1,
+     N_("keep the results per pack file in directory ARG\n"
+        "                             and reuse them in later runs")},
+
     {NULL}
   };
 
@@ -166,8 +175,26 @@ static const svn_opt_subcommand_desc3_t cmd_table[] =
     "usage: svnfsfs stats REPOS_PATH\n"
     "\n"), N_(
     "Write object size statistics to console.\n"
+    "\n"), N_(
+    "With --state-dir, the results for each pack file are kept in the given\n"
+    "directory.  Later runs using the same directory only read pack files that\n"
+    "have been added or changed since, plus all non-packed revisions.\n"
    )},
-   {'M'} },
+   {'M', svnfsfs__jobs, svnfsfs__state_dir} },
+
+  {"warm-cache", subcommand__warm_cache, {0}, {N_(
+    "usage: svnfsfs warm-cache REPOS_PATH [FILE]\n"
+    "\n"), N_(
+    "Read the data referenced in FILE, or from console if FILE is not given,\n"
+    "such that it ends up in the FSFS caches.  This is only useful if the\n"
+    "repository has been configured to use a persistent cache in fsfs.conf.\n"
+    "\n"), N_(
+    "Each line may either be a line from an svnserve or Apache operational log,\n"
+    "or name a path as PATH[@REV] [depth=DEPTH].  Paths must be URI-encoded.\n"
+    "Without REV, the youngest revision is used.  For log lines, the same data\n"
+    "that the logged request read will be read.  Other lines are ignored.\n"
+   )},
+   {'q', 'M'} },
 
   { NULL, NULL, {0}, {NULL}, {0} }
 };
@@ -323,6 +350,16 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
       case svnfsfs__version:
         opt_state.version = TRUE;
         break;
+      case svnfsfs__jobs:
+        SVN_ERR(svn_cstring_atoi(&opt_state.jobs, opt_arg));
+        if (opt_state.jobs < 1)
+          return svn_error_create(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+                                  _("--jobs must be a positive number"));
+        break;
+      case svnfsfs__state_dir:
+        SVN_ERR(svn_utf_cstring_to_utf8(&utf8_opt_arg, opt_arg, pool));
+        opt_state.state_dir = svn_dirent_internal_style(utf8_opt_arg, pool);
+        break;
       default:
         {
           SVN_ERR(subcommand__help(NULL, NULL, pool));
@@ -449,7 +486,8 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
     svn_cache_config_t settings = *svn_cache_config_get();
 
     settings.cache_size = opt_state.memory_cache_size;
-    settings.single_threaded = TRUE;
+    /* Concurrent statistics require thread-safe caches. */
+    settings.single_threaded = opt_state.jobs <= 1;
 
     svn_cache_config_set(&settings);
   }
@@ -45,6 +45,8 @@ typedef struct svnfsfs__opt_state
   svn_boolean_t version;                            /* --version */
   svn_boolean_t quiet;                              /* --quiet */
   apr_uint64_t memory_cache_size;                   /* --memory-cache-size M */
+  int jobs;                                         /* --jobs */
+  const char *state_dir;                            /* --state-dir */
 } svnfsfs__opt_state;
 
 /* Declare all the command procedures */
@@ -52,7 +54,8 @@ svn_opt_subcommand_t
   subcommand__help,
   subcommand__dump_index,
   subcommand__load_index,
-  subcommand__stats;
+  subcommand__stats,
+  subcommand__warm_cache;
 
 
 /* Check that the filesystem at PATH is an FSFS repository and then open it.
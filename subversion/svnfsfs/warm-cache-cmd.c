@@ -0,0 +1,482 @@
+/* warm-cache-cmd.c -- implements the warm-cache sub-command.
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include "svn_cmdline.h"
+#include "svn_dirent_uri.h"
+#include "svn_fs.h"
+#include "svn_io.h"
+#include "svn_path.h"
+#include "svn_pools.h"
+#include "svn_sorts.h"
+
+#include "private/svn_fspath.h"
+#include "private/svn_string_private.h"
+
+#include "svn_private_config.h"
+
+#include "svnfsfs.h"
+
+/* A node to preload into the caches. */
+typedef struct warm_target_t
+{
+  /* Absolute path within the repository. */
+  const char *path;
+
+  /* Revision to read PATH in. */
+  svn_revnum_t revision;
+
+  /* How much of the sub-tree below PATH to read. */
+  svn_depth_t depth;
+} warm_target_t;
+
+/* What we did so far. */
+typedef struct warm_stats_t
+{
+  /* Number of input lines processed. */
+  apr_uint64_t lines;
+
+  /* Number of input lines that did not produce any target. */
+  apr_uint64_t lines_skipped;
+
+  /* Number of targets that did not exist in the repository. */
+  apr_uint64_t targets_missing;
+
+  /* Number of node revisions read. */
+  apr_uint64_t nodes;
+
+  /* Number of file contents read. */
+  apr_uint64_t files;
+
+  /* Sum of the sizes of all file contents read. */
+  apr_uint64_t bytes;
+} warm_stats_t;
+
+/* Parse TOKEN of the form "rN" or "rN:M".  Set *START to N and *END to M,
+ * or to N if there is no range.  Return FALSE for any other input.
+ */
+static svn_boolean_t
+parse_revnum_token(svn_revnum_t *start,
+                   svn_revnum_t *end,
+                   const char *token)
+{
+  const char *p;
+  svn_error_t *err;
+
+  if (token[0] != 'r')
+    return FALSE;
+
+  err = svn_revnum_parse(start, token + 1, &p);
+  if (!err && *p == ':')
+    err = svn_revnum_parse(end, p + 1, &p);
+  else
+    *end = *start;
+
+  svn_error_clear(err);
+  return !err && *p == '\0';
+}
+
+/* Parse TOKEN of the form "PATH@N".  Set *PATH to the URI-decoded PATH
+ * and *REVISION to N.  Allocate *PATH in POOL.  Return FALSE for any other
+ * input.
+ */
+static svn_boolean_t
+parse_path_rev_token(const char **path,
+                     svn_revnum_t *revision,
+                     const char *token,
+                     apr_pool_t *pool)
+{
+  const char *at = strrchr(token, '@');
+  const char *p;
+  svn_error_t *err;
+
+  if (token[0] != '/' || at == NULL)
+    return FALSE;
+
+  err = svn_revnum_parse(revision, at + 1, &p);
+  svn_error_clear(err);
+  if (err || *p != '\0')
+    return FALSE;
+
+  *path = svn_path_uri_decode(apr_pstrmemdup(pool, token, at - token),
+                              pool);
+  return TRUE;
+}
+
+/* Return the depth given by the first "depth=D" entry in TOKENS, starting
+ * at index FIRST.  If there is none, return DEFAULT_DEPTH.
+ */
+static svn_depth_t
+find_depth(apr_array_header_t *tokens,
+           int first,
+           svn_depth_t default_depth)
+{
+  int i;
+  for (i = first; i < tokens->nelts; ++i)
+    {
+      const char *token = APR_ARRAY_IDX(tokens, i, const char *);
+      if (strncmp(token, "depth=", 6) == 0)
+        {
+          svn_depth_t depth = svn_depth_from_word(token + 6);
+          return depth == svn_depth_unknown ? default_depth : depth;
+        }
+    }
+
+  return default_depth;
+}
+
+/* Append a new target for PATH in REVISION with DEPTH to TARGETS. */
+static void
+add_target(apr_array_header_t *targets,
+           const char *path,
+           svn_revnum_t revision,
+           svn_depth_t depth)
+{
+  warm_target_t *target = apr_palloc(targets->pool, sizeof(*target));
+  target->path = svn_fspath__canonicalize(path, targets->pool);
+  target->revision = revision;
+  target->depth = depth;
+
+  APR_ARRAY_PUSH(targets, warm_target_t *) = target;
+}
+
+/* Parse the SVN-ACTION in TOKENS, starting at index ACTION, as written to
+ * the operational logs of svnserve and mod_dav_svn.  Append what needs
+ * to be read to serve the same request again to TARGETS.  Allocate
+ * everything in POOL.
+ *
+ * Actions that are not recognized or don't read any file or directory
+ * data are ignored.
+ */
+static void
+parse_action(apr_array_header_t *targets,
+             apr_array_header_t *tokens,
+             int action,
+             apr_pool_t *pool)
+{
+  const char *name = APR_ARRAY_IDX(tokens, action, const char *);
+  const char *first, *second;
+  const char *path, *path2;
+  svn_revnum_t start, end, rev2;
+
+  if (tokens->nelts < action + 3)
+    return;
+
+  first = APR_ARRAY_IDX(tokens, action + 1, const char *);
+  second = APR_ARRAY_IDX(tokens, action + 2, const char *);
+  path = svn_path_uri_decode(first, pool);
+
+  /* get-file <PATH> r<N> text? props?
+   * get-dir <PATH> r<N> text? props? */
+  if (   (strcmp(name, "get-file") == 0 || strcmp(name, "get-dir") == 0)
+      && parse_revnum_token(&start, &end, second))
+    add_target(targets, path, start, svn_depth_empty);
+
+  /* checkout-or-export <PATH> r<N> depth=<D>?
+   * status <PATH> r<N> depth=<D>?
+   * update <PATH> r<N> depth=<D>? send-copyfrom-args? */
+  else if (   (   strcmp(name, "checkout-or-export") == 0
+               || strcmp(name, "status") == 0
+               || strcmp(name, "update") == 0)
+           && parse_revnum_token(&start, &end, second))
+    add_target(targets, path, start,
+               find_depth(tokens, action + 3, svn_depth_infinity));
+
+  /* switch <FROM-PATH> <TO-PATH>@<N> depth=<D>? */
+  else if (   strcmp(name, "switch") == 0
+           && parse_path_rev_token(&path2, &rev2, second, pool))
+    add_target(targets, path2, rev2,
+               find_depth(tokens, action + 3, svn_depth_infinity));
+
+  /* diff <PATH> r<N>:<M> depth=<D>? ignore-ancestry?
+   * diff <FROM-PATH>@<N> <TO-PATH>@<M> depth=<D>? ignore-ancestry? */
+  else if (strcmp(name, "diff") == 0)
+    {
+      svn_depth_t depth = find_depth(tokens, action + 3, svn_depth_infinity);
+      if (parse_revnum_token(&start, &end, second))
+        {
+          add_target(targets, path, start, depth);
+          add_target(targets, path, end, depth);
+        }
+      else if (   parse_path_rev_token(&path, &start, first, pool)
+               && parse_path_rev_token(&path2, &end, second, pool))
+        {
+          add_target(targets, path, start, depth);
+          add_target(targets, path2, end, depth);
+        }
+    }
+
+  /* get-file-revs <PATH> r<N>:<M> include-merged-revisions?
+   * Blame will start with the contents in the later revision. */
+  else if (   strcmp(name, "get-file-revs") == 0
+           && parse_revnum_token(&start, &end, second))
+    add_target(targets, path, MAX(start, end), svn_depth_empty);
+}
+
+/* Parse LINE and append the nodes to read to TARGETS.  LINE may either
+ * be a line of an svnserve or mod_dav_svn operational log, or name a
+ * single node as "PATH[@N] depth=<D>?".  YOUNGEST is the revision to use
+ * if none is given.  Allocate everything in POOL.
+ */
+static void
+parse_line(apr_array_header_t *targets,
+           const char *line,
+           svn_revnum_t youngest,
+           apr_pool_t *pool)
+{
+  /* The SVN-ACTION words that we know how to replay. */
+  static const char *const actions[] =
+    { "get-file", "get-dir", "checkout-or-export", "status", "update",
+      "switch", "diff", "get-file-revs", NULL };
+
+  apr_array_header_t *tokens = svn_cstring_split(line, " \t", TRUE, pool);
+  const char *first;
+  svn_revnum_t revision;
+  int i, k;
+
+  if (tokens->nelts == 0)
+    return;
+
+  /* Plain list of paths? */
+  first = APR_ARRAY_IDX(tokens, 0, const char *);
+  if (first[0] == '/')
+    {
+      const char *path;
+      if (!parse_path_rev_token(&path, &revision, first, pool))
+        {
+          path = svn_path_uri_decode(first, pool);
+          revision = youngest;
+        }
+
+      add_target(targets, path, revision,
+                 find_depth(tokens, 1, svn_depth_empty));
+      return;
+    }
+
+  /* Log lines start with a variable number of fields, e.g. PID, time
+   * stamp, user and repository name, before the actual SVN-ACTION. */
+  for (i = 0; i < tokens->nelts; ++i)
+    for (k = 0; actions[k]; ++k)
+      if (strcmp(APR_ARRAY_IDX(tokens, i, const char *), actions[k]) == 0)
+        {
+          parse_action(targets, tokens, i, pool);
+          return;
+        }
+}
+
+/* Read PATH of kind KIND in ROOT and, depending on DEPTH, the nodes below
+ * it such that they end up in the FSFS caches.  For directories, this
+ * always includes the node revisions of their entries, just as listing
+ * them would require.  Update STATS accordingly.  Use SCRATCH_POOL for
+ * temporary allocations.
+ */
+static svn_error_t *
+warm_node(warm_stats_t *stats,
+          svn_fs_root_t *root,
+          const char *path,
+          svn_node_kind_t kind,
+          svn_depth_t depth,
+          apr_pool_t *scratch_pool)
+{
+  apr_hash_t *props;
+
+  if (check_cancel)
+    SVN_ERR(check_cancel(NULL));
+
+  ++stats->nodes;
+  SVN_ERR(svn_fs_node_proplist(&props, root, path, scratch_pool));
+
+  if (kind == svn_node_file)
+    {
+      svn_stream_t *contents;
+      svn_filesize_t length;
+
+      SVN_ERR(svn_fs_file_length(&length, root, path, scratch_pool));
+      SVN_ERR(svn_fs_file_contents(&contents, root, path, scratch_pool));
+      SVN_ERR(svn_stream_copy3(contents, svn_stream_empty(scratch_pool),
+                               check_cancel, NULL, scratch_pool));
+
+      ++stats->files;
+      stats->bytes += length;
+    }
+  else if (kind == svn_node_dir)
+    {
+      apr_hash_t *entries;
+      apr_hash_index_t *hi;
+      apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+
+      SVN_ERR(svn_fs_dir_entries(&entries, root, path, scratch_pool));
+      for (hi = apr_hash_first(scratch_pool, entries);
+           hi;
+           hi = apr_hash_next(hi))
+        {
+          const svn_fs_dirent_t *dirent = apr_hash_this_val(hi);
+          const char *child_path;
+
+          svn_pool_clear(iterpool);
+          child_path = svn_fspath__join(path, dirent->name, iterpool);
+
+          if (depth == svn_depth_infinity)
+            {
+              SVN_ERR(warm_node(stats, root, child_path, dirent->kind,
+                                depth, iterpool));
+            }
+          else if (   depth == svn_depth_immediates
+                   || (   depth == svn_depth_files
+                       && dirent->kind == svn_node_file))
+            {
+              SVN_ERR(warm_node(stats, root, child_path, dirent->kind,
+                                svn_depth_empty, iterpool));
+            }
+          else
+            {
+              /* Node revision only. */
+              svn_revnum_t created_rev;
+              SVN_ERR(svn_fs_node_created_rev(&created_rev, root,
+                                              child_path, iterpool));
+              ++stats->nodes;
+            }
+        }
+
+      svn_pool_destroy(iterpool);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Read all lines from INPUT and preload the data that they reference
+ * from the repository at PATH into the caches.  Update STATS accordingly.
+ * Use POOL for allocations.
+ */
+static svn_error_t *
+warm_cache(warm_stats_t *stats,
+           const char *path,
+           svn_stream_t *input,
+           apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_root_t *root = NULL;
+  svn_revnum_t youngest;
+  svn_boolean_t eof = FALSE;
+  apr_pool_t *root_pool = svn_pool_create(pool);
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  SVN_ERR(open_fs(&fs, path, pool));
+  SVN_ERR(svn_fs_youngest_rev(&youngest, fs, pool));
+
+  while (!eof)
+    {
+      svn_stringbuf_t *line;
+      apr_array_header_t *targets;
+      int i;
+
+      svn_pool_clear(iterpool);
+
+      SVN_ERR(svn_stream_readline(input, &line, "\n", &eof, iterpool));
+      svn_stringbuf_strip_whitespace(line);
+      if (eof && line->len == 0)
+        break;
+
+      ++stats->lines;
+      targets = apr_array_make(iterpool, 2, sizeof(warm_target_t *));
+      parse_line(targets, line->data, youngest, iterpool);
+      if (targets->nelts == 0)
+        {
+          ++stats->lines_skipped;
+          continue;
+        }
+
+      for (i = 0; i < targets->nelts; ++i)
+        {
+          warm_target_t *target = APR_ARRAY_IDX(targets, i, warm_target_t *);
+          svn_node_kind_t kind = svn_node_none;
+
+          /* Consecutive requests tend to be for the same revision.
+           * Keep the root around to benefit from its DAG node cache. */
+          if (   SVN_IS_VALID_REVNUM(target->revision)
+              && target->revision <= youngest
+              && (   root == NULL
+                  || svn_fs_revision_root_revision(root) != target->revision))
+            {
+              svn_pool_clear(root_pool);
+              SVN_ERR(svn_fs_revision_root(&root, fs, target->revision,
+                                           root_pool));
+            }
+
+          if (root && svn_fs_revision_root_revision(root) == target->revision)
+            SVN_ERR(svn_fs_check_path(&kind, root, target->path, iterpool));
+
+          if (kind == svn_node_none)
+            ++stats->targets_missing;
+          else
+            SVN_ERR(warm_node(stats, root, target->path, kind, target->depth,
+                              iterpool));
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+  svn_pool_destroy(root_pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* This implements `svn_opt_subcommand_t'. */
+svn_error_t *
+subcommand__warm_cache(apr_getopt_t *os, void *baton, apr_pool_t *pool)
+{
+  svnfsfs__opt_state *opt_state = baton;
+  apr_array_header_t *args;
+  svn_stream_t *input;
+  warm_stats_t stats = { 0 };
+
+  SVN_ERR(svn_opt_parse_all_args(&args, os, pool));
+  if (args->nelts > 1)
+    return svn_error_create(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+                            _("Too many arguments given"));
+
+  if (args->nelts == 1)
+    SVN_ERR(svn_stream_open_readonly(&input,
+                                     svn_dirent_internal_style(
+                                       APR_ARRAY_IDX(args, 0, const char *),
+                                       pool),
+                                     pool, pool));
+  else
+    SVN_ERR(svn_stream_for_stdin2(&input, TRUE, pool));
+
+  SVN_ERR(warm_cache(&stats, opt_state->repository_path, input, pool));
+
+  if (!opt_state->quiet)
+    SVN_ERR(svn_cmdline_printf(pool,
+                               _("%s lines read, %s skipped, "
+                                 "%s paths not found.\n"
+                                 "%s nodes read, including %s files "
+                                 "with %s bytes.\n"),
+                               svn__ui64toa_sep(stats.lines, ',', pool),
+                               svn__ui64toa_sep(stats.lines_skipped, ',',
+                                                pool),
+                               svn__ui64toa_sep(stats.targets_missing, ',',
+                                                pool),
+                               svn__ui64toa_sep(stats.nodes, ',', pool),
+                               svn__ui64toa_sep(stats.files, ',', pool),
+                               svn__ui64toa_sep(stats.bytes, ',', pool)));
+
+  return SVN_NO_ERROR;
+}
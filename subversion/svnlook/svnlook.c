@@ -200,7 +200,11 @@ static const apr_getopt_option_t options_table[] =
       "                             "
       "  -U ARG, --context ARG: Show ARG lines of context\n"
       "                             "
-      "  -p, --show-c-function: Show C function name")},
+      "  -p, --show-c-function: Show C function name\n"
+      "                             "
+      "  --diff-algorithm ARG: Compare lines using ARG\n"
+      "                             "
+      "    ('myers' (default), 'patience' or 'histogram')")},
 
   {"quiet",             'q', 0,
    N_("no progress (only errors) to stderr")},
@@ -54,6 +54,7 @@
 #include "private/svn_log.h"
 #include "private/svn_mergeinfo_private.h"
 #include "private/svn_ra_svn_private.h"
+#include "private/svn_repos_private.h"
 #include "private/svn_fspath.h"
 
 #ifdef HAVE_UNISTD_H
@@ -1015,6 +1016,10 @@ static svn_error_t *accept_report(svn_boolean_t *only_empty_entry,
                                       &ab, svn_ra_svn_zero_copy_limit(conn),
                                       pool));
 
+  /* Large file contents may go straight from disk to the network. */
+  svn_repos__report_set_send_file_range_func(report_baton,
+                                             svn_ra_svn__try_send_file_range);
+
   rb.sb = b;
   rb.repos_url = svn_path_uri_decode(b->repository->repos_url, pool);
   rb.report_baton = report_baton;
@@ -3780,6 +3785,112 @@ list(svn_ra_svn_conn_t *conn,
   return svn_error_trace(svn_ra_svn__write_cmd_response(conn, pool, ""));
 }
 
+/* Baton type to be used with blame_receiver. */
+typedef struct blame_receiver_baton_t
+{
+  svn_ra_svn_conn_t *conn;
+
+  /* Revisions whose revprops have already been sent, allocated in POOL. */
+  apr_hash_t *revs_sent;
+  apr_pool_t *pool;
+} blame_receiver_baton_t;
+
+/* Implements svn_repos_blame_receiver_t, sending the chunk to the client.
+ * BATON must be a blame_receiver_baton_t. */
+static svn_error_t *
+blame_receiver(void *baton,
+               apr_int64_t start_line,
+               svn_revnum_t revision,
+               apr_hash_t *rev_props,
+               apr_pool_t *pool)
+{
+  blame_receiver_baton_t *b = baton;
+
+  SVN_ERR(svn_ra_svn__write_tuple(b->conn, pool, "n(?r)(!",
+                                  (apr_uint64_t) start_line, revision));
+
+  /* Many chunks tend to share the same revision.  Send its revprops
+   * only once. */
+  if (   SVN_IS_VALID_REVNUM(revision)
+      && !apr_hash_get(b->revs_sent, &revision, sizeof(revision)))
+    {
+      svn_revnum_t *key = apr_pmemdup(b->pool, &revision, sizeof(revision));
+      apr_hash_set(b->revs_sent, key, sizeof(*key), key);
+
+      SVN_ERR(svn_ra_svn__write_proplist(b->conn, pool, rev_props));
+    }
+
+  return svn_error_trace(svn_ra_svn__write_tuple(b->conn, pool, "!))"));
+}
+
+/* Return the svn_diff_file_ignore_space_t value for the protocol WORD. */
+static svn_diff_file_ignore_space_t
+ignore_space_from_word(const char *word)
+{
+  if (strcmp(word, "change") == 0)
+    return svn_diff_file_ignore_space_change;
+  if (strcmp(word, "all") == 0)
+    return svn_diff_file_ignore_space_all;
+
+  return svn_diff_file_ignore_space_none;
+}
+
+static svn_error_t *
+blame(svn_ra_svn_conn_t *conn,
+      apr_pool_t *pool,
+      svn_ra_svn__list_t *params,
+      void *baton)
+{
+  server_baton_t *b = baton;
+  const char *path, *full_path, *canonical_path;
+  svn_revnum_t start_rev, end_rev;
+  const char *ignore_space_word;
+  svn_boolean_t ignore_eol_style;
+  svn_diff_file_options_t diff_options = { 0 };
+  blame_receiver_baton_t rb;
+  svn_error_t *err, *write_err;
+  authz_baton_t ab;
+
+  ab.server = b;
+  ab.conn = conn;
+
+  /* Read the command parameters. */
+  SVN_ERR(svn_ra_svn__parse_tuple(params, "crrwb", &path, &start_rev,
+                                  &end_rev, &ignore_space_word,
+                                  &ignore_eol_style));
+  SVN_ERR(svn_relpath_canonicalize_safe(&canonical_path, NULL, path,
+                                        pool, pool));
+  SVN_ERR(trivial_auth_request(conn, pool, b));
+  full_path = svn_fspath__join(b->repository->fs_path->data,
+                               canonical_path, pool);
+
+  diff_options.ignore_space = ignore_space_from_word(ignore_space_word);
+  diff_options.ignore_eol_style = ignore_eol_style;
+
+  SVN_ERR(log_command(b, conn, pool, "%s",
+                      svn_log__blame(full_path, start_rev, end_rev, pool)));
+
+  rb.conn = conn;
+  rb.revs_sent = apr_hash_make(pool);
+  rb.pool = pool;
+
+  /* Calculate the attribution and send it in chunks. */
+  err = svn_repos_blame(b->repository->repos, full_path, start_rev, end_rev,
+                        &diff_options, authz_check_access_cb_func(b), &ab,
+                        blame_receiver, &rb, pool);
+
+  /* Finish response. */
+  write_err = svn_ra_svn__write_word(conn, pool, "done");
+  if (write_err)
+    {
+      svn_error_clear(err);
+      return write_err;
+    }
+  SVN_CMD_ERR(err);
+
+  return svn_error_trace(svn_ra_svn__write_cmd_response(conn, pool, ""));
+}
+
 static const svn_ra_svn__cmd_entry_t main_commands[] = {
   { "reparent",        reparent },
   { "get-latest-rev",  get_latest_rev },
@@ -3813,6 +3924,7 @@ static const svn_ra_svn__cmd_entry_t main_commands[] = {
   { "get-deleted-rev", get_deleted_rev },
   { "get-iprops",      get_inherited_props },
   { "list",            list },
+  { "blame",           blame },
   { NULL }
 };
 
@@ -4239,7 +4351,7 @@ construct_server_baton(server_baton_t **baton,
    * send an empty mechlist. */
   if (params->compression_level > 0)
     SVN_ERR(svn_ra_svn__write_cmd_response(conn, scratch_pool,
-                                           "nn()(wwwwwwwwwwwww)",
+                                           "nn()(wwwwwwwwwwwwww)",
                                            (apr_uint64_t) 2, (apr_uint64_t) 2,
                                            SVN_RA_SVN_CAP_EDIT_PIPELINE,
                                            SVN_RA_SVN_CAP_SVNDIFF1,
@@ -4253,11 +4365,12 @@ construct_server_baton(server_baton_t **baton,
                                            SVN_RA_SVN_CAP_INHERITED_PROPS,
                                            SVN_RA_SVN_CAP_EPHEMERAL_TXNPROPS,
                                            SVN_RA_SVN_CAP_GET_FILE_REVS_REVERSE,
-                                           SVN_RA_SVN_CAP_LIST
+                                           SVN_RA_SVN_CAP_LIST,
+                                           SVN_RA_SVN_CAP_BLAME
                                            ));
   else
     SVN_ERR(svn_ra_svn__write_cmd_response(conn, scratch_pool,
-                                           "nn()(wwwwwwwwwww)",
+                                           "nn()(wwwwwwwwwwww)",
                                            (apr_uint64_t) 2, (apr_uint64_t) 2,
                                            SVN_RA_SVN_CAP_EDIT_PIPELINE,
                                            SVN_RA_SVN_CAP_ABSENT_ENTRIES,
@@ -4269,7 +4382,8 @@ construct_server_baton(server_baton_t **baton,
                                            SVN_RA_SVN_CAP_INHERITED_PROPS,
                                            SVN_RA_SVN_CAP_EPHEMERAL_TXNPROPS,
                                            SVN_RA_SVN_CAP_GET_FILE_REVS_REVERSE,
-                                           SVN_RA_SVN_CAP_LIST
+                                           SVN_RA_SVN_CAP_LIST,
+                                           SVN_RA_SVN_CAP_BLAME
                                            ));
 
   /* Read client response, which we assume to be in version 2 format:
@@ -55,6 +55,7 @@
 #include "private/svn_dep_compat.h"
 #include "private/svn_cmdline_private.h"
 #include "private/svn_atomic.h"
+#include "private/svn_cache.h"
 #include "private/svn_mutex.h"
 #include "private/svn_subr_private.h"
 
@@ -296,6 +297,8 @@ static const apr_getopt_option_t svnserve__options[] =
         "                             "
         "0 switches to dynamically sized caches.\n"
         "                             "
+        "In fork mode, all processes share that cache.\n"
+        "                             "
         "[used for FSFS and FSX repositories only]")},
     {"cache-txdeltas", SVNSERVE_OPT_CACHE_TXDELTAS, 1,
      N_("enable or disable caching of deltas between older\n"
@@ -1295,6 +1298,18 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
       }
 
     svn_cache_config_set(&settings);
+
+#if APR_HAS_FORK
+    /* Let all worker processes share a single cache.  For that, it must
+     * be allocated before we fork the first one.  If shared memory is not
+     * available, we will silently fall back to per-process caches.
+     */
+    if (handling_mode == connection_mode_fork)
+      {
+        svn_cache__set_global_membuffer_shared(TRUE);
+        svn_cache__get_global_membuffer_cache();
+      }
+#endif
   }
 
 #if APR_HAS_THREADS
@@ -1352,6 +1367,17 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
               /* the child wouldn't listen to the main server's socket */
               apr_socket_close(sock);
 
+              /* Attach to the cross-process locks of the shared cache. */
+              err = svn_cache__membuffer_child_init(
+                      svn_cache__get_global_membuffer_cache(), pool);
+              if (err)
+                {
+                  logger__log_error(params.logger, err, NULL, NULL);
+                  svn_error_clear(err);
+                  close_connection(connection);
+                  return SVN_NO_ERROR;
+                }
+
               /* serve_socket() logs any error it returns, so ignore it. */
               svn_error_clear(serve_socket(connection, connection->pool));
               close_connection(connection);
@@ -4058,6 +4058,66 @@ def build_repcache(sbox):
   if new_rep_cache != rep_cache:
     raise svntest.Failure
 
+@SkipUnless(svntest.main.is_fs_type_fsfs)
+def build_mergeinfo_index(sbox):
+  "svnadmin build-mergeinfo-index"
+
+  sbox.build()
+
+  # Mergeinfo to be found below the root.
+  sbox.simple_propset('svn:mergeinfo', '/branch/B:1', 'A/B')
+  sbox.simple_commit()
+
+  expected_output = ["* Indexed revision 0.\n",
+                     "* Indexed revision 1.\n",
+                     "* Indexed revision 2.\n"]
+  svntest.actions.run_and_verify_svnadmin(expected_output, [],
+                                          "build-mergeinfo-index",
+                                          sbox.repo_dir)
+
+  # Nothing left to do on the second run.
+  svntest.actions.run_and_verify_svnadmin([], [],
+                                          "build-mergeinfo-index",
+                                          sbox.repo_dir)
+
+  # Commits keep the index up to date.
+  sbox.simple_propset('svn:mergeinfo', '/branch/D:2', 'A/D')
+  sbox.simple_commit()
+  svntest.actions.run_and_verify_svnadmin([], [],
+                                          "build-mergeinfo-index",
+                                          sbox.repo_dir)
+
+@SkipUnless(svntest.main.is_fs_type_fsfs)
+def build_history_index(sbox):
+  "svnadmin build-history-index"
+
+  sbox.build()
+  sbox.simple_append('iota', 'new line\n')
+  sbox.simple_commit()
+
+  expected_output = ["* Indexed revision 1.\n",
+                     "* Indexed revision 2.\n"]
+  svntest.actions.run_and_verify_svnadmin(expected_output, [],
+                                          "build-history-index",
+                                          sbox.repo_dir)
+
+  # Nothing left to do on the second run.
+  svntest.actions.run_and_verify_svnadmin([], [],
+                                          "build-history-index",
+                                          sbox.repo_dir)
+
+  # Once enabled, commits keep the index up to date.
+  fsfs_conf = svntest.main.get_fsfs_conf_file_path(sbox.repo_dir)
+  svntest.main.file_append(fsfs_conf,
+                           "\n"
+                           "[history-index]\n"
+                           "enable-history-index = true\n")
+  sbox.simple_append('iota', 'another line\n')
+  sbox.simple_commit()
+  svntest.actions.run_and_verify_svnadmin([], [],
+                                          "build-history-index",
+                                          sbox.repo_dir)
+
 
 ########################################################################
 # Run the tests
@@ -4139,6 +4199,8 @@ test_list = [ None,
               dump_include_copied_directory,
               load_normalize_node_props,
               build_repcache,
+              build_mergeinfo_index,
+              build_history_index,
              ]
 
 if __name__ == '__main__':
@@ -63,6 +63,9 @@ Item = svntest.wc.StateItem
 #
 #   'svnfsfs dump-index': Tested implicitly by the load-index test
 #
+#   'svnfsfs warm-cache': Feed it a mix of path lists, log lines and noise
+#                         and verify the summary counts.
+#
 #   'svnfsfs load-index': Create a greek repo but set shard to 2 and pack
 #                         it so we can load into a packed shard with more
 #                         than one revision to test ordering issues etc.
@@ -320,6 +323,50 @@ def test_stats_on_empty_repo(sbox):
   exit_code, output, errput = \
     svntest.actions.run_and_verify_svnfsfs(None, [], 'stats', sbox.repo_dir)
 
+@SkipUnless(svntest.main.fs_has_pack)
+@SkipUnless(svntest.main.is_fs_log_addressing)
+def test_stats_concurrent(sbox):
+  "stats with concurrent jobs"
+
+  # One revision per shard, so that there are several pack files to read.
+  sbox.build(create_wc=False)
+  patch_format(sbox.repo_dir, shard_size=1)
+  for i in range(2, 6):
+    svntest.actions.run_and_verify_svnmucc(None, [],
+                                           '-U', sbox.repo_url,
+                                           '-m', 'r%d' % i,
+                                           'propset', 'prop', str(i), 'iota')
+  svntest.actions.run_and_verify_svnadmin(None, [], "pack", sbox.repo_dir)
+
+  exit_code, expected_output, errput = \
+    svntest.actions.run_and_verify_svnfsfs(None, [], 'stats', sbox.repo_dir)
+  svntest.actions.run_and_verify_svnfsfs(expected_output, [], 'stats',
+                                         '--jobs', '2', sbox.repo_dir)
+
+@SkipUnless(svntest.main.is_fs_type_fsfs)
+def test_warm_cache(sbox):
+  "warm-cache with paths and log lines"
+
+  sbox.build(create_wc=False)
+
+  input_file = sbox.get_tempname()
+  svntest.main.file_write(input_file,
+                          "/A/mu@1\n"
+                          "/A/D depth=infinity\n"
+                          "4711 2018-01-01T12:00:00.000000Z jrandom repo "
+                            "get-file /iota r1 text props\n"
+                          "this is not a request\n"
+                          "/not/there\n")
+
+  # /A/mu, the 10 nodes in /A/D and /iota.  All of them are files
+  # except /A/D, /A/D/G and /A/D/H.
+  expected_output = [
+    "5 lines read, 1 skipped, 1 paths not found.\n",
+    "12 nodes read, including 9 files with 219 bytes.\n" ]
+  svntest.actions.run_and_verify_svnfsfs(expected_output, [],
+                                         'warm-cache', sbox.repo_dir,
+                                         input_file)
+
 ########################################################################
 # Run the tests
 
@@ -329,6 +376,8 @@ test_list = [ None,
               test_stats,
               load_index_sharded,
               test_stats_on_empty_repo,
+              test_warm_cache,
+              test_stats_concurrent,
              ]
 
 if __name__ == '__main__':
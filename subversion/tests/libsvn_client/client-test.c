@@ -1419,6 +1419,168 @@ test_copy_pin_externals_select_subtree(const svn_test_opts_t *opts, apr_pool_t *
   return SVN_NO_ERROR;
 }
 
+/* Number of lines in the file blamed by test_blame_many_chunks, the
+   number of revisions to commit and the number of edits per revision. */
+#define BLAME_LINES 2000
+#define BLAME_REVS 60
+#define BLAME_EDITS 16
+
+/* Baton for blame_many_chunks_receiver. */
+typedef struct blame_many_chunks_baton_t
+{
+  /* The revision each line is expected to be attributed to. */
+  const svn_revnum_t *revs;
+
+  /* The expected contents of each line. */
+  const char * const *lines;
+
+  /* Number of lines received so far. */
+  int count;
+} blame_many_chunks_baton_t;
+
+/* Implements svn_client_blame_receiver4_t. */
+static svn_error_t *
+blame_many_chunks_receiver(void *baton,
+                           apr_int64_t line_no,
+                           svn_revnum_t revision,
+                           apr_hash_t *rev_props,
+                           svn_revnum_t merged_revision,
+                           apr_hash_t *merged_rev_props,
+                           const char *merged_path,
+                           const svn_string_t *line,
+                           svn_boolean_t local_change,
+                           apr_pool_t *pool)
+{
+  blame_many_chunks_baton_t *b = baton;
+
+  SVN_TEST_ASSERT(line_no == b->count && line_no < BLAME_LINES);
+  SVN_TEST_INT_ASSERT(revision, b->revs[line_no]);
+  SVN_TEST_STRING_ASSERT(line->data, b->lines[line_no]);
+  b->count++;
+
+  return SVN_NO_ERROR;
+}
+
+/* Blame a file whose history leaves it split into many small chunks.
+   Including merged revisions makes the client calculate the blame
+   itself, i.e. it has to maintain a deep chunk treap. */
+static svn_error_t *
+test_blame_many_chunks(const svn_test_opts_t *opts,
+                       apr_pool_t *pool)
+{
+  const char *repos_path = svn_test_data_path("blame-many-chunks", pool);
+  svn_repos_t *repos;
+  svn_revnum_t rev = 0;
+  svn_revnum_t revs[BLAME_LINES];
+  const char *lines[BLAME_LINES];
+  const char *url;
+  svn_client_ctx_t *ctx;
+  svn_opt_revision_t peg_rev, start_rev, end_rev;
+  blame_many_chunks_baton_t baton;
+  apr_uint32_t seed = 1;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  int i, k;
+
+  SVN_ERR(svn_test__create_repos(&repos, repos_path, opts, pool));
+
+  for (i = 0; i < BLAME_LINES; ++i)
+    {
+      revs[i] = 1;
+      lines[i] = apr_psprintf(pool, "line %d", i);
+    }
+
+  while (rev < BLAME_REVS)
+    {
+      svn_revnum_t next = rev + 1;
+      svn_stringbuf_t *contents;
+      svn_fs_txn_t *txn;
+      svn_fs_root_t *txn_root;
+
+      svn_pool_clear(iterpool);
+
+      /* Replace lines and move new ones around at pseudo-random places.
+         The number of lines stays the same. */
+      for (k = 0; rev > 0 && k < BLAME_EDITS; ++k)
+        {
+          const char *text = apr_psprintf(pool, "edit %d in r%ld", k, next);
+          int from, to;
+
+          seed = seed * 1103515245 + 12345;
+          from = (int)((seed >> 8) % BLAME_LINES);
+          seed = seed * 1103515245 + 12345;
+          to = (k % 2) ? (int)((seed >> 8) % BLAME_LINES) : from;
+
+          /* Delete line FROM and insert the new one at TO. */
+          if (to > from)
+            {
+              memmove(&revs[from], &revs[from + 1],
+                      (to - from) * sizeof(revs[0]));
+              memmove(&lines[from], &lines[from + 1],
+                      (to - from) * sizeof(lines[0]));
+            }
+          else if (to < from)
+            {
+              memmove(&revs[to + 1], &revs[to],
+                      (from - to) * sizeof(revs[0]));
+              memmove(&lines[to + 1], &lines[to],
+                      (from - to) * sizeof(lines[0]));
+            }
+
+          revs[to] = next;
+          lines[to] = text;
+        }
+
+      contents = svn_stringbuf_create_empty(iterpool);
+      for (i = 0; i < BLAME_LINES; ++i)
+        {
+          svn_stringbuf_appendcstr(contents, lines[i]);
+          svn_stringbuf_appendbyte(contents, '\n');
+        }
+
+      SVN_ERR(svn_fs_begin_txn2(&txn, svn_repos_fs(repos), rev, 0,
+                                iterpool));
+      SVN_ERR(svn_fs_txn_root(&txn_root, txn, iterpool));
+      if (rev == 0)
+        SVN_ERR(svn_fs_make_file(txn_root, "file", iterpool));
+      SVN_ERR(svn_test__set_file_contents(txn_root, "file", contents->data,
+                                          iterpool));
+      SVN_ERR(svn_repos_fs_commit_txn(NULL, repos, &rev, txn, iterpool));
+      SVN_TEST_ASSERT(rev == next);
+    }
+
+  SVN_ERR(svn_uri_get_file_url_from_dirent(&url, repos_path, pool));
+  url = apr_pstrcat(pool, url, "/file", SVN_VA_NULL);
+
+  SVN_ERR(svn_client_create_context(&ctx, pool));
+  peg_rev.kind = svn_opt_revision_head;
+  start_rev.kind = svn_opt_revision_number;
+  start_rev.value.number = 1;
+  end_rev.kind = svn_opt_revision_head;
+
+  baton.revs = revs;
+  baton.lines = lines;
+  baton.count = 0;
+  SVN_ERR(svn_client_blame6(NULL, NULL, url, &peg_rev, &start_rev, &end_rev,
+                            svn_diff_file_options_create(pool), FALSE, TRUE,
+                            blame_many_chunks_receiver, &baton, ctx, pool));
+  SVN_TEST_INT_ASSERT(baton.count, BLAME_LINES);
+
+  /* The server-side calculation must agree. */
+  baton.count = 0;
+  SVN_ERR(svn_client_blame6(NULL, NULL, url, &peg_rev, &start_rev, &end_rev,
+                            svn_diff_file_options_create(pool), FALSE, FALSE,
+                            blame_many_chunks_receiver, &baton, ctx, pool));
+  SVN_TEST_INT_ASSERT(baton.count, BLAME_LINES);
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#undef BLAME_LINES
+#undef BLAME_REVS
+#undef BLAME_EDITS
+
 /* ========================================================================== */
 
 
@@ -1447,6 +1609,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                        "test svn_client_copy7 with externals_to_pin"),
     SVN_TEST_OPTS_PASS(test_copy_pin_externals_select_subtree,
                        "pin externals on selected subtrees only"),
+    SVN_TEST_OPTS_PASS(test_blame_many_chunks,
+                       "blame a file split into many chunks"),
     SVN_TEST_NULL
   };
 
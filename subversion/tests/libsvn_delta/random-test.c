@@ -37,6 +37,7 @@
 #include "svn_pools.h"
 #include "svn_error.h"
 
+#include "private/svn_delta_private.h"
 #include "../../libsvn_delta/delta.h"
 #include "delta-window-test.h"
 
@@ -605,6 +606,106 @@ random_txdelta_to_svndiff_stream_test(apr_pool_t *pool)
   return err;
 }
 
+/* Compare the output of svn_txdelta__to_svndiff_parallel() with that of
+   svn_txdelta_to_svndiff3() for random data. */
+static svn_error_t *
+do_random_parallel_svndiff_test(apr_pool_t *pool,
+                                apr_uint32_t *last_seed)
+{
+  apr_uint32_t seed;
+  apr_uint32_t maxlen;
+  apr_size_t bytes_range;
+  int i;
+  int iterations;
+  int dump_files;
+  int print_windows;
+  const char *random_bytes;
+  apr_pool_t *iterpool;
+  apr_pool_t *windowpool;
+
+  /* Initialize parameters and print out the seed in case we dump core
+     or something. */
+  init_params(&seed, &maxlen, &iterations, &dump_files, &print_windows,
+              &random_bytes, &bytes_range, pool);
+
+  iterpool = svn_pool_create(pool);
+  windowpool = svn_pool_create(pool);
+  for (i = 0; i < iterations; i++)
+    {
+      apr_uint32_t subseed_base;
+      apr_file_t *source;
+      apr_file_t *target;
+      svn_txdelta_stream_t *txstream;
+      svn_txdelta_window_t *window;
+      svn_stringbuf_t *expected;
+      svn_stringbuf_t *actual;
+      svn_txdelta_window_handler_t serial_handler, parallel_handler;
+      void *serial_baton, *parallel_baton;
+      int version = 1 + i % 2;
+
+      svn_pool_clear(iterpool);
+
+      /* Generate source and target for the delta. */
+      *last_seed = seed;
+      subseed_base = svn_test_rand(&seed);
+      source = generate_random_file(maxlen, subseed_base, &seed,
+                                    random_bytes, bytes_range,
+                                    dump_files, iterpool);
+      target = generate_random_file(maxlen, subseed_base, &seed,
+                                    random_bytes, bytes_range,
+                                    dump_files, iterpool);
+
+      expected = svn_stringbuf_create_empty(iterpool);
+      actual = svn_stringbuf_create_empty(iterpool);
+      svn_txdelta_to_svndiff3(&serial_handler, &serial_baton,
+                              svn_stream_from_stringbuf(expected, iterpool),
+                              version, i % 10, iterpool);
+      SVN_ERR(svn_txdelta__to_svndiff_parallel(&parallel_handler,
+                                               &parallel_baton,
+                                               svn_stream_from_stringbuf(
+                                                 actual, iterpool),
+                                               version, i % 10, 2 + i % 4,
+                                               iterpool));
+
+      /* Feed the same windows to both encoders.  Clearing WINDOWPOOL
+         after each window makes sure the parallel encoder does not
+         depend on the caller's window data after returning. */
+      svn_txdelta2(&txstream,
+                   svn_stream_from_aprfile2(source, TRUE, iterpool),
+                   svn_stream_from_aprfile2(target, TRUE, iterpool),
+                   FALSE, iterpool);
+      do
+        {
+          svn_pool_clear(windowpool);
+          SVN_ERR(svn_txdelta_next_window(&window, txstream, windowpool));
+          SVN_ERR(serial_handler(window, serial_baton));
+          SVN_ERR(parallel_handler(window, parallel_baton));
+        }
+      while (window);
+
+      SVN_TEST_ASSERT(actual->len == expected->len);
+      SVN_TEST_ASSERT(memcmp(actual->data, expected->data, actual->len) == 0);
+
+      apr_file_close(source);
+      apr_file_close(target);
+    }
+  svn_pool_destroy(windowpool);
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_test_driver_t. */
+static svn_error_t *
+random_parallel_svndiff_test(apr_pool_t *pool)
+{
+  apr_uint32_t seed;
+  svn_error_t *err = do_random_parallel_svndiff_test(pool, &seed);
+  if (err)
+    fprintf(stderr, "SEED: %lu\n", (unsigned long)seed);
+  return err;
+}
+
 /* Change to 1 to enable the unit test for the delta combiner's range index: */
 #if 0
 #include "range-index-test.h"
@@ -625,6 +726,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "random combine delta test"),
     SVN_TEST_PASS2(random_txdelta_to_svndiff_stream_test,
                    "random txdelta to svndiff stream test"),
+    SVN_TEST_PASS2(random_parallel_svndiff_test,
+                   "random parallel svndiff encoder test"),
 #ifdef SVN_RANGE_INDEX_TEST_H
     SVN_TEST_PASS2(random_range_index_test,
                    "random range index test"),
@@ -3065,6 +3065,463 @@ three_way_double_add(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Implements svn_diff_output_fns_t::output_diff_modified, counting the
+   modified ranges in the int BATON. */
+static svn_error_t *
+count_diff_modified(void *baton,
+                    apr_off_t original_start, apr_off_t original_length,
+                    apr_off_t modified_start, apr_off_t modified_length,
+                    apr_off_t latest_start, apr_off_t latest_length)
+{
+  (*(int *)baton)++;
+
+  return SVN_NO_ERROR;
+}
+
+/* Diff files with many distinct lines, to exercise the growth of the
+   token table beyond its initial size. */
+static svn_error_t *
+test_many_tokens(apr_pool_t *pool)
+{
+  svn_stringbuf_t *original = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *modified = svn_stringbuf_create_empty(pool);
+  const char *filename1 = svn_test_data_path("many-tokens-original", pool);
+  const char *filename2 = svn_test_data_path("many-tokens-modified", pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  svn_diff_output_fns_t vtable = { 0 };
+  svn_diff_t *diff;
+  int count;
+  int i;
+
+  /* Change every 100th line and, in between, the whitespace of every
+     100th line. */
+  for (i = 0; i < 20000; i++)
+    {
+      svn_stringbuf_appendcstr(original,
+                               apr_psprintf(pool, "line %d\n", i));
+      if (i % 100 == 0)
+        svn_stringbuf_appendcstr(modified,
+                                 apr_psprintf(pool, "changed %d\n", i));
+      else if (i % 100 == 50)
+        svn_stringbuf_appendcstr(modified,
+                                 apr_psprintf(pool, "line  %d\n", i));
+      else
+        svn_stringbuf_appendcstr(modified,
+                                 apr_psprintf(pool, "line %d\n", i));
+    }
+
+  SVN_ERR(make_file(filename1, original->data, pool));
+  SVN_ERR(make_file(filename2, modified->data, pool));
+  vtable.output_diff_modified = count_diff_modified;
+
+  count = 0;
+  SVN_ERR(svn_diff_file_diff_2(&diff, filename1, filename2, options, pool));
+  SVN_ERR(svn_diff_output2(diff, &count, &vtable, NULL, NULL));
+  SVN_TEST_INT_ASSERT(count, 400);
+
+  options->ignore_space = svn_diff_file_ignore_space_change;
+
+  count = 0;
+  SVN_ERR(svn_diff_file_diff_2(&diff, filename1, filename2, options, pool));
+  SVN_ERR(svn_diff_output2(diff, &count, &vtable, NULL, NULL));
+  SVN_TEST_INT_ASSERT(count, 200);
+
+  count = 0;
+  SVN_ERR(svn_diff_mem_string_diff(&diff,
+                                   svn_string_create(original->data, pool),
+                                   svn_string_create(modified->data, pool),
+                                   options, pool));
+  SVN_ERR(svn_diff_output2(diff, &count, &vtable, NULL, NULL));
+  SVN_TEST_INT_ASSERT(count, 200);
+
+  return SVN_NO_ERROR;
+}
+
+/* Check the patience and histogram diff algorithms: option parsing, the
+   diff of a moved function, for which they find fewer changes than the
+   default algorithm, and trivial merges of random files. */
+static svn_error_t *
+test_diff_algorithms(apr_pool_t *pool)
+{
+  static const char *original =
+    "void f()\n"
+    "{\n"
+    "  f1();\n"
+    "}\n"
+    "\n"
+    "void g()\n"
+    "{\n"
+    "  g1();\n"
+    "}\n";
+  static const char *modified =
+    "void g()\n"
+    "{\n"
+    "  g1();\n"
+    "}\n"
+    "\n"
+    "void f()\n"
+    "{\n"
+    "  f1();\n"
+    "}\n";
+  const char *filename1 = svn_test_data_path("algorithm-original", pool);
+  const char *filename2 = svn_test_data_path("algorithm-modified", pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  apr_array_header_t *args = apr_array_make(pool, 2, sizeof(const char *));
+  svn_diff_output_fns_t vtable = { 0 };
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_t *diff;
+  int count;
+  int i;
+
+  SVN_TEST_ASSERT(options->algorithm == svn_diff_file_algorithm_myers);
+
+  APR_ARRAY_PUSH(args, const char *) = "--diff-algorithm";
+  APR_ARRAY_PUSH(args, const char *) = "histogram";
+  SVN_ERR(svn_diff_file_options_parse(options, args, pool));
+  SVN_TEST_ASSERT(options->algorithm == svn_diff_file_algorithm_histogram);
+
+  apr_array_clear(args);
+  APR_ARRAY_PUSH(args, const char *) = "--patience";
+  SVN_ERR(svn_diff_file_options_parse(options, args, pool));
+  SVN_TEST_ASSERT(options->algorithm == svn_diff_file_algorithm_patience);
+
+  apr_array_clear(args);
+  APR_ARRAY_PUSH(args, const char *) = "--diff-algorithm";
+  APR_ARRAY_PUSH(args, const char *) = "bogus";
+  SVN_TEST_ASSERT_ERROR(svn_diff_file_options_parse(options, args, pool),
+                        SVN_ERR_INVALID_DIFF_OPTION);
+
+  SVN_ERR(make_file(filename1, original, pool));
+  SVN_ERR(make_file(filename2, modified, pool));
+  vtable.output_diff_modified = count_diff_modified;
+
+  /* The default algorithm matches up the braces and the empty line. */
+  options->algorithm = svn_diff_file_algorithm_myers;
+  count = 0;
+  SVN_ERR(svn_diff_file_diff_2(&diff, filename1, filename2, options, pool));
+  SVN_ERR(svn_diff_output2(diff, &count, &vtable, NULL, NULL));
+  SVN_TEST_INT_ASSERT(count, 4);
+
+  /* The others see one function deleted and the other one inserted. */
+  for (i = svn_diff_file_algorithm_patience;
+       i <= svn_diff_file_algorithm_histogram;
+       i++)
+    {
+      options->algorithm = i;
+
+      count = 0;
+      SVN_ERR(svn_diff_file_diff_2(&diff, filename1, filename2, options,
+                                   pool));
+      SVN_ERR(svn_diff_output2(diff, &count, &vtable, NULL, NULL));
+      SVN_TEST_INT_ASSERT(count, 2);
+
+      count = 0;
+      SVN_ERR(svn_diff_mem_string_diff(&diff,
+                                       svn_string_create(original, pool),
+                                       svn_string_create(modified, pool),
+                                       options, pool));
+      SVN_ERR(svn_diff_output2(diff, &count, &vtable, NULL, NULL));
+      SVN_TEST_INT_ASSERT(count, 2);
+    }
+
+  seed_val();
+
+  for (i = 0; i < 6; i++)
+    {
+      svn_stringbuf_t *contents1, *contents2;
+
+      svn_pool_clear(iterpool);
+
+      options->algorithm = (i % 2) ? svn_diff_file_algorithm_histogram
+                                   : svn_diff_file_algorithm_patience;
+
+      SVN_ERR(make_random_file(filename1, 1000, 1100, 50, 10 * (i % 3),
+                               i % 2, iterpool));
+      SVN_ERR(make_random_file(filename2, 1000, 1100, 50, 10 * (i % 3),
+                               TRUE, iterpool));
+
+      SVN_ERR(svn_stringbuf_from_file2(&contents1, filename1, iterpool));
+      SVN_ERR(svn_stringbuf_from_file2(&contents2, filename2, iterpool));
+
+      SVN_ERR(three_way_merge("algorithm1", "algorithm2", "algorithm1",
+                              contents1->data, contents2->data,
+                              contents1->data, contents2->data, options,
+                              svn_diff_conflict_display_modified_latest,
+                              iterpool));
+    }
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Append line number I to BUF, preceded by PADDING zeros.  Without
+   padding, the line is 16 bytes long and ends in "\r\n". */
+static void
+append_crlf_line(svn_stringbuf_t *buf, int i, apr_size_t padding)
+{
+  char line[17];
+
+  apr_snprintf(line, sizeof(line), "%014d\r\n", i);
+  svn_stringbuf_appendfill(buf, '0', padding);
+  svn_stringbuf_appendcstr(buf, line);
+}
+
+/* Diff files whose identical prefix and suffix span several of the
+   4 KB blocks that find_identical_prefix() and find_identical_suffix()
+   compare at once, as well as a chunk boundary.  Pad the first line by
+   0 to 15 bytes, so that the "\r\n" of every line gets split at a block
+   boundary for one of the paddings.
+   The magic number used in this test, 4096, is SCAN_BLOCK_SIZE from
+   ../../libsvn_diff/diff_file.c. */
+static svn_error_t *
+test_identical_blocks(apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_size_t padding;
+
+  for (padding = 0; padding < 16; padding++)
+    {
+      svn_stringbuf_t *original, *modified1, *modified2;
+      svn_stringbuf_t *expected1, *expected2;
+      int i;
+
+      svn_pool_clear(iterpool);
+
+      /* 12000 lines make up about 192 KB, and line 9000 starts beyond
+         the first chunk.  Line 4095 ends at the 16th block boundary. */
+      original = svn_stringbuf_create_empty(iterpool);
+      modified1 = svn_stringbuf_create_empty(iterpool);
+      modified2 = svn_stringbuf_create_empty(iterpool);
+      for (i = 0; i < 12000; i++)
+        {
+          apr_size_t line_padding = i ? 0 : padding;
+
+          append_crlf_line(original, i, line_padding);
+
+          if (i == 9000)
+            svn_stringbuf_appendcstr(modified1, "changed line\r\n");
+          else
+            append_crlf_line(modified1, i, line_padding);
+
+          /* Insert a '\r' between the '\r' and the '\n'. */
+          append_crlf_line(modified2, i, line_padding);
+          if (i == 4095)
+            svn_stringbuf_insert(modified2, modified2->len - 1, "\r", 1);
+        }
+
+      expected1 = svn_stringbuf_create("--- identical-blocks-original" NL
+                                       "+++ identical-blocks-modified1" NL
+                                       "@@ -8998,7 +8998,7 @@" NL,
+                                       iterpool);
+      for (i = 8997; i < 9004; i++)
+        {
+          svn_stringbuf_appendbyte(expected1, i == 9000 ? '-' : ' ');
+          append_crlf_line(expected1, i, 0);
+          if (i == 9000)
+            svn_stringbuf_appendcstr(expected1, "+changed line\r\n");
+        }
+
+      expected2 = svn_stringbuf_create("--- identical-blocks-original" NL
+                                       "+++ identical-blocks-modified2" NL
+                                       "@@ -4093,7 +4093,8 @@" NL,
+                                       iterpool);
+      for (i = 4092; i < 4099; i++)
+        {
+          svn_stringbuf_appendbyte(expected2, i == 4095 ? '-' : ' ');
+          append_crlf_line(expected2, i, 0);
+          if (i == 4095)
+            svn_stringbuf_appendcstr(expected2,
+                                     apr_psprintf(iterpool,
+                                                  "+%014d\r" "+\r\n", i));
+        }
+
+      SVN_ERR(two_way_diff("identical-blocks-original",
+                           "identical-blocks-modified1",
+                           original->data, modified1->data, expected1->data,
+                           NULL, iterpool));
+      SVN_ERR(two_way_diff("identical-blocks-original",
+                           "identical-blocks-modified2",
+                           original->data, modified2->data, expected2->data,
+                           NULL, iterpool));
+    }
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Merge files larger than the windows in which svn_diff_file_output_merge3()
+   maps them, with a "\r\n" split at the window edge and a line longer than
+   a chunk straddling it.
+   The magic numbers used in this test, 1<<17 and 128, are CHUNK_SIZE and
+   OUTPUT_WINDOW_SIZE in chunks from ../../libsvn_diff/diff_file.c. */
+static svn_error_t *
+test_merge_window_edges(apr_pool_t *pool)
+{
+  apr_size_t chunk_size = 1 << 17;
+  apr_size_t window_size =
+#ifdef OUTPUT_WINDOW_SIZE
+                           OUTPUT_WINDOW_SIZE;
+#else
+                           128 * chunk_size;
+#endif
+  /* With a 17 byte first line, the "\r\n" of line EDGE straddles the
+     window edge.  The files extend two chunks beyond it. */
+  int edge = (int)(window_size / 16) - 1;
+  int num_lines = edge + (int)(chunk_size / 8);
+  apr_pool_t *subpool = svn_pool_create(pool);
+  svn_stringbuf_t *long_line = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *original, *modified, *latest, *expected;
+  int i;
+
+  svn_stringbuf_appendfill(long_line, 'x', 2 * chunk_size);
+  svn_stringbuf_appendcstr(long_line, "\r\n");
+
+  original = svn_stringbuf_create_ensure(window_size + 2 * chunk_size, pool);
+  modified = svn_stringbuf_create_ensure(window_size + 2 * chunk_size, pool);
+  for (i = 0; i < num_lines; i++)
+    {
+      append_crlf_line(original, i, i ? 0 : 1);
+      if (i == edge + 5)
+        svn_stringbuf_appendcstr(modified, "modified line\r\n");
+      else
+        append_crlf_line(modified, i, i ? 0 : 1);
+    }
+
+  /* Non-conflicting changes: LATEST replaces the line before the edge
+     with LONG_LINE and adds a line without eol at the end. */
+  latest = svn_stringbuf_create_ensure(window_size + 4 * chunk_size,
+                                       subpool);
+  expected = svn_stringbuf_create_ensure(window_size + 4 * chunk_size,
+                                         subpool);
+  for (i = 0; i < num_lines; i++)
+    {
+      if (i == edge - 1)
+        {
+          svn_stringbuf_appendstr(latest, long_line);
+          svn_stringbuf_appendstr(expected, long_line);
+        }
+      else
+        {
+          append_crlf_line(latest, i, i ? 0 : 1);
+          if (i == edge + 5)
+            svn_stringbuf_appendcstr(expected, "modified line\r\n");
+          else
+            append_crlf_line(expected, i, i ? 0 : 1);
+        }
+    }
+  svn_stringbuf_appendcstr(latest, "last line");
+  svn_stringbuf_appendcstr(expected, "last line");
+
+  SVN_ERR(three_way_merge("window-edges1", "window-edges2", "window-edges3",
+                          original->data, modified->data, latest->data,
+                          expected->data, NULL,
+                          svn_diff_conflict_display_modified_latest,
+                          subpool));
+  svn_pool_clear(subpool);
+
+  /* Conflicting changes after the edge. */
+  latest = svn_stringbuf_create_ensure(window_size + 4 * chunk_size,
+                                       subpool);
+  expected = svn_stringbuf_create_ensure(window_size + 4 * chunk_size,
+                                         subpool);
+  for (i = 0; i < num_lines; i++)
+    {
+      if (i == edge - 1)
+        {
+          svn_stringbuf_appendstr(latest, long_line);
+          svn_stringbuf_appendstr(expected, long_line);
+        }
+      else if (i == edge + 5)
+        {
+          svn_stringbuf_appendcstr(latest, "latest line\r\n");
+          svn_stringbuf_appendcstr(expected,
+                                   "<<<<<<< window-edges2\r\n"
+                                   "modified line\r\n"
+                                   "=======\r\n"
+                                   "latest line\r\n"
+                                   ">>>>>>> window-edges3\r\n");
+        }
+      else
+        {
+          append_crlf_line(latest, i, i ? 0 : 1);
+          append_crlf_line(expected, i, i ? 0 : 1);
+        }
+    }
+
+  SVN_ERR(three_way_merge("window-edges1", "window-edges2", "window-edges3",
+                          original->data, modified->data, latest->data,
+                          expected->data, NULL,
+                          svn_diff_conflict_display_modified_latest,
+                          subpool));
+  svn_pool_destroy(subpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Measure the time it takes to diff two files of several MB each. */
+static svn_error_t *
+diff_performance(apr_pool_t *pool)
+{
+  svn_stringbuf_t *original = svn_stringbuf_create_ensure(10000000, pool);
+  svn_stringbuf_t *modified = svn_stringbuf_create_ensure(10000000, pool);
+  const char *filename1 = svn_test_data_path("perf-original", pool);
+  const char *filename2 = svn_test_data_path("perf-modified", pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_uint32_t seed = 0x12345678;
+  apr_time_t start, end;
+  int i;
+
+  /* About 8 MB of lines with many repetitions, like in source code.
+     Change, delete or insert 1% of the lines. */
+  for (i = 0; i < 200000; i++)
+    {
+      apr_uint32_t r = svn_test_rand(&seed) % 100000;
+      const char *line
+        = apr_psprintf(iterpool, "    value_%u = compute(value_%u, %u);\n",
+                       r, r / 2, r % 1000);
+
+      svn_stringbuf_appendcstr(original, line);
+      switch (svn_test_rand(&seed) % 300)
+        {
+          case 0:
+            svn_stringbuf_appendcstr(modified, "    /* changed */\n");
+            break;
+          case 1:
+            break;
+          case 2:
+            svn_stringbuf_appendcstr(modified, "    /* inserted */\n");
+            /* fall through */
+          default:
+            svn_stringbuf_appendcstr(modified, line);
+        }
+
+      svn_pool_clear(iterpool);
+    }
+
+  SVN_ERR(make_file(filename1, original->data, pool));
+  SVN_ERR(make_file(filename2, modified->data, pool));
+
+  start = apr_time_now();
+  for (i = 0; i < 3; i++)
+    {
+      svn_diff_t *diff;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_diff_file_diff_2(&diff, filename1, filename2, options,
+                                   iterpool));
+    }
+  end = apr_time_now();
+  svn_pool_destroy(iterpool);
+
+  printf("%" APR_TIME_T_FMT " musecs per diff\n", (end - start) / 3);
+  printf("%" APR_TIME_T_FMT " kB / sec\n",
+         (apr_time_t)(original->len + modified->len) * 3 * 1000000
+           / 1024 / (end > start ? end - start : 1));
+
+  return SVN_NO_ERROR;
+}
+
 /* ========================================================================== */
 
 
@@ -3109,6 +3566,16 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "2-way issue #3362 test v2"),
     SVN_TEST_XFAIL2(three_way_double_add,
                    "3-way merge, double add"),
+    SVN_TEST_PASS2(test_many_tokens,
+                   "diff files with many distinct lines"),
+    SVN_TEST_PASS2(test_diff_algorithms,
+                   "patience and histogram diff"),
+    SVN_TEST_PASS2(test_identical_blocks,
+                   "identical prefix and suffix spanning blocks"),
+    SVN_TEST_PASS2(test_merge_window_edges,
+                   "3-way merge with lines straddling window edges"),
+    SVN_TEST_SKIP2(diff_performance, TRUE,
+                   "optional diff performance test"),
     SVN_TEST_NULL
   };
 
@@ -26,9 +26,13 @@
 
 #include "../svn_test.h"
 
+#include "svn_checksum.h"
+#include "svn_dirent_uri.h"
 #include "svn_error.h"
 #include "svn_fs.h"
 #include "svn_hash.h"
+#include "svn_io.h"
+#include "svn_string.h"
 
 #include "../svn_test_fs.h"
 
@@ -1214,6 +1218,374 @@ parent_and_child_lock(const svn_test_opts_t *opts,
   return SVN_NO_ERROR;
 }
 
+/* Set *COUNT to the number of locks in FS within DEPTH of PATH. */
+static svn_error_t *
+count_locks(int *count,
+            svn_fs_t *fs,
+            const char *path,
+            svn_depth_t depth,
+            apr_pool_t *pool)
+{
+  struct get_locks_baton_t *baton = make_get_locks_baton(pool);
+
+  SVN_ERR(svn_fs_get_locks2(fs, path, depth, get_locks_callback, baton,
+                            pool));
+  *count = apr_hash_count(baton->locks);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+lock_db_migration(const svn_test_opts_t *opts,
+                  apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root;
+  svn_revnum_t newrev;
+  svn_fs_access_t *access;
+  svn_lock_t *lock;
+  svn_node_kind_t kind;
+  int count;
+  apr_hash_t *fs_config = apr_hash_make(pool);
+  const char *repo_name = "test-repo-lock-db-migration";
+  const char *conf_path = svn_dirent_join(repo_name, "fsfs.conf", pool);
+
+  /* The lock database is specific to FSFS. */
+  if (strcmp(opts->fs_type, SVN_FS_TYPE_FSFS) != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  /* Start with a repository in a format that predates the lock database,
+     so that older servers can still open it. */
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_COMPATIBLE_VERSION, "1.14.0");
+  SVN_ERR(svn_test__create_fs2(&fs, repo_name, opts, fs_config, pool));
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__create_greek_tree(txn_root, pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &newrev, txn, pool));
+  SVN_TEST_ASSERT(SVN_IS_VALID_REVNUM(newrev));
+
+  SVN_ERR(svn_fs_create_access(&access, "harry", pool));
+  SVN_ERR(svn_fs_set_access(fs, access));
+
+  /* Put two locks into the digest file tree.  Enabling the lock database
+     has no effect on that format. */
+  SVN_ERR(svn_io_file_create(conf_path,
+                             "[locks]\nenable-lock-db = true\n", pool));
+  SVN_ERR(svn_fs_open2(&fs, repo_name, NULL, pool, pool));
+  SVN_ERR(svn_fs_set_access(fs, access));
+  SVN_ERR(svn_fs_lock(&lock, fs, "/A/D/G/rho", NULL, "", FALSE, 0,
+                      SVN_INVALID_REVNUM, FALSE, pool));
+  SVN_ERR(svn_fs_lock(&lock, fs, "/A/D/gamma", NULL, "", FALSE, 0,
+                      SVN_INVALID_REVNUM, FALSE, pool));
+
+  SVN_ERR(svn_io_check_path(svn_dirent_join(repo_name, "locks.db", pool),
+                            &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_none);
+  SVN_ERR(svn_io_check_path(svn_dirent_join(repo_name, "locks", pool),
+                            &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_dir);
+
+  /* After an upgrade, the next lock operation migrates them into the
+     lock database. */
+  SVN_ERR(svn_fs_upgrade2(repo_name, NULL, NULL, NULL, NULL, pool));
+  SVN_ERR(svn_fs_open2(&fs, repo_name, NULL, pool, pool));
+  SVN_ERR(svn_fs_set_access(fs, access));
+  SVN_ERR(svn_fs_lock(&lock, fs, "/A/D/H/psi", NULL, "comment", FALSE, 0,
+                      SVN_INVALID_REVNUM, FALSE, pool));
+
+  SVN_ERR(svn_io_check_path(svn_dirent_join(repo_name, "locks.db", pool),
+                            &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_file);
+  SVN_ERR(svn_io_check_path(svn_dirent_join(repo_name, "locks", pool),
+                            &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_none);
+
+  /* An existing database is used regardless of the configuration. */
+  SVN_ERR(svn_io_file_create(conf_path,
+                             "[locks]\nenable-lock-db = false\n", pool));
+  SVN_ERR(svn_fs_open2(&fs, repo_name, NULL, pool, pool));
+  SVN_ERR(svn_fs_set_access(fs, access));
+
+  SVN_ERR(count_locks(&count, fs, "/", svn_depth_infinity, pool));
+  SVN_TEST_INT_ASSERT(count, 3);
+  SVN_ERR(count_locks(&count, fs, "/A/D", svn_depth_immediates, pool));
+  SVN_TEST_INT_ASSERT(count, 1);
+  SVN_ERR(count_locks(&count, fs, "/A/D/G", svn_depth_infinity, pool));
+  SVN_TEST_INT_ASSERT(count, 1);
+  SVN_ERR(count_locks(&count, fs, "/A/D/G/rho", svn_depth_empty, pool));
+  SVN_TEST_INT_ASSERT(count, 1);
+  SVN_ERR(count_locks(&count, fs, "/A/B", svn_depth_infinity, pool));
+  SVN_TEST_INT_ASSERT(count, 0);
+
+  SVN_ERR(svn_fs_get_lock(&lock, fs, "/A/D/H/psi", pool));
+  SVN_TEST_ASSERT(lock);
+  SVN_TEST_STRING_ASSERT(lock->owner, "harry");
+  SVN_TEST_STRING_ASSERT(lock->comment, "comment");
+  SVN_TEST_ASSERT(lock->expiration_date == 0);
+
+  /* Unlocking removes the entry from the database. */
+  SVN_ERR(svn_fs_get_lock(&lock, fs, "/A/D/gamma", pool));
+  SVN_TEST_ASSERT(lock);
+  SVN_ERR(svn_fs_unlock(fs, "/A/D/gamma", lock->token, FALSE, pool));
+  SVN_ERR(svn_fs_get_lock(&lock, fs, "/A/D/gamma", pool));
+  SVN_TEST_ASSERT(!lock);
+  SVN_ERR(count_locks(&count, fs, "/", svn_depth_infinity, pool));
+  SVN_TEST_INT_ASSERT(count, 2);
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *DIGEST_PATH to the path of the FSFS lock digest file for PATH in
+   the repository at REPO_NAME.  Allocate the result in POOL. */
+static svn_error_t *
+get_digest_path(const char **digest_path,
+                const char *repo_name,
+                const char *path,
+                apr_pool_t *pool)
+{
+  svn_checksum_t *checksum;
+  const char *digest;
+
+  SVN_ERR(svn_checksum(&checksum, svn_checksum_md5, path, strlen(path),
+                       pool));
+  digest = svn_checksum_to_cstring_display(checksum, pool);
+  *digest_path = svn_dirent_join_many(pool, repo_name, "locks",
+                                      apr_pstrmemdup(pool, digest, 3),
+                                      digest, SVN_VA_NULL);
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *HASH to the contents of the FSFS lock digest file for PATH in the
+   repository at REPO_NAME, or to NULL if that digest file does not
+   exist.  Allocate the result in POOL. */
+static svn_error_t *
+read_digest_hash(apr_hash_t **hash,
+                 const char *repo_name,
+                 const char *path,
+                 apr_pool_t *pool)
+{
+  const char *digest_path;
+  svn_node_kind_t kind;
+  svn_stream_t *stream;
+
+  SVN_ERR(get_digest_path(&digest_path, repo_name, path, pool));
+  SVN_ERR(svn_io_check_path(digest_path, &kind, pool));
+  if (kind == svn_node_none)
+    {
+      *hash = NULL;
+      return SVN_NO_ERROR;
+    }
+
+  *hash = apr_hash_make(pool);
+  SVN_ERR(svn_stream_open_readonly(&stream, digest_path, pool, pool));
+  SVN_ERR(svn_hash_read2(*hash, stream, SVN_HASH_TERMINATOR, pool));
+  SVN_ERR(svn_stream_close(stream));
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *COUNT to the number of children listed in the FSFS lock digest
+   file for PATH in the repository at REPO_NAME, or to -1 if that digest
+   file does not exist. */
+static svn_error_t *
+count_digest_children(int *count,
+                      const char *repo_name,
+                      const char *path,
+                      apr_pool_t *pool)
+{
+  apr_hash_t *hash;
+  svn_string_t *children;
+
+  SVN_ERR(read_digest_hash(&hash, repo_name, path, pool));
+  if (!hash)
+    {
+      *count = -1;
+      return SVN_NO_ERROR;
+    }
+
+  children = svn_hash_gets(hash, "children");
+  *count = children
+         ? svn_cstring_split(children->data, "\n", TRUE, pool)->nelts
+         : 0;
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *COUNT to the number of FSFS lock digest files in the repository
+   at REPO_NAME. */
+static svn_error_t *
+count_digest_files(int *count,
+                   const char *repo_name,
+                   apr_pool_t *pool)
+{
+  const char *locks_dir = svn_dirent_join(repo_name, "locks", pool);
+  apr_hash_t *subdirs;
+  apr_hash_index_t *hi;
+
+  *count = 0;
+  SVN_ERR(svn_io_get_dirents3(&subdirs, locks_dir, TRUE, pool, pool));
+  for (hi = apr_hash_first(pool, subdirs); hi; hi = apr_hash_next(hi))
+    {
+      apr_hash_t *files;
+
+      SVN_ERR(svn_io_get_dirents3(&files,
+                                  svn_dirent_join(locks_dir,
+                                                  apr_hash_this_key(hi),
+                                                  pool),
+                                  TRUE, pool, pool));
+      *count += apr_hash_count(files);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Add a key unknown to FSFS to the lock digest file for PATH in the
+   repository at REPO_NAME.  FSFS ignores that key when reading the file
+   and drops it whenever it rewrites the file. */
+static svn_error_t *
+mark_digest_file(const char *repo_name,
+                 const char *path,
+                 apr_pool_t *pool)
+{
+  const char *digest_path;
+  apr_hash_t *hash;
+  svn_stream_t *stream;
+
+  SVN_ERR(read_digest_hash(&hash, repo_name, path, pool));
+  SVN_TEST_ASSERT(hash);
+  svn_hash_sets(hash, "test-marker", svn_string_create("1", pool));
+
+  SVN_ERR(get_digest_path(&digest_path, repo_name, path, pool));
+  SVN_ERR(svn_io_remove_file2(digest_path, FALSE, pool));
+  SVN_ERR(svn_stream_open_writable(&stream, digest_path, pool, pool));
+  SVN_ERR(svn_hash_write2(hash, stream, SVN_HASH_TERMINATOR, pool));
+  SVN_ERR(svn_stream_close(stream));
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *MARKED to whether the lock digest file for PATH in the repository
+   at REPO_NAME still has the key added by mark_digest_file(). */
+static svn_error_t *
+is_digest_file_marked(svn_boolean_t *marked,
+                      const char *repo_name,
+                      const char *path,
+                      apr_pool_t *pool)
+{
+  apr_hash_t *hash;
+
+  SVN_ERR(read_digest_hash(&hash, repo_name, path, pool));
+  *marked = hash && svn_hash_gets(hash, "test-marker");
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+lock_many_digests(const svn_test_opts_t *opts,
+                  apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_access_t *access;
+  svn_fs_lock_target_t *target;
+  apr_hash_t *lock_paths = apr_hash_make(pool);
+  apr_hash_t *unlock_paths = apr_hash_make(pool);
+  svn_revnum_t newrev;
+  svn_lock_t *lock;
+  int count;
+  svn_boolean_t marked;
+  apr_size_t i;
+  const char *parents[] = { "/", "/A", "/A/D", "/A/D/G" };
+  const char *repo_name = "test-repo-lock-many-digests";
+
+  /* The digest file layout is specific to FSFS. */
+  if (strcmp(opts->fs_type, SVN_FS_TYPE_FSFS) != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  SVN_ERR(create_greek_fs(&fs, &newrev, repo_name, opts, pool));
+  SVN_ERR(svn_fs_create_access(&access, "harry", pool));
+  SVN_ERR(svn_fs_set_access(fs, access));
+
+  /* Lock files in several directories in a single batch. */
+  target = svn_fs_lock_target_create(NULL, newrev, pool);
+  svn_hash_sets(lock_paths, "/A/D/G/pi", target);
+  svn_hash_sets(lock_paths, "/A/D/G/rho", target);
+  svn_hash_sets(lock_paths, "/A/D/H/psi", target);
+  svn_hash_sets(lock_paths, "/A/mu", target);
+  SVN_ERR(svn_fs_lock_many(fs, lock_paths, "", FALSE, 0, FALSE,
+                           NULL, NULL, pool, pool));
+
+  /* Every parent lists all locked descendants. */
+  SVN_ERR(count_digest_children(&count, repo_name, "/", pool));
+  SVN_TEST_INT_ASSERT(count, 4);
+  SVN_ERR(count_digest_children(&count, repo_name, "/A", pool));
+  SVN_TEST_INT_ASSERT(count, 4);
+  SVN_ERR(count_digest_children(&count, repo_name, "/A/D", pool));
+  SVN_TEST_INT_ASSERT(count, 3);
+  SVN_ERR(count_digest_children(&count, repo_name, "/A/D/G", pool));
+  SVN_TEST_INT_ASSERT(count, 2);
+  SVN_ERR(count_locks(&count, fs, "/A/D", svn_depth_infinity, pool));
+  SVN_TEST_INT_ASSERT(count, 3);
+
+  /* One digest file per lock and one per parent directory. */
+  SVN_ERR(count_digest_files(&count, repo_name, pool));
+  SVN_TEST_INT_ASSERT(count, 9);
+
+  /* Stealing locks that the parents already list must only rewrite the
+     digest files of the locked paths themselves. */
+  for (i = 0; i < sizeof(parents) / sizeof(parents[0]); ++i)
+    SVN_ERR(mark_digest_file(repo_name, parents[i], pool));
+  SVN_ERR(mark_digest_file(repo_name, "/A/mu", pool));
+
+  apr_hash_clear(lock_paths);
+  svn_hash_sets(lock_paths, "/A/D/G/pi", target);
+  svn_hash_sets(lock_paths, "/A/mu", target);
+  SVN_ERR(svn_fs_lock_many(fs, lock_paths, "", FALSE, 0, TRUE,
+                           NULL, NULL, pool, pool));
+
+  for (i = 0; i < sizeof(parents) / sizeof(parents[0]); ++i)
+    {
+      SVN_ERR(is_digest_file_marked(&marked, repo_name, parents[i], pool));
+      SVN_TEST_ASSERT(marked);
+    }
+  SVN_ERR(is_digest_file_marked(&marked, repo_name, "/A/mu", pool));
+  SVN_TEST_ASSERT(!marked);
+  SVN_ERR(count_digest_files(&count, repo_name, pool));
+  SVN_TEST_INT_ASSERT(count, 9);
+
+  /* Unlock a batch that empties /A/D/G and /A/D/H. */
+  SVN_ERR(svn_fs_get_lock(&lock, fs, "/A/D/G/pi", pool));
+  svn_hash_sets(unlock_paths, "/A/D/G/pi", lock->token);
+  SVN_ERR(svn_fs_get_lock(&lock, fs, "/A/D/G/rho", pool));
+  svn_hash_sets(unlock_paths, "/A/D/G/rho", lock->token);
+  SVN_ERR(svn_fs_get_lock(&lock, fs, "/A/D/H/psi", pool));
+  svn_hash_sets(unlock_paths, "/A/D/H/psi", lock->token);
+  SVN_ERR(svn_fs_unlock_many(fs, unlock_paths, FALSE, NULL, NULL,
+                             pool, pool));
+
+  SVN_ERR(count_digest_children(&count, repo_name, "/", pool));
+  SVN_TEST_INT_ASSERT(count, 1);
+  SVN_ERR(count_digest_children(&count, repo_name, "/A", pool));
+  SVN_TEST_INT_ASSERT(count, 1);
+  SVN_ERR(count_digest_children(&count, repo_name, "/A/D", pool));
+  SVN_TEST_INT_ASSERT(count, -1);
+  SVN_ERR(count_digest_children(&count, repo_name, "/A/D/G", pool));
+  SVN_TEST_INT_ASSERT(count, -1);
+  SVN_ERR(count_digest_children(&count, repo_name, "/A/D/G/pi", pool));
+  SVN_TEST_INT_ASSERT(count, -1);
+  SVN_ERR(count_locks(&count, fs, "/", svn_depth_infinity, pool));
+  SVN_TEST_INT_ASSERT(count, 1);
+
+  /* Only the digest files of /, /A and /A/mu are left. */
+  SVN_ERR(count_digest_files(&count, repo_name, pool));
+  SVN_TEST_INT_ASSERT(count, 3);
+
+  return SVN_NO_ERROR;
+}
+
 /* ------------------------------------------------------------------------ */
 
 /* The test table.  */
@@ -1253,6 +1625,10 @@ static struct svn_test_descriptor_t test_funcs[] =
                        "lock/unlock when 'write-lock' couldn't be obtained"),
     SVN_TEST_OPTS_PASS(parent_and_child_lock,
                        "lock parent and it's child"),
+    SVN_TEST_OPTS_PASS(lock_db_migration,
+                       "migrate locks into the lock database"),
+    SVN_TEST_OPTS_PASS(lock_many_digests,
+                       "batched lock digest updates"),
     SVN_TEST_NULL
   };
 
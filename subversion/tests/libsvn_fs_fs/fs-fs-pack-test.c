@@ -37,6 +37,7 @@
 #include "svn_props.h"
 #include "svn_fs.h"
 #include "private/svn_string_private.h"
+#include "private/svn_subr_private.h"
 
 #include "../svn_test_fs.h"
 
@@ -417,6 +418,133 @@ read_packed_fs(const svn_test_opts_t *opts,
 #undef SHARD_SIZE
 #undef MAX_REV
 
+/* ------------------------------------------------------------------------ */
+#define REPO_NAME "test-repo-read-mapped-packed-fs"
+#define SHARD_SIZE 5
+#define MAX_REV 11
+static svn_error_t *
+read_mapped_packed_fs(const svn_test_opts_t *opts,
+                      apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  fs_fs_data_t *ffd;
+  apr_hash_t *fs_config;
+  svn_revnum_t i;
+
+  SVN_ERR(create_packed_filesystem(REPO_NAME, opts, MAX_REV, SHARD_SIZE, pool));
+
+  /* Use block-read and disjoint caches to make sure that we actually
+   * read index and item data from the mapped pack files. */
+  fs_config = apr_hash_make(pool);
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_CACHE_NS,
+                           svn_uuid_generate(pool));
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_BLOCK_READ, "1");
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, fs_config, pool, pool));
+
+  ffd = fs->fsap_data;
+  if (!ffd->use_log_addressing)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "mapped pack files require log addressing");
+
+  ffd->mmap_pack_files = TRUE;
+
+  for (i = 1; i < (MAX_REV + 1); i++)
+    {
+      svn_fs_root_t *rev_root;
+      svn_stream_t *rstream;
+      svn_stringbuf_t *rstring;
+      apr_hash_t *entries;
+      const char *expected;
+
+      SVN_ERR(svn_fs_revision_root(&rev_root, fs, i, pool));
+      SVN_ERR(svn_fs_dir_entries(&entries, rev_root, "/A/D/G", pool));
+      SVN_TEST_ASSERT(apr_hash_count(entries) == 3);
+
+      SVN_ERR(svn_fs_file_contents(&rstream, rev_root, "iota", pool));
+      SVN_ERR(svn_test__stream_to_string(&rstring, rstream, pool));
+
+      expected = (i == 1) ? "This is the file 'iota'.\n"
+                          : get_rev_contents(i, pool);
+      SVN_TEST_STRING_ASSERT(rstring->data, expected);
+    }
+
+  return SVN_NO_ERROR;
+}
+#undef REPO_NAME
+#undef SHARD_SIZE
+#undef MAX_REV
+
+/* ------------------------------------------------------------------------ */
+#define REPO_NAME "test-repo-read-ahead-packed-fs"
+#define SHARD_SIZE 5
+#define MAX_REV 20
+static svn_error_t *
+read_ahead_packed_fs(const svn_test_opts_t *opts,
+                     apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  fs_fs_data_t *ffd;
+  apr_hash_t *fs_config;
+  svn_revnum_t i;
+  svn_fs_fs__ioctl_get_read_ahead_stats_output_t *output;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  SVN_ERR(create_packed_filesystem(REPO_NAME, opts, MAX_REV, SHARD_SIZE, pool));
+
+  /* Use block-read and disjoint caches such that all data has to be read
+   * from disk. */
+  fs_config = apr_hash_make(pool);
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_CACHE_NS,
+                           svn_uuid_generate(pool));
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_BLOCK_READ, "1");
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, fs_config, pool, pool));
+
+  ffd = fs->fsap_data;
+  if (!ffd->use_log_addressing)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "read-ahead requires log addressing");
+
+  ffd->block_read_ahead = 4;
+
+  /* Walk the changed paths lists like 'svn log -v' does.  r1 is special
+   * as it adds the whole Greek tree. */
+  for (i = MAX_REV; i > 1; i--)
+    {
+      svn_fs_root_t *rev_root;
+      svn_fs_path_change_iterator_t *iterator;
+      svn_fs_path_change3_t *change;
+      int count = 0;
+
+      svn_pool_clear(iterpool);
+
+      SVN_ERR(svn_fs_revision_root(&rev_root, fs, i, iterpool));
+      SVN_ERR(svn_fs_paths_changed3(&iterator, rev_root, iterpool, iterpool));
+      SVN_ERR(svn_fs_path_change_get(&change, iterator));
+      while (change)
+        {
+          ++count;
+          SVN_ERR(svn_fs_path_change_get(&change, iterator));
+        }
+
+      SVN_TEST_ASSERT(count == 1);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  /* Some of the changes lists must have been read ahead in time. */
+  SVN_ERR(svn_fs_ioctl(fs, SVN_FS_FS__IOCTL_GET_READ_AHEAD_STATS,
+                       NULL, (void **)&output, NULL, NULL, pool, pool));
+  SVN_TEST_ASSERT(output->stats.requests > 0);
+  SVN_TEST_ASSERT(output->stats.blocks_prefetched > 0);
+  SVN_TEST_ASSERT(output->stats.hits > 0);
+  SVN_TEST_ASSERT(output->stats.requests < MAX_REV - 1);
+
+  return SVN_NO_ERROR;
+}
+#undef REPO_NAME
+#undef SHARD_SIZE
+#undef MAX_REV
+
 /* ------------------------------------------------------------------------ */
 #define REPO_NAME "test-repo-commit-packed-fs"
 #define SHARD_SIZE 5
@@ -1812,6 +1940,113 @@ pack_with_limited_memory(const svn_test_opts_t *opts,
 #undef MAX_REV
 #undef SHARD_SIZE
 
+/* ------------------------------------------------------------------------ */
+/* Verify that packing still produces the right result if the external
+   sorts of the pack code have to spill several runs to disk and merge
+   them.  With a 512 kB budget, a range gets about 2400 items on 64 bit
+   systems and each sorter keeps a quarter of that in memory.  The shard
+   has about 1800 items, i.e. sorting them for the L2P index spills three
+   runs. */
+#define REPO_NAME "test-repo-pack-with-spilled-sort-runs"
+#define SHARD_SIZE 4
+#define MAX_REV (SHARD_SIZE - 1)
+#define FILE_COUNT 200
+static svn_error_t *
+pack_with_spilled_sort_runs(const svn_test_opts_t *opts,
+                            apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *root;
+  svn_revnum_t rev;
+  svn_node_kind_t kind;
+  apr_hash_t *fs_config;
+  int i;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  if (opts->server_minor_version && (opts->server_minor_version < 9))
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "pre-1.9 SVN doesn't support reordering packs");
+
+  fs_config = apr_hash_make(pool);
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_SHARD_SIZE,
+                apr_itoa(pool, SHARD_SIZE));
+  SVN_ERR(svn_test__create_fs2(&fs, REPO_NAME, opts, fs_config, pool));
+
+  /* Revision 1 adds the files, all further revisions modify their
+     contents as well as their properties.  That gives us 3 items per
+     file and revision. */
+  for (rev = 0; rev < MAX_REV; )
+    {
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, iterpool));
+      SVN_ERR(svn_fs_txn_root(&root, txn, iterpool));
+      for (i = 0; i < FILE_COUNT; ++i)
+        {
+          const char *path = apr_psprintf(iterpool, "file-%d", i);
+          if (rev == 0)
+            SVN_ERR(svn_fs_make_file(root, path, iterpool));
+
+          SVN_ERR(svn_test__set_file_contents(root, path,
+                      apr_psprintf(iterpool, "%s in r%ld\n", path, rev + 1),
+                      iterpool));
+          SVN_ERR(svn_fs_change_node_prop(root, path, "prop",
+                      svn_string_createf(iterpool, "r%ld", rev + 1),
+                      iterpool));
+        }
+
+      SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, iterpool));
+    }
+
+  /* Pack the shard with a budget that holds it in a single range but
+     makes the sorters spill. */
+  SVN_ERR(svn_fs_fs__pack(fs, 512 * 1024, NULL, NULL, NULL, NULL, pool));
+  SVN_ERR(svn_io_check_path(svn_dirent_join_many(pool, REPO_NAME, "revs",
+                                                 "0.pack", SVN_VA_NULL),
+                            &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_dir);
+
+  /* Every item must still be found at its new location. */
+  SVN_ERR(svn_fs_verify(REPO_NAME, NULL, 0, MAX_REV, NULL, NULL, NULL, NULL,
+                        pool));
+
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  for (rev = 1; rev <= MAX_REV; ++rev)
+    for (i = 0; i < FILE_COUNT; ++i)
+      {
+        const char *path;
+        svn_stringbuf_t *contents;
+        svn_string_t *value;
+
+        svn_pool_clear(iterpool);
+        path = apr_psprintf(iterpool, "file-%d", i);
+        SVN_ERR(svn_fs_revision_root(&root, fs, rev, iterpool));
+        SVN_ERR(svn_test__get_file_contents(root, path, &contents,
+                                            iterpool));
+        SVN_TEST_STRING_ASSERT(contents->data,
+                               apr_psprintf(iterpool, "%s in r%ld\n",
+                                            path, rev));
+
+        SVN_ERR(svn_fs_node_prop(&value, root, path, "prop", iterpool));
+        SVN_TEST_ASSERT(value != NULL);
+        SVN_TEST_STRING_ASSERT(value->data,
+                               apr_psprintf(iterpool, "r%ld", rev));
+      }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+#undef REPO_NAME
+#undef MAX_REV
+#undef SHARD_SIZE
+#undef FILE_COUNT
+
 /* ------------------------------------------------------------------------ */
 
 #define REPO_NAME "test-repo-large_delta_against_plain"
@@ -1889,6 +2124,337 @@ large_delta_against_plain(const svn_test_opts_t *opts,
 #undef REPO_NAME
 
 
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-long_delta_chain_cold_read"
+#define SHARD_SIZE 4
+#define MAX_REV 17
+
+/* Return the contents of the multi-window file used by
+   long_delta_chain_cold_read in revision REV.  Allocate it in POOL. */
+static svn_stringbuf_t *
+get_large_rev_contents(svn_revnum_t rev,
+                       apr_pool_t *pool)
+{
+  svn_stringbuf_t *contents = svn_stringbuf_create_empty(pool);
+  int i;
+
+  /* Spread changes over more than 3 txdelta windows such that every
+     chunk of the reconstruction has to walk the full delta chain. */
+  for (i = 0; contents->len < 3 * 102400 + 1000; ++i)
+    svn_stringbuf_appendcstr(contents,
+                             apr_psprintf(pool, "line %d: %ld\n", i,
+                                          i % 997 ? 0 : rev));
+
+  return contents;
+}
+
+static svn_error_t *
+long_delta_chain_cold_read(const svn_test_opts_t *opts,
+                           apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *root;
+  svn_revnum_t rev;
+  apr_hash_t *fs_config;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL, NULL);
+
+  fs_config = apr_hash_make(pool);
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_SHARD_SIZE,
+                apr_itoa(pool, SHARD_SIZE));
+  SVN_ERR(svn_test__create_fs2(&fs, REPO_NAME, opts, fs_config, pool));
+
+  /* Revision 1 adds the file, all further revisions modify it. */
+  for (rev = 0; rev < MAX_REV; )
+    {
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, iterpool));
+      SVN_ERR(svn_fs_txn_root(&root, txn, iterpool));
+      if (rev == 0)
+        SVN_ERR(svn_fs_make_file(root, "large", iterpool));
+      SVN_ERR(svn_test__set_file_contents(root, "large",
+                    get_large_rev_contents(rev + 1, iterpool)->data,
+                    iterpool));
+      SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, iterpool));
+    }
+
+  /* Have the delta chains span packed as well as non-packed revs. */
+  SVN_ERR(svn_fs_pack(REPO_NAME, NULL, NULL, NULL, NULL, pool));
+
+  /* Use disjoint caches such that every chain has to be read from disk. */
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_CACHE_NS,
+                           svn_uuid_generate(pool));
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, fs_config, pool, pool));
+
+  for (rev = MAX_REV; rev > 0; --rev)
+    {
+      svn_stringbuf_t *contents;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_revision_root(&root, fs, rev, iterpool));
+      SVN_ERR(svn_test__get_file_contents(root, "large", &contents,
+                                          iterpool));
+      SVN_TEST_STRING_ASSERT(contents->data,
+                             get_large_rev_contents(rev, iterpool)->data);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+#undef SHARD_SIZE
+#undef MAX_REV
+
+/* ------------------------------------------------------------------------ */
+/* Verify that packing multiple shards concurrently produces a valid
+   repository and that shards are still being switched over in order. */
+#define REPO_NAME "test-repo-pack-concurrently"
+#define SHARD_SIZE 3
+#define MAX_REV (7 * SHARD_SIZE + 1)
+
+struct concurrent_pack_notify_baton
+{
+  /* Next shard that we expect to start resp. to end. */
+  apr_int64_t next_start;
+  apr_int64_t next_end;
+};
+
+/* Implements svn_fs_pack_notify_t for concurrent_pack_notify_baton. */
+static svn_error_t *
+concurrent_pack_notify(void *baton,
+                       apr_int64_t shard,
+                       svn_fs_pack_notify_action_t action,
+                       apr_pool_t *pool)
+{
+  struct concurrent_pack_notify_baton *pnb = baton;
+
+  switch (action)
+    {
+      case svn_fs_pack_notify_start:
+        SVN_TEST_ASSERT(shard == pnb->next_start);
+        pnb->next_start++;
+        break;
+
+      case svn_fs_pack_notify_end:
+        SVN_TEST_ASSERT(shard == pnb->next_end);
+        SVN_TEST_ASSERT(shard < pnb->next_start);
+        pnb->next_end++;
+        break;
+
+      default:
+        return svn_error_create(SVN_ERR_TEST_FAILED, NULL,
+                                "Unknown notification action when packing");
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+pack_concurrently(const svn_test_opts_t *opts,
+                  apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  apr_hash_t *fs_config;
+  struct concurrent_pack_notify_baton pnb = { 0 };
+  svn_revnum_t rev;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  SVN_ERR(create_non_packed_filesystem(REPO_NAME, opts, MAX_REV, SHARD_SIZE,
+                                       pool));
+
+  /* Pack with more shards than jobs. */
+  fs_config = apr_hash_make(pool);
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_PACK_JOBS, "3");
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, fs_config, pool, pool));
+  SVN_ERR(svn_fs_fs__pack(fs, 0, concurrent_pack_notify, &pnb, NULL, NULL,
+                          pool));
+
+  SVN_TEST_ASSERT(pnb.next_start == MAX_REV / SHARD_SIZE);
+  SVN_TEST_ASSERT(pnb.next_end == MAX_REV / SHARD_SIZE);
+
+  /* All complete shards must have been packed. */
+  SVN_ERR(svn_fs_fs__read_min_unpacked_rev(&rev, fs, pool));
+  SVN_TEST_ASSERT(rev == (MAX_REV / SHARD_SIZE) * SHARD_SIZE);
+
+  /* Read the contents back from a fresh instance. */
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  for (rev = 2; rev <= MAX_REV; ++rev)
+    {
+      svn_fs_root_t *root;
+      svn_stringbuf_t *contents;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_revision_root(&root, fs, rev, iterpool));
+      SVN_ERR(svn_test__get_file_contents(root, "iota", &contents,
+                                          iterpool));
+      SVN_TEST_STRING_ASSERT(contents->data,
+                             get_rev_contents(rev, iterpool));
+    }
+
+  SVN_ERR(svn_fs_verify(REPO_NAME, NULL, 0, MAX_REV, NULL, NULL, NULL, NULL,
+                        pool));
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+#undef SHARD_SIZE
+#undef MAX_REV
+
+/* ------------------------------------------------------------------------ */
+#define REPO_NAME "test-repo-packed-revprop-single-read"
+#define SHARD_SIZE 4
+#define MAX_REV 10
+
+/* Set *STORED to TRUE if the revprop pack file at PATH has been stored
+   without compression.  Use POOL for allocations. */
+static svn_error_t *
+is_stored_revprop_pack(svn_boolean_t *stored,
+                       const char *path,
+                       apr_pool_t *pool)
+{
+  svn_stringbuf_t *content;
+  const unsigned char *data, *p;
+  apr_uint64_t size;
+
+  SVN_ERR(svn_stringbuf_from_file2(&content, path, pool));
+  data = (const unsigned char *)content->data;
+  p = svn__decode_uint(&size, data, data + content->len);
+  SVN_TEST_ASSERT(p != NULL);
+  *stored = (size == content->len - (apr_size_t)(p - data));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_fs_upgrade_notify_t, counting the revprop shards that
+   got rewritten in the int pointed to by BATON. */
+static svn_error_t *
+count_revprop_shards(void *baton,
+                     apr_uint64_t number,
+                     svn_fs_upgrade_notify_action_t action,
+                     apr_pool_t *scratch_pool)
+{
+  int *count = baton;
+  if (action == svn_fs_upgrade_pack_revprops)
+    ++*count;
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+packed_revprop_single_read(const svn_test_opts_t *opts,
+                           apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_revnum_t rev;
+  svn_boolean_t stored;
+  int shards = 0;
+  apr_array_header_t *logs = apr_array_make(pool, MAX_REV + 1,
+                                            sizeof(const char *));
+  const char *conf_path = svn_dirent_join(REPO_NAME, PATH_CONFIG, pool);
+  const char *pack_path = svn_dirent_join_many(pool, REPO_NAME,
+                                               PATH_REVPROPS_DIR, "1.pack",
+                                               "4.0", SVN_VA_NULL);
+  const char *compressed_conf = "[" CONFIG_SECTION_PACKED_REVPROPS "]\n"
+                                CONFIG_OPTION_COMPRESS_PACKED_REVPROPS
+                                " = true\n";
+  const char *stored_conf = "[" CONFIG_SECTION_PACKED_REVPROPS "]\n"
+                            CONFIG_OPTION_COMPRESS_PACKED_REVPROPS
+                            " = false\n";
+
+  if (opts->server_minor_version && (opts->server_minor_version < 8))
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "pre-1.8 SVN doesn't support revprop packing");
+
+  /* Create packs with compressed revprops.  Make the log messages long
+     enough to be worth compressing. */
+  SVN_ERR(create_non_packed_filesystem(REPO_NAME, opts, MAX_REV, SHARD_SIZE,
+                                       pool));
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  for (rev = 1; rev <= MAX_REV; ++rev)
+    {
+      svn_string_t *log = large_log(rev, 2000, pool);
+      SVN_ERR(svn_fs_change_rev_prop2(fs, rev, SVN_PROP_REVISION_LOG, NULL,
+                                      log, pool));
+      APR_ARRAY_PUSH(logs, const char *) = log->data;
+    }
+
+  SVN_ERR(svn_io_write_atomic2(conf_path, compressed_conf,
+                               strlen(compressed_conf), NULL, FALSE, pool));
+  SVN_ERR(svn_fs_pack(REPO_NAME, NULL, NULL, NULL, NULL, pool));
+  SVN_ERR(is_stored_revprop_pack(&stored, pack_path, pool));
+  SVN_TEST_ASSERT(!stored);
+
+  /* Compressed packs must still be readable. */
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  for (rev = 1; rev <= MAX_REV; ++rev)
+    {
+      svn_string_t *value;
+      SVN_ERR(svn_fs_revision_prop2(&value, fs, rev, SVN_PROP_REVISION_LOG,
+                                    TRUE, pool, pool));
+      SVN_TEST_STRING_ASSERT(value->data,
+                             APR_ARRAY_IDX(logs, rev - 1, const char *));
+    }
+
+  /* Once compression is disabled, upgrade converts the packs. */
+  SVN_ERR(svn_io_write_atomic2(conf_path, stored_conf, strlen(stored_conf),
+                               NULL, FALSE, pool));
+  SVN_ERR(svn_fs_upgrade2(REPO_NAME, count_revprop_shards, &shards,
+                          NULL, NULL, pool));
+  SVN_TEST_INT_ASSERT(shards, 2);
+  SVN_ERR(is_stored_revprop_pack(&stored, pack_path, pool));
+  SVN_TEST_ASSERT(stored);
+
+  /* Read single revisions from the stored packs, with and without
+     the revprop cache being involved. */
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  for (rev = 1; rev <= MAX_REV; ++rev)
+    {
+      svn_string_t *value;
+      SVN_ERR(svn_fs_revision_prop2(&value, fs, rev, SVN_PROP_REVISION_LOG,
+                                    TRUE, pool, pool));
+      SVN_TEST_STRING_ASSERT(value->data,
+                             APR_ARRAY_IDX(logs, rev - 1, const char *));
+      SVN_ERR(svn_fs_revision_prop2(&value, fs, rev, SVN_PROP_REVISION_LOG,
+                                    FALSE, pool, pool));
+      SVN_TEST_STRING_ASSERT(value->data,
+                             APR_ARRAY_IDX(logs, rev - 1, const char *));
+    }
+
+  /* Modifying a revprop in a stored pack keeps the pack intact. */
+  SVN_ERR(svn_fs_change_rev_prop2(fs, 5, SVN_PROP_REVISION_LOG, NULL,
+                                  svn_string_create("changed", pool), pool));
+  for (rev = 4; rev <= 7; ++rev)
+    {
+      svn_string_t *value;
+      SVN_ERR(svn_fs_revision_prop2(&value, fs, rev, SVN_PROP_REVISION_LOG,
+                                    TRUE, pool, pool));
+      SVN_TEST_STRING_ASSERT(value->data,
+                             rev == 5
+                               ? "changed"
+                               : APR_ARRAY_IDX(logs, rev - 1, const char *));
+    }
+
+  /* Running upgrade again does not touch stored packs. */
+  shards = 0;
+  SVN_ERR(svn_fs_upgrade2(REPO_NAME, count_revprop_shards, &shards,
+                          NULL, NULL, pool));
+  SVN_TEST_INT_ASSERT(shards, 0);
+
+  return SVN_NO_ERROR;
+}
+#undef REPO_NAME
+#undef MAX_REV
+#undef SHARD_SIZE
+
+
 
 /* The test table.  */
 
@@ -1903,6 +2469,10 @@ static struct svn_test_descriptor_t test_funcs[] =
                        "pack FSFS where revs % shard = 0"),
     SVN_TEST_OPTS_PASS(read_packed_fs,
                        "read from a packed FSFS filesystem"),
+    SVN_TEST_OPTS_PASS(read_mapped_packed_fs,
+                       "read from memory-mapped FSFS pack files"),
+    SVN_TEST_OPTS_PASS(read_ahead_packed_fs,
+                       "read ahead while walking FSFS history"),
     SVN_TEST_OPTS_PASS(commit_packed_fs,
                        "commit to a packed FSFS filesystem"),
     SVN_TEST_OPTS_PASS(get_set_revprop_packed_fs,
@@ -1941,8 +2511,16 @@ static struct svn_test_descriptor_t test_funcs[] =
                        "compare empty PLAIN and non-existent reps"),
     SVN_TEST_OPTS_PASS(pack_with_limited_memory,
                        "pack with limited memory for metadata"),
+    SVN_TEST_OPTS_PASS(pack_with_spilled_sort_runs,
+                       "pack with external sorts spilling to disk"),
     SVN_TEST_OPTS_PASS(large_delta_against_plain,
                        "large deltas against PLAIN, issue #4658"),
+    SVN_TEST_OPTS_PASS(long_delta_chain_cold_read,
+                       "read long delta chains with cold caches"),
+    SVN_TEST_OPTS_PASS(pack_concurrently,
+                       "pack multiple shards concurrently"),
+    SVN_TEST_OPTS_PASS(packed_revprop_single_read,
+                       "read single revisions from revprop packs"),
     SVN_TEST_NULL
   };
 
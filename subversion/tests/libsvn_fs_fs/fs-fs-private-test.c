@@ -22,6 +22,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <apr_thread_proc.h>
 
 #include "../svn_test.h"
 
@@ -29,13 +30,21 @@
 #include "svn_pools.h"
 #include "svn_props.h"
 #include "svn_fs.h"
+#include "svn_delta.h"
+#include "svn_dirent_uri.h"
+#include "svn_mergeinfo.h"
 
 #include "private/svn_string_private.h"
+#include "private/svn_fs_private.h"
 #include "private/svn_fs_fs_private.h"
+#include "private/svn_sorts_private.h"
 #include "private/svn_subr_private.h"
 
+#include "../../libsvn_fs_fs/fs_fs.h"
 #include "../../libsvn_fs_fs/index.h"
+#include "../../libsvn_fs_fs/mergeinfo_index.h"
 #include "../../libsvn_fs_fs/rep-cache.h"
+#include "../../libsvn_fs_fs/transaction.h"
 #include "../../libsvn_fs/fs-loader.h"
 
 #include "../svn_test_fs.h"
@@ -274,6 +283,223 @@ get_repo_stats(const svn_test_opts_t *opts,
 
 /* ------------------------------------------------------------------------ */
 
+#define REPO_NAME "test-repo-incremental-stats"
+
+/* Implements svn_fs_progress_notify_func_t, appending REVISION to the
+   svn_revnum_t array given as BATON. */
+static void
+collect_progress(svn_revnum_t revision,
+                 void *baton,
+                 apr_pool_t *pool)
+{
+  apr_array_header_t *revisions = baton;
+  APR_ARRAY_PUSH(revisions, svn_revnum_t) = revision;
+}
+
+/* Verify that the histograms LHS and RHS are equal. */
+static svn_error_t *
+compare_histograms(const svn_fs_fs__histogram_t *lhs,
+                   const svn_fs_fs__histogram_t *rhs)
+{
+  SVN_TEST_ASSERT(memcmp(lhs, rhs, sizeof(*lhs)) == 0);
+  return SVN_NO_ERROR;
+}
+
+/* Verify that the repository statistics LHS and RHS are equal. */
+static svn_error_t *
+compare_stats(const svn_fs_fs__stats_t *lhs,
+              const svn_fs_fs__stats_t *rhs,
+              apr_pool_t *pool)
+{
+  apr_size_t i;
+  apr_hash_index_t *hi;
+
+  SVN_TEST_ASSERT(lhs->total_size == rhs->total_size);
+  SVN_TEST_ASSERT(lhs->revision_count == rhs->revision_count);
+  SVN_TEST_ASSERT(lhs->change_count == rhs->change_count);
+  SVN_TEST_ASSERT(lhs->change_len == rhs->change_len);
+
+  SVN_TEST_ASSERT(memcmp(&lhs->total_rep_stats, &rhs->total_rep_stats,
+                         sizeof(lhs->total_rep_stats)) == 0);
+  SVN_TEST_ASSERT(memcmp(&lhs->file_rep_stats, &rhs->file_rep_stats,
+                         sizeof(lhs->file_rep_stats)) == 0);
+  SVN_TEST_ASSERT(memcmp(&lhs->dir_rep_stats, &rhs->dir_rep_stats,
+                         sizeof(lhs->dir_rep_stats)) == 0);
+  SVN_TEST_ASSERT(memcmp(&lhs->file_prop_rep_stats,
+                         &rhs->file_prop_rep_stats,
+                         sizeof(lhs->file_prop_rep_stats)) == 0);
+  SVN_TEST_ASSERT(memcmp(&lhs->dir_prop_rep_stats, &rhs->dir_prop_rep_stats,
+                         sizeof(lhs->dir_prop_rep_stats)) == 0);
+  SVN_TEST_ASSERT(memcmp(&lhs->total_node_stats, &rhs->total_node_stats,
+                         sizeof(lhs->total_node_stats)) == 0);
+  SVN_TEST_ASSERT(memcmp(&lhs->file_node_stats, &rhs->file_node_stats,
+                         sizeof(lhs->file_node_stats)) == 0);
+  SVN_TEST_ASSERT(memcmp(&lhs->dir_node_stats, &rhs->dir_node_stats,
+                         sizeof(lhs->dir_node_stats)) == 0);
+
+  SVN_TEST_ASSERT(lhs->largest_changes->count
+                  == rhs->largest_changes->count);
+  for (i = 0; i < lhs->largest_changes->count; ++i)
+    {
+      svn_fs_fs__large_change_info_t *lhs_info
+        = lhs->largest_changes->changes[i];
+      svn_fs_fs__large_change_info_t *rhs_info
+        = rhs->largest_changes->changes[i];
+
+      SVN_TEST_ASSERT(lhs_info->size == rhs_info->size);
+      SVN_TEST_ASSERT(lhs_info->revision == rhs_info->revision);
+      SVN_TEST_STRING_ASSERT(lhs_info->path->data, rhs_info->path->data);
+    }
+
+  SVN_ERR(compare_histograms(&lhs->rep_size_histogram,
+                             &rhs->rep_size_histogram));
+  SVN_ERR(compare_histograms(&lhs->node_size_histogram,
+                             &rhs->node_size_histogram));
+  SVN_ERR(compare_histograms(&lhs->added_rep_size_histogram,
+                             &rhs->added_rep_size_histogram));
+  SVN_ERR(compare_histograms(&lhs->added_node_size_histogram,
+                             &rhs->added_node_size_histogram));
+  SVN_ERR(compare_histograms(&lhs->unused_rep_histogram,
+                             &rhs->unused_rep_histogram));
+  SVN_ERR(compare_histograms(&lhs->file_histogram, &rhs->file_histogram));
+  SVN_ERR(compare_histograms(&lhs->file_rep_histogram,
+                             &rhs->file_rep_histogram));
+  SVN_ERR(compare_histograms(&lhs->file_prop_histogram,
+                             &rhs->file_prop_histogram));
+  SVN_ERR(compare_histograms(&lhs->file_prop_rep_histogram,
+                             &rhs->file_prop_rep_histogram));
+  SVN_ERR(compare_histograms(&lhs->dir_histogram, &rhs->dir_histogram));
+  SVN_ERR(compare_histograms(&lhs->dir_rep_histogram,
+                             &rhs->dir_rep_histogram));
+  SVN_ERR(compare_histograms(&lhs->dir_prop_histogram,
+                             &rhs->dir_prop_histogram));
+  SVN_ERR(compare_histograms(&lhs->dir_prop_rep_histogram,
+                             &rhs->dir_prop_rep_histogram));
+
+  SVN_TEST_ASSERT(apr_hash_count(lhs->by_extension)
+                  == apr_hash_count(rhs->by_extension));
+  for (hi = apr_hash_first(pool, lhs->by_extension);
+       hi;
+       hi = apr_hash_next(hi))
+    {
+      svn_fs_fs__extension_info_t *lhs_info = apr_hash_this_val(hi);
+      svn_fs_fs__extension_info_t *rhs_info
+        = svn_hash_gets(rhs->by_extension, lhs_info->extension);
+
+      SVN_TEST_ASSERT(rhs_info);
+      SVN_ERR(compare_histograms(&lhs_info->rep_histogram,
+                                 &rhs_info->rep_histogram));
+      SVN_ERR(compare_histograms(&lhs_info->node_histogram,
+                                 &rhs_info->node_histogram));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+incremental_stats(const svn_test_opts_t *opts,
+                  apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root;
+  svn_fs_root_t *rev_root;
+  svn_revnum_t rev;
+  svn_node_kind_t kind;
+  svn_fs_fs__stats_t *expected;
+  svn_fs_fs__stats_t *stats;
+  apr_hash_t *fs_config = apr_hash_make(pool);
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_array_header_t *progress = apr_array_make(pool, 4,
+                                                sizeof(svn_revnum_t));
+  const char *state_dir = svn_dirent_join(REPO_NAME, "stats-state", pool);
+  const char *state_file = svn_dirent_join(state_dir, "1.stats", pool);
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  if (opts->server_minor_version && (opts->server_minor_version < 6))
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "pre-1.6 SVN doesn't support FSFS packing");
+
+  /* Use shards of 3 revisions.  Add the Greek tree in r1 and modify iota
+     up to r9. */
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_SHARD_SIZE, "3");
+  SVN_ERR(svn_test__create_fs2(&fs, REPO_NAME, opts, fs_config, pool));
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__create_greek_tree(txn_root, pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+  SVN_TEST_INT_ASSERT(rev, 1);
+
+  for (rev = 2; rev <= 9; ++rev)
+    {
+      svn_revnum_t new_rev;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_begin_txn(&txn, fs, rev - 1, iterpool));
+      SVN_ERR(svn_fs_txn_root(&txn_root, txn, iterpool));
+      SVN_ERR(svn_test__set_file_contents(txn_root, "iota",
+                                          apr_psprintf(iterpool,
+                                                       "iota in r%ld\n",
+                                                       rev),
+                                          iterpool));
+      SVN_ERR(svn_fs_commit_txn(NULL, &new_rev, txn, iterpool));
+      SVN_TEST_INT_ASSERT(new_rev, rev);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  /* Copy a tree in r10, so its nodes reference reps from the first shard.
+     Leave the last shard non-packed. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 9, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_revision_root(&rev_root, fs, 1, pool));
+  SVN_ERR(svn_fs_copy(rev_root, "A", txn_root, "A2", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+  SVN_TEST_INT_ASSERT(rev, 10);
+  SVN_ERR(svn_fs_pack(REPO_NAME, NULL, NULL, NULL, NULL, pool));
+
+  /* Single-threaded scan without any state. */
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  SVN_ERR(svn_fs_fs__get_stats(&expected, fs, 1, NULL, collect_progress,
+                               progress, NULL, NULL, pool, pool));
+  SVN_TEST_ASSERT(expected->revision_count == 11);
+
+  /* One notification per shard, in order. */
+  SVN_TEST_INT_ASSERT(progress->nelts, 4);
+  SVN_TEST_INT_ASSERT(APR_ARRAY_IDX(progress, 0, svn_revnum_t), 0);
+  SVN_TEST_INT_ASSERT(APR_ARRAY_IDX(progress, 3, svn_revnum_t), 9);
+
+  /* Concurrent scan, creating the state. */
+  SVN_ERR(svn_fs_fs__get_stats(&stats, fs, 3, state_dir, NULL, NULL,
+                               NULL, NULL, pool, pool));
+  SVN_ERR(compare_stats(expected, stats, pool));
+  SVN_ERR(svn_io_check_path(state_file, &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_file);
+
+  /* Reusing that state. */
+  SVN_ERR(svn_fs_fs__get_stats(&stats, fs, 3, state_dir, NULL, NULL,
+                               NULL, NULL, pool, pool));
+  SVN_ERR(compare_stats(expected, stats, pool));
+
+  /* Single-threaded scan with partial state. */
+  SVN_ERR(svn_io_remove_file2(state_file, FALSE, pool));
+  SVN_ERR(svn_fs_fs__get_stats(&stats, fs, 1, state_dir, NULL, NULL,
+                               NULL, NULL, pool, pool));
+  SVN_ERR(compare_stats(expected, stats, pool));
+  SVN_ERR(svn_io_check_path(state_file, &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_file);
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+
+/* ------------------------------------------------------------------------ */
+
 #define REPO_NAME "test-repo-dump-index-test"
 
 typedef struct dump_baton_t
@@ -499,6 +725,806 @@ build_rep_cache(const svn_test_opts_t *opts, apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-history-index"
+
+/* Set *LOCATIONS to the space-separated list of PATH@REV entries that
+   the history of PATH@REVISION in FS reports, following copies only
+   if CROSS_COPIES is set.  Allocate the result in POOL. */
+static svn_error_t *
+get_history_locations(const char **locations,
+                      svn_fs_t *fs,
+                      const char *path,
+                      svn_revnum_t revision,
+                      svn_boolean_t cross_copies,
+                      apr_pool_t *pool)
+{
+  svn_stringbuf_t *result = svn_stringbuf_create_empty(pool);
+  svn_fs_root_t *root;
+  svn_fs_history_t *history;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  SVN_ERR(svn_fs_revision_root(&root, fs, revision, pool));
+  SVN_ERR(svn_fs_node_history2(&history, root, path, pool, pool));
+  while (TRUE)
+    {
+      const char *history_path;
+      svn_revnum_t history_rev;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_history_prev2(&history, history, cross_copies,
+                                   pool, iterpool));
+      if (!history)
+        break;
+
+      SVN_ERR(svn_fs_history_location(&history_path, &history_rev, history,
+                                      iterpool));
+      if (result->len)
+        svn_stringbuf_appendbyte(result, ' ');
+      svn_stringbuf_appendcstr(result,
+                               apr_psprintf(iterpool, "%s@%ld",
+                                            history_path, history_rev));
+    }
+
+  svn_pool_destroy(iterpool);
+  *locations = result->data;
+
+  return SVN_NO_ERROR;
+}
+
+/* Verify that the history index is written on commit and that history
+   walks through it match those of an instance that does not use it,
+   across copies, replacements and file copies. */
+static svn_error_t *
+history_index(const svn_test_opts_t *opts,
+              apr_pool_t *pool)
+{
+  svn_fs_t *fs, *plain_fs;
+  fs_fs_data_t *ffd;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root, *rev_root;
+  svn_revnum_t rev;
+  svn_node_kind_t kind;
+  const char *indexed, *plain;
+  apr_size_t i;
+  const char *paths[] = { "/iota", "/mu2", "/A", "/A/mu", "/B", "/B/mu",
+                          "/B/D", "/B/D/gamma", "/B/D/G/rho", "/B/E/beta" };
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  SVN_ERR(svn_test__create_fs(&fs, REPO_NAME, opts, pool));
+  ffd = fs->fsap_data;
+  ffd->history_index_enabled = TRUE;
+
+  /* r1: Greek tree. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__create_greek_tree(txn_root, pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r2: Plain modifications. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/A/mu", "r2\n", pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/iota", "r2\n", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r3: Branch /A to /B. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_revision_root(&rev_root, fs, rev, pool));
+  SVN_ERR(svn_fs_copy(rev_root, "/A", txn_root, "/B", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r4: Modify both branches. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/A/mu", "r4\n", pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/B/mu", "r4\n", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r5: Copy a single file and modify something else. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_revision_root(&rev_root, fs, rev, pool));
+  SVN_ERR(svn_fs_copy(rev_root, "/B/mu", txn_root, "/mu2", pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/B/D/G/rho", "r5\n",
+                                      pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r6: Replace /iota without history. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_delete(txn_root, "/iota", pool));
+  SVN_ERR(svn_fs_make_file(txn_root, "/iota", pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/iota", "r6\n", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r7: Replace /B/D with a copy and modify it in the same revision. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_revision_root(&rev_root, fs, rev, pool));
+  SVN_ERR(svn_fs_delete(txn_root, "/B/D", pool));
+  SVN_ERR(svn_fs_copy(rev_root, "/A/D", txn_root, "/B/D", pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/B/D/gamma", "r7\n",
+                                      pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r8: Modify the file copy. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/mu2", "r8\n", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  SVN_ERR(svn_io_check_path(svn_dirent_join(REPO_NAME, PATH_HISTORY_INDEX_DB,
+                                            pool),
+                            &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_file);
+
+  SVN_ERR(get_history_locations(&indexed, fs, "/mu2", rev, TRUE, pool));
+  SVN_TEST_STRING_ASSERT(indexed,
+                         "/mu2@8 /mu2@5 /B/mu@4 /B/mu@3 /A/mu@2 /A/mu@1");
+  SVN_ERR(get_history_locations(&indexed, fs, "/iota", rev, TRUE, pool));
+  SVN_TEST_STRING_ASSERT(indexed, "/iota@6");
+
+  /* A fresh instance does not use the index.  Both must agree. */
+  SVN_ERR(svn_fs_open2(&plain_fs, REPO_NAME, NULL, pool, pool));
+  ffd = plain_fs->fsap_data;
+  SVN_TEST_ASSERT(!ffd->history_index_enabled);
+
+  for (i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i)
+    {
+      SVN_ERR(get_history_locations(&indexed, fs, paths[i], rev, TRUE,
+                                    pool));
+      SVN_ERR(get_history_locations(&plain, plain_fs, paths[i], rev, TRUE,
+                                    pool));
+      SVN_TEST_STRING_ASSERT(indexed, plain);
+
+      SVN_ERR(get_history_locations(&indexed, fs, paths[i], rev, FALSE,
+                                    pool));
+      SVN_ERR(get_history_locations(&plain, plain_fs, paths[i], rev, FALSE,
+                                    pool));
+      SVN_TEST_STRING_ASSERT(indexed, plain);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-mergeinfo-index"
+
+/* Implements svn_fs_mergeinfo_receiver_t.  Add PATH and the string form
+   of MERGEINFO to the apr_hash_t * BATON. */
+static svn_error_t *
+collect_mergeinfo(const char *path,
+                  svn_mergeinfo_t mergeinfo,
+                  void *baton,
+                  apr_pool_t *scratch_pool)
+{
+  apr_hash_t *result = baton;
+  apr_pool_t *result_pool = apr_hash_pool_get(result);
+  svn_string_t *value;
+
+  SVN_ERR(svn_mergeinfo_to_string(&value, mergeinfo, scratch_pool));
+  svn_hash_sets(result, apr_pstrdup(result_pool, path),
+                apr_pstrdup(result_pool, value->data));
+
+  return SVN_NO_ERROR;
+}
+
+/* Return the PATH=VALUE entries of the mergeinfo collected in MERGEINFO,
+   sorted by path and separated by spaces.  Allocate the result in POOL. */
+static const char *
+mergeinfo_to_cstring(apr_hash_t *mergeinfo,
+                     apr_pool_t *pool)
+{
+  svn_stringbuf_t *result = svn_stringbuf_create_empty(pool);
+  apr_array_header_t *sorted = svn_sort__hash(mergeinfo,
+                                              svn_sort_compare_items_as_paths,
+                                              pool);
+  int i;
+
+  for (i = 0; i < sorted->nelts; ++i)
+    {
+      svn_sort__item_t *item = &APR_ARRAY_IDX(sorted, i, svn_sort__item_t);
+      if (result->len)
+        svn_stringbuf_appendbyte(result, ' ');
+      svn_stringbuf_appendcstr(result,
+                               apr_psprintf(pool, "%s=%s",
+                                            (const char *)item->key,
+                                            (const char *)item->value));
+    }
+
+  return result->data;
+}
+
+/* Set *CRAWLED to the descendant mergeinfo of PATH@REVISION in FS as
+   reported by svn_fs_get_mergeinfo3() and *INDEXED to the same as
+   reported by the mergeinfo index, or NULL if the index does not cover
+   REVISION.  Allocate the results in POOL. */
+static svn_error_t *
+get_descendant_mergeinfo(const char **crawled,
+                         const char **indexed,
+                         svn_fs_t *fs,
+                         const char *path,
+                         svn_revnum_t revision,
+                         apr_pool_t *pool)
+{
+  svn_fs_root_t *root;
+  apr_array_header_t *paths = apr_array_make(pool, 1, sizeof(const char *));
+  apr_hash_t *mergeinfo = apr_hash_make(pool);
+  svn_boolean_t handled;
+
+  SVN_ERR(svn_fs_fs__mergeinfo_index_get_descendants(&handled, fs, revision,
+                                                     path, collect_mergeinfo,
+                                                     mergeinfo, pool));
+  *indexed = handled ? mergeinfo_to_cstring(mergeinfo, pool) : NULL;
+
+  /* svn_fs_get_mergeinfo3() also reports PATH itself. */
+  mergeinfo = apr_hash_make(pool);
+  APR_ARRAY_PUSH(paths, const char *) = path;
+  SVN_ERR(svn_fs_revision_root(&root, fs, revision, pool));
+  SVN_ERR(svn_fs_get_mergeinfo3(root, paths, svn_mergeinfo_explicit, TRUE,
+                                FALSE, collect_mergeinfo, mergeinfo, pool));
+  svn_hash_sets(mergeinfo, path, NULL);
+  *crawled = mergeinfo_to_cstring(mergeinfo, pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Verify that the mergeinfo index agrees with crawling the tree, both
+   when built from scratch and when updated by commits, and that a commit
+   catches up with a lagging index only in bounded steps. */
+static svn_error_t *
+mergeinfo_index(const svn_test_opts_t *opts,
+                apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root, *rev_root;
+  svn_revnum_t rev, i;
+  const char *crawled, *indexed;
+  apr_hash_t *expected = apr_hash_make(pool);
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  const char *paths[] = { "/", "/A", "/A2", "/A2/D" };
+  apr_size_t k;
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  SVN_ERR(svn_test__create_fs(&fs, REPO_NAME, opts, pool));
+  if (! svn_fs_fs__fs_supports_mergeinfo(fs))
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this FSFS format doesn't support mergeinfo");
+
+  /* r1: Greek tree. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__create_greek_tree(txn_root, pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r2: Some mergeinfo. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_change_node_prop(txn_root, "/A/B", SVN_PROP_MERGEINFO,
+                                  svn_string_create("/x/B:1", pool), pool));
+  SVN_ERR(svn_fs_change_node_prop(txn_root, "/A/D/G", SVN_PROP_MERGEINFO,
+                                  svn_string_create("/x/G:1", pool), pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r3: Copy it along with its parent. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_revision_root(&rev_root, fs, rev, pool));
+  SVN_ERR(svn_fs_copy(rev_root, "/A", txn_root, "/A2", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* r4: Delete a parent, remove mergeinfo from the copy and add some. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_delete(txn_root, "/A/D", pool));
+  SVN_ERR(svn_fs_change_node_prop(txn_root, "/A2/D/G", SVN_PROP_MERGEINFO,
+                                  NULL, pool));
+  SVN_ERR(svn_fs_change_node_prop(txn_root, "/A2/D/H", SVN_PROP_MERGEINFO,
+                                  svn_string_create("/x/H:1-3", pool),
+                                  pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  /* Remember what crawling the tree reports without the index. */
+  for (i = 1; i <= rev; ++i)
+    for (k = 0; k < sizeof(paths) / sizeof(paths[0]); ++k)
+      {
+        svn_error_t *err;
+
+        err = get_descendant_mergeinfo(&crawled, &indexed, fs, paths[k], i,
+                                       pool);
+        if (err && err->apr_err == SVN_ERR_FS_NOT_FOUND)
+          {
+            svn_error_clear(err);
+            continue;
+          }
+
+        SVN_ERR(err);
+        SVN_TEST_ASSERT(indexed == NULL);
+        svn_hash_sets(expected,
+                      apr_psprintf(pool, "%s@%ld", paths[k], i), crawled);
+      }
+
+  /* Build the index.  It must agree with the crawler. */
+  SVN_ERR(svn_fs_fs__build_mergeinfo_index(fs, NULL, NULL, NULL, NULL,
+                                           pool));
+  for (i = 1; i <= rev; ++i)
+    for (k = 0; k < sizeof(paths) / sizeof(paths[0]); ++k)
+      {
+        const char *key;
+
+        svn_pool_clear(iterpool);
+        key = apr_psprintf(iterpool, "%s@%ld", paths[k], i);
+        if (!svn_hash_gets(expected, key))
+          continue;
+
+        SVN_ERR(get_descendant_mergeinfo(&crawled, &indexed, fs, paths[k],
+                                         i, iterpool));
+        SVN_TEST_STRING_ASSERT(indexed, svn_hash_gets(expected, key));
+      }
+
+  SVN_ERR(get_descendant_mergeinfo(&crawled, &indexed, fs, "/", rev, pool));
+  SVN_TEST_STRING_ASSERT(indexed,
+                         "/A/B=/x/B:1 /A2/B=/x/B:1 /A2/D/H=/x/H:1-3");
+
+  /* r5: Replace a sub-tree with mergeinfo by a copy without it.
+     The commit updates the index. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_revision_root(&rev_root, fs, rev, pool));
+  SVN_ERR(svn_fs_delete(txn_root, "/A2/B", pool));
+  SVN_ERR(svn_fs_copy(rev_root, "/A/C", txn_root, "/A2/B", pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+
+  SVN_ERR(get_descendant_mergeinfo(&crawled, &indexed, fs, "/", rev, pool));
+  SVN_TEST_ASSERT(indexed);
+  SVN_TEST_STRING_ASSERT(indexed, crawled);
+  SVN_TEST_STRING_ASSERT(indexed, "/A/B=/x/B:1 /A2/D/H=/x/H:1-3");
+
+  /* A commit adds at most 16 revisions to an index that lags behind.
+     That number is MERGEINFO_INDEX_COMMIT_LIMIT in mergeinfo_index.c. */
+  for (i = 0; i < 20; ++i)
+    {
+      if (i == 19)
+        SVN_ERR(svn_fs_fs__mergeinfo_index_truncate(fs, 0, pool));
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_begin_txn(&txn, fs, rev, iterpool));
+      SVN_ERR(svn_fs_txn_root(&txn_root, txn, iterpool));
+      SVN_ERR(svn_fs_change_node_prop(txn_root, "/", "prop",
+                                      svn_string_createf(iterpool, "%ld", i),
+                                      iterpool));
+      SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, iterpool));
+    }
+
+  SVN_ERR(get_descendant_mergeinfo(&crawled, &indexed, fs, "/", 16, pool));
+  SVN_TEST_ASSERT(indexed);
+  SVN_TEST_STRING_ASSERT(indexed, crawled);
+  SVN_ERR(get_descendant_mergeinfo(&crawled, &indexed, fs, "/", 17, pool));
+  SVN_TEST_ASSERT(indexed == NULL);
+
+  /* Building the index catches up with the rest. */
+  SVN_ERR(svn_fs_fs__build_mergeinfo_index(fs, NULL, NULL, NULL, NULL,
+                                           pool));
+  SVN_ERR(get_descendant_mergeinfo(&crawled, &indexed, fs, "/", rev, pool));
+  SVN_TEST_ASSERT(indexed);
+  SVN_TEST_STRING_ASSERT(indexed, crawled);
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-get-file-range-test"
+
+static svn_error_t *
+get_file_range(const svn_test_opts_t *opts, apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root, *rev_root;
+  svn_revnum_t rev;
+  svn_boolean_t success;
+  apr_file_t *file;
+  apr_off_t offset;
+  svn_filesize_t length;
+  int svndiff_version;
+  svn_stringbuf_t *data, *expected, *actual;
+  svn_stream_t *contents;
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  /* Create a filesystem with the Greek tree. */
+  SVN_ERR(svn_test__create_fs(&fs, REPO_NAME, opts, pool));
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__create_greek_tree(txn_root, pool));
+
+  /* Uncommitted contents are not available. */
+  success = TRUE;
+  SVN_ERR(svn_fs__try_get_file_range(&success, &file, &offset, &length,
+                                     &svndiff_version, txn_root, "iota",
+                                     pool, pool));
+  SVN_TEST_ASSERT(!success);
+
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+  SVN_TEST_ASSERT(SVN_IS_VALID_REVNUM(rev));
+  SVN_ERR(svn_fs_revision_root(&rev_root, fs, rev, pool));
+
+  /* Directories are not files. */
+  SVN_TEST_ASSERT_ERROR(svn_fs__try_get_file_range(&success, &file, &offset,
+                                                   &length, &svndiff_version,
+                                                   rev_root, "A", pool, pool),
+                        SVN_ERR_FS_NOT_FILE);
+
+  /* Committed contents can be found in the rev file. */
+  SVN_ERR(svn_fs__try_get_file_range(&success, &file, &offset, &length,
+                                     &svndiff_version, rev_root, "iota",
+                                     pool, pool));
+  SVN_TEST_ASSERT(success);
+
+  data = svn_stringbuf_create_ensure((apr_size_t)length, pool);
+  SVN_ERR(svn_io_file_seek(file, APR_SET, &offset, pool));
+  SVN_ERR(svn_io_file_read_full2(file, data->data, (apr_size_t)length,
+                                 &data->len, NULL, pool));
+  data->data[data->len] = '\0';
+
+  /* Reconstruct the fulltext from it and compare. */
+  SVN_ERR(svn_fs_file_contents(&contents, rev_root, "iota", pool));
+  SVN_ERR(svn_stringbuf_from_stream(&expected, contents, 0, pool));
+
+  if (svndiff_version < 0)
+    {
+      actual = data;
+    }
+  else
+    {
+      svn_txdelta_window_handler_t handler;
+      void *handler_baton;
+      svn_stream_t *svndiff;
+      apr_size_t len = data->len;
+
+      SVN_TEST_ASSERT(svndiff_version == data->data[3]);
+
+      actual = svn_stringbuf_create_empty(pool);
+      svn_txdelta_apply(svn_stream_empty(pool),
+                        svn_stream_from_stringbuf(actual, pool),
+                        NULL, NULL, pool, &handler, &handler_baton);
+      svndiff = svn_txdelta_parse_svndiff(handler, handler_baton, TRUE,
+                                          pool);
+      SVN_ERR(svn_stream_write(svndiff, data->data, &len));
+      SVN_ERR(svn_stream_close(svndiff));
+    }
+
+  SVN_TEST_STRING_ASSERT(actual->data, expected->data);
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-commit-out-of-date-txn"
+
+/* Verify that a txn whose final rev data has been written ahead of the
+   commit can still be committed after losing the race for its revision. */
+static svn_error_t *
+commit_out_of_date_txn(const svn_test_opts_t *opts,
+                       apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn, *stale_txn;
+  svn_fs_root_t *txn_root, *root;
+  const char *conflict;
+  svn_revnum_t new_rev;
+  svn_stringbuf_t *contents;
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  /* r1: Greek tree. */
+  SVN_ERR(svn_test__create_fs(&fs, REPO_NAME, opts, pool));
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__create_greek_tree(txn_root, pool));
+  SVN_ERR(svn_fs_commit_txn(&conflict, &new_rev, txn, pool));
+  SVN_TEST_ASSERT(new_rev == 1);
+
+  /* Two txns based on the same revision, touching different files. */
+  SVN_ERR(svn_fs_begin_txn(&stale_txn, fs, 1, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, stale_txn, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "A/mu", "new mu\n", pool));
+
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 1, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "iota", "new iota\n",
+                                      pool));
+  SVN_ERR(svn_fs_commit_txn(&conflict, &new_rev, txn, pool));
+  SVN_TEST_ASSERT(new_rev == 2);
+
+  /* Committing without merging must fail and leave the txn intact. */
+  SVN_TEST_ASSERT_ERROR(svn_fs_fs__commit(&new_rev, fs, stale_txn, pool),
+                        SVN_ERR_FS_TXN_OUT_OF_DATE);
+
+  /* The regular commit merges and retries. */
+  SVN_ERR(svn_fs_commit_txn(&conflict, &new_rev, stale_txn, pool));
+  SVN_TEST_ASSERT(new_rev == 3);
+
+  SVN_ERR(svn_fs_revision_root(&root, fs, new_rev, pool));
+  SVN_ERR(svn_test__get_file_contents(root, "iota", &contents, pool));
+  SVN_TEST_STRING_ASSERT(contents->data, "new iota\n");
+  SVN_ERR(svn_test__get_file_contents(root, "A/mu", &contents, pool));
+  SVN_TEST_STRING_ASSERT(contents->data, "new mu\n");
+
+  SVN_ERR(svn_fs_verify(REPO_NAME, NULL, 0, new_rev, NULL, NULL, NULL, NULL,
+                        pool));
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-commit-batch-fsync"
+
+/* Commit across shard boundaries with fsync enabled. */
+static svn_error_t *
+commit_batch_fsync(const svn_test_opts_t *opts,
+                   apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  fs_fs_data_t *ffd;
+  apr_hash_t *fs_config = apr_hash_make(pool);
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root;
+  svn_revnum_t rev;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  /* Use shards of 4 revisions, add the Greek tree in r1 and commit r2
+     to r9. */
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_SHARD_SIZE, "4");
+  SVN_ERR(svn_test__create_fs2(&fs, REPO_NAME, opts, fs_config, pool));
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__create_greek_tree(txn_root, pool));
+  SVN_ERR(svn_fs_commit_txn(NULL, &rev, txn, pool));
+  SVN_TEST_ASSERT(rev == 1);
+
+  ffd = fs->fsap_data;
+  ffd->flush_to_disk = TRUE;
+
+  for (rev = 2; rev <= 9; ++rev)
+    {
+      const char *conflict;
+      svn_revnum_t new_rev;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_begin_txn(&txn, fs, rev - 1, iterpool));
+      SVN_ERR(svn_fs_txn_root(&txn_root, txn, iterpool));
+      SVN_ERR(svn_test__set_file_contents(txn_root, "iota",
+                                          apr_psprintf(iterpool,
+                                                       "iota in r%ld\n",
+                                                       rev),
+                                          iterpool));
+      SVN_ERR(svn_fs_change_txn_prop(txn, "test-prop",
+                                     svn_string_create("value", iterpool),
+                                     iterpool));
+      SVN_ERR(svn_fs_commit_txn(&conflict, &new_rev, txn, iterpool));
+      SVN_TEST_ASSERT(new_rev == rev);
+    }
+
+  /* Read everything back from a fresh instance. */
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  for (rev = 2; rev <= 9; ++rev)
+    {
+      svn_fs_root_t *root;
+      svn_stringbuf_t *contents;
+      svn_string_t *value;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_revision_root(&root, fs, rev, iterpool));
+      SVN_ERR(svn_test__get_file_contents(root, "iota", &contents,
+                                          iterpool));
+      SVN_TEST_STRING_ASSERT(contents->data,
+                             apr_psprintf(iterpool, "iota in r%ld\n", rev));
+
+      SVN_ERR(svn_fs_revision_prop2(&value, fs, rev, "test-prop", TRUE,
+                                    iterpool, iterpool));
+      SVN_TEST_ASSERT(value);
+      SVN_TEST_STRING_ASSERT(value->data, "value");
+    }
+
+  SVN_ERR(svn_fs_verify(REPO_NAME, NULL, 0, 9,
+                        NULL, NULL, NULL, NULL, pool));
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-commit-group-fsync"
+#define THREAD_COUNT 4
+
+#if APR_HAS_THREADS
+/* Baton for commit_group_child. */
+typedef struct commit_group_baton_t
+{
+  /* Name of the file to add in r0 of REPO_NAME. */
+  const char *path;
+
+  /* Pool exclusively owned by the thread. */
+  apr_pool_t *pool;
+
+  /* Result of the commit. */
+  svn_error_t *err;
+} commit_group_baton_t;
+
+/* Open REPO_NAME in its own svn_fs_t and commit a new file PATH with
+   fsync enabled.  Use POOL for allocations. */
+static svn_error_t *
+commit_group_member(const char *path,
+                    apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  fs_fs_data_t *ffd;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root;
+  const char *conflict;
+  svn_revnum_t new_rev;
+
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  ffd = fs->fsap_data;
+  ffd->flush_to_disk = TRUE;
+
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_make_file(txn_root, path, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, path, path, pool));
+
+  return svn_error_trace(svn_fs_commit_txn(&conflict, &new_rev, txn,
+                                           pool));
+}
+
+static void * APR_THREAD_FUNC
+commit_group_child(apr_thread_t *tid, void *data)
+{
+  commit_group_baton_t *baton = data;
+
+  baton->err = commit_group_member(baton->path, baton->pool);
+  apr_thread_exit(tid, 0);
+  return NULL;
+}
+#endif
+
+/* Commit from several threads concurrently with group commit enabled. */
+static svn_error_t *
+commit_group_fsync(const svn_test_opts_t *opts,
+                   apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  svn_fs_t *fs;
+  fs_fs_data_t *ffd;
+  svn_fs_root_t *root;
+  svn_revnum_t youngest;
+  apr_threadattr_t *tattr;
+  apr_thread_t *tids[THREAD_COUNT];
+  commit_group_baton_t batons[THREAD_COUNT];
+  apr_status_t status;
+  svn_error_t *err = SVN_NO_ERROR;
+  int i;
+  const char *conf_path = svn_dirent_join(REPO_NAME, PATH_CONFIG, pool);
+  const char *group_conf = "[" CONFIG_SECTION_IO "]\n"
+                           CONFIG_OPTION_GROUP_COMMIT_WINDOW " = 10\n";
+
+  /* Bail (with success) on known-untestable scenarios */
+  if (strcmp(opts->fs_type, "fsfs") != 0)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "this will test FSFS repositories only");
+
+  SVN_ERR(svn_test__create_fs2(&fs, REPO_NAME, opts, NULL, pool));
+
+  ffd = fs->fsap_data;
+  if (!ffd->use_log_addressing)
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "group commit requires log addressing");
+
+  /* Group commit is off by default and must be enabled in fsfs.conf. */
+  SVN_TEST_ASSERT(ffd->group_commit_window == 0);
+  SVN_ERR(svn_io_write_atomic2(conf_path, group_conf, strlen(group_conf),
+                               NULL, FALSE, pool));
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, NULL, pool, pool));
+  ffd = fs->fsap_data;
+  SVN_TEST_ASSERT(ffd->group_commit_window == apr_time_from_msec(10));
+
+  /* Let all threads commit at the same time, such that their flushes
+     fall into the same window. */
+  status = apr_threadattr_create(&tattr, pool);
+  if (status)
+    return svn_error_wrap_apr(status, "Can't create threadattr");
+
+  for (i = 0; i < THREAD_COUNT; ++i)
+    {
+      batons[i].path = apr_psprintf(pool, "file-%d", i);
+      batons[i].pool = svn_pool_create(pool);
+      batons[i].err = SVN_NO_ERROR;
+      status = apr_thread_create(&tids[i], tattr, commit_group_child,
+                                 &batons[i], pool);
+      if (status)
+        return svn_error_wrap_apr(status, "Can't create thread");
+    }
+
+  for (i = 0; i < THREAD_COUNT; ++i)
+    {
+      apr_status_t child_status;
+
+      status = apr_thread_join(&child_status, tids[i]);
+      if (status)
+        return svn_error_wrap_apr(status, "Can't join thread");
+
+      err = svn_error_compose_create(err, batons[i].err);
+      svn_pool_destroy(batons[i].pool);
+    }
+  SVN_ERR(err);
+
+  /* Every thread got its own revision and all data made it to disk. */
+  SVN_ERR(svn_fs_youngest_rev(&youngest, fs, pool));
+  SVN_TEST_INT_ASSERT(youngest, THREAD_COUNT);
+
+  SVN_ERR(svn_fs_revision_root(&root, fs, youngest, pool));
+  for (i = 0; i < THREAD_COUNT; ++i)
+    {
+      svn_stringbuf_t *contents;
+
+      SVN_ERR(svn_test__get_file_contents(root, batons[i].path, &contents,
+                                          pool));
+      SVN_TEST_STRING_ASSERT(contents->data, batons[i].path);
+    }
+
+  SVN_ERR(svn_fs_verify(REPO_NAME, NULL, 0, youngest,
+                        NULL, NULL, NULL, NULL, pool));
+
+  return SVN_NO_ERROR;
+#else
+  return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL, "no thread support");
+#endif
+}
+
+#undef REPO_NAME
+#undef THREAD_COUNT
+
 
 
 /* The test table.  */
@@ -510,12 +1536,26 @@ static struct svn_test_descriptor_t test_funcs[] =
     SVN_TEST_NULL,
     SVN_TEST_OPTS_PASS(get_repo_stats,
                        "get statistics on a FSFS filesystem"),
+    SVN_TEST_OPTS_PASS(incremental_stats,
+                       "incremental and concurrent FSFS statistics"),
     SVN_TEST_OPTS_PASS(dump_index,
                        "dump the P2L index"),
     SVN_TEST_OPTS_PASS(load_index,
                        "load the P2L index"),
     SVN_TEST_OPTS_PASS(build_rep_cache,
                        "build the representation cache"),
+    SVN_TEST_OPTS_PASS(history_index,
+                       "follow history through the path history index"),
+    SVN_TEST_OPTS_PASS(mergeinfo_index,
+                       "find descendant mergeinfo through the index"),
+    SVN_TEST_OPTS_PASS(get_file_range,
+                       "locate file contents in the rev file"),
+    SVN_TEST_OPTS_PASS(commit_out_of_date_txn,
+                       "commit a txn after losing the race for its rev"),
+    SVN_TEST_OPTS_PASS(commit_batch_fsync,
+                       "commit with batched fsyncs"),
+    SVN_TEST_OPTS_PASS(commit_group_fsync,
+                       "commit concurrently with group commit enabled"),
     SVN_TEST_NULL
   };
 
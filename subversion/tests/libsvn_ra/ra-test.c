@@ -179,6 +179,8 @@ typedef struct tunnel_baton_t
   int magic; /* TUNNEL_MAGIC */
   int open_count;
   svn_boolean_t last_check;
+  const char *const *server_args; /* NULL-terminated extra svnserve
+                                     arguments, may be NULL */
 } tunnel_baton_t;
 
 #define TUNNEL_MAGIC 0xF00DF00F
@@ -221,13 +223,22 @@ open_tunnel(svn_stream_t **request, svn_stream_t **response,
   apr_proc_t *proc;
   apr_procattr_t *attr;
   apr_status_t status;
-  const char *args[] = { "svnserve", "-t", "-r", ".", NULL };
+  apr_array_header_t *args = apr_array_make(pool, 8, sizeof(const char *));
+  const char *const *arg;
   const char *svnserve;
   tunnel_baton_t *b = tunnel_baton;
   close_baton_t *cb;
 
   SVN_TEST_ASSERT(b->magic == TUNNEL_MAGIC);
 
+  APR_ARRAY_PUSH(args, const char *) = "svnserve";
+  APR_ARRAY_PUSH(args, const char *) = "-t";
+  APR_ARRAY_PUSH(args, const char *) = "-r";
+  APR_ARRAY_PUSH(args, const char *) = ".";
+  for (arg = b->server_args; arg && *arg; ++arg)
+    APR_ARRAY_PUSH(args, const char *) = *arg;
+  APR_ARRAY_PUSH(args, const char *) = NULL;
+
   SVN_ERR(svn_dirent_get_absolute(&svnserve, "../../svnserve/svnserve", pool));
 #ifdef WIN32
   svnserve = apr_pstrcat(pool, svnserve, ".exe", SVN_VA_NULL);
@@ -247,7 +258,8 @@ open_tunnel(svn_stream_t **request, svn_stream_t **response,
   if (status == APR_SUCCESS)
     status = apr_proc_create(proc,
                              svn_dirent_local_style(svnserve, pool),
-                             args, NULL, attr, pool);
+                             (const char *const *)args->elts, NULL, attr,
+                             pool);
   if (status != APR_SUCCESS)
     return svn_error_wrap_apr(status, "Could not run svnserve");
   apr_pool_note_subprocess(pool, proc, APR_KILL_NEVER);
@@ -1612,6 +1624,164 @@ tunnel_run_checkout(const svn_test_opts_t *opts,
   return SVN_NO_ERROR;
 }
 
+/* Implements svn_delta_editor_t.add_file, using the svn_stringbuf_t *
+   PARENT_BATON of the root directory as the file baton. */
+static svn_error_t *
+large_file_add_file(const char *path,
+                    void *parent_baton,
+                    const char *copyfrom_path,
+                    svn_revnum_t copyfrom_revision,
+                    apr_pool_t *file_pool,
+                    void **file_baton)
+{
+  *file_baton = parent_baton;
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_delta_editor_t.apply_textdelta, appending the file
+   contents to the svn_stringbuf_t * FILE_BATON. */
+static svn_error_t *
+large_file_apply_textdelta(void *file_baton,
+                           const char *base_checksum,
+                           apr_pool_t *pool,
+                           svn_txdelta_window_handler_t *handler,
+                           void **handler_baton)
+{
+  svn_stringbuf_t *contents = file_baton;
+
+  svn_txdelta_apply(svn_stream_empty(pool),
+                    svn_stream_from_stringbuf(contents, pool),
+                    NULL, NULL, pool, handler, handler_baton);
+  return SVN_NO_ERROR;
+}
+
+/* Test checking out a file over a tunnel that is large enough for
+   svnserve to send it straight from the rev file, once with and once
+   without compression being negotiated. */
+static svn_error_t *
+tunnel_checkout_large_file(const svn_test_opts_t *opts,
+                           apr_pool_t *pool)
+{
+  /* A client speed of 1000 Mbit/s sets the zero-copy limit to 120000
+     bytes.  Compression level 0 makes svnserve fall back to svndiff0. */
+  static const char *const compressed_args[]
+    = { "--client-speed", "1000", NULL };
+  static const char *const uncompressed_args[]
+    = { "--client-speed", "1000", "--compression", "0", NULL };
+  const char *const *server_args[] = { compressed_args, uncompressed_args };
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_stringbuf_t *contents = svn_stringbuf_create_empty(pool);
+  apr_uint32_t seed = 0;
+  int i;
+
+  /* 256kB of poorly compressible data. */
+  while (contents->len < 0x40000)
+    {
+      seed = seed * 1103515245 + 12345;
+      svn_stringbuf_appendbyte(contents, (char)(seed >> 16));
+    }
+
+  for (i = 0; i < 2; ++i)
+    {
+      tunnel_baton_t *b;
+      apr_pool_t *scratch_pool;
+      const char *repos_name;
+      const char *url;
+      svn_ra_callbacks2_t *cbtable;
+      svn_ra_session_t *session;
+      const svn_delta_editor_t *editor;
+      void *edit_baton, *root_baton, *file_baton;
+      svn_txdelta_window_handler_t handler;
+      void *handler_baton;
+      svn_delta_editor_t *checkout_editor;
+      svn_stringbuf_t *received;
+      const svn_ra_reporter3_t *reporter;
+      void *report_baton;
+
+      svn_pool_clear(iterpool);
+      scratch_pool = svn_pool_create(iterpool);
+      repos_name = apr_psprintf(iterpool, "test-repo-tunnel-large-file-%d",
+                                i);
+      received = svn_stringbuf_create_empty(iterpool);
+      b = apr_pcalloc(iterpool, sizeof(*b));
+      b->magic = TUNNEL_MAGIC;
+      b->server_args = server_args[i];
+
+      SVN_ERR(svn_test__create_repos(NULL, repos_name, opts, scratch_pool));
+
+      /* Store the contents as svndiff0 if the client is going to receive
+         svndiff0, so that it can still be forwarded unchanged. */
+      if (i == 1 && strcmp(opts->fs_type, SVN_FS_TYPE_FSFS) == 0)
+        SVN_ERR(svn_io_file_create(svn_dirent_join_many(scratch_pool,
+                                                        repos_name, "db",
+                                                        "fsfs.conf",
+                                                        SVN_VA_NULL),
+                                   "[deltification]\ncompression = none\n",
+                                   scratch_pool));
+
+      /* Immediately close the repository to avoid race condition with
+         svnserve (and then the cleanup code) with BDB when our pool is
+         cleared. */
+      svn_pool_clear(scratch_pool);
+
+      url = apr_pstrcat(iterpool, "svn+test://localhost/", repos_name,
+                        SVN_VA_NULL);
+      SVN_ERR(svn_ra_create_callbacks(&cbtable, iterpool));
+      cbtable->check_tunnel_func = check_tunnel;
+      cbtable->open_tunnel_func = open_tunnel;
+      cbtable->tunnel_baton = b;
+      SVN_ERR(svn_cmdline_create_auth_baton2(&cbtable->auth_baton,
+                                             TRUE  /* non_interactive */,
+                                             "jrandom", "rayjandom",
+                                             NULL,
+                                             TRUE  /* no_auth_cache */,
+                                             FALSE /* trust_server_cert */,
+                                             FALSE, FALSE, FALSE, FALSE,
+                                             NULL, NULL, NULL, iterpool));
+      SVN_ERR(svn_ra_open5(&session, NULL, NULL, url, NULL, cbtable,
+                           NULL, NULL, scratch_pool));
+
+      /* r1: Add the file. */
+      SVN_ERR(svn_ra_get_commit_editor3(session, &editor, &edit_baton,
+                                        apr_hash_make(iterpool),
+                                        NULL, NULL, NULL, TRUE, iterpool));
+      SVN_ERR(editor->open_root(edit_baton, SVN_INVALID_REVNUM,
+                                iterpool, &root_baton));
+      SVN_ERR(editor->add_file("large", root_baton, NULL,
+                               SVN_INVALID_REVNUM, iterpool, &file_baton));
+      SVN_ERR(editor->apply_textdelta(file_baton, NULL, iterpool,
+                                      &handler, &handler_baton));
+      SVN_ERR(svn_txdelta_send_string(svn_string_ncreate(contents->data,
+                                                         contents->len,
+                                                         iterpool),
+                                      handler, handler_baton, iterpool));
+      SVN_ERR(editor->close_file(file_baton, NULL, iterpool));
+      SVN_ERR(editor->close_directory(root_baton, iterpool));
+      SVN_ERR(editor->close_edit(edit_baton, iterpool));
+
+      /* Check it out again. */
+      checkout_editor = svn_delta_default_editor(iterpool);
+      checkout_editor->add_file = large_file_add_file;
+      checkout_editor->apply_textdelta = large_file_apply_textdelta;
+      SVN_ERR(svn_ra_do_update3(session, &reporter, &report_baton,
+                                1, "", svn_depth_infinity, FALSE, FALSE,
+                                checkout_editor, received,
+                                iterpool, iterpool));
+      SVN_ERR(reporter->set_path(report_baton, "", 1, svn_depth_infinity,
+                                 TRUE, NULL, iterpool));
+      SVN_ERR(reporter->finish_report(report_baton, iterpool));
+
+      SVN_TEST_ASSERT(svn_stringbuf_compare(received, contents));
+
+      svn_pool_destroy(scratch_pool);
+      SVN_TEST_ASSERT(b->open_count == 0);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
 /* Implements svn_log_entry_receiver_t for commit_empty_last_change */
 static svn_error_t *
 AA_receiver(void *baton,
@@ -1909,6 +2079,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                        "check list has_props performance"),
     SVN_TEST_OPTS_PASS(tunnel_run_checkout,
                        "verify checkout over a tunnel"),
+    SVN_TEST_OPTS_PASS(tunnel_checkout_large_file,
+                       "check out a large file over a tunnel"),
     SVN_TEST_OPTS_PASS(commit_empty_last_change,
                        "check how last change applies to empty commit"),
     SVN_TEST_OPTS_PASS(commit_locked_file,
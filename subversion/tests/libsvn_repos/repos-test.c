@@ -4468,6 +4468,143 @@ test_list(const svn_test_opts_t *opts,
   return SVN_NO_ERROR;
 }
 
+/* One chunk as reported to blame_receiver(). */
+typedef struct blame_chunk_t
+{
+  apr_int64_t start;
+  svn_revnum_t revision;
+} blame_chunk_t;
+
+/* Implements svn_repos_blame_receiver_t, appending a blame_chunk_t to
+   the array BATON. */
+static svn_error_t *
+blame_receiver(void *baton,
+               apr_int64_t start_line,
+               svn_revnum_t revision,
+               apr_hash_t *rev_props,
+               apr_pool_t *scratch_pool)
+{
+  apr_array_header_t *chunks = baton;
+  blame_chunk_t *chunk = apr_array_push(chunks);
+
+  /* Only the lines older than the range come without revprops. */
+  SVN_TEST_ASSERT(SVN_IS_VALID_REVNUM(revision) == (rev_props != NULL));
+
+  chunk->start = start_line;
+  chunk->revision = revision;
+
+  return SVN_NO_ERROR;
+}
+
+/* Verify that CHUNKS contains exactly the EXPECTED_COUNT entries in
+   EXPECTED. */
+static svn_error_t *
+verify_blame(const apr_array_header_t *chunks,
+             const blame_chunk_t *expected,
+             int expected_count)
+{
+  int i;
+
+  SVN_TEST_INT_ASSERT(chunks->nelts, expected_count);
+  for (i = 0; i < expected_count; ++i)
+    {
+      const blame_chunk_t *chunk = &APR_ARRAY_IDX(chunks, i, blame_chunk_t);
+
+      SVN_TEST_INT_ASSERT(chunk->start, expected[i].start);
+      SVN_TEST_INT_ASSERT(chunk->revision, expected[i].revision);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_blame(const svn_test_opts_t *opts,
+           apr_pool_t *pool)
+{
+  svn_repos_t *repos;
+  svn_fs_t *fs;
+  svn_fs_txn_t *txn;
+  svn_fs_root_t *txn_root;
+  svn_revnum_t youngest_rev;
+  apr_array_header_t *chunks;
+  svn_diff_file_options_t *diff_options;
+
+  const blame_chunk_t full_blame[] = {
+    { 0, 3 }, { 1, 1 }, { 2, 2 }, { 3, 3 }, { 4, 2 }
+  };
+  const blame_chunk_t space_blame[] = {
+    { 0, 3 }, { 1, 1 }, { 2, 2 }, { 3, 1 }, { 4, 2 }
+  };
+  const blame_chunk_t partial_blame[] = {
+    { 0, 3 }, { 1, SVN_INVALID_REVNUM }, { 2, 2 },
+    { 3, SVN_INVALID_REVNUM }, { 4, 2 }
+  };
+
+  SVN_ERR(svn_test__create_repos(&repos, "test-repo-blame", opts, pool));
+  fs = svn_repos_fs(repos);
+
+  /* r1: create the file. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, 0, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_fs_make_file(txn_root, "/iota", pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/iota",
+                                      "a\nb\nc d\n", pool));
+  SVN_ERR(svn_repos_fs_commit_txn(NULL, repos, &youngest_rev, txn, pool));
+
+  /* r2: modify a line and append one. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, youngest_rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/iota",
+                                      "a\nB\nc d\ne\n", pool));
+  SVN_ERR(svn_repos_fs_commit_txn(NULL, repos, &youngest_rev, txn, pool));
+
+  /* r3: prepend a line and change the whitespace in another one. */
+  SVN_ERR(svn_fs_begin_txn(&txn, fs, youngest_rev, pool));
+  SVN_ERR(svn_fs_txn_root(&txn_root, txn, pool));
+  SVN_ERR(svn_test__set_file_contents(txn_root, "/iota",
+                                      "x\na\nB\nc  d\ne\n", pool));
+  SVN_ERR(svn_repos_fs_commit_txn(NULL, repos, &youngest_rev, txn, pool));
+  SVN_TEST_ASSERT(youngest_rev == 3);
+
+  /* Blame the whole history with the default diff options. */
+  chunks = apr_array_make(pool, 5, sizeof(blame_chunk_t));
+  SVN_ERR(svn_repos_blame(repos, "/iota", 1, youngest_rev, NULL, NULL, NULL,
+                          blame_receiver, chunks, pool));
+  SVN_ERR(verify_blame(chunks, full_blame,
+                       sizeof(full_blame) / sizeof(full_blame[0])));
+
+  /* Ignoring whitespace changes, r3 only added the first line. */
+  diff_options = svn_diff_file_options_create(pool);
+  diff_options->ignore_space = svn_diff_file_ignore_space_change;
+  chunks = apr_array_make(pool, 5, sizeof(blame_chunk_t));
+  SVN_ERR(svn_repos_blame(repos, "/iota", 1, youngest_rev, diff_options,
+                          NULL, NULL, blame_receiver, chunks, pool));
+  SVN_ERR(verify_blame(chunks, space_blame,
+                       sizeof(space_blame) / sizeof(space_blame[0])));
+
+  /* Lines older than the start revision get no revision. */
+  chunks = apr_array_make(pool, 5, sizeof(blame_chunk_t));
+  SVN_ERR(svn_repos_blame(repos, "/iota", 2, youngest_rev, diff_options,
+                          NULL, NULL, blame_receiver, chunks, pool));
+  SVN_ERR(verify_blame(chunks, partial_blame,
+                       sizeof(partial_blame) / sizeof(partial_blame[0])));
+
+  /* Repeated queries may be served from the cache but must not differ. */
+  chunks = apr_array_make(pool, 5, sizeof(blame_chunk_t));
+  SVN_ERR(svn_repos_blame(repos, "/iota", 1, youngest_rev, NULL, NULL, NULL,
+                          blame_receiver, chunks, pool));
+  SVN_ERR(verify_blame(chunks, full_blame,
+                       sizeof(full_blame) / sizeof(full_blame[0])));
+
+  /* Reversed ranges are rejected. */
+  SVN_TEST_ASSERT_ERROR(svn_repos_blame(repos, "/iota", 3, 2, NULL,
+                                        NULL, NULL, blame_receiver, chunks,
+                                        pool),
+                        SVN_ERR_INCORRECT_PARAMS);
+
+  return SVN_NO_ERROR;
+}
+
 /* The test table.  */
 
 static int max_threads = 4;
@@ -4539,6 +4676,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "optional authz wildcard performance test"),
     SVN_TEST_OPTS_PASS(test_list,
                        "test svn_repos_list"),
+    SVN_TEST_OPTS_PASS(test_blame,
+                       "test svn_repos_blame"),
     SVN_TEST_NULL
   };
 
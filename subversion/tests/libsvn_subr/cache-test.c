@@ -22,12 +22,16 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <apr_general.h>
 #include <apr_lib.h>
 #include <apr_time.h>
+#include <apr_thread_proc.h>
 
 #include "svn_pools.h"
+#include "svn_dirent_uri.h"
+#include "svn_io.h"
 
 #include "private/svn_cache.h"
 #include "svn_private_config.h"
@@ -590,6 +594,474 @@ test_membuffer_unaligned_fixed_keys(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+#if APR_HAS_THREADS
+
+/* Number of distinct keys used by the concurrency test. */
+#define CONCURRENT_KEY_COUNT 1000
+
+/* Number of cache accesses per thread in the concurrency test. */
+#define CONCURRENT_ITERATIONS 20000
+
+/* Per-thread state in test_membuffer_concurrent_access. */
+typedef struct concurrent_baton_t
+{
+  /* The cache shared between all threads. */
+  svn_membuffer_t *membuffer;
+
+  /* Used to give each thread its own random sequence. */
+  apr_uint32_t seed;
+
+  /* Error returned by the thread or NULL. */
+  svn_error_t *err;
+} concurrent_baton_t;
+
+/* Return the value expected for KEY in the concurrency test.
+ * Different keys use different lengths and contents, such that torn
+ * reads would produce detectable garbage. */
+static svn_stringbuf_t *
+concurrent_value(int key, apr_pool_t *result_pool)
+{
+  apr_size_t len = 16 + (key % 64) * 16;
+  svn_stringbuf_t *value = svn_stringbuf_create_ensure(len, result_pool);
+  memset(value->data, 'a' + key % 26, len);
+  value->data[len] = 0;
+  value->len = len;
+
+  return value;
+}
+
+/* Verify that DATA of DATA_LEN bytes is what should be cached for KEY. */
+static svn_error_t *
+verify_concurrent_value(int key,
+                        const char *data,
+                        apr_size_t data_len)
+{
+  apr_size_t i;
+
+  SVN_TEST_ASSERT(data_len == 16 + (key % 64) * 16);
+  for (i = 0; i < data_len; ++i)
+    SVN_TEST_ASSERT(data[i] == 'a' + key % 26);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_cache__partial_getter_func_t.  BATON is the int key. */
+static svn_error_t *
+verify_concurrent_partial_getter(void **out,
+                                 const void *data,
+                                 apr_size_t data_len,
+                                 void *baton,
+                                 apr_pool_t *result_pool)
+{
+  /* Serialized stringbufs include the terminating NUL. */
+  SVN_ERR(verify_concurrent_value(*(int *)baton, data, data_len - 1));
+  *out = baton;
+
+  return SVN_NO_ERROR;
+}
+
+/* Mix of lookups and updates against the membuffer in BATON as done by
+ * a single thread.  Use POOL for allocations. */
+static svn_error_t *
+concurrent_access(concurrent_baton_t *baton,
+                  apr_pool_t *pool)
+{
+  svn_cache__t *cache;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_uint32_t seed = baton->seed;
+  int i;
+
+  /* Front-end objects are not thread-safe.  Share only the membuffer. */
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, baton->membuffer,
+                                            NULL, NULL,
+                                            APR_HASH_KEY_STRING,
+                                            "concurrent:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE,
+                                            pool, pool));
+
+  for (i = 0; i < CONCURRENT_ITERATIONS; ++i)
+    {
+      int key;
+      const char *key_str;
+      svn_boolean_t found;
+      void *value;
+
+      svn_pool_clear(iterpool);
+
+      seed = seed * 1103515245 + 12345;
+      key = (int)((seed >> 8) % CONCURRENT_KEY_COUNT);
+      key_str = apr_itoa(iterpool, key);
+
+      if (i % 16 == 0)
+        {
+          SVN_ERR(svn_cache__set(cache, key_str,
+                                 concurrent_value(key, iterpool), iterpool));
+        }
+      else if (i % 2)
+        {
+          SVN_ERR(svn_cache__get(&value, &found, cache, key_str, iterpool));
+          if (found)
+            {
+              svn_stringbuf_t *str = value;
+              SVN_ERR(verify_concurrent_value(key, str->data, str->len));
+            }
+        }
+      else
+        {
+          SVN_ERR(svn_cache__get_partial(&value, &found, cache, key_str,
+                                         verify_concurrent_partial_getter,
+                                         &key, iterpool));
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+static void *
+APR_THREAD_FUNC concurrent_thread_func(apr_thread_t *tid, void *data)
+{
+  concurrent_baton_t *baton = data;
+  apr_pool_t *pool = svn_pool_create(NULL);
+
+  baton->err = concurrent_access(baton, pool);
+  svn_pool_destroy(pool);
+  apr_thread_exit(tid, APR_SUCCESS);
+
+  return NULL;
+}
+
+/* Run CONCURRENT_ITERATIONS cache accesses on each of THREAD_COUNT threads
+ * against MEMBUFFER and return the time it took in *DURATION.  Use POOL
+ * for allocations. */
+static svn_error_t *
+run_concurrent_access(apr_interval_time_t *duration,
+                      svn_membuffer_t *membuffer,
+                      int thread_count,
+                      apr_pool_t *pool)
+{
+  apr_thread_t **threads = apr_pcalloc(pool, thread_count * sizeof(*threads));
+  concurrent_baton_t *batons = apr_pcalloc(pool,
+                                           thread_count * sizeof(*batons));
+  apr_time_t start = apr_time_now();
+  svn_error_t *err = SVN_NO_ERROR;
+  int i;
+
+  for (i = 0; i < thread_count; ++i)
+    {
+      apr_status_t status;
+
+      batons[i].membuffer = membuffer;
+      batons[i].seed = i;
+      status = apr_thread_create(&threads[i], NULL, concurrent_thread_func,
+                                 &batons[i], pool);
+      if (status)
+        return svn_error_wrap_apr(status, "Can't create thread");
+    }
+
+  /* Wait for all threads and collect their errors. */
+  for (i = 0; i < thread_count; ++i)
+    {
+      apr_status_t retval;
+      apr_status_t status = apr_thread_join(&retval, threads[i]);
+      if (status)
+        return svn_error_wrap_apr(status, "Can't join thread");
+
+      err = svn_error_compose_create(err, batons[i].err);
+    }
+
+  *duration = apr_time_now() - start;
+
+  return svn_error_trace(err);
+}
+
+#endif
+
+static svn_error_t *
+test_membuffer_concurrent_access(const svn_test_opts_t *opts,
+                                 apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  enum { THREAD_COUNT = 8 };
+  svn_membuffer_t *membuffer;
+  apr_interval_time_t single, multiple;
+
+  /* Use a single segment to maximize contention and a size small enough
+   * to have frequent evictions, i.e. writers modifying the directory. */
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 256 * 1024,
+                                            16 * 1024, 1, TRUE, FALSE,
+                                            pool));
+
+  /* Compare the throughput of one vs. many threads. */
+  SVN_ERR(run_concurrent_access(&single, membuffer, 1, pool));
+  SVN_ERR(run_concurrent_access(&multiple, membuffer, THREAD_COUNT, pool));
+
+  if (opts->verbose)
+    printf("membuffer cache: %d accesses by 1 thread in %.3fs, "
+           "by %d threads each in %.3fs\n",
+           CONCURRENT_ITERATIONS, (double)single / APR_USEC_PER_SEC,
+           THREAD_COUNT, (double)multiple / APR_USEC_PER_SEC);
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+
+/* Store TWENTY under "twenty" in CACHE. */
+static svn_error_t *
+set_twenty(svn_cache__t *cache,
+           apr_pool_t *pool)
+{
+  svn_revnum_t twenty = 20;
+  return svn_error_trace(svn_cache__set(cache, "twenty", &twenty, pool));
+}
+
+static svn_error_t *
+test_membuffer_shared_cache(apr_pool_t *pool)
+{
+#if APR_HAS_FORK
+  svn_cache__t *cache;
+  svn_membuffer_t *membuffer;
+  svn_boolean_t found;
+  svn_revnum_t *answer;
+  apr_proc_t proc;
+  apr_status_t status;
+  int exit_code;
+  apr_exit_why_e exit_why;
+
+  svn_error_t *err = svn_cache__membuffer_cache_create_shared(&membuffer,
+                                                              10*1024, 1, 0,
+                                                              TRUE, pool);
+  if (err && (   err->apr_err == SVN_ERR_UNSUPPORTED_FEATURE
+              || APR_STATUS_IS_ENOTIMPL(err->apr_err)))
+    {
+      svn_error_clear(err);
+      return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                              "shared memory caches not supported");
+    }
+  SVN_ERR(err);
+
+  /* Use a fixed-size key that process-local caches would map to a
+   * shared prefix. */
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache,
+                                            membuffer,
+                                            serialize_revnum,
+                                            deserialize_revnum,
+                                            sizeof("twenty"),
+                                            "cache:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            TRUE,
+                                            FALSE,
+                                            pool, pool));
+
+  /* Let a child process fill the cache ...
+   * Don't let it repeat any buffered output of ours when it exits. */
+  fflush(stdout);
+  status = apr_proc_fork(&proc, pool);
+  if (status == APR_INCHILD)
+    {
+      err = svn_cache__membuffer_child_init(membuffer, pool);
+      if (!err)
+        err = set_twenty(cache, pool);
+      exit(err ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+  else if (status != APR_INPARENT)
+    return svn_error_wrap_apr(status, "apr_proc_fork");
+
+  status = apr_proc_wait(&proc, &exit_code, &exit_why, APR_WAIT);
+  if (status != APR_CHILD_DONE)
+    return svn_error_wrap_apr(status, "apr_proc_wait");
+  if (!APR_PROC_CHECK_EXIT(exit_why) || exit_code != EXIT_SUCCESS)
+    return svn_error_create(SVN_ERR_TEST_FAILED, NULL,
+                            "child process failed to write to the cache");
+
+  /* ... and see its contents in the parent. */
+  SVN_ERR(svn_cache__get((void **) &answer, &found, cache, "twenty", pool));
+  if (! found)
+    return svn_error_create(SVN_ERR_TEST_FAILED, NULL,
+                            "cache entry written by child not found");
+  if (*answer != 20)
+    return svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                             "expected 20 but cache said %ld", *answer);
+
+  return SVN_NO_ERROR;
+#else
+  return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                          "fork not supported");
+#endif
+}
+
+static svn_error_t *
+test_persistent_cache(apr_pool_t *pool)
+{
+  svn_cache__t *cache;
+  svn_membuffer_t *membuffer;
+  svn_boolean_t found;
+  svn_revnum_t *answer;
+  const char *cache_dir;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  int i, hits;
+
+  SVN_ERR(svn_test_make_sandbox_dir(&cache_dir, "cache-test-persistent",
+                                    pool));
+
+  /* Without a front cache, all data comes from disk. */
+  SVN_ERR(svn_cache__create_persistent(&cache, NULL, cache_dir, 0x100000,
+                                       serialize_revnum, deserialize_revnum,
+                                       APR_HASH_KEY_STRING, "cache:",
+                                       pool, pool));
+  SVN_ERR(basic_cache_test(cache, FALSE, pool));
+
+  /* A new instance, e.g. after a restart, still sees the data and puts
+   * it into its front cache. */
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 10*1024, 1, 0,
+                                            TRUE, TRUE, pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache,
+                                            membuffer,
+                                            serialize_revnum,
+                                            deserialize_revnum,
+                                            APR_HASH_KEY_STRING,
+                                            "cache:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE,
+                                            FALSE,
+                                            pool, pool));
+  SVN_ERR(svn_cache__create_persistent(&cache, cache, cache_dir, 0x100000,
+                                       serialize_revnum, deserialize_revnum,
+                                       APR_HASH_KEY_STRING, "cache:",
+                                       pool, pool));
+  SVN_ERR(svn_cache__get((void **) &answer, &found, cache, "twenty", pool));
+  SVN_TEST_ASSERT(found && *answer == 20);
+
+  /* Different prefixes don't see each other's data. */
+  SVN_ERR(svn_cache__create_persistent(&cache, NULL, cache_dir, 0x100000,
+                                       serialize_revnum, deserialize_revnum,
+                                       APR_HASH_KEY_STRING, "other:",
+                                       pool, pool));
+  SVN_ERR(svn_cache__get((void **) &answer, &found, cache, "twenty", pool));
+  SVN_TEST_ASSERT(!found);
+
+  /* Writing much more than the size limit must evict old entries. */
+  SVN_ERR(svn_cache__create_persistent(&cache, NULL, cache_dir, 16 * 1024,
+                                       NULL, NULL, APR_HASH_KEY_STRING,
+                                       "evict:", pool, pool));
+  for (i = 0; i < 100; ++i)
+    {
+      svn_stringbuf_t *value;
+
+      svn_pool_clear(iterpool);
+      value = svn_stringbuf_create_empty(iterpool);
+      while (value->len < 800)
+        svn_stringbuf_appendcstr(value, apr_psprintf(iterpool, "%d", rand()));
+
+      SVN_ERR(svn_cache__set(cache, apr_itoa(iterpool, i), value, iterpool));
+    }
+
+  for (i = 0, hits = 0; i < 100; ++i)
+    {
+      svn_stringbuf_t *value;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_cache__get((void **) &value, &found, cache,
+                             apr_itoa(iterpool, i), iterpool));
+      if (found)
+        {
+          SVN_TEST_ASSERT(value->len >= 800);
+          ++hits;
+        }
+    }
+
+  SVN_TEST_ASSERT(hits > 0 && hits < 100);
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *PATH to the only entry file in the persistent cache at CACHE_DIR.
+ * Allocate it in POOL. */
+static svn_error_t *
+find_persistent_entry(const char **path,
+                      const char *cache_dir,
+                      apr_pool_t *pool)
+{
+  int i;
+
+  *path = NULL;
+  for (i = 0; i < 256; ++i)
+    {
+      const char *subdir = svn_dirent_join(cache_dir,
+                                           apr_psprintf(pool, "%02x", i),
+                                           pool);
+      apr_hash_t *dirents;
+      apr_hash_index_t *hi;
+
+      SVN_ERR(svn_io_get_dirents3(&dirents, subdir, TRUE, pool, pool));
+      for (hi = apr_hash_first(pool, dirents); hi; hi = apr_hash_next(hi))
+        {
+          SVN_TEST_ASSERT(*path == NULL);
+          *path = svn_dirent_join(subdir, apr_hash_this_key(hi), pool);
+        }
+    }
+
+  SVN_TEST_ASSERT(*path != NULL);
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_persistent_cache_corruption(apr_pool_t *pool)
+{
+  svn_cache__t *cache;
+  svn_boolean_t found;
+  svn_stringbuf_t *value;
+  svn_stringbuf_t *contents;
+  const char *cache_dir;
+  const char *path;
+  svn_node_kind_t kind;
+
+  SVN_ERR(svn_test_make_sandbox_dir(&cache_dir,
+                                    "cache-test-persistent-corruption",
+                                    pool));
+  SVN_ERR(svn_cache__create_persistent(&cache, NULL, cache_dir, 0x100000,
+                                       NULL, NULL, APR_HASH_KEY_STRING,
+                                       "cache:", pool, pool));
+
+  /* Flip a bit in the stored value. */
+  value = svn_stringbuf_create("some value to be cached", pool);
+  SVN_ERR(svn_cache__set(cache, "key", value, pool));
+  SVN_ERR(find_persistent_entry(&path, cache_dir, pool));
+  SVN_ERR(svn_stringbuf_from_file2(&contents, path, pool));
+  contents->data[contents->len - 1] ^= 1;
+  SVN_ERR(svn_io_write_atomic2(path, contents->data, contents->len, NULL,
+                               FALSE, pool));
+
+  /* That is a miss and the broken entry gets removed. */
+  SVN_ERR(svn_cache__get((void **) &value, &found, cache, "key", pool));
+  SVN_TEST_ASSERT(!found);
+  SVN_ERR(svn_io_check_path(path, &kind, pool));
+  SVN_TEST_ASSERT(kind == svn_node_none);
+
+  /* Cut the entry short, as a crash before the data got flushed would. */
+  value = svn_stringbuf_create("some value to be cached", pool);
+  SVN_ERR(svn_cache__set(cache, "key", value, pool));
+  SVN_ERR(svn_stringbuf_from_file2(&contents, path, pool));
+  SVN_ERR(svn_io_write_atomic2(path, contents->data, contents->len - 4,
+                               NULL, FALSE, pool));
+
+  SVN_ERR(svn_cache__get((void **) &value, &found, cache, "key", pool));
+  SVN_TEST_ASSERT(!found);
+
+  /* An intact entry is still found. */
+  value = svn_stringbuf_create("some value to be cached", pool);
+  SVN_ERR(svn_cache__set(cache, "key", value, pool));
+  SVN_ERR(svn_cache__get((void **) &value, &found, cache, "key", pool));
+  SVN_TEST_ASSERT(found);
+  SVN_TEST_STRING_ASSERT(value->data, "some value to be cached");
+
+  return SVN_NO_ERROR;
+}
+
 
 /* The test table.  */
 
@@ -616,6 +1088,15 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "test membuffer cache with unaligned string keys"),
     SVN_TEST_PASS2(test_membuffer_unaligned_fixed_keys,
                    "test membuffer cache with unaligned fixed keys"),
+    SVN_TEST_OPTS_SKIP(test_membuffer_concurrent_access,
+                       ! APR_HAS_THREADS,
+                       "concurrent access to membuffer cache"),
+    SVN_TEST_PASS2(test_membuffer_shared_cache,
+                   "membuffer cache shared between processes"),
+    SVN_TEST_PASS2(test_persistent_cache,
+                   "basic persistent svn_cache test"),
+    SVN_TEST_PASS2(test_persistent_cache_corruption,
+                   "persistent svn_cache with corrupted entries"),
     SVN_TEST_NULL
   };
 
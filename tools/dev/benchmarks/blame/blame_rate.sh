@@ -0,0 +1,119 @@
+#!/bin/sh
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# Measures the client-side blame calculation on a large file with a long
+# history.  Every revision inserts, replaces and deletes lines at a few
+# pseudo-random places throughout the file, so the blame chain ends up
+# with many small chunks.
+#
+# A plain forward 'svn blame' lets the server do the work.  Including
+# merged revisions or blaming a reverse range still makes the client
+# combine the file revisions itself, so both are timed here.  The time
+# that 'svnbench null-blame' takes just to fetch the file revisions is
+# reported for reference.
+#
+# usage: run this script from the root of your working copy
+#        and / or adjust the path settings below as needed
+
+# set SVNPATH to the 'subversion' folder of your SVN source code w/c
+
+SVNPATH="$('pwd')/subversion"
+
+SVN=${SVNPATH}/svn/svn
+SVNADMIN=${SVNPATH}/svnadmin/svnadmin
+SVNBENCH=${SVNPATH}/svnbench/svnbench
+
+# set your data paths here
+
+REPOROOT=/dev/shm
+REPONAME=blame
+URL=file://${REPOROOT}/$REPONAME
+WC=$REPOROOT/$REPONAME.wc
+
+# initial number of lines in the file, number of revisions to commit
+# and number of places to edit per revision
+
+LINES=100000
+REVS=1000
+EDITS=20
+
+# from here on, we should be good
+
+get_sequence() {
+  # three equivalents...
+  (jot - "$1" "$2" "1" 2>/dev/null || seq -s ' ' "$1" "$2" 2>/dev/null || python -c "for i in range($1,$2+1): print(i)")
+}
+
+now() {
+  date +%s.%N 2>/dev/null || date +%s
+}
+
+# Print the seconds since $1 with the label $2.
+report() {
+  echo "$2 $1 `now`" | awk '{ printf "  %-10s %8.2f s\n", $1, $3 - $2 }'
+}
+
+# Rewrite file $1 for revision $2: at $EDITS places, either insert,
+# replace or delete a few lines.
+edit_file() {
+  awk -v rev=$2 -v edits=$EDITS -v lines=`wc -l < $1` '
+    BEGIN {
+      srand(rev);
+      for (i = 0; i < edits; ++i)
+        op[int(rand() * lines) + 1] = int(rand() * 3);
+    }
+    {
+      if (!(NR in op)) { print; next }
+      if (op[NR] == 0) { print "inserted in r" rev; print }
+      else if (op[NR] == 1) { print "replaced in r" rev }
+    }' $1 > $1.tmp && mv $1.tmp $1
+}
+
+printf "using "
+${SVN} --version | grep " version"
+echo "blaming a file of $LINES lines with $REVS revisions, $EDITS edits each"
+
+rm -rf $REPOROOT/$REPONAME $WC
+${SVNADMIN} create $REPOROOT/$REPONAME
+${SVN} co -q $URL $WC
+
+get_sequence 1 $LINES | tr ' ' '\n' | sed 's/^/line /' > $WC/file
+${SVN} add -q $WC/file
+${SVN} ci -q -m "" $WC
+
+START=`now`
+for REV in `get_sequence 2 $REVS`; do
+  edit_file $WC/file $REV
+  ${SVN} ci -q -m "" $WC || exit 1
+done
+report $START "commit"
+
+START=`now`
+${SVNBENCH} null-blame -q $URL/file > /dev/null || exit 1
+report $START "fetch"
+
+START=`now`
+${SVN} blame -g $URL/file > /dev/null || exit 1
+report $START "merged"
+
+START=`now`
+${SVN} blame -r HEAD:1 $URL/file > /dev/null || exit 1
+report $START "reverse"
+
+rm -rf $REPOROOT/$REPONAME $WC
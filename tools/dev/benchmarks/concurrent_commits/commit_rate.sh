@@ -0,0 +1,92 @@
+#!/bin/sh
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# Measures how the commit rate of a FSFS repository scales with the
+# number of concurrent committers.  Every committer uses svnmucc to
+# repeatedly replace its own file, so there are no conflicts and all
+# contention happens inside the repository.
+#
+# usage: run this script from the root of your working copy
+#        and / or adjust the path settings below as needed
+
+# set SVNPATH to the 'subversion' folder of your SVN source code w/c
+
+SVNPATH="$('pwd')/subversion"
+
+SVNADMIN=${SVNPATH}/svnadmin/svnadmin
+SVNMUCC=${SVNPATH}/svnmucc/svnmucc
+
+# set your data paths here
+
+REPOROOT=/dev/shm
+REPONAME=commits
+URL=file://${REPOROOT}/$REPONAME
+
+# commits per committer and the committer counts to test
+
+COMMITS=200
+CLIENTS="1 2 4 8 16"
+
+# size of the file contents (in KB) written by every commit
+
+FILESIZE=64
+
+# from here on, we should be good
+
+get_sequence() {
+  # three equivalents...
+  (jot - "$1" "$2" "1" 2>/dev/null || seq -s ' ' "$1" "$2" 2>/dev/null || python -c "for i in range($1,$2+1): print(i)")
+}
+
+now() {
+  date +%s.%N 2>/dev/null || date +%s
+}
+
+committer() {
+  sequence=`get_sequence 1 $COMMITS`
+  for i in $sequence; do
+    ${SVNMUCC} -U $URL -m "" put $DATA client_$1 > /dev/null || exit 1
+  done
+}
+
+DATA=$REPOROOT/$REPONAME.data
+dd if=/dev/urandom of=$DATA bs=1024 count=$FILESIZE 2>/dev/null
+
+printf "using "
+${SVNMUCC} --version | grep " version"
+echo
+printf "clients  commits   seconds  commits/s\n"
+
+for CLIENTCOUNT in $CLIENTS; do
+  rm -rf $REPOROOT/$REPONAME
+  ${SVNADMIN} create $REPOROOT/$REPONAME
+
+  START=`now`
+  for CLIENT in `get_sequence 1 $CLIENTCOUNT`; do
+    committer $CLIENT &
+  done
+  wait
+  END=`now`
+
+  TOTAL=`expr $CLIENTCOUNT \* $COMMITS`
+  echo "$CLIENTCOUNT $TOTAL $START $END" \
+    | awk '{ t = $4 - $3; printf "%7d  %7d  %8.2f  %9.1f\n", $1, $2, t, $2 / t }'
+done
+
+rm -rf $REPOROOT/$REPONAME $DATA
@@ -0,0 +1,108 @@
+#!/bin/sh
+
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# Compares the FSFS lock stores: the digest file tree below db/locks
+# and the indexed lock database enabled by 'enable-lock-db' in fsfs.conf.
+# For each store, this locks a large number of files in a single
+# 'svn lock' call, lists all locks from the repository root with
+# 'svnadmin lslocks' and finally unlocks everything again.
+#
+# usage: run this script from the root of your working copy
+#        and / or adjust the path settings below as needed
+
+# set SVNPATH to the 'subversion' folder of your SVN source code w/c
+
+SVNPATH="$('pwd')/subversion"
+
+SVN=${SVNPATH}/svn/svn
+SVNADMIN=${SVNPATH}/svnadmin/svnadmin
+
+# set your data paths here
+
+REPOROOT=/dev/shm
+REPONAME=locks
+URL=file://${REPOROOT}/$REPONAME
+
+# number of files to lock, spread over DIRS directories
+
+FILES=10000
+DIRS=100
+
+# from here on, we should be good
+
+get_sequence() {
+  # three equivalents...
+  (jot - "$1" "$2" "1" 2>/dev/null || seq -s ' ' "$1" "$2" 2>/dev/null || python -c "for i in range($1,$2+1): print(i)")
+}
+
+now() {
+  date +%s.%N 2>/dev/null || date +%s
+}
+
+# Print the seconds since $1 with the label $2.
+report() {
+  echo "$2 $1 `now`" | awk '{ printf "  %-10s %8.2f s\n", $1, $3 - $2 }'
+}
+
+# Create the import source and the list of URLs to lock, once.
+
+DATA=$REPOROOT/$REPONAME.data
+TARGETS=$REPOROOT/$REPONAME.targets
+rm -rf $DATA $TARGETS
+mkdir $DATA
+
+PER_DIR=`expr $FILES / $DIRS`
+for DIR in `get_sequence 1 $DIRS`; do
+  mkdir $DATA/dir_$DIR
+  for FILE in `get_sequence 1 $PER_DIR`; do
+    echo "$DIR $FILE" > $DATA/dir_$DIR/file_$FILE
+    echo "$URL/dir_$DIR/file_$FILE" >> $TARGETS
+  done
+done
+
+printf "using "
+${SVN} --version | grep " version"
+echo "locking `wc -l < $TARGETS` files in $DIRS directories"
+
+for STORE in digest-tree lock-db; do
+  rm -rf $REPOROOT/$REPONAME
+  ${SVNADMIN} create $REPOROOT/$REPONAME
+  if [ $STORE = lock-db ]; then
+    printf "\n[locks]\nenable-lock-db = true\n" \
+      >> $REPOROOT/$REPONAME/db/fsfs.conf
+  fi
+  ${SVN} import -q -m "" $DATA $URL
+
+  echo
+  echo "$STORE:"
+
+  START=`now`
+  ${SVN} lock -q --targets $TARGETS > /dev/null || exit 1
+  report $START "lock"
+
+  START=`now`
+  ${SVNADMIN} lslocks $REPOROOT/$REPONAME / > /dev/null || exit 1
+  report $START "get-locks"
+
+  START=`now`
+  ${SVN} unlock -q --targets $TARGETS > /dev/null || exit 1
+  report $START "unlock"
+done
+
+rm -rf $REPOROOT/$REPONAME $DATA $TARGETS